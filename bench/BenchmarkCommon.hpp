@@ -0,0 +1,252 @@
+#pragma once
+
+// Harness shared by the headless benchmarks and checks: argument parsing, timing summaries,
+// result tables written as text, csv or json, pass/fail bookkeeping and a box model to build
+// scenes from. Each tool only keeps its scenario.
+
+#include "Model.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+    struct BenchmarkOptions {
+        // Scene sizes to run, one result row each
+        std::vector<uint32_t> counts;
+        std::string format = "text";
+        std::string output;
+    };
+
+    // Parses --counts a,b,c, --format and --output. Every other "--name value" pair goes to
+    // parseOption, which returns false for a name it does not know.
+    inline BenchmarkOptions parseBenchmarkArguments(
+        int argc,
+        char** argv,
+        std::vector<uint32_t> defaultCounts,
+        const std::function<bool(const std::string& name, const std::string& value)>& parseOption) {
+        BenchmarkOptions options{};
+        options.counts = std::move(defaultCounts);
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc) {
+                throw std::runtime_error("missing value for " + arg);
+            }
+            std::string value = argv[++i];
+            if (arg == "--counts") {
+                options.counts.clear();
+                std::stringstream stream{ value };
+                std::string count;
+                while (std::getline(stream, count, ',')) {
+                    options.counts.push_back(static_cast<uint32_t>(std::stoul(count)));
+                }
+            } else if (arg == "--format") {
+                options.format = value;
+            } else if (arg == "--output") {
+                options.output = value;
+            } else if (!parseOption || !parseOption(arg, value)) {
+                throw std::runtime_error("unknown argument: " + arg);
+            }
+        }
+        return options;
+    }
+
+    inline double elapsedMs(std::chrono::high_resolution_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    struct TimingSummary {
+        double mean = 0.0;
+        double p95 = 0.0;
+        double max = 0.0;
+    };
+
+    // Zero for no samples
+    inline TimingSummary summarizeTimes(std::vector<double> times) {
+        TimingSummary summary{};
+        if (times.empty()) {
+            return summary;
+        }
+        double total = 0.0;
+        for (double time : times) {
+            total += time;
+        }
+        const double count = static_cast<double>(times.size());
+        summary.mean = total / count;
+        std::sort(times.begin(), times.end());
+        summary.p95 = times[std::min(times.size() - 1, static_cast<size_t>(count * .95))];
+        summary.max = times.back();
+        return summary;
+    }
+
+    // One row per run, one column per measured value
+    class BenchmarkTable {
+    public:
+        struct Column {
+            // csv and json key
+            std::string key;
+            // Text table header
+            std::string label;
+            int width;
+            // Written without decimals
+            bool integer = false;
+        };
+
+        explicit BenchmarkTable(std::vector<Column> columns) : m_columns{ std::move(columns) } {}
+
+        // values in column order
+        void addRow(std::vector<double> values) {
+            if (values.size() != m_columns.size()) {
+                throw std::runtime_error("benchmark row does not match its columns");
+            }
+            m_rows.push_back(std::move(values));
+        }
+
+        void write(std::ostream& out, const std::string& format) const {
+            out << std::fixed;
+            if (format == "csv") {
+                for (size_t c = 0; c < m_columns.size(); c++) {
+                    out << (c > 0 ? "," : "") << m_columns[c].key;
+                }
+                out << '\n';
+                for (const auto& row : m_rows) {
+                    for (size_t c = 0; c < m_columns.size(); c++) {
+                        out << (c > 0 ? "," : "");
+                        writeValue(out, c, row[c]);
+                    }
+                    out << '\n';
+                }
+            } else if (format == "json") {
+                out << "[\n";
+                for (size_t r = 0; r < m_rows.size(); r++) {
+                    for (size_t c = 0; c < m_columns.size(); c++) {
+                        out << (c > 0 ? ", \"" : "  {\"") << m_columns[c].key << "\": ";
+                        writeValue(out, c, m_rows[r][c]);
+                    }
+                    out << (r + 1 < m_rows.size() ? "},\n" : "}\n");
+                }
+                out << "]\n";
+            } else {
+                for (const auto& column : m_columns) {
+                    out << std::setw(column.width) << column.label;
+                }
+                out << '\n';
+                for (const auto& row : m_rows) {
+                    for (size_t c = 0; c < m_columns.size(); c++) {
+                        out << std::setw(m_columns[c].width);
+                        writeValue(out, c, row[c]);
+                    }
+                    out << '\n';
+                }
+            }
+        }
+
+        // To --output when it is set, otherwise to stdout
+        void write(const BenchmarkOptions& options) const {
+            if (options.output.empty()) {
+                write(std::cout, options.format);
+                return;
+            }
+            std::ofstream file{ options.output };
+            if (!file.is_open()) {
+                throw std::runtime_error("failed to open file: " + options.output);
+            }
+            write(file, options.format);
+        }
+
+    private:
+        void writeValue(std::ostream& out, size_t column, double value) const {
+            out << std::setprecision(m_columns[column].integer ? 0 : 3) << value;
+        }
+
+        std::vector<Column> m_columns;
+        std::vector<std::vector<double>> m_rows;
+    };
+
+    // Runs one row per count, announcing each on stderr as "running <count> <unit>...", then
+    // writes the table
+    inline void runBenchmarks(
+        const BenchmarkOptions& options,
+        const std::string& unit,
+        std::vector<BenchmarkTable::Column> columns,
+        const std::function<std::vector<double>(uint32_t count)>& runRow) {
+        BenchmarkTable table{ std::move(columns) };
+        for (uint32_t count : options.counts) {
+            std::cerr << "running " << count << " " << unit << "..." << std::endl;
+            table.addRow(runRow(count));
+        }
+        table.write(options);
+    }
+
+    // Unit cube around the origin, without GPU buffers
+    inline std::shared_ptr<Model> createBoxModel() {
+        Model::Builder builder{};
+        const glm::vec3 color{ .8f, .8f, .8f };
+        for (int i = 0; i < 8; i++) {
+            Model::Vertex vertex{};
+            vertex.position = {
+                (i & 1) ? .5f : -.5f,
+                (i & 2) ? .5f : -.5f,
+                (i & 4) ? .5f : -.5f };
+            vertex.color = color;
+            builder.vertices.push_back(vertex);
+        }
+        builder.indices = {
+            0, 1, 3, 0, 3, 2,  4, 6, 7, 4, 7, 5,
+            0, 4, 5, 0, 5, 1,  2, 3, 7, 2, 7, 6,
+            0, 2, 6, 0, 6, 4,  1, 5, 7, 1, 7, 3 };
+        return std::make_shared<Model>(builder);
+    }
+
+    // Exit status ctest treats as skipped (SKIP_RETURN_CODE), for checks this machine cannot run
+    static constexpr int EXIT_SKIPPED = 77;
+
+    // Counts checks and reports the ones that fail, so a tool can run under ctest
+    class CheckResult {
+    public:
+        void expect(bool condition, const std::string& name) {
+            m_checks++;
+            if (!condition) {
+                m_failures++;
+                std::cerr << "FAILED: " << name << std::endl;
+            }
+        }
+
+        uint32_t getChecks() const { return m_checks; }
+        uint32_t getFailures() const { return m_failures; }
+        bool passed() const { return m_failures == 0; }
+
+        // Summary line, then the exit status for main
+        int report() const {
+            std::cout << m_checks - m_failures << " of " << m_checks << " checks passed" << std::endl;
+            return passed() ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+    private:
+        uint32_t m_checks = 0;
+        uint32_t m_failures = 0;
+    };
+
+    // Runs a tool's main body, turning anything it throws into a failure status
+    inline int runGuarded(const std::function<int()>& body) {
+        try {
+            return body();
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+} // namespace engine
@@ -0,0 +1,295 @@
+// Headless test and stress test for RenderBvh frustum culling.
+// First checks CullingSystem against a brute force sphere test while entities move, appear
+// and disappear and the camera creeps, jumps and turns, so kept walks and retests of single
+// entities are covered, then the batched sphere test against the single one. Then scatters N
+// static boxes over a large plane plus a share of moving ones, builds a static and a dynamic
+// tree like CullingSystem does, turns a camera in place and reports build, cull and dynamic
+// refit timings without creating a window or a Vulkan device. Exits with a failure status if
+// a check fails.
+//
+// usage: culling_bench [--counts 10000,100000,1000000] [--frames 240] [--dynamic 0.01]
+//                      [--format text|csv|json] [--output file]
+
+#include "BenchmarkCommon.hpp"
+#include "Camera.hpp"
+#include "RenderBvh.hpp"
+#include "systems/CullingSystem.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+    struct BenchmarkConfig {
+        uint32_t frames = 240;
+        // Share of the objects that move every frame
+        float dynamicShare = .01f;
+    };
+
+    static const std::vector<BenchmarkTable::Column> RESULT_COLUMNS{
+        { "objects", "objects", 10, true },
+        { "dynamic_objects", "dynamic", 10, true },
+        { "frames", "frames", 8, true },
+        { "build_ms", "build ms", 12 },
+        { "static_cull_ms", "cull ms", 12 },
+        { "p95_static_cull_ms", "p95 ms", 12 },
+        { "max_static_cull_ms", "max ms", 12 },
+        { "dynamic_ms", "dynamic ms", 14 },
+        { "visible", "visible", 12 },
+        { "nodes_visited", "nodes", 12 },
+        { "dynamic_rebuilds", "rebuilds", 10, true } };
+
+    // Every entity whose world sphere reaches into the frustum must be reported, once
+    static void runChecks(CheckResult& result) {
+        EntityManager entityManager{ 600 };
+        std::shared_ptr<Model> box = createBoxModel();
+        std::mt19937 rng{ 4321u };
+        std::uniform_real_distribution<float> position{ -40.f, 40.f };
+        std::uniform_real_distribution<float> unit{ -1.f, 1.f };
+        auto spawn = [&](bool movable) {
+            const uint32_t entity = entityManager.createEntity();
+            entityManager.addComponent(entity, ComponentType::Model);
+            ModelComponent modelComponent{};
+            modelComponent.model = box;
+            entityManager.setComponentData(entity, modelComponent);
+            entityManager.addComponent(entity, ComponentType::Transform);
+            TransformComponent transform{};
+            transform.translation = { position(rng), position(rng) * .25f, position(rng) };
+            entityManager.setComponentData(entity, transform);
+            if (movable) {
+                entityManager.addComponent(entity, ComponentType::Physics);
+                PhysicsComponent physics{};
+                physics.movable = true;
+                entityManager.setComponentData(entity, physics);
+            }
+            return entity;
+        };
+        std::vector<uint32_t> entities;
+        for (uint32_t i = 0; i < 400; i++) {
+            entities.push_back(spawn(i % 4 == 0));
+        }
+
+        Camera camera{};
+        camera.setPerspectiveProjection(glm::radians(50.f), 16.f / 9.f, .1f, 60.f);
+        glm::vec3 eye{ 0.f };
+        glm::vec3 direction{ 0.f, 0.f, 1.f };
+        CullingSystem cullingSystem;
+        FrameInfo frameInfo{ 0, 1.f / 60.f, VK_NULL_HANDLE, camera, VK_NULL_HANDLE, entityManager };
+
+        uint32_t missed = 0;
+        uint32_t stale = 0;
+        uint32_t duplicated = 0;
+        uint32_t retested = 0;
+        uint32_t walks = 0;
+        uint32_t culled = 0;
+        for (uint32_t frame = 0; frame < 240; frame++) {
+            // Mostly steps below the motion threshold, now and then a jump or a turn
+            if (frame % 40 == 39) {
+                direction = glm::normalize(glm::vec3{ unit(rng), unit(rng) * .3f, unit(rng) });
+            } else if (frame % 10 == 9) {
+                eye += glm::vec3{ unit(rng), 0.f, unit(rng) } * 2.f;
+            } else {
+                eye += glm::vec3{ unit(rng), 0.f, unit(rng) } * .005f;
+            }
+            camera.setViewDirection(eye, direction);
+
+            for (uint32_t i = 0; i < entities.size(); i += 4) {
+                TransformComponent transform = entityManager.getComponentData<TransformComponent>(entities[i]);
+                transform.translation += glm::vec3{ unit(rng), unit(rng), unit(rng) } * (frame % 3 == 0 ? 1.5f : .02f);
+                entityManager.setComponentData(entities[i], transform);
+            }
+            // Now and then a static entity starts moving for good
+            if (frame % 8 == 0) {
+                const uint32_t entity = entities[1 + (frame / 8) % (entities.size() - 1)];
+                TransformComponent transform = entityManager.getComponentData<TransformComponent>(entity);
+                transform.translation.x += 3.f;
+                entityManager.setComponentData(entity, transform);
+            }
+            if (frame % 16 == 5) {
+                entityManager.destroyEntity(entities.back());
+                entities.pop_back();
+                entities.push_back(spawn(frame % 32 == 5));
+            }
+
+            cullingSystem.update(frameInfo);
+            const CullingStats& stats = cullingSystem.getStats();
+            retested += stats.retested;
+            walks += stats.reused ? 0 : 1;
+            culled += stats.culled;
+
+            const std::vector<uint32_t>& visible = cullingSystem.getVisibleEntities();
+            const std::set<uint32_t> reported{ visible.begin(), visible.end() };
+            duplicated += static_cast<uint32_t>(visible.size() - reported.size());
+            const Frustum frustum = camera.getFrustum();
+            for (const uint32_t entity : entities) {
+                TransformComponent transform = entityManager.getComponentData<TransformComponent>(entity);
+                const BoundingSphere sphere = CullingSystem::getWorldSphere(*box, transform);
+                const bool reportedVisible = reported.count(entity) != 0;
+                if (CullingSystem::isSphereVisible(frustum, sphere.center, sphere.radius) && !reportedVisible) {
+                    missed++;
+                }
+                // The walk tests the box around the sphere, grown by the motion threshold, against
+                // planes the camera may since have moved the threshold away from
+                const float slack = sphere.radius * 1.75f + 2.f * CullingSystem::MOTION_THRESHOLD;
+                if (reportedVisible && !CullingSystem::isSphereVisible(frustum, sphere.center, slack)) {
+                    stale++;
+                }
+            }
+        }
+        std::cerr << walks << " walks and " << retested << " single entity retests over 240 frames" << std::endl;
+
+        // The batch test against the scalar one, over a count that leaves a tail past the lanes
+        std::vector<glm::vec4> spheres;
+        for (uint32_t i = 0; i < 1003; i++) {
+            spheres.push_back({ position(rng), position(rng), position(rng), (unit(rng) + 1.f) * 4.f });
+        }
+        std::vector<uint8_t> batchVisible;
+        CullingSystem::testSpheres(camera.getFrustum(), spheres, batchVisible);
+        uint32_t batchMismatches = 0;
+        uint32_t batchCulled = 0;
+        for (uint32_t i = 0; i < spheres.size(); i++) {
+            const bool expected = CullingSystem::isSphereVisible(camera.getFrustum(), glm::vec3{ spheres[i] }, spheres[i].w);
+            batchMismatches += (batchVisible[i] != 0) != expected ? 1 : 0;
+            batchCulled += expected ? 0 : 1;
+        }
+
+        result.expect(missed == 0, "no entity reaching into the frustum is culled");
+        result.expect(stale == 0, "no entity well outside the frustum is reported");
+        result.expect(duplicated == 0, "no entity is reported twice");
+        result.expect(walks > 1 && walks < 240, "small camera steps keep the walk");
+        result.expect(retested > 0, "moving entities are retested between walks");
+        result.expect(culled > 0, "entities outside the frustum are culled");
+        result.expect(batchMismatches == 0 && batchCulled > 0, "batched sphere tests match single ones");
+    }
+
+    // One row of RESULT_COLUMNS
+    static std::vector<double> runBenchmark(uint32_t objectCount, const BenchmarkConfig& config) {
+        const uint32_t dynamicCount = static_cast<uint32_t>(objectCount * config.dynamicShare);
+        const uint32_t staticCount = objectCount - dynamicCount;
+        // Keeps density the same across counts, about one box per 4 square units
+        const float extent = 2.f * std::sqrt(static_cast<float>(objectCount));
+
+        std::mt19937 rng{ 1234u };
+        std::uniform_real_distribution<float> position{ -extent * .5f, extent * .5f };
+        std::uniform_real_distribution<float> height{ -10.f, 0.f };
+        std::uniform_real_distribution<float> size{ .25f, 1.f };
+        std::uniform_real_distribution<float> step{ -.1f, .1f };
+        auto randomBounds = [&]() {
+            const glm::vec3 center{ position(rng), height(rng), position(rng) };
+            const float halfSize = size(rng);
+            BvhBounds bounds;
+            bounds.min = center - glm::vec3{ halfSize };
+            bounds.max = center + glm::vec3{ halfSize };
+            return bounds;
+        };
+
+        RenderBvh staticTree;
+        for (uint32_t i = 0; i < staticCount; i++) {
+            staticTree.insert(i, randomBounds());
+        }
+        auto buildStart = std::chrono::high_resolution_clock::now();
+        staticTree.rebuild();
+        const double buildMs = elapsedMs(buildStart);
+
+        RenderBvh dynamicTree;
+        std::vector<uint32_t> handles(dynamicCount);
+        std::vector<BvhBounds> dynamicBounds(dynamicCount);
+        for (uint32_t i = 0; i < dynamicCount; i++) {
+            dynamicBounds[i] = randomBounds();
+            handles[i] = dynamicTree.insert(staticCount + i, dynamicBounds[i]);
+        }
+        dynamicTree.rebuild();
+
+        // +y points down in this engine, so the camera looks out over the boxes from above them
+        Camera camera{};
+        camera.setPerspectiveProjection(glm::radians(50.f), 16.f / 9.f, .1f, 500.f);
+
+        std::vector<BvhCullHit> visible;
+        visible.reserve(objectCount);
+        std::vector<double> staticTimes;
+        staticTimes.reserve(config.frames);
+        double dynamicTotal = 0.0;
+        double visibleTotal = 0.0;
+        double nodesTotal = 0.0;
+        for (uint32_t frame = 0; frame < config.frames; frame++) {
+            const float yaw = glm::two_pi<float>() * frame / std::max(config.frames, 1u);
+            camera.setViewDirection({ 0.f, -20.f, 0.f }, { std::cos(yaw), .2f, std::sin(yaw) });
+            const Frustum frustum = camera.getFrustum();
+            visible.clear();
+            BvhCullStats stats{};
+
+            auto staticStart = std::chrono::high_resolution_clock::now();
+            staticTree.maintain();
+            staticTree.cull(frustum, 0.f, visible, stats);
+            staticTimes.push_back(elapsedMs(staticStart));
+
+            auto dynamicStart = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < dynamicCount; i++) {
+                const glm::vec3 offset{ step(rng), step(rng), step(rng) };
+                dynamicBounds[i].min += offset;
+                dynamicBounds[i].max += offset;
+                dynamicTree.update(handles[i], dynamicBounds[i]);
+            }
+            dynamicTree.maintain();
+            dynamicTree.cull(frustum, 0.f, visible, stats);
+            dynamicTotal += elapsedMs(dynamicStart);
+
+            visibleTotal += static_cast<double>(visible.size());
+            nodesTotal += stats.nodesVisited;
+        }
+
+        const TimingSummary staticCull = summarizeTimes(staticTimes);
+        const double frameCount = std::max(static_cast<double>(config.frames), 1.0);
+        return {
+            static_cast<double>(objectCount),
+            static_cast<double>(dynamicCount),
+            static_cast<double>(config.frames),
+            buildMs,
+            staticCull.mean,
+            staticCull.p95,
+            staticCull.max,
+            dynamicTotal / frameCount,
+            visibleTotal / frameCount,
+            nodesTotal / frameCount,
+            static_cast<double>(dynamicTree.getBuildCount() - 1) };
+    }
+
+    static bool parseOption(BenchmarkConfig& config, const std::string& name, const std::string& value) {
+        if (name == "--frames") {
+            config.frames = static_cast<uint32_t>(std::stoul(value));
+        } else if (name == "--dynamic") {
+            config.dynamicShare = std::clamp(std::stof(value), 0.f, 1.f);
+        } else {
+            return false;
+        }
+        return true;
+    }
+} // namespace engine
+
+int main(int argc, char** argv) {
+    return engine::runGuarded([&]() {
+        engine::BenchmarkConfig config{};
+        const engine::BenchmarkOptions options = engine::parseBenchmarkArguments(
+            argc, argv, { 10000, 100000, 1000000 }, [&config](const std::string& name, const std::string& value) {
+                return engine::parseOption(config, name, value);
+            });
+        engine::CheckResult checks;
+        engine::runChecks(checks);
+        if (!checks.passed()) {
+            return EXIT_FAILURE;
+        }
+
+        engine::runBenchmarks(options, "objects", engine::RESULT_COLUMNS, [&config](uint32_t count) {
+            return engine::runBenchmark(count, config);
+        });
+        return EXIT_SUCCESS;
+    });
+}
@@ -0,0 +1,328 @@
+// Headless check of instance_cull.comp against the CPU reference tests in CullingSystem.
+// Creates a Vulkan device without a window, fills the culling buffers with instances, some
+// split into meshlets with normal cones, dispatches the shader alone for a camera that moves
+// and turns, and reads back each draw's instance count and visible indices. A count must lie
+// between the reference results with every sphere shrunk and grown by
+// CullingSystem::REFERENCE_TOLERANCE, so rounding at a boundary is not a failure.
+//
+// Exits with a failure status on any disagreement, and with EXIT_SKIPPED when there is no
+// Vulkan device or it lacks drawIndirectFirstInstance, which the GPU culling path needs.
+// Loads shaders/instance_cull.comp.spv relative to ENGINE_DIR, like the app does.
+//
+// usage: gpu_culling_check [--instances 4096] [--frames 16]
+
+#include "BenchmarkCommon.hpp"
+#include "Buffer.hpp"
+#include "Descriptors.hpp"
+#include "GpuCullingData.hpp"
+#include "Pipeline.hpp"
+#include "systems/CullingSystem.hpp"
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+    struct CheckConfig {
+        uint32_t instances = 4096;
+        uint32_t frames = 16;
+    };
+
+    // Meshlets in model space shared by every instance split into meshlets
+    static constexpr uint32_t MESHLETS_PER_INSTANCE = 8;
+
+    struct CullingScene {
+        std::vector<CullData> cullData;
+        std::vector<InstanceData> instances;
+        std::vector<Meshlet> meshlets;
+        uint32_t drawCount = 0;
+    };
+
+    // Random instances over a 200 unit cube, every third one split into meshlets; every draw
+    // belongs to one instance, so each expected count is 0 or 1
+    static CullingScene buildScene(uint32_t instanceCount) {
+        std::mt19937 rng{ 2024u };
+        std::uniform_real_distribution<float> position{ -100.f, 100.f };
+        std::uniform_real_distribution<float> unit{ -1.f, 1.f };
+        std::uniform_real_distribution<float> size{ .25f, 4.f };
+
+        CullingScene scene;
+        for (uint32_t m = 0; m < MESHLETS_PER_INSTANCE; m++) {
+            Meshlet meshlet{};
+            meshlet.sphere = glm::vec4{ unit(rng) * .5f, unit(rng) * .5f, unit(rng) * .5f, .3f };
+            const glm::vec3 axis = glm::normalize(glm::vec3{ unit(rng), unit(rng), unit(rng) } + glm::vec3{ 0.f, 0.f, .01f });
+            // Mostly narrow cones, now and then one with a triangle facing every way
+            meshlet.cone = glm::vec4{ axis, m % 4 == 3 ? 1.f : std::abs(unit(rng)) * .8f };
+            scene.meshlets.push_back(meshlet);
+        }
+
+        for (uint32_t i = 0; i < instanceCount; i++) {
+            const bool meshlets = i % 3 == 0;
+            // Non-uniform scale disables the cone test, as it does in SimpleRenderSystem
+            const bool uniform = i % 5 != 0;
+            const float scale = size(rng);
+            const glm::vec3 scales = uniform ? glm::vec3{ scale } : glm::vec3{ scale, scale * .5f, scale * 1.5f };
+            glm::mat4 modelMatrix = glm::translate(glm::mat4{ 1.f }, { position(rng), position(rng), position(rng) });
+            modelMatrix = glm::rotate(modelMatrix, unit(rng) * glm::pi<float>(), glm::normalize(glm::vec3{ unit(rng), 1.f, unit(rng) }));
+            modelMatrix = glm::scale(modelMatrix, scales);
+
+            InstanceData instance{};
+            instance.modelMatrix = modelMatrix;
+            instance.normalMatrix = glm::mat4{ glm::transpose(glm::inverse(glm::mat3{ modelMatrix })) };
+            scene.instances.push_back(instance);
+
+            CullData data{};
+            // The model's sphere is the unit sphere around the origin
+            data.sphere = glm::vec4{ glm::vec3{ modelMatrix[3] }, std::max({ scales.x, scales.y, scales.z }) };
+            data.drawIndex = scene.drawCount;
+            data.firstMeshlet = 0;
+            data.meshletCount = meshlets ? MESHLETS_PER_INSTANCE : 0;
+            data.flags = meshlets && uniform ? CULL_CONE : 0;
+            scene.cullData.push_back(data);
+            scene.drawCount += meshlets ? MESHLETS_PER_INSTANCE : 1;
+        }
+        return scene;
+    }
+
+    // Reference count of each draw with every sphere grown by margin
+    static std::vector<uint32_t> countReference(
+        const CullingScene& scene, const Frustum& frustum, const glm::vec3& cameraPosition, float margin) {
+        std::vector<uint32_t> counts(scene.drawCount, 0);
+        for (size_t i = 0; i < scene.cullData.size(); i++) {
+            const CullData& data = scene.cullData[i];
+            if (!CullingSystem::isSphereVisible(frustum, glm::vec3{ data.sphere }, data.sphere.w + margin)) {
+                continue;
+            }
+            if (data.meshletCount == 0) {
+                counts[data.drawIndex]++;
+                continue;
+            }
+            for (uint32_t m = 0; m < data.meshletCount; m++) {
+                if (CullingSystem::isMeshletVisible(
+                    frustum,
+                    cameraPosition,
+                    scene.meshlets[data.firstMeshlet + m],
+                    scene.instances[i].modelMatrix,
+                    glm::mat3{ scene.instances[i].normalMatrix },
+                    (data.flags & CULL_CONE) != 0,
+                    margin)) {
+                    counts[data.drawIndex + m]++;
+                }
+            }
+        }
+        return counts;
+    }
+
+    static int runChecks(Device& device, const CheckConfig& config) {
+        CullingScene scene = buildScene(config.instances);
+        const uint32_t instanceCount = static_cast<uint32_t>(scene.instances.size());
+
+        auto createBuffer = [&](VkDeviceSize instanceSize, uint32_t count, VkMemoryPropertyFlags properties) {
+            auto buffer = std::make_unique<Buffer>(
+                device, instanceSize, count, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, properties);
+            if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+                buffer->map();
+            }
+            return buffer;
+        };
+        auto cullBuffer = createBuffer(sizeof(CullData), instanceCount, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        auto drawBuffer = createBuffer(
+            sizeof(VkDrawIndexedIndirectCommand), scene.drawCount, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        // One slot per draw, since every draw has at most one instance
+        auto visibleBuffer = createBuffer(sizeof(uint32_t), scene.drawCount, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        auto instanceBuffer = createBuffer(sizeof(InstanceData), instanceCount, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        auto meshletBuffer = createBuffer(
+            sizeof(MeshletBounds), static_cast<uint32_t>(scene.meshlets.size()), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        auto occludedBuffer = createBuffer(sizeof(uint32_t), instanceCount, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        cullBuffer->writeToBuffer(scene.cullData.data());
+        cullBuffer->flush();
+        instanceBuffer->writeToBuffer(scene.instances.data());
+        instanceBuffer->flush();
+        std::vector<MeshletBounds> meshletBounds;
+        for (const Meshlet& meshlet : scene.meshlets) {
+            meshletBounds.push_back({ meshlet.sphere, meshlet.cone });
+        }
+        meshletBuffer->writeToBuffer(meshletBounds.data());
+        meshletBuffer->flush();
+
+        auto setLayout = DescriptorSetLayout::Builder(device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
+        auto pool = DescriptorPool::Builder(device)
+            .setMaxSets(1)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 7)
+            .build();
+        auto cullInfo = cullBuffer->descriptorInfo();
+        auto drawInfo = drawBuffer->descriptorInfo();
+        auto visibleInfo = visibleBuffer->descriptorInfo();
+        auto instanceInfo = instanceBuffer->descriptorInfo();
+        auto meshletInfo = meshletBuffer->descriptorInfo();
+        auto occludedInfo = occludedBuffer->descriptorInfo();
+        VkDescriptorSet cullSet = VK_NULL_HANDLE;
+        // Occlusion stays off, so binding 5 only needs some valid buffer, as in SimpleRenderSystem
+        DescriptorWriter(*setLayout, *pool)
+            .writeBuffer(0, &cullInfo)
+            .writeBuffer(1, &drawInfo)
+            .writeBuffer(2, &visibleInfo)
+            .writeBuffer(3, &instanceInfo)
+            .writeBuffer(4, &meshletInfo)
+            .writeBuffer(5, &occludedInfo)
+            .writeBuffer(6, &occludedInfo)
+            .build(cullSet);
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(CullPushConstantData);
+        VkDescriptorSetLayout cullSetLayout = setLayout->getDescriptorSetLayout();
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &cullSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+        if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("error while creating cull pipelineLayout");
+        }
+        auto pipeline = std::make_unique<ComputePipeline>(device, "shaders/instance_cull.comp.spv", pipelineLayout);
+
+        Camera camera{};
+        camera.setPerspectiveProjection(glm::radians(50.f), 16.f / 9.f, .1f, 120.f);
+        CheckResult result;
+        uint32_t outOfBand = 0;
+        uint32_t wrongIndices = 0;
+        uint32_t visibleDraws = 0;
+        uint32_t culledDraws = 0;
+        uint32_t boundaryDraws = 0;
+        for (uint32_t frame = 0; frame < config.frames; frame++) {
+            const float yaw = glm::two_pi<float>() * frame / std::max(config.frames, 1u);
+            const glm::vec3 eye{ 10.f * std::sin(yaw * 3.f), 5.f * std::cos(yaw), -20.f + frame };
+            camera.setViewDirection(eye, { std::cos(yaw), .3f * std::sin(yaw * 2.f), std::sin(yaw) });
+            const Frustum frustum = camera.getFrustum();
+
+            auto* commands = static_cast<VkDrawIndexedIndirectCommand*>(drawBuffer->getMappedMemory());
+            for (uint32_t i = 0; i < scene.drawCount; i++) {
+                commands[i] = { 3, 0, 0, 0, i };
+            }
+            drawBuffer->flush();
+
+            CullPushConstantData push{};
+            for (int i = 0; i < 6; i++) {
+                push.planes[i] = frustum.planes[i];
+            }
+            push.cameraPosition = glm::vec4(camera.getPosition(), 1.f);
+            push.instanceCount = instanceCount;
+            push.phase = 0;
+            push.drawCount = scene.drawCount;
+            push.occlusion = 0;
+
+            VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
+            pipeline->bind(commandBuffer);
+            vkCmdBindDescriptorSets(
+                commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &cullSet, 0, nullptr);
+            vkCmdPushConstants(
+                commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstantData), &push);
+            vkCmdDispatch(commandBuffer, (instanceCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            vkCmdPipelineBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_PIPELINE_STAGE_HOST_BIT,
+                0,
+                1,
+                &barrier,
+                0,
+                nullptr,
+                0,
+                nullptr);
+            device.endSingleTimeCommands(commandBuffer);
+            drawBuffer->invalidate();
+            visibleBuffer->invalidate();
+
+            const std::vector<uint32_t> minCounts =
+                countReference(scene, frustum, camera.getPosition(), -CullingSystem::REFERENCE_TOLERANCE);
+            const std::vector<uint32_t> maxCounts =
+                countReference(scene, frustum, camera.getPosition(), CullingSystem::REFERENCE_TOLERANCE);
+            const auto* visibleIndices = static_cast<const uint32_t*>(visibleBuffer->getMappedMemory());
+            for (uint32_t i = 0; i < scene.drawCount; i++) {
+                const uint32_t count = commands[i].instanceCount;
+                if (count < minCounts[i] || count > maxCounts[i]) {
+                    outOfBand++;
+                }
+                boundaryDraws += minCounts[i] != maxCounts[i] ? 1 : 0;
+                visibleDraws += count;
+                culledDraws += count == 0 ? 1 : 0;
+            }
+            // Every survivor must land in its own draw's slot
+            for (uint32_t instance = 0; instance < instanceCount; instance++) {
+                const CullData& data = scene.cullData[instance];
+                const uint32_t draws = std::max(data.meshletCount, 1u);
+                for (uint32_t d = data.drawIndex; d < data.drawIndex + draws; d++) {
+                    if (commands[d].instanceCount == 1 && visibleIndices[d] != instance) {
+                        wrongIndices++;
+                    }
+                }
+            }
+        }
+        vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
+
+        std::cerr << visibleDraws << " draws visible and " << culledDraws << " culled over " << config.frames
+            << " frames, " << boundaryDraws << " within the tolerance of a boundary" << std::endl;
+        result.expect(outOfBand == 0, "GPU draw counts lie within the CPU reference band");
+        result.expect(wrongIndices == 0, "GPU visible indices name the instance of their draw");
+        result.expect(visibleDraws > 0 && culledDraws > 0, "the camera sees part of the scene");
+        return result.report();
+    }
+
+    static bool parseOption(CheckConfig& config, const std::string& name, const std::string& value) {
+        if (name == "--instances") {
+            config.instances = static_cast<uint32_t>(std::stoul(value));
+        } else if (name == "--frames") {
+            config.frames = static_cast<uint32_t>(std::stoul(value));
+        } else {
+            return false;
+        }
+        return true;
+    }
+} // namespace engine
+
+int main(int argc, char** argv) {
+    return engine::runGuarded([&]() {
+        engine::CheckConfig config{};
+        engine::parseBenchmarkArguments(argc, argv, {}, [&config](const std::string& name, const std::string& value) {
+            return engine::parseOption(config, name, value);
+        });
+
+        std::unique_ptr<engine::Device> device;
+        try {
+            device = std::make_unique<engine::Device>();
+        }
+        catch (const std::exception& e) {
+            std::cout << "no usable Vulkan device (" << e.what() << "), skipped" << std::endl;
+            return engine::EXIT_SKIPPED;
+        }
+        if (!device->features.drawIndirectFirstInstance) {
+            std::cout << "drawIndirectFirstInstance not supported, GPU culling never runs here, skipped" << std::endl;
+            return engine::EXIT_SKIPPED;
+        }
+        return engine::runChecks(*device, config);
+    });
+}
@@ -0,0 +1,231 @@
+// Headless check of the level of detail path. simplifyMesh has to reach its target index
+// count on a closed sphere and a flat grid without moving the bounds further than its error
+// budget allows, and LodSystem::selectLod must not switch back and forth while the screen
+// size jitters inside the hysteresis band around a threshold. Exits with a failure status on
+// any wrong answer, so it can run under ctest.
+//
+// usage: lod_check
+
+#include "BenchmarkCommon.hpp"
+#include "MeshSimplifier.hpp"
+#include "systems/LodSystem.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+    struct TestMesh {
+        std::vector<Model::Vertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    // Unit sphere of rings around the y axis, closed at the poles with shared vertices
+    static TestMesh makeSphere(uint32_t rings, uint32_t segments) {
+        TestMesh mesh;
+        auto addVertex = [&](const glm::vec3& position) {
+            Model::Vertex vertex{};
+            vertex.position = position;
+            vertex.normal = position;
+            vertex.color = { .8f, .8f, .8f };
+            mesh.vertices.push_back(vertex);
+        };
+        addVertex({ 0.f, 1.f, 0.f });
+        for (uint32_t ring = 1; ring < rings; ring++) {
+            const float polar = glm::pi<float>() * ring / rings;
+            for (uint32_t segment = 0; segment < segments; segment++) {
+                const float azimuth = glm::two_pi<float>() * segment / segments;
+                addVertex({ std::sin(polar) * std::cos(azimuth), std::cos(polar), std::sin(polar) * std::sin(azimuth) });
+            }
+        }
+        addVertex({ 0.f, -1.f, 0.f });
+
+        const uint32_t bottom = static_cast<uint32_t>(mesh.vertices.size() - 1);
+        auto ringVertex = [&](uint32_t ring, uint32_t segment) {
+            return 1 + (ring - 1) * segments + segment % segments;
+        };
+        for (uint32_t segment = 0; segment < segments; segment++) {
+            mesh.indices.insert(mesh.indices.end(), { 0, ringVertex(1, segment + 1), ringVertex(1, segment) });
+            mesh.indices.insert(mesh.indices.end(),
+                { bottom, ringVertex(rings - 1, segment), ringVertex(rings - 1, segment + 1) });
+            for (uint32_t ring = 1; ring < rings - 1; ring++) {
+                const uint32_t a = ringVertex(ring, segment);
+                const uint32_t b = ringVertex(ring, segment + 1);
+                const uint32_t c = ringVertex(ring + 1, segment);
+                const uint32_t d = ringVertex(ring + 1, segment + 1);
+                mesh.indices.insert(mesh.indices.end(), { a, b, d, a, d, c });
+            }
+        }
+        return mesh;
+    }
+
+    // Square grid in the xz plane from -1 to 1, with an open border all around
+    static TestMesh makeGrid(uint32_t cells) {
+        TestMesh mesh;
+        for (uint32_t z = 0; z <= cells; z++) {
+            for (uint32_t x = 0; x <= cells; x++) {
+                Model::Vertex vertex{};
+                vertex.position = { 2.f * x / cells - 1.f, 0.f, 2.f * z / cells - 1.f };
+                vertex.normal = { 0.f, 1.f, 0.f };
+                vertex.color = { .8f, .8f, .8f };
+                mesh.vertices.push_back(vertex);
+            }
+        }
+        for (uint32_t z = 0; z < cells; z++) {
+            for (uint32_t x = 0; x < cells; x++) {
+                const uint32_t a = z * (cells + 1) + x;
+                const uint32_t b = a + 1;
+                const uint32_t c = a + cells + 1;
+                const uint32_t d = c + 1;
+                mesh.indices.insert(mesh.indices.end(), { a, c, d, a, d, b });
+            }
+        }
+        return mesh;
+    }
+
+    struct Bounds {
+        glm::vec3 min{ std::numeric_limits<float>::max() };
+        glm::vec3 max{ -std::numeric_limits<float>::max() };
+    };
+
+    static Bounds boundsOf(const TestMesh& mesh, const std::vector<uint32_t>& indices) {
+        Bounds bounds;
+        for (const uint32_t index : indices) {
+            bounds.min = glm::min(bounds.min, mesh.vertices[index].position);
+            bounds.max = glm::max(bounds.max, mesh.vertices[index].position);
+        }
+        return bounds;
+    }
+
+    static bool validTriangles(const TestMesh& mesh, const std::vector<uint32_t>& indices) {
+        if (indices.size() % 3 != 0) {
+            return false;
+        }
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            const uint32_t a = indices[i];
+            const uint32_t b = indices[i + 1];
+            const uint32_t c = indices[i + 2];
+            if (a >= mesh.vertices.size() || b >= mesh.vertices.size() || c >= mesh.vertices.size()) {
+                return false;
+            }
+            if (mesh.vertices[a].position == mesh.vertices[b].position ||
+                mesh.vertices[b].position == mesh.vertices[c].position ||
+                mesh.vertices[a].position == mesh.vertices[c].position) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void checkSimplifiedSphere(CheckResult& result) {
+        const TestMesh sphere = makeSphere(32, 64);
+        const Bounds original = boundsOf(sphere, sphere.indices);
+        const float maxError = .05f;
+        for (const uint32_t divisor : { 2u, 4u, 8u }) {
+            const uint32_t target = static_cast<uint32_t>(sphere.indices.size() / 3 / divisor) * 3;
+            const std::vector<uint32_t> simplified = simplifyMesh(sphere.vertices, sphere.indices, target, maxError);
+            const std::string name = "sphere at 1/" + std::to_string(divisor);
+            result.expect(validTriangles(sphere, simplified), name + " has valid, non degenerate triangles");
+            // A collapse removes two triangles, so the last one may overshoot by one
+            result.expect(simplified.size() <= target && simplified.size() + 3 >= target,
+                name + " reaches its target index count");
+
+            // Positions only ever move onto existing ones, so the bounds can only shrink, and
+            // no further than the error budget allows
+            const Bounds bounds = boundsOf(sphere, simplified);
+            bool keptBounds = true;
+            for (int axis = 0; axis < 3; axis++) {
+                const float shrinkMin = bounds.min[axis] - original.min[axis];
+                const float shrinkMax = original.max[axis] - bounds.max[axis];
+                keptBounds = keptBounds && shrinkMin >= 0.f && shrinkMin <= 2.f * maxError &&
+                    shrinkMax >= 0.f && shrinkMax <= 2.f * maxError;
+            }
+            result.expect(keptBounds, name + " keeps its bounds");
+            std::cout << name << ": " << sphere.indices.size() / 3 << " -> " << simplified.size() / 3
+                << " triangles" << std::endl;
+        }
+
+        const std::vector<uint32_t> untouched = simplifyMesh(sphere.vertices, sphere.indices, 0, 0.f);
+        result.expect(untouched.size() == sphere.indices.size(), "a curved mesh with no error budget is left alone");
+    }
+
+    static void checkSimplifiedGrid(CheckResult& result) {
+        const TestMesh grid = makeGrid(32);
+        const Bounds original = boundsOf(grid, grid.indices);
+        const uint32_t target = static_cast<uint32_t>(grid.indices.size() / 3 / 4) * 3;
+        // Collapses inside a plane cost nothing, so a tiny budget still reaches the target
+        const std::vector<uint32_t> simplified = simplifyMesh(grid.vertices, grid.indices, target, 1e-4f);
+        result.expect(validTriangles(grid, simplified), "grid has valid, non degenerate triangles");
+        result.expect(simplified.size() <= target && simplified.size() + 3 >= target,
+            "grid reaches its target index count");
+        const Bounds bounds = boundsOf(grid, simplified);
+        result.expect(bounds.min == original.min && bounds.max == original.max, "grid keeps its corners");
+    }
+
+    // Level k takes over below FULL_DETAIL_SCREEN_SIZE / 2^(k - 1)
+    static float lodThreshold(uint32_t lod) {
+        return LodSystem::FULL_DETAIL_SCREEN_SIZE / static_cast<float>(1u << (lod - 1));
+    }
+
+    static void checkHysteresis(CheckResult& result) {
+        const uint32_t lodCount = 4;
+        // Small enough that a size on one side, scaled by the band, is still past the threshold
+        const float jitter = .5f * LodSystem::HYSTERESIS / (1.f + LodSystem::HYSTERESIS);
+
+        bool steady = true;
+        bool leaves = true;
+        for (uint32_t lod = 1; lod <= lodCount - 1; lod++) {
+            const float threshold = lodThreshold(lod);
+            for (const uint32_t start : { lod - 1, lod }) {
+                uint32_t current = start;
+                for (uint32_t frame = 0; frame < 100; frame++) {
+                    const float size = threshold * (frame % 2 ? 1.f + jitter : 1.f - jitter);
+                    current = LodSystem::selectLod(size, lodCount, current);
+                    steady = steady && current == start;
+                }
+            }
+            // Once the size is clear of the band the level has to follow it
+            const float clear = 1.5f * LodSystem::HYSTERESIS;
+            leaves = leaves && LodSystem::selectLod(threshold * (1.f - clear), lodCount, lod - 1) == lod;
+            leaves = leaves && LodSystem::selectLod(threshold * (1.f + clear), lodCount, lod) == lod - 1;
+        }
+        result.expect(steady, "level holds while the size jitters around a threshold");
+        result.expect(leaves, "level changes once the size is clear of the band");
+
+        // Shrinking with jitter on every frame: each level is entered exactly once, where
+        // picking the level from the size alone switches back and forth at every threshold
+        uint32_t current = 0;
+        uint32_t previousPlain = 0;
+        uint32_t switches = 0;
+        uint32_t plainSwitches = 0;
+        float size = .5f;
+        for (uint32_t frame = 0; size > .01f; frame++) {
+            const float jittered = size * (frame % 2 ? 1.f + jitter : 1.f - jitter);
+            const uint32_t next = LodSystem::selectLod(jittered, lodCount, current);
+            switches += next != current ? 1 : 0;
+            current = next;
+            const uint32_t plain = LodSystem::selectLod(jittered, lodCount);
+            plainSwitches += plain != previousPlain ? 1 : 0;
+            previousPlain = plain;
+            size *= .995f;
+        }
+        result.expect(switches == lodCount - 1, "a shrinking sphere switches once per level");
+        result.expect(current == lodCount - 1, "a shrinking sphere ends at the coarsest level");
+        result.expect(plainSwitches > switches, "jitter alone would switch back and forth");
+        std::cout << "shrinking sphere: " << switches << " level switches, " << plainSwitches
+            << " without hysteresis" << std::endl;
+    }
+} // namespace engine
+
+int main() {
+    engine::CheckResult result;
+    engine::checkSimplifiedSphere(result);
+    engine::checkSimplifiedGrid(result);
+    engine::checkHysteresis(result);
+    return result.report();
+}
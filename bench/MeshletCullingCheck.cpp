@@ -0,0 +1,191 @@
+// Headless check of CullingSystem::isMeshletVisible, the CPU reference for the meshlet test
+// in instance_cull.comp. Runs hand-built meshlets with known answers, then builds meshlets
+// for a closed sphere and makes sure no meshlet with a triangle facing the camera is ever
+// culled. Exits with a failure status on any wrong answer, so it can run under ctest.
+//
+// usage: meshlet_check
+
+#include "BenchmarkCommon.hpp"
+#include "MeshletBuilder.hpp"
+#include "systems/CullingSystem.hpp"
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+namespace engine {
+
+    static Meshlet makeMeshlet(const glm::vec3& center, float radius, const glm::vec3& axis, float spread) {
+        Meshlet meshlet{};
+        meshlet.sphere = glm::vec4(center, radius);
+        meshlet.cone = glm::vec4(axis, spread);
+        return meshlet;
+    }
+
+    static glm::mat3 normalMatrixOf(const glm::mat4& modelMatrix) {
+        return glm::transpose(glm::inverse(glm::mat3(modelMatrix)));
+    }
+
+    // Camera at the origin looking down +z with a square 50 degree frustum, so the side
+    // planes lean 25 degrees out of the view direction
+    static void checkKnownMeshlets(CheckResult& result) {
+        Camera camera{};
+        camera.setPerspectiveProjection(glm::radians(50.f), 1.f, .1f, 100.f);
+        camera.setViewDirection(glm::vec3{ 0.f }, { 0.f, 0.f, 1.f });
+        const Frustum frustum = camera.getFrustum();
+        const glm::vec3 eye{ 0.f };
+        const glm::mat4 identity{ 1.f };
+        const glm::mat3 identityNormal{ 1.f };
+
+        const Meshlet noCone = makeMeshlet({ 0.f, 0.f, 10.f }, 1.f, { 0.f, 0.f, 0.f }, 1.f);
+        result.expect(CullingSystem::isMeshletVisible(frustum, eye, noCone, identity, identityNormal, true),
+            "meshlet ahead of the camera is visible");
+        const Meshlet behind = makeMeshlet({ 0.f, 0.f, -10.f }, 1.f, { 0.f, 0.f, 0.f }, 1.f);
+        result.expect(!CullingSystem::isMeshletVisible(frustum, eye, behind, identity, identityNormal, true),
+            "meshlet behind the camera is culled");
+        const Meshlet beyondFar = makeMeshlet({ 0.f, 0.f, 102.f }, 1.f, { 0.f, 0.f, 0.f }, 1.f);
+        result.expect(!CullingSystem::isMeshletVisible(frustum, eye, beyondFar, identity, identityNormal, true),
+            "meshlet beyond the far plane is culled");
+
+        // Faces pointing away from the camera in a narrow cone only show their backs
+        const Meshlet facingAway = makeMeshlet({ 0.f, 0.f, 10.f }, 1.f, { 0.f, 0.f, 1.f }, .1f);
+        result.expect(!CullingSystem::isMeshletVisible(frustum, eye, facingAway, identity, identityNormal, true),
+            "back facing meshlet is culled");
+        result.expect(CullingSystem::isMeshletVisible(frustum, eye, facingAway, identity, identityNormal, false),
+            "back facing meshlet is kept without cone culling");
+        const Meshlet facingCamera = makeMeshlet({ 0.f, 0.f, 10.f }, 1.f, { 0.f, 0.f, -1.f }, .1f);
+        result.expect(CullingSystem::isMeshletVisible(frustum, eye, facingCamera, identity, identityNormal, true),
+            "front facing meshlet is visible");
+        // Seen edge on, the widest faces of a cone around the view direction turn to the camera
+        const Meshlet sideways = makeMeshlet({ 0.f, 0.f, 10.f }, 1.f, { 1.f, 0.f, 0.f }, .1f);
+        result.expect(CullingSystem::isMeshletVisible(frustum, eye, sideways, identity, identityNormal, true),
+            "meshlet seen edge on is visible");
+
+        // The center lies 1.21 units outside a side plane
+        const Meshlet outside = makeMeshlet({ 6.f, 0.f, 10.f }, 1.f, { 0.f, 0.f, 0.f }, 1.f);
+        result.expect(!CullingSystem::isMeshletVisible(frustum, eye, outside, identity, identityNormal, true),
+            "meshlet outside a side plane is culled");
+        // Scaled by two, the same world center has a radius reaching back into the frustum
+        const glm::mat4 scaled = glm::scale(identity, glm::vec3{ 2.f });
+        const Meshlet scaledOutside = makeMeshlet({ 3.f, 0.f, 5.f }, 1.f, { 0.f, 0.f, 0.f }, 1.f);
+        result.expect(CullingSystem::isMeshletVisible(
+                frustum, eye, scaledOutside, scaled, normalMatrixOf(scaled), true),
+            "scaled meshlet straddling a side plane is visible");
+        const glm::mat4 moved = glm::translate(identity, { 0.f, 0.f, -20.f });
+        result.expect(!CullingSystem::isMeshletVisible(frustum, eye, noCone, moved, normalMatrixOf(moved), true),
+            "meshlet moved behind the camera is culled");
+
+        // Half a turn about y brings a meshlet from behind the camera to 10 units ahead and
+        // turns its faces from the camera to away from it
+        const glm::mat4 turned = glm::rotate(identity, glm::pi<float>(), { 0.f, 1.f, 0.f });
+        const Meshlet turnedAway = makeMeshlet({ 0.f, 0.f, -10.f }, 1.f, { 0.f, 0.f, -1.f }, .1f);
+        result.expect(!CullingSystem::isMeshletVisible(
+                frustum, eye, turnedAway, turned, normalMatrixOf(turned), true),
+            "rotated meshlet turned away is culled");
+        const Meshlet turnedToward = makeMeshlet({ 0.f, 0.f, -10.f }, 1.f, { 0.f, 0.f, 1.f }, .1f);
+        result.expect(CullingSystem::isMeshletVisible(
+                frustum, eye, turnedToward, turned, normalMatrixOf(turned), true),
+            "rotated meshlet turned toward the camera is visible");
+    }
+
+    // Closed unit sphere with outward counter-clockwise winding. Seam and pole vertices share
+    // their positions exactly, so MeshletBuilder welds them and builds normal cones.
+    static void createSphere(
+        uint32_t rings, uint32_t segments, std::vector<Model::Vertex>& vertices, std::vector<uint32_t>& indices) {
+        const float ringStep = glm::pi<float>() / rings;
+        const float segmentStep = glm::two_pi<float>() / segments;
+        for (uint32_t ring = 0; ring <= rings; ring++) {
+            for (uint32_t segment = 0; segment <= segments; segment++) {
+                const float theta = ring * ringStep;
+                const float phi = (segment % segments) * segmentStep;
+                Model::Vertex vertex{};
+                if (ring == 0 || ring == rings) {
+                    vertex.position = { 0.f, ring == 0 ? 1.f : -1.f, 0.f };
+                } else {
+                    vertex.position = {
+                        std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+                }
+                vertex.normal = vertex.position;
+                vertex.color = glm::vec3(1.f);
+                vertices.push_back(vertex);
+            }
+        }
+        const uint32_t rowLength = segments + 1;
+        for (uint32_t ring = 0; ring < rings; ring++) {
+            for (uint32_t segment = 0; segment < segments; segment++) {
+                const uint32_t a = ring * rowLength + segment;
+                const uint32_t b = a + rowLength;
+                const uint32_t c = b + 1;
+                const uint32_t d = a + 1;
+                indices.insert(indices.end(), { a, c, b, a, d, c });
+            }
+        }
+    }
+
+    // Cone culling must be conservative: any meshlet with a triangle facing the camera stays
+    // visible. Views from all around a rotated, scaled and moved sphere, which should still
+    // cull the meshlets on its far side.
+    static void checkSphereMeshlets(CheckResult& result) {
+        std::vector<Model::Vertex> vertices;
+        std::vector<uint32_t> indices;
+        createSphere(32, 64, vertices, indices);
+        const std::vector<Meshlet> meshlets =
+            buildMeshlets(vertices, indices, 0, static_cast<uint32_t>(indices.size()));
+        result.expect(meshlets.size() > 1, "sphere is split into meshlets");
+        uint32_t conedMeshlets = 0;
+        for (const Meshlet& meshlet : meshlets) {
+            conedMeshlets += meshlet.cone.w < 1.f ? 1 : 0;
+        }
+        result.expect(conedMeshlets > 0, "closed sphere meshlets get normal cones");
+
+        glm::mat4 modelMatrix = glm::translate(glm::mat4{ 1.f }, { 3.f, -2.f, 5.f });
+        modelMatrix = glm::rotate(modelMatrix, .7f, glm::normalize(glm::vec3{ 1.f, 2.f, .5f }));
+        modelMatrix = glm::scale(modelMatrix, glm::vec3{ 2.f });
+        const glm::mat3 normalMatrix = normalMatrixOf(modelMatrix);
+        const glm::vec3 center{ modelMatrix[3] };
+
+        Camera camera{};
+        camera.setPerspectiveProjection(glm::radians(50.f), 1.f, .1f, 100.f);
+        uint32_t missed = 0;
+        uint32_t culled = 0;
+        for (float height : { -.6f, 0.f, .6f }) {
+            for (uint32_t step = 0; step < 24; step++) {
+                const float yaw = glm::two_pi<float>() * step / 24.f;
+                const glm::vec3 direction = glm::normalize(glm::vec3{ std::cos(yaw), height, std::sin(yaw) });
+                const glm::vec3 eye = center - direction * 12.f;
+                camera.setViewDirection(eye, direction);
+                const Frustum frustum = camera.getFrustum();
+
+                for (const Meshlet& meshlet : meshlets) {
+                    if (CullingSystem::isMeshletVisible(frustum, eye, meshlet, modelMatrix, normalMatrix, true)) {
+                        continue;
+                    }
+                    culled++;
+                    for (uint32_t i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3) {
+                        const glm::vec3 p0{ modelMatrix * glm::vec4(vertices[indices[i]].position, 1.f) };
+                        const glm::vec3 p1{ modelMatrix * glm::vec4(vertices[indices[i + 1]].position, 1.f) };
+                        const glm::vec3 p2{ modelMatrix * glm::vec4(vertices[indices[i + 2]].position, 1.f) };
+                        if (glm::dot(glm::cross(p1 - p0, p2 - p0), eye - p0) > 1e-5f) {
+                            missed++;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        result.expect(missed == 0, "no meshlet with a front facing triangle is culled");
+        result.expect(culled > 0, "meshlets on the far side of the sphere are culled");
+        std::cout << meshlets.size() << " sphere meshlets, " << conedMeshlets << " with cones, "
+            << culled << " culled over 72 views" << std::endl;
+    }
+} // namespace engine
+
+int main() {
+    engine::CheckResult result;
+    engine::checkKnownMeshlets(result);
+    engine::checkSphereMeshlets(result);
+    return result.report();
+}
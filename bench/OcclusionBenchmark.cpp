@@ -0,0 +1,216 @@
+// Headless test and stress test for MaskedOcclusionBuffer.
+// First checks a wall with known answers: boxes behind it are hidden, boxes in front of it,
+// through it or behind the near plane are not, and any worker count rasterizes the same depth.
+// Then scatters N cube occluders in front of a camera and reports rasterization and box test
+// timings without creating a window or a Vulkan device. Exits with a failure status if a
+// check fails.
+//
+// usage: occlusion_bench [--counts 16,256,4096] [--frames 120] [--boxes 10000] [--workers 2]
+//                        [--format text|csv|json] [--output file]
+
+#include "BenchmarkCommon.hpp"
+#include "Camera.hpp"
+#include "MaskedOcclusionBuffer.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+    // Size of the buffer OcclusionCullingSystem uses
+    static constexpr uint32_t BUFFER_WIDTH = 256;
+    static constexpr uint32_t BUFFER_HEIGHT = 128;
+
+    struct BenchmarkConfig {
+        uint32_t frames = 120;
+        uint32_t boxes = 10000;
+        uint32_t workers = 2;
+    };
+
+    static const std::vector<BenchmarkTable::Column> RESULT_COLUMNS{
+        { "occluders", "occluders", 10, true },
+        { "triangles", "triangles", 12, true },
+        { "frames", "frames", 8, true },
+        { "raster_ms", "raster ms", 12 },
+        { "p95_raster_ms", "p95 ms", 12 },
+        { "test_ms", "test ms", 12 },
+        { "occluded_share", "occluded", 12 } };
+
+    // Unit cube around the origin, 12 triangles
+    static const std::vector<glm::vec3> CUBE_POSITIONS{
+        { -.5f, -.5f, -.5f }, { .5f, -.5f, -.5f }, { .5f, .5f, -.5f }, { -.5f, .5f, -.5f },
+        { -.5f, -.5f, .5f }, { .5f, -.5f, .5f }, { .5f, .5f, .5f }, { -.5f, .5f, .5f } };
+    static const std::vector<uint32_t> CUBE_INDICES{
+        0, 1, 2, 0, 2, 3, 4, 6, 5, 4, 7, 6, 0, 4, 5, 0, 5, 1,
+        3, 2, 6, 3, 6, 7, 0, 3, 7, 0, 7, 4, 1, 5, 6, 1, 6, 2 };
+
+    // Camera at the origin looking down +z, like the scene the engine starts with
+    static glm::mat4 createViewProjection() {
+        Camera camera{};
+        camera.setPerspectiveProjection(glm::radians(50.f), 2.f, .1f, 100.f);
+        camera.setViewDirection(glm::vec3{ 0.f }, { 0.f, 0.f, 1.f });
+        return camera.getProjection() * camera.getView();
+    }
+
+    static void runChecks(uint32_t workerCount, CheckResult& result) {
+        const glm::mat4 viewProjection = createViewProjection();
+
+        // A wall at z = 10 far wider than the view
+        const std::vector<glm::vec3> wall{
+            { -100.f, -100.f, 10.f }, { 100.f, -100.f, 10.f }, { 100.f, 100.f, 10.f }, { -100.f, 100.f, 10.f } };
+        const std::vector<uint32_t> wallIndices{ 0, 1, 2, 0, 2, 3 };
+        MaskedOcclusionBuffer::Occluder wallOccluder{};
+        wallOccluder.positions = wall.data();
+        wallOccluder.indices = wallIndices.data();
+        wallOccluder.indexCount = static_cast<uint32_t>(wallIndices.size());
+        wallOccluder.modelViewProjection = viewProjection;
+
+        JobPool jobPool{ workerCount };
+        MaskedOcclusionBuffer buffer{ BUFFER_WIDTH, BUFFER_HEIGHT, jobPool };
+        buffer.rasterize();
+        result.expect(buffer.isBoxVisible({ -1.f, -1.f, 20.f }, { 1.f, 1.f, 22.f }, viewProjection),
+            "nothing rasterized hides nothing");
+
+        buffer.clear();
+        buffer.addOccluder(wallOccluder);
+        buffer.rasterize();
+        result.expect(buffer.getTriangleCount() == 2, "both wall triangles reach the tiles");
+        result.expect(buffer.getPixelDepth(BUFFER_WIDTH / 2, BUFFER_HEIGHT / 2) < 1.f, "the wall covers the center");
+        result.expect(!buffer.isBoxVisible({ -1.f, -1.f, 20.f }, { 1.f, 1.f, 22.f }, viewProjection),
+            "box behind the wall is hidden");
+        result.expect(!buffer.isBoxVisible({ 8.f, 3.f, 40.f }, { 9.f, 4.f, 41.f }, viewProjection),
+            "box behind the wall off center is hidden");
+        result.expect(buffer.isBoxVisible({ -1.f, -1.f, 4.f }, { 1.f, 1.f, 6.f }, viewProjection),
+            "box in front of the wall is visible");
+        result.expect(buffer.isBoxVisible({ -1.f, -1.f, 9.f }, { 1.f, 1.f, 11.f }, viewProjection),
+            "box through the wall is visible");
+        result.expect(buffer.isBoxVisible({ -1.f, -1.f, -1.f }, { 1.f, 1.f, 20.f }, viewProjection),
+            "box behind the near plane is visible");
+
+        // Rows of tiles are split across workers, which must not change the result
+        std::mt19937 rng{ 99u };
+        std::uniform_real_distribution<float> position{ -10.f, 10.f };
+        std::uniform_real_distribution<float> depth{ 5.f, 40.f };
+        std::vector<glm::mat4> models;
+        for (uint32_t i = 0; i < 64; i++) {
+            glm::mat4 model = glm::translate(glm::mat4{ 1.f }, { position(rng), position(rng) * .5f, depth(rng) });
+            models.push_back(glm::scale(model, glm::vec3{ 2.f }));
+        }
+        JobPool singleWorker{ 1 };
+        MaskedOcclusionBuffer single{ BUFFER_WIDTH, BUFFER_HEIGHT, singleWorker };
+        for (MaskedOcclusionBuffer* target : { &single, &buffer }) {
+            target->clear();
+            for (const glm::mat4& model : models) {
+                MaskedOcclusionBuffer::Occluder cube{};
+                cube.positions = CUBE_POSITIONS.data();
+                cube.indices = CUBE_INDICES.data();
+                cube.indexCount = static_cast<uint32_t>(CUBE_INDICES.size());
+                cube.modelViewProjection = viewProjection * model;
+                target->addOccluder(cube);
+            }
+            target->rasterize();
+        }
+        uint32_t differingPixels = 0;
+        for (uint32_t y = 0; y < BUFFER_HEIGHT; y++) {
+            for (uint32_t x = 0; x < BUFFER_WIDTH; x++) {
+                differingPixels += single.getPixelDepth(x, y) != buffer.getPixelDepth(x, y) ? 1 : 0;
+            }
+        }
+        result.expect(differingPixels == 0, "one and " + std::to_string(buffer.getWorkerCount()) + " workers agree");
+    }
+
+    // One row of RESULT_COLUMNS
+    static std::vector<double> runBenchmark(uint32_t occluderCount, const BenchmarkConfig& config) {
+        const glm::mat4 viewProjection = createViewProjection();
+        std::mt19937 rng{ 1234u };
+        std::uniform_real_distribution<float> position{ -30.f, 30.f };
+        std::uniform_real_distribution<float> depth{ 3.f, 60.f };
+        std::uniform_real_distribution<float> size{ .5f, 3.f };
+
+        std::vector<MaskedOcclusionBuffer::Occluder> occluders(occluderCount);
+        for (auto& occluder : occluders) {
+            glm::mat4 model = glm::translate(glm::mat4{ 1.f }, { position(rng), position(rng) * .5f, depth(rng) });
+            model = glm::scale(model, glm::vec3{ size(rng), size(rng), size(rng) });
+            occluder.positions = CUBE_POSITIONS.data();
+            occluder.indices = CUBE_INDICES.data();
+            occluder.indexCount = static_cast<uint32_t>(CUBE_INDICES.size());
+            occluder.modelViewProjection = viewProjection * model;
+        }
+        std::vector<glm::vec3> boxCenters(config.boxes);
+        for (auto& center : boxCenters) {
+            center = { position(rng), position(rng) * .5f, depth(rng) };
+        }
+
+        JobPool jobPool{ config.workers };
+        MaskedOcclusionBuffer buffer{ BUFFER_WIDTH, BUFFER_HEIGHT, jobPool };
+        std::vector<double> rasterTimes;
+        rasterTimes.reserve(config.frames);
+        double testTotal = 0.0;
+        uint64_t occluded = 0;
+        for (uint32_t frame = 0; frame < config.frames; frame++) {
+            auto rasterStart = std::chrono::high_resolution_clock::now();
+            buffer.clear();
+            for (const auto& occluder : occluders) {
+                buffer.addOccluder(occluder);
+            }
+            buffer.rasterize();
+            rasterTimes.push_back(elapsedMs(rasterStart));
+
+            auto testStart = std::chrono::high_resolution_clock::now();
+            for (const glm::vec3& center : boxCenters) {
+                occluded += buffer.isBoxVisible(center - .5f, center + .5f, viewProjection) ? 0 : 1;
+            }
+            testTotal += elapsedMs(testStart);
+        }
+
+        const TimingSummary raster = summarizeTimes(rasterTimes);
+        const double frameCount = std::max(static_cast<double>(config.frames), 1.0);
+        return {
+            static_cast<double>(occluderCount),
+            static_cast<double>(buffer.getTriangleCount()),
+            static_cast<double>(config.frames),
+            raster.mean,
+            raster.p95,
+            testTotal / frameCount,
+            config.boxes > 0 ? occluded / (frameCount * config.boxes) : 0.0 };
+    }
+
+    static bool parseOption(BenchmarkConfig& config, const std::string& name, const std::string& value) {
+        if (name == "--frames") {
+            config.frames = static_cast<uint32_t>(std::stoul(value));
+        } else if (name == "--boxes") {
+            config.boxes = static_cast<uint32_t>(std::stoul(value));
+        } else if (name == "--workers") {
+            config.workers = static_cast<uint32_t>(std::stoul(value));
+        } else {
+            return false;
+        }
+        return true;
+    }
+} // namespace engine
+
+int main(int argc, char** argv) {
+    return engine::runGuarded([&]() {
+        engine::BenchmarkConfig config{};
+        const engine::BenchmarkOptions options = engine::parseBenchmarkArguments(
+            argc, argv, { 16, 256, 4096 }, [&config](const std::string& name, const std::string& value) {
+                return engine::parseOption(config, name, value);
+            });
+        // At least two workers, so the check covers splitting rows between them
+        engine::CheckResult checks;
+        engine::runChecks(std::max(config.workers, 2u), checks);
+        if (!checks.passed()) {
+            return EXIT_FAILURE;
+        }
+
+        engine::runBenchmarks(options, "occluders", engine::RESULT_COLUMNS, [&config](uint32_t count) {
+            return engine::runBenchmark(count, config);
+        });
+        return EXIT_SUCCESS;
+    });
+}
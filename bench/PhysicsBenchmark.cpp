@@ -0,0 +1,151 @@
+// Headless stress test for CollisionSystem and PhysicsSystem.
+// Spawns N boxes above a static floor and steps the simulation without creating
+// a window or a Vulkan device, then reports per-step timings and pair counts.
+//
+// usage: physics_bench [--counts 1000,10000,100000] [--steps 120] [--dt 0.016]
+//                      [--format text|csv|json] [--output file]
+
+#include "BenchmarkCommon.hpp"
+#include "systems/CollisionSystem.hpp"
+#include "systems/PhysicsSystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+    struct BenchmarkConfig {
+        uint32_t steps = 120;
+        float dt = 1.f / 60.f;
+    };
+
+    static const std::vector<BenchmarkTable::Column> RESULT_COLUMNS{
+        { "bodies", "bodies", 10, true },
+        { "steps", "steps", 8, true },
+        { "mean_step_ms", "ms/step", 12 },
+        { "p95_step_ms", "p95 ms", 12 },
+        { "max_step_ms", "max ms", 12 },
+        { "collision_ms", "collision ms", 14 },
+        { "physics_ms", "physics ms", 12 },
+        { "pairs_tested", "pairs tested", 16 },
+        { "pairs_colliding", "pairs colliding", 16 } };
+
+    // One row of RESULT_COLUMNS
+    static std::vector<double> runBenchmark(uint32_t bodyCount, const BenchmarkConfig& config) {
+        EntityManager entityManager{ bodyCount + 1 };
+        std::shared_ptr<Model> box = createBoxModel();
+
+        // +y points down in this engine, so the floor's top face sits at y = 0
+        // and the boxes start above it at negative y
+        const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(bodyCount))));
+        const float spacing = 1.1f;
+        const float extent = side * spacing;
+
+        uint32_t floor = entityManager.createEntity();
+        entityManager.addComponent(floor, ComponentType::Model);
+        ModelComponent floorModel{};
+        floorModel.model = box;
+        entityManager.setComponentData(floor, floorModel);
+        entityManager.addComponent(floor, ComponentType::Physics);
+        TransformComponent floorTransform{};
+        floorTransform.translation = { extent * .5f, .5f, extent * .5f };
+        floorTransform.scale = { extent + 2.f, 1.f, extent + 2.f };
+        entityManager.setComponentData(floor, floorTransform);
+        PhysicsComponent floorPhysics{};
+        floorPhysics.movable = false;
+        floorPhysics.hasGravity = false;
+        floorPhysics.coefRes = 1.f;
+        entityManager.setComponentData(floor, floorPhysics);
+
+        std::mt19937 rng{ 1234u };
+        std::uniform_real_distribution<float> height{ 1.f, 10.f };
+        for (uint32_t i = 0; i < bodyCount; i++) {
+            uint32_t entity = entityManager.createEntity();
+            entityManager.addComponent(entity, ComponentType::Model);
+            ModelComponent modelComponent{};
+            modelComponent.model = box;
+            entityManager.setComponentData(entity, modelComponent);
+            entityManager.addComponent(entity, ComponentType::Physics);
+            TransformComponent transform{};
+            transform.translation = { (i % side) * spacing, -height(rng), (i / side) * spacing };
+            entityManager.setComponentData(entity, transform);
+            entityManager.setComponentData(entity, PhysicsComponent{});
+        }
+
+        Camera camera{};
+        CollisionSystem collisionSystem;
+        PhysicsSystem physicsSystem;
+        FrameInfo frameInfo{
+            0,
+            config.dt,
+            VK_NULL_HANDLE,
+            camera,
+            VK_NULL_HANDLE,
+            entityManager };
+
+        std::vector<double> stepTimes;
+        stepTimes.reserve(config.steps);
+        double collisionTotal = 0.0;
+        double physicsTotal = 0.0;
+        double pairsTested = 0.0;
+        double pairsColliding = 0.0;
+        for (uint32_t step = 0; step < config.steps; step++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            collisionSystem.update(frameInfo);
+            auto afterCollision = std::chrono::high_resolution_clock::now();
+            physicsSystem.update(frameInfo);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            double collisionMs = std::chrono::duration<double, std::milli>(afterCollision - start).count();
+            double physicsMs = std::chrono::duration<double, std::milli>(end - afterCollision).count();
+            collisionTotal += collisionMs;
+            physicsTotal += physicsMs;
+            stepTimes.push_back(collisionMs + physicsMs);
+            pairsTested += static_cast<double>(collisionSystem.getStats().pairsTested);
+            pairsColliding += collisionSystem.getStats().pairsColliding;
+        }
+
+        const TimingSummary steps = summarizeTimes(stepTimes);
+        const double stepCount = std::max(static_cast<double>(config.steps), 1.0);
+        return {
+            static_cast<double>(bodyCount),
+            static_cast<double>(config.steps),
+            steps.mean,
+            steps.p95,
+            steps.max,
+            collisionTotal / stepCount,
+            physicsTotal / stepCount,
+            pairsTested / stepCount,
+            pairsColliding / stepCount };
+    }
+
+    static bool parseOption(BenchmarkConfig& config, const std::string& name, const std::string& value) {
+        if (name == "--steps") {
+            config.steps = static_cast<uint32_t>(std::stoul(value));
+        } else if (name == "--dt") {
+            config.dt = std::stof(value);
+        } else {
+            return false;
+        }
+        return true;
+    }
+} // namespace engine
+
+int main(int argc, char** argv) {
+    return engine::runGuarded([&]() {
+        engine::BenchmarkConfig config{};
+        const engine::BenchmarkOptions options = engine::parseBenchmarkArguments(
+            argc, argv, { 1000, 10000, 100000 }, [&config](const std::string& name, const std::string& value) {
+                return engine::parseOption(config, name, value);
+            });
+        engine::runBenchmarks(options, "bodies", engine::RESULT_COLUMNS, [&config](uint32_t count) {
+            return engine::runBenchmark(count, config);
+        });
+        return EXIT_SUCCESS;
+    });
+}
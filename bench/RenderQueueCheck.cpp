@@ -0,0 +1,145 @@
+// Headless check of RenderQueue, which orders SimpleRenderSystem's draws into instanced
+// groups. Makes sure every field of a sort key lands in its own bits, that the radix sort
+// agrees with a stable std::sort on the keys, including the passes it skips, and that sort
+// key ids are kept while in use and handed out again once retired. Exits with a failure
+// status on any wrong answer, so it can run under ctest.
+//
+// usage: render_queue_check
+
+#include "BenchmarkCommon.hpp"
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace engine {
+
+    static void checkKeyPacking(CheckResult& result) {
+        const uint64_t key = RenderQueue::makeKey(0xAB, 0x1234, 0x5678, 1.f);
+        result.expect((key >> 56) == 0xAB, "pipeline lands in the top byte");
+        result.expect(((key >> 40) & 0xFFFF) == 0x1234, "material lands below the pipeline");
+        result.expect(((key >> 24) & 0xFFFF) == 0x5678, "mesh lands below the material");
+        result.expect((key & 0xFFFFFF) == 0xFFFFFF, "far depth fills the depth bits");
+        result.expect((key >> RenderQueue::STATE_SHIFT) == 0xAB12345678ull, "state bits are everything above depth");
+
+        result.expect((RenderQueue::makeKey(0, 0, 0, 0.f) & 0xFFFFFF) == 0, "near depth is zero");
+        result.expect(RenderQueue::makeKey(0, 0, 0, -1.f) == RenderQueue::makeKey(0, 0, 0, 0.f),
+            "depth below zero is clamped");
+        result.expect(RenderQueue::makeKey(0, 0, 0, 2.f) == RenderQueue::makeKey(0, 0, 0, 1.f),
+            "depth above one is clamped");
+        result.expect(RenderQueue::makeKey(0, 0, 0, .25f) < RenderQueue::makeKey(0, 0, 0, .5f),
+            "nearer draws sort first");
+        result.expect(RenderQueue::makeKey(0, 0xFFFF, 0xFFFF, 1.f) < RenderQueue::makeKey(1, 0, 0, 0.f),
+            "pipeline outranks material, mesh and depth");
+        result.expect(RenderQueue::makeKey(0, 0, 0xFFFF, 1.f) < RenderQueue::makeKey(0, 1, 0, 0.f),
+            "material outranks mesh and depth");
+    }
+
+    // Sorts the keys with the queue and with std::stable_sort, and compares both the keys
+    // and the payloads, so equal keys have to keep the order they were pushed in
+    static bool sortsLikeStableSort(const std::vector<uint64_t>& keys) {
+        RenderQueue queue;
+        std::vector<RenderItem> expected;
+        for (uint32_t i = 0; i < keys.size(); i++) {
+            queue.push(keys[i], i);
+            expected.push_back({ keys[i], i });
+        }
+        queue.sort();
+        std::stable_sort(expected.begin(), expected.end(), [](const RenderItem& a, const RenderItem& b) {
+            return a.key < b.key;
+        });
+        const std::vector<RenderItem>& items = queue.getItems();
+        if (items.size() != expected.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < items.size(); i++) {
+            if (items[i].key != expected[i].key || items[i].payload != expected[i].payload) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void checkSort(CheckResult& result) {
+        std::mt19937_64 random(7);
+        std::uniform_real_distribution<float> depth(0.f, 1.f);
+
+        std::vector<uint64_t> keys;
+        for (uint32_t i = 0; i < 5000; i++) {
+            keys.push_back(random());
+        }
+        result.expect(sortsLikeStableSort(keys), "random keys sort in order");
+
+        // A handful of pipelines, materials and meshes, like a real frame: most bytes are
+        // shared by every key, so most passes are skipped
+        keys.clear();
+        for (uint32_t i = 0; i < 5000; i++) {
+            keys.push_back(RenderQueue::makeKey(
+                static_cast<uint8_t>(random() % 3),
+                static_cast<uint16_t>(random() % 4),
+                static_cast<uint16_t>(random() % 6),
+                depth(random)));
+        }
+        result.expect(sortsLikeStableSort(keys), "frame like keys sort in order");
+
+        // Only an odd number of passes runs here, so the result ends up in the scratch buffer
+        keys.clear();
+        for (uint32_t i = 0; i < 1000; i++) {
+            keys.push_back(RenderQueue::makeKey(2, 1, 1, 0.f) | (random() & 0xFF));
+        }
+        result.expect(sortsLikeStableSort(keys), "keys differing in one byte sort in order");
+
+        keys.assign(1000, RenderQueue::makeKey(1, 2, 3, .5f));
+        result.expect(sortsLikeStableSort(keys), "equal keys keep their push order");
+
+        result.expect(sortsLikeStableSort({}), "an empty queue sorts");
+        result.expect(sortsLikeStableSort({ 42 }), "a single key sorts");
+    }
+
+    static void checkIds(CheckResult& result) {
+        RenderQueue queue;
+        std::vector<int> meshes(200);
+        std::vector<uint16_t> ids;
+        queue.clear();
+        for (const int& mesh : meshes) {
+            ids.push_back(queue.getMeshId(&mesh));
+        }
+        std::vector<uint16_t> sortedIds = ids;
+        std::sort(sortedIds.begin(), sortedIds.end());
+        result.expect(std::unique(sortedIds.begin(), sortedIds.end()) == sortedIds.end(),
+            "every mesh gets its own id");
+        result.expect(queue.getMeshId(&meshes[17]) == ids[17], "a mesh keeps its id within a frame");
+
+        int material = 0;
+        const uint16_t materialId = queue.getMaterialId(&material);
+        result.expect(queue.getMaterialId(&material) == materialId, "a material keeps its id");
+
+        // Only the first mesh and the material stay in use. Ids are retired in a sweep every
+        // ID_RETIRE_FRAMES frames, so an unused one can last up to twice that long.
+        bool keptId = true;
+        for (uint64_t frame = 0; frame < 2 * RenderQueue::ID_RETIRE_FRAMES; frame++) {
+            queue.clear();
+            keptId = keptId && queue.getMeshId(&meshes[0]) == ids[0];
+            queue.getMaterialId(&material);
+        }
+        result.expect(keptId, "a mesh in use keeps its id across frames");
+        result.expect(queue.getMeshIdCount() == 1, "ids of meshes no longer drawn are retired");
+        result.expect(queue.getMaterialIdCount() == 1, "the material in use is not retired");
+        result.expect(queue.getMaterialId(&material) == materialId, "a material keeps its id across retirement");
+
+        int newMesh = 0;
+        const uint16_t newId = queue.getMeshId(&newMesh);
+        result.expect(newId != ids[0] && newId < meshes.size(), "a new mesh reuses a retired id");
+    }
+} // namespace engine
+
+int main() {
+    engine::CheckResult result;
+    engine::checkKeyPacking(result);
+    engine::checkSort(result);
+    engine::checkIds(result);
+    return result.report();
+}
@@ -0,0 +1,31 @@
+// Clustered point lighting shared by the forward fragment shaders. Include it after the
+// GlobalUbo declaration; LightClusterSystem fills in these buffers and the ubo cluster fields.
+
+#include "lights.glsl"
+
+// Per cluster: first entry in the light index list and number of lights
+layout(std430, set = 0, binding = 2) readonly buffer ClusterBuffer {
+	uvec2 clusters[];
+} clusterBuffer;
+
+layout(std430, set = 0, binding = 3) readonly buffer LightIndexBuffer {
+	uint indices[];
+} lightIndexBuffer;
+
+uint getClusterIndex(vec3 posWorld) {
+	float viewDepth = (ubo.view * vec4(posWorld, 1.0)).z;
+	float slice = log(viewDepth) * ubo.clusterDepth.z + ubo.clusterDepth.w;
+	uint z = uint(clamp(slice, 0.0, float(ubo.clusterCounts.z - 1)));
+	uvec2 tile = min(uvec2(gl_FragCoord.xy / ubo.clusterTileSize.xy), ubo.clusterCounts.xy - 1);
+	return (z * ubo.clusterCounts.y + tile.y) * ubo.clusterCounts.x + tile.x;
+}
+
+// Blinn-Phong over the lights of this fragment's cluster only
+void accumulateClusterLights(
+	vec3 posWorld, vec3 surfaceNormal, vec3 viewDirection, inout vec3 diffuseLight, inout vec3 specularLight) {
+	uvec2 cluster = clusterBuffer.clusters[getClusterIndex(posWorld)];
+	for (uint i = 0; i < cluster.y; i++) {
+		PointLight light = lightBuffer.lights[lightIndexBuffer.indices[cluster.x + i]];
+		shadePointLight(light, posWorld, surfaceNormal, viewDirection, diffuseLight, specularLight);
+	}
+}
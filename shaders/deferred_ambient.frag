@@ -0,0 +1,21 @@
+#version 450
+
+layout (location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	mat4 inverseView;
+	vec4 ambientLightColor;
+	uvec4 clusterCounts;
+	vec4 clusterDepth;
+	vec4 clusterTileSize;
+} ubo;
+
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput gBufferAlbedo;
+
+// Ambient term of every pixel; light volumes are added on top
+void main() {
+	vec3 albedo = subpassLoad(gBufferAlbedo).rgb;
+	outColor = vec4(ubo.ambientLightColor.xyz * ubo.ambientLightColor.w * albedo, 0.0);
+}
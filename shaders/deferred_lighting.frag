@@ -0,0 +1,43 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+layout(location = 0) in vec3 inPosView;
+layout(location = 1) flat in uint inLightIndex;
+
+layout (location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	mat4 inverseView;
+	vec4 ambientLightColor;
+	uvec4 clusterCounts;
+	vec4 clusterDepth;
+	vec4 clusterTileSize;
+} ubo;
+
+#include "lights.glsl"
+
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput gBufferAlbedo;
+layout(input_attachment_index = 1, set = 1, binding = 1) uniform subpassInput gBufferNormal;
+layout(input_attachment_index = 2, set = 1, binding = 2) uniform subpassInput gBufferDepth;
+
+// Adds one light to the G-buffer surface under this fragment of its light volume
+void main() {
+	// Perspective projection with depth in [0, 1], so depth = p22 + p32 / viewZ
+	float depth = subpassLoad(gBufferDepth).r;
+	float viewZ = ubo.projection[3][2] / (depth - ubo.projection[2][2]);
+	// The volume fragment and the stored surface lie on the same view ray
+	vec3 posView = inPosView * (viewZ / inPosView.z);
+	vec3 posWorld = (ubo.inverseView * vec4(posView, 1.0)).xyz;
+
+	vec3 surfaceNormal = subpassLoad(gBufferNormal).xyz;
+	vec3 viewDirection = normalize(ubo.inverseView[3].xyz - posWorld);
+	vec3 diffuseLight = vec3(0.0);
+	vec3 specularLight = vec3(0.0);
+	shadePointLight(
+		lightBuffer.lights[inLightIndex], posWorld, surfaceNormal, viewDirection, diffuseLight, specularLight);
+
+	vec3 albedo = subpassLoad(gBufferAlbedo).rgb;
+	outColor = vec4((diffuseLight + specularLight) * albedo, 0.0);
+}
@@ -0,0 +1,37 @@
+#version 450
+
+// Depth pre-pass: position only, no fragment stage. gl_Position is invariant here and in
+// simple_shader.vert, so both compute bit-identical depth and the main pass can test EQUAL.
+layout(location = 0) in vec3 position;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	mat4 inverseView;
+	vec4 ambientLightColor;
+	uvec4 clusterCounts;
+	vec4 clusterDepth;
+	vec4 clusterTileSize;
+} ubo;
+
+struct InstanceData {
+	mat4 modelMatrix;
+	mat4 normalMatrix;
+	uint textureIndex;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer InstanceBuffer {
+	InstanceData instances[];
+} instanceBuffer;
+
+layout(std430, set = 2, binding = 1) readonly buffer VisibleBuffer {
+	uint indices[];
+} visibleBuffer;
+
+invariant gl_Position;
+
+void main() {
+	InstanceData instance = instanceBuffer.instances[visibleBuffer.indices[gl_InstanceIndex]];
+	vec4 positionWorld = instance.modelMatrix * vec4(position, 1.0);
+	gl_Position = ubo.projection * ubo.view * positionWorld;
+}
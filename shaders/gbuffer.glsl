@@ -0,0 +1,17 @@
+// Deferred geometry subpass body of gbuffer.frag and gbuffer_bindless.frag: surface
+// attributes only, deferred_lighting.frag shades them
+
+layout(location = 0) in vec3 inColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec3 inPosWorld;
+layout(location = 3) in vec3 inNormalWorld;
+
+layout (location = 0) out vec4 outAlbedo;
+layout (location = 1) out vec4 outNormal;
+
+#include "surface_texture.glsl"
+
+void main() {
+	outAlbedo = vec4(shadeSurface(inColor, fragTexCoord), 1.0);
+	outNormal = vec4(normalize(inNormalWorld), 0.0);
+}
@@ -0,0 +1,7 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Textures come from the bindless image array instead of the per-texture set
+#define BINDLESS
+#include "gbuffer.glsl"
@@ -0,0 +1,20 @@
+// Hi-Z pyramid as laid out by HiZPyramid. Define HIZ_BINDING before including it.
+
+const uint HIZ_MAX_LEVELS = 16;
+
+layout(std430, set = 0, binding = HIZ_BINDING) buffer HiZBuffer {
+	// Transform the depth was rendered with
+	mat4 viewProjection;
+	uvec2 depthSize;
+	uint levelCount;
+	uint padding;
+	// Offset into depths, width and height of each level; texel i of level L holds the
+	// farthest depth of pixels [i * 2^(L+1), (i + 1) * 2^(L+1))
+	uvec4 levels[HIZ_MAX_LEVELS];
+	float depths[];
+} hiz;
+
+float fetchHiZ(uint level, uvec2 texel) {
+	uvec4 entry = hiz.levels[level];
+	return hiz.depths[entry.x + texel.y * entry.y + texel.x];
+}
@@ -0,0 +1,36 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+layout(location = 0) in vec3 position;
+
+layout(location = 0) out vec3 outPosView;
+layout(location = 1) flat out uint outLightIndex;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	mat4 inverseView;
+	vec4 ambientLightColor;
+	uvec4 clusterCounts;
+	vec4 clusterDepth;
+	vec4 clusterTileSize;
+} ubo;
+
+#include "lights.glsl"
+
+// False when the device cannot clamp depth, see DeferredLightingSystem
+layout(constant_id = 0) const bool DEPTH_CLAMPED = true;
+
+// One instance per light: the unit sphere scaled to the light's range
+void main() {
+	PointLight light = lightBuffer.lights[gl_InstanceIndex];
+	vec4 posView = ubo.view * vec4(light.position.xyz + position * light.position.w, 1.0);
+	gl_Position = ubo.projection * posView;
+	// The far side of a volume reaching past the far plane would be clipped away, taking the
+	// light off every pixel behind it; pull those vertices onto the far plane instead
+	if (!DEPTH_CLAMPED && gl_Position.w > 0.0) {
+		gl_Position.z = min(gl_Position.z, gl_Position.w);
+	}
+	outPosView = posView.xyz;
+	outLightIndex = gl_InstanceIndex;
+}
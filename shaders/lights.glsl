@@ -0,0 +1,36 @@
+// Point lights as written by LightClusterSystem, and the shading both render paths apply to
+// them. Include it after the GlobalUbo declaration.
+
+struct PointLight {
+	vec4 position; // w is the range
+	vec4 color; // w is the intensity
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer LightBuffer {
+	PointLight lights[];
+} lightBuffer;
+
+// Blinn-Phong for one light
+void shadePointLight(
+	PointLight light, vec3 posWorld, vec3 surfaceNormal, vec3 viewDirection,
+	inout vec3 diffuseLight, inout vec3 specularLight) {
+	vec3 lightDirection = light.position.xyz - posWorld;
+	float distanceSquared = dot(lightDirection, lightDirection);
+	// Inverse square falloff, windowed to reach zero at the light's range so clipping it
+	// to clusters or light volumes leaves no seams
+	float rangeRatio = distanceSquared / (light.position.w * light.position.w);
+	float window = clamp(1.0 - rangeRatio * rangeRatio, 0.0, 1.0);
+	float attenuation = window * window / distanceSquared;
+	lightDirection = normalize(lightDirection);
+	float cosAngIncidence = max(dot(surfaceNormal, lightDirection), 0);
+	vec3 intensity = light.color.xyz * light.color.w * attenuation;
+
+	diffuseLight += intensity * cosAngIncidence;
+
+	//specular light
+	vec3 halfAngle = normalize(lightDirection + viewDirection);
+	float blinnTerm = dot(surfaceNormal, halfAngle);
+	blinnTerm = clamp(blinnTerm, 0, 1);
+	blinnTerm = pow(blinnTerm, 32.0);
+	specularLight += intensity * blinnTerm;
+}
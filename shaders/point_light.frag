@@ -1,28 +1,9 @@
 #version 450
 
 layout (location = 0) in vec2 fragOffset;
+layout (location = 1) flat in vec4 fragColor;
 layout (location = 0) out vec4 outColor;
 
-struct PointLight {
-    vec4 position;
-    vec4 color;
-};
-
-layout(set = 0, binding = 0) uniform GlobalUbo {
-	mat4 projection;
-	mat4 view;
-	mat4 inverseView;
-    vec4 ambientLightColor;
-    PointLight pointLights[10];
-    int numLights;
-} ubo;
-
-layout (push_constant) uniform Push {
-    vec4 position;
-    vec4 color;
-    float radius;
-} push;
-
 const float M_PI = 3.1415926538;
 
 void main() {
@@ -30,5 +11,5 @@ void main() {
     if (dist >= 1.0) {
         discard;
     }
-    outColor = vec4(push.color.xyz, 0.5 * (cos(dist * M_PI) + 1.0));
+    outColor = vec4(fragColor.xyz, 0.5 * (cos(dist * M_PI) + 1.0));
 }
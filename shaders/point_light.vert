@@ -10,35 +10,38 @@ const vec2 OFFSETS[6] = vec2[] (
 );
 
 layout (location = 0) out vec2 fragOffset;
-
-struct PointLight {
-    vec4 position;
-    vec4 color;
-};
+layout (location = 1) flat out vec4 fragColor;
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
 	mat4 projection;
 	mat4 view;
 	mat4 inverseView;
-    vec4 ambientLightColor;
-    PointLight pointLights[10];
-    int numLights;
+	vec4 ambientLightColor;
+	uvec4 clusterCounts;
+	vec4 clusterDepth;
+	vec4 clusterTileSize;
 } ubo;
 
-layout (push_constant) uniform Push {
-    vec4 position;
+struct Billboard {
+    vec4 position; // w is the radius
     vec4 color;
-    float radius;
-} push;
+};
+
+// Sorted back to front by BillboardBatch, one instance per billboard
+layout(set = 1, binding = 0) readonly buffer BillboardBuffer {
+    Billboard billboards[];
+};
 
 void main() {
+    Billboard billboard = billboards[gl_InstanceIndex];
     fragOffset = OFFSETS[gl_VertexIndex];
+    fragColor = billboard.color;
     vec3 cameraRightWorld = {ubo.view[0][0], ubo.view[1][0], ubo.view[2][0]};
     vec3 cameraUpWorld = {ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]};
 
-    vec3 positionWorld = push.position.xyz
-        + push.radius * fragOffset.x * cameraRightWorld
-        + push.radius * fragOffset.y * cameraUpWorld;
+    vec3 positionWorld = billboard.position.xyz
+        + billboard.position.w * fragOffset.x * cameraRightWorld
+        + billboard.position.w * fragOffset.y * cameraUpWorld;
 
     gl_Position = ubo.projection * ubo.view * vec4(positionWorld, 1.0);
 }
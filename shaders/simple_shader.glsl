@@ -0,0 +1,35 @@
+// Forward shading body of simple_shader.frag and simple_shader_bindless.frag
+
+layout(location = 0) in vec3 inColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec3 inPosWorld;
+layout(location = 3) in vec3 inNormalWorld;
+
+layout (location = 0) out vec4 outColor;
+
+layout(set = 0, binding = 0) uniform GlobalUbo {
+	mat4 projection;
+	mat4 view;
+	mat4 inverseView;
+	vec4 ambientLightColor;
+	uvec4 clusterCounts;
+	vec4 clusterDepth;
+	vec4 clusterTileSize;
+} ubo;
+
+#include "clustered_lighting.glsl"
+#include "surface_texture.glsl"
+
+void main() {
+	vec3 diffuseLight = ubo.ambientLightColor.xyz * ubo.ambientLightColor.w;
+	vec3 specularLight = vec3(0.0);
+	vec3 surfaceNormal = normalize(inNormalWorld);
+
+	vec3 cameraPosWorld = ubo.inverseView[3].xyz;
+	vec3 viewDirection = normalize(cameraPosWorld - inPosWorld);
+
+	accumulateClusterLights(inPosWorld, surfaceNormal, viewDirection, diffuseLight, specularLight);
+
+	vec3 surfaceColor = shadeSurface(inColor, fragTexCoord);
+	outColor = vec4((diffuseLight + specularLight) * surfaceColor, 1.0);
+}
@@ -9,38 +9,47 @@ layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 layout(location = 2) out vec3 outPosWorld;
 layout(location = 3) out vec3 outNormalWorld;
-
-struct PointLight {
-    vec4 position;
-    vec4 color;
-};
+layout(location = 4) flat out uint fragTextureIndex;
 
 layout(set = 0, binding = 0) uniform GlobalUbo {
 	mat4 projection;
 	mat4 view;
 	mat4 inverseView;
-    vec4 ambientLightColor;
-    PointLight pointLights[10];
-    int numLights;
+	vec4 ambientLightColor;
+	uvec4 clusterCounts;
+	vec4 clusterDepth;
+	vec4 clusterTileSize;
 } ubo;
 
-layout(set = 1, binding = 0) uniform sampler2D texSampler;
-layout(set = 1, binding = 1) uniform TextureUbo {
-	int texIndex;
-} textureUbo;
-
-layout(push_constant) uniform Push {
+struct InstanceData {
 	mat4 modelMatrix;
 	mat4 normalMatrix;
-} push;
+	// Slot in the bindless texture array; unused with per-texture sets
+	uint textureIndex;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer InstanceBuffer {
+	InstanceData instances[];
+} instanceBuffer;
+
+// Maps gl_InstanceIndex to an instance; firstInstance of each draw points at its group's
+// slice. Identity when culled on the CPU, compacted by instance_cull.comp otherwise.
+layout(std430, set = 2, binding = 1) readonly buffer VisibleBuffer {
+	uint indices[];
+} visibleBuffer;
+
+// Must match depth_only.vert exactly for the EQUAL test after a depth pre-pass
+invariant gl_Position;
 
 void main() {
-	vec4 positionWorld = push.modelMatrix * vec4(position, 1.0);
+	InstanceData instance = instanceBuffer.instances[visibleBuffer.indices[gl_InstanceIndex]];
+	vec4 positionWorld = instance.modelMatrix * vec4(position, 1.0);
 
 	gl_Position = ubo.projection * ubo.view * positionWorld;
 	outPosWorld = positionWorld.xyz;
 	fragColor = inColor;
 	fragTexCoord = uv;
+	fragTextureIndex = instance.textureIndex;
 	
-	outNormalWorld = normalize(mat3(push.normalMatrix) * normal);
+	outNormalWorld = normalize(mat3(instance.normalMatrix) * normal);
 }
@@ -0,0 +1,31 @@
+// Surface texture lookup shared by the forward and G-buffer fragment shaders. The
+// *_bindless variants define BINDLESS before including it to index every loaded image by
+// the instance's texture, the others read the per-texture set.
+
+#ifdef BINDLESS
+layout(location = 4) flat in uint fragTextureIndex;
+
+// Every loaded image, indexed by the instance's textureIndex
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+#else
+layout(set = 1, binding = 0) uniform sampler2D texSampler;
+#endif
+
+// Specialized per pipeline by SimpleRenderSystem, so these branches compile away
+layout(constant_id = 0) const bool TEXTURED = true;
+// 0: none, 1: discard the half of the surface with u > 0.5
+layout(constant_id = 1) const int DISCARD_MODE = 0;
+
+// Texture color at uv, or the vertex color for untextured pipelines. Discards the
+// cut-away half only after sampling, so the quad still has derivatives for the fetch.
+vec3 shadeSurface(vec3 vertexColor, vec2 uv) {
+#ifdef BINDLESS
+	vec3 surfaceColor = TEXTURED ? texture(textures[nonuniformEXT(fragTextureIndex)], uv).rgb : vertexColor;
+#else
+	vec3 surfaceColor = TEXTURED ? texture(texSampler, uv).rgb : vertexColor;
+#endif
+	if (DISCARD_MODE == 1 && uv.x > 0.5) {
+		discard;
+	}
+	return surfaceColor;
+}
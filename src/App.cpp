@@ -5,6 +5,16 @@
 #include "systems/PointLightSystem.hpp"
 #include "systems/PhysicsSystem.hpp"
 #include "systems/CollisionSystem.hpp"
+#include "systems/CullingSystem.hpp"
+#include "systems/OcclusionCullingSystem.hpp"
+#include "systems/LodSystem.hpp"
+#include "systems/LightClusterSystem.hpp"
+#include "systems/DeferredLightingSystem.hpp"
+#include "CommandRecorder.hpp"
+#include "GpuTimer.hpp"
+#include "HiZPyramid.hpp"
+#include "JobPool.hpp"
+#include "PipelineBuildQueue.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -16,20 +26,33 @@
 #include <chrono>
 #include <cassert>
 #include <numeric>
+#include <iostream>
+#include <algorithm>
 
 namespace engine
 {
-    App::App()
+    App::App(
+        RenderPath renderPath, bool depthPrePass, bool occlusionCulling, bool softwareOcclusion, bool verifyGpuCulling)
+        : m_renderPath{ renderPath },
+          m_depthPrePass{ depthPrePass },
+          m_occlusionCulling{ occlusionCulling },
+          m_softwareOcclusion{ softwareOcclusion },
+          m_verifyGpuCulling{ verifyGpuCulling }
     {
+        if (m_verifyGpuCulling && m_softwareOcclusion) {
+            throw std::runtime_error("GPU culling verification needs GPU culling, not software occlusion");
+        }
         globalPool = DescriptorPool::Builder(m_device)
                     .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT * 2)
                     .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT)
+                    .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT * 3)
                     .build();
         loadGameObjects();
-        texturePool = DescriptorPool::Builder(m_device)
-                    .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT * 2)
-                    .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, images.size())
-                    .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, images.size())
+        // Starts sized for the textures loaded so far plus the default set, and chains more pools
+        // as others arrive
+        textureAllocator = DescriptorAllocator::Builder(m_device)
+                    .setInitialSets(static_cast<uint32_t>(images.size()) + 1)
+                    .addPoolRatio(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.f)
                     .build();
     }
 
@@ -51,7 +74,15 @@ namespace engine
 
         auto globalSetLayout = DescriptorSetLayout::Builder(m_device)
                                 .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
-                                .build();
+                                // Clustered lights, written by LightClusterSystem; deferred
+                                // light volumes also read the lights when placing their spheres
+                                .addBinding(
+                                    1,
+                                    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                    VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+                                .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+                                .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+                                .build(layoutCache);
         std::vector<VkDescriptorSet> globalDescriptorSets(SwapChain::MAX_FRAMES_IN_FLIGHT);
         for (int i = 0; i < globalDescriptorSets.size(); i++)
         {
@@ -60,55 +91,158 @@ namespace engine
                 .writeBuffer(0, &bufferInfo)
                 .build(globalDescriptorSets[i]);
         }
-        
-        uint16_t textureNum = images.size();
-        std::vector<std::shared_ptr<Buffer>> textureBuffers(textureNum);
-        for (int i = 0; i < textureBuffers.size(); i++) {
-            textureBuffers[i] = std::make_shared<Buffer>(
-                m_device,
-                sizeof(TextureData),
-                1,
-                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-            textureBuffers[i]->map();
-        }
 
-        auto textureSetLayout = DescriptorSetLayout::Builder(m_device)
+        // Bindless: one set holds every image and instances index into it. Otherwise each
+        // texture gets its own set.
+        const bool bindless = m_device.bindlessTextures && !images.empty();
+        const uint32_t textureCount = static_cast<uint32_t>(images.size());
+        std::shared_ptr<DescriptorSetLayout> textureSetLayout;
+        VkDescriptorSet bindlessTextureSet = VK_NULL_HANDLE;
+        if (bindless) {
+            // Combined image samplers count against both the sampler and the sampled image
+            // limits. The binding is not update-after-bind, so those limits do not apply.
+            const VkPhysicalDeviceLimits& limits = m_device.properties.limits;
+            const uint32_t maxTextures = std::min({
+                MAX_BINDLESS_TEXTURES,
+                limits.maxPerStageDescriptorSampledImages, limits.maxPerStageDescriptorSamplers,
+                limits.maxDescriptorSetSampledImages, limits.maxDescriptorSetSamplers });
+            if (textureCount > maxTextures) {
+                throw std::runtime_error("Too many textures for the bindless texture array");
+            }
+            textureSetLayout = DescriptorSetLayout::Builder(m_device)
+                                .addBinding(
+                                    0,
+                                    VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                    VK_SHADER_STAGE_FRAGMENT_BIT,
+                                    maxTextures,
+                                    VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                                        VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT)
+                                .build(layoutCache);
+
+            std::vector<VkDescriptorImageInfo> imageInfos;
+            for (auto& image : images) {
+                auto texInfo = image->textureInfo();
+                if (texInfo.imageView == VK_NULL_HANDLE || texInfo.descriptorInfo.imageView == VK_NULL_HANDLE)  {
+                    throw std::runtime_error("Invalid VkImageView handle in TextureInfo!");
+                }
+                imageInfos.push_back(texInfo.descriptorInfo);
+            }
+            DescriptorWriter(*textureSetLayout, *textureAllocator)
+                .writeImage(0, imageInfos.data(), textureCount)
+                .build(bindlessTextureSet, textureCount);
+        } else {
+            textureSetLayout = DescriptorSetLayout::Builder(m_device)
                                 .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_ALL_GRAPHICS)
-                                .addBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
-                                .build();
-        
+                                .build(layoutCache);
+        }
+
+        // Bound for entities without an ImageComponent, whose pipeline never samples it
+        VkDescriptorSet defaultTextureSet = VK_NULL_HANDLE;
+        if (!bindless) {
+            auto texInfo = entityManager.noTexture->textureInfo();
+            DescriptorWriter(*textureSetLayout, *textureAllocator)
+                .writeImage(0, &texInfo.descriptorInfo)
+                .build(defaultTextureSet);
+        }
+
         std::vector<VkDescriptorSet> textureDescriptorSets(images.size());
         for (const uint32_t entityID : entityManager.getEntitiesWithComponent(ComponentType::Image)) {
             if (entityManager.entityExists(entityID)) {
                 ImageComponent imageComponent = entityManager.getComponentData<ImageComponent>(entityID);
                 for (auto& imageIndex : imageComponent.imagesIndex) {
+                    imageComponent.textureBufferIndex.emplace_back(imageIndex);
+                    if (bindless) {
+                        imageComponent.pDescriptorSet.emplace_back(&bindlessTextureSet);
+                        continue;
+                    }
                     auto texInfo = images.at(imageIndex)->textureInfo();
-                    auto& buffer = textureBuffers[imageIndex];
                     if (texInfo.imageView == VK_NULL_HANDLE || texInfo.descriptorInfo.imageView == VK_NULL_HANDLE)  {
                         throw std::runtime_error("Invalid VkImageView handle in TextureInfo!");
                     }
-                    auto bufferInfo = buffer->descriptorInfo();
-                    DescriptorWriter(*textureSetLayout, *texturePool)
+                    DescriptorWriter(*textureSetLayout, *textureAllocator)
                         .writeImage(0,&texInfo.descriptorInfo)
-                        .writeBuffer(1,&bufferInfo)
                         .build(textureDescriptorSets.at(imageIndex));
                     imageComponent.pDescriptorSet.emplace_back(&textureDescriptorSets.at(imageIndex));
-                    imageComponent.textureBufferIndex.emplace_back(imageIndex);
                 }
                 entityManager.setComponentData<ImageComponent>(entityID, imageComponent);
             }
         }
 
+        // Systems only submit their pipelines here; they compile concurrently while the rest
+        // of startup runs and each system collects its own on first use
+        auto pipelineStart = std::chrono::high_resolution_clock::now();
+        // One thread per hardware thread, shared by pipeline builds, draw recording and
+        // software occlusion
+        JobPool jobPool{};
+        PipelineBuildQueue pipelineQueue{ pipelineRegistry, jobPool };
+        const bool deferred = m_renderPath == RenderPath::Deferred;
+        std::unique_ptr<HiZPyramid> hiZPyramid;
+        if (m_occlusionCulling && renderer.isDepthSampled()) {
+            hiZPyramid = std::make_unique<HiZPyramid>(m_device, pipelineQueue, renderer.getSwapChainExtent());
+        }
         SimpleRenderSystem simpleRenderSystem{
-            m_device, renderer.getSwapChainRenderPass(), 
-            globalSetLayout->getDescriptorSetLayout(), textureSetLayout->getDescriptorSetLayout()};
+            m_device, pipelineQueue, renderer.getSwapChainRenderPass(), 
+            globalSetLayout->getDescriptorSetLayout(), textureSetLayout->getDescriptorSetLayout(),
+            defaultTextureSet, m_softwareOcclusion ? CullingMode::Cpu : CullingMode::Gpu, bindlessTextureSet, m_renderPath,
+            m_depthPrePass, hiZPyramid.get()};
+        // The render system may turn it down
+        const bool occlusionCulling = simpleRenderSystem.hasOcclusionCulling();
+        simpleRenderSystem.setGpuCullingVerification(m_verifyGpuCulling);
+        uint32_t verifyFrames = 0;
+        uint32_t verifiedFrames = 0;
+        uint32_t cullingMismatches = 0;
         
+        // On the deferred path billboards are blended over the lit image in the lighting subpass
         PointLightSystem pointLightSysyem{
-            m_device, renderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout()};
+            m_device, pipelineQueue, renderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout(),
+            deferred ? SwapChain::LIGHTING_SUBPASS : SwapChain::GEOMETRY_SUBPASS};
+        std::unique_ptr<DeferredLightingSystem> deferredLightingSystem;
+        if (deferred) {
+            deferredLightingSystem = std::make_unique<DeferredLightingSystem>(
+                m_device, pipelineQueue, renderer.getSwapChainRenderPass(), globalSetLayout->getDescriptorSetLayout());
+        }
 
         PhysicsSystem physicsSystem;
         CollisionSystem collisionSystem;
+        // The BVH walk only feeds the CPU culling path; in the GPU path instance_cull.comp tests
+        // every instance itself, so nothing would be left for the tree to save
+        CullingSystem cullingSystem;
+        // Only the CPU culling path records draws from a list of entities it could filter
+        std::unique_ptr<OcclusionCullingSystem> occlusionCullingSystem;
+        if (m_softwareOcclusion && simpleRenderSystem.getCullingMode() == CullingMode::Cpu) {
+            occlusionCullingSystem = std::make_unique<OcclusionCullingSystem>(jobPool);
+        }
+        LodSystem lodSystem;
+        // The deferred path lights by volume, so it only needs the light buffer
+        LightClusterSystem lightClusterSystem{ m_device, *globalSetLayout, *globalPool, !deferred };
+        std::vector<PointLight> lights;
+        CommandRecorder commandRecorder{ m_device, jobPool };
+        GpuTimer gpuTimer{ m_device };
+        float depthPrePassMs = 0.f;
+        float opaqueMs = 0.f;
+        float hiZBuildMs = 0.f;
+        float disoccludedMs = 0.f;
+        float softwareOcclusionMs = 0.f;
+        float frustumCullingMs = 0.f;
+        uint32_t cullingWalks = 0;
+        uint32_t cullingRetests = 0;
+        uint32_t timedFrames = 0;
+        float drawRecordMs = 0.f;
+        uint32_t cpuTimedFrames = 0;
+
+        pipelineQueue.waitIdle();
+        std::cout << (deferred ? "deferred shading" : "clustered forward shading")
+            << (m_depthPrePass ? " with a depth pre-pass" : "")
+            << (occlusionCulling ? " and Hi-Z occlusion culling" : "")
+            << (occlusionCullingSystem ? " and software occlusion culling" : "")
+            << (bindless ? ", bindless textures" : ", per-texture descriptor sets") << std::endl;
+        std::cout << "pipelines created in "
+            << std::chrono::duration<float, std::chrono::milliseconds::period>(
+                std::chrono::high_resolution_clock::now() - pipelineStart).count()
+            << " ms on " << pipelineQueue.getWorkerCount() << " threads with a "
+            << (m_device.isPipelineCacheWarm() ? "warm" : "cold") << " pipeline cache ("
+            << pipelineRegistry.getPipelineCount() << " pipelines, "
+            << pipelineRegistry.getShaderModuleCount() << " shader modules)" << std::endl;
         Camera camera{};
 
         TransformComponent viewerObject {};
@@ -116,6 +250,8 @@ namespace engine
 
         KeyboardMovementController cameraController{};
         auto currentTime = std::chrono::high_resolution_clock::now();
+        bool firstFrameDone = false;
+        uint32_t swapChainGeneration = renderer.getSwapChainGeneration();
         while (m_window.m_stillRunning)
         {
             KeyboardMovementController::KeyMappings kMap{};
@@ -129,6 +265,10 @@ namespace engine
 
             cameraController.moveInPlaneXZ(
                 current_key_states, frameTime, viewerObject);
+            if (m_verifyGpuCulling) {
+                // Sweeps the frustum across the scene so instances keep entering and leaving it
+                viewerObject.rotation.y += glm::two_pi<float>() / GPU_CULLING_VERIFY_FRAMES;
+            }
             camera.setViewYXZ(
                 viewerObject.translation, viewerObject.rotation);
 
@@ -137,6 +277,15 @@ namespace engine
             if (auto commandBuffer = renderer.beginFrame())
             {
                 int frameIndex = renderer.getFrameIndex();
+                if (renderer.getSwapChainGeneration() != swapChainGeneration) {
+                    swapChainGeneration = renderer.getSwapChainGeneration();
+                    if (deferredLightingSystem) {
+                        deferredLightingSystem->invalidateGBufferSets();
+                    }
+                    if (hiZPyramid) {
+                        hiZPyramid->invalidateDepthSets();
+                    }
+                }
                 FrameInfo frameInfo{
                     frameIndex,
                     frameTime,
@@ -144,31 +293,184 @@ namespace engine
                     camera,
                     globalDescriptorSets[frameIndex],
                     entityManager,
-                    textureBuffers};
+                    &gpuTimer};
+                // Collects the timings this frame index recorded MAX_FRAMES_IN_FLIGHT frames ago
+                gpuTimer.beginFrame(frameIndex, commandBuffer);
+                if (gpuTimer.isSupported()) {
+                    depthPrePassMs += gpuTimer.getMs(GpuScope::DepthPrePass);
+                    opaqueMs += gpuTimer.getMs(GpuScope::Opaque);
+                    hiZBuildMs += gpuTimer.getMs(GpuScope::HiZBuild);
+                    disoccludedMs += gpuTimer.getMs(GpuScope::Disoccluded);
+                    if (++timedFrames == GPU_TIMING_FRAMES) {
+                        std::cout << "GPU opaque geometry: "
+                            << (depthPrePassMs + opaqueMs + disoccludedMs) / timedFrames << " ms";
+                        if (m_depthPrePass) {
+                            std::cout << " (depth pre-pass " << depthPrePassMs / timedFrames << " ms, shading "
+                                << opaqueMs / timedFrames << " ms)";
+                        }
+                        if (occlusionCulling) {
+                            std::cout << ", Hi-Z build " << hiZBuildMs / timedFrames << " ms, disoccluded "
+                                << disoccludedMs / timedFrames << " ms";
+                        }
+                        const RenderStats& renderStats = simpleRenderSystem.getStats();
+                        std::cout << ", " << renderStats.triangles << " triangles";
+                        if (simpleRenderSystem.getCullingMode() == CullingMode::Gpu) {
+                            std::cout << " (" << renderStats.gpuVisibleTriangles << " after GPU culling";
+                            if (occlusionCulling) {
+                                std::cout << ", " << renderStats.gpuDisoccludedInstances << " instances disoccluded";
+                            }
+                            std::cout << ")";
+                        }
+                        std::cout << std::endl;
+                        depthPrePassMs = 0.f;
+                        opaqueMs = 0.f;
+                        hiZBuildMs = 0.f;
+                        disoccludedMs = 0.f;
+                        timedFrames = 0;
+                    }
+                }
                 
                 // update
                 GlobalUbo ubo{};
                 ubo.projection = camera.getProjection();
                 ubo.view = camera.getView();
                 ubo.inverseView = camera.getInverseView();
-                pointLightSysyem.update(frameInfo, ubo);
+                pointLightSysyem.update(frameInfo, lights);
+                lightClusterSystem.update(frameInfo, lights, renderer.getSwapChainExtent(), ubo);
                 collisionSystem.update(frameInfo);
                 physicsSystem.update(frameInfo);
                 uboBuffers[frameIndex]->writeToBuffer(&ubo);
                 uboBuffers[frameIndex]->flush();
 
-                // render
-                renderer.beginSwapChainRenderPass(commandBuffer);
-                
-                simpleRenderSystem.renderGameObjects(frameInfo);
-                pointLightSysyem.render(frameInfo);
+                // culling, recorded before the render pass since the GPU path dispatches compute;
+                // levels of detail are picked first since they decide which indices get drawn
+                lodSystem.update(frameInfo);
+                if (occlusionCulling) {
+                    hiZPyramid->resize(renderer.getSwapChainExtent());
+                }
+                if (simpleRenderSystem.getCullingMode() == CullingMode::Gpu) {
+                    simpleRenderSystem.prepareDraws(
+                        frameInfo, entityManager.getEntitiesWithComponent(ComponentType::Model));
+                    if (simpleRenderSystem.getStats().gpuCullingVerified) {
+                        verifiedFrames++;
+                        cullingMismatches += simpleRenderSystem.getStats().gpuCullingMismatches;
+                    }
+                } else {
+                    auto cullingStart = std::chrono::high_resolution_clock::now();
+                    cullingSystem.update(frameInfo);
+                    frustumCullingMs += std::chrono::duration<float, std::chrono::milliseconds::period>(
+                        std::chrono::high_resolution_clock::now() - cullingStart).count();
+                    cullingWalks += cullingSystem.getStats().reused ? 0 : 1;
+                    cullingRetests += cullingSystem.getStats().retested;
+                    if (occlusionCullingSystem) {
+                        occlusionCullingSystem->update(frameInfo, cullingSystem.getVisibleEntities());
+                        const OcclusionStats& occlusionStats = occlusionCullingSystem->getStats();
+                        softwareOcclusionMs += occlusionStats.rasterMs + occlusionStats.testMs;
+                        simpleRenderSystem.prepareDraws(frameInfo, occlusionCullingSystem->getVisibleEntities());
+                    } else {
+                        simpleRenderSystem.prepareDraws(frameInfo, cullingSystem.getVisibleEntities());
+                    }
+                }
 
+                // render, geometry recorded in parallel into secondary command buffers; point
+                // lights go last since they are alpha blended over the scene
+                commandRecorder.beginFrame(
+                    frameIndex,
+                    renderer.getSwapChainRenderPass(),
+                    renderer.getCurrentFramebuffer(),
+                    renderer.getSwapChainExtent());
+                simpleRenderSystem.renderGameObjects(frameInfo, commandRecorder);
+                if (deferred) {
+                    drawRecordMs += commandRecorder.getFrameRecordMs();
+                    // The lighting subpass is a handful of draws, recorded inline
+                    renderer.beginSwapChainRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                    commandRecorder.execute(commandBuffer);
+                    renderer.nextSubpass(commandBuffer);
+                    deferredLightingSystem->render(
+                        frameInfo, renderer.getCurrentGBufferViews(), static_cast<uint32_t>(lights.size()));
+                    pointLightSysyem.render(frameInfo);
+                } else {
+                    // With occlusion culling, what the first phase drew becomes the depth the second
+                    // phase is culled against, between two halves of the render pass
+                    const uint32_t earlyBuffers = commandRecorder.getRecordedCount();
+                    if (occlusionCulling) {
+                        simpleRenderSystem.renderDisoccluded(frameInfo, commandRecorder);
+                    }
+                    // Only the scene's draw jobs, before the single point light job
+                    drawRecordMs += commandRecorder.getFrameRecordMs();
+                    commandRecorder.record(1, [&](uint32_t, VkCommandBuffer lightCommandBuffer) {
+                        FrameInfo lightFrameInfo = frameInfo;
+                        lightFrameInfo.commandBuffer = lightCommandBuffer;
+                        pointLightSysyem.render(lightFrameInfo);
+                    });
+                    if (occlusionCulling) {
+                        renderer.beginEarlyRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                        commandRecorder.execute(commandBuffer, 0, earlyBuffers);
+                        renderer.endSwapChainRenderPass(commandBuffer);
+                        simpleRenderSystem.cullDisoccluded(frameInfo, renderer.getCurrentDepthView());
+                        renderer.beginLateRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                        commandRecorder.execute(commandBuffer, earlyBuffers, commandRecorder.getRecordedCount());
+                    } else {
+                        renderer.beginSwapChainRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+                        commandRecorder.execute(commandBuffer);
+                    }
+                }
                 renderer.endSwapChainRenderPass(commandBuffer);
                 renderer.endFrame();
+                if (++cpuTimedFrames == GPU_TIMING_FRAMES) {
+                    const RenderStats& recordStats = simpleRenderSystem.getStats();
+                    std::cout << "CPU draw recording: " << drawRecordMs / cpuTimedFrames << " ms on "
+                        << commandRecorder.getWorkerCount() << " workers, " << recordStats.drawCalls
+                        << " draws, " << recordStats.pipelineBinds << " pipeline binds, "
+                        << recordStats.descriptorSetBinds << " descriptor set binds, "
+                        << recordStats.geometryBinds << " geometry binds in the last frame" << std::endl;
+                    if (simpleRenderSystem.getCullingMode() == CullingMode::Cpu) {
+                        const CullingStats& cullingStats = cullingSystem.getStats();
+                        std::cout << "frustum culling: " << frustumCullingMs / cpuTimedFrames << " ms, "
+                            << cullingStats.visible << " visible, " << cullingStats.culled << " culled, "
+                            << cullingWalks << " walks in " << cpuTimedFrames << " frames ("
+                            << cullingStats.walk.nodesVisited << " nodes in the last), " << cullingRetests
+                            << " single entity retests" << std::endl;
+                    }
+                    if (occlusionCullingSystem) {
+                        const OcclusionStats& occlusionStats = occlusionCullingSystem->getStats();
+                        std::cout << "software occlusion: " << softwareOcclusionMs / cpuTimedFrames << " ms on "
+                            << occlusionCullingSystem->getBuffer().getWorkerCount() << " workers, "
+                            << occlusionStats.triangles << " occluder triangles, " << occlusionStats.occluded
+                            << " of " << occlusionStats.tested + occlusionStats.reused << " instances occluded ("
+                            << occlusionStats.reused << " cached)" << std::endl;
+                    }
+                    drawRecordMs = 0.f;
+                    softwareOcclusionMs = 0.f;
+                    frustumCullingMs = 0.f;
+                    cullingWalks = 0;
+                    cullingRetests = 0;
+                    cpuTimedFrames = 0;
+                }
+                if (!firstFrameDone) {
+                    std::cout << "startup to first frame: "
+                        << std::chrono::duration<float, std::chrono::milliseconds::period>(
+                            std::chrono::high_resolution_clock::now() - m_startTime).count()
+                        << " ms" << std::endl;
+                    firstFrameDone = true;
+                }
+                if (m_verifyGpuCulling && ++verifyFrames == GPU_CULLING_VERIFY_FRAMES) {
+                    break;
+                }
             }
         }
 
         vkDeviceWaitIdle(m_device.device());
+        if (m_verifyGpuCulling && simpleRenderSystem.getCullingMode() != CullingMode::Gpu) {
+            // The device lacks what GPU culling needs, so there is nothing to verify
+            std::cout << "GPU culling verification skipped, culling ran on the CPU" << std::endl;
+        } else if (m_verifyGpuCulling) {
+            std::cout << "GPU culling verified on " << verifiedFrames << " frames, "
+                << cullingMismatches << " draws disagreed with the CPU reference" << std::endl;
+            if (verifiedFrames == 0 || cullingMismatches > 0) {
+                throw std::runtime_error("GPU culling verification failed");
+            }
+        }
     }
 
     void App::handleSDLEvents()
@@ -217,7 +519,7 @@ namespace engine
         images.push_back(entityManager.noTexture);
         //****************** CUBE ***********************
         uint32_t cube = entityManager.createEntity();
-        std::shared_ptr<Model> model = Model::createModelFromFile(m_device, "models/cube.obj");        
+        std::shared_ptr<Model> model = Model::createModelFromFile(meshPool, "models/cube.obj");        
         ImageComponent cubeTexture;
         std::shared_ptr<Image> image = std::make_shared<Image>(m_device, "textures/texture.jpg", 0);
         images.push_back(image);
@@ -232,6 +534,7 @@ namespace engine
         entityManager.addComponent(cube, ComponentType::Model);
         ModelComponent cubeModel;
         cubeModel.model = model;
+        cubeModel.occluder = true;
         entityManager.setComponentData(cube, cubeModel);
         entityManager.addComponent(cube, ComponentType::Transform);
         TransformComponent cubeTransform{};
@@ -240,7 +543,7 @@ namespace engine
         entityManager.setComponentData(cube, cubeTransform);
 
         //****************** SHIP ***********************
-        model = Model::createModelFromFile(m_device, "models/shiptest.obj");
+        model = Model::createModelFromFile(meshPool, "models/shiptest.obj", MODEL_LOD_COUNT);
         uint32_t ship = entityManager.createEntity();
         entityManager.addComponent(ship, ComponentType::Model);
         ModelComponent shipModel;
@@ -260,11 +563,12 @@ namespace engine
         entityManager.setComponentData(ship, shipTransform);
 
         //****************** FLOOR ***********************
-        model = Model::createModelFromFile(m_device, "models/Quad.obj");
+        model = Model::createModelFromFile(meshPool, "models/Quad.obj");
         uint32_t floor = entityManager.createEntity();
         entityManager.addComponent(floor, ComponentType::Model);
         ModelComponent floorModel;
         floorModel.model = model;
+        floorModel.occluder = true;
         entityManager.setComponentData(floor, floorModel);
 
         entityManager.addComponent(floor, ComponentType::Transform);
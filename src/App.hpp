@@ -3,17 +3,40 @@
 #include "Renderer.hpp"
 #include "KeyboardMovementController.hpp"
 #include "Descriptors.hpp"
+#include "PipelineRegistry.hpp"
 #include "EntityManager.hpp"
 
+#include <chrono>
+
 namespace engine {
 
 	static constexpr size_t MAX_ENTITIES = 500;
+	static constexpr uint32_t MESH_POOL_VERTICES = 1 << 20;
+	static constexpr uint32_t MESH_POOL_INDICES = 1 << 22;
+	// Upper bound of the bindless sampler array, further capped by the device limit
+	static constexpr uint32_t MAX_BINDLESS_TEXTURES = 4096;
+	// Levels of detail generated for detailed models, including the full mesh
+	static constexpr uint32_t MODEL_LOD_COUNT = 4;
+	// Frames averaged into each printed GPU or CPU timing
+	static constexpr uint32_t GPU_TIMING_FRAMES = 500;
+	// Frames rendered, turning the camera a step each, before GPU culling verification ends
+	static constexpr uint32_t GPU_CULLING_VERIFY_FRAMES = 120;
 	class App {
 	public:
 		static constexpr int WIDTH = 1920;
 		static constexpr int HEIGHT = 1200;
 
-		App();
+		// depthPrePass lays down scene depth before shading, for scenes with heavy overdraw.
+		// occlusionCulling skips instances hidden behind the previous frame's depth (forward only).
+		// softwareOcclusion culls on the CPU instead, against flagged occluders rasterized there.
+		// verifyGpuCulling checks GPU culling against the CPU reference for a fixed number of
+		// frames, then run() returns, or throws if any draw disagreed.
+		explicit App(
+			RenderPath renderPath = RenderPath::Forward,
+			bool depthPrePass = false,
+			bool occlusionCulling = false,
+			bool softwareOcclusion = false,
+			bool verifyGpuCulling = false);
 		~App();
 
 		App(const App&) = delete;
@@ -25,13 +48,26 @@ namespace engine {
 	private:
 		void loadGameObjects();
 
+		// First member, so startup timing covers window and device creation
+		std::chrono::high_resolution_clock::time_point m_startTime = std::chrono::high_resolution_clock::now();
 		Window m_window{ WIDTH, HEIGHT, "Hello Vulkan!" };
 		Device m_device{ m_window };
-		Renderer renderer{ m_window, m_device };
+		RenderPath m_renderPath;
+		bool m_depthPrePass;
+		bool m_occlusionCulling;
+		bool m_softwareOcclusion;
+		bool m_verifyGpuCulling;
+		// Only Hi-Z occlusion culling, which runs on the forward path with GPU culling, samples depth
+		Renderer renderer{
+			m_window, m_device, m_renderPath,
+			m_occlusionCulling && !m_softwareOcclusion && m_renderPath == RenderPath::Forward };
+		MeshPool meshPool{ m_device, sizeof(Model::Vertex), MESH_POOL_VERTICES, MESH_POOL_INDICES };
 		std::vector<std::shared_ptr<Image>> images;
 
 		std::unique_ptr<DescriptorPool> globalPool{};
-		std::unique_ptr<DescriptorPool> texturePool{};
+		std::unique_ptr<DescriptorAllocator> textureAllocator{};
+		DescriptorLayoutCache layoutCache{ m_device };
+		PipelineRegistry pipelineRegistry{ m_device };
 		EntityManager entityManager = EntityManager(MAX_ENTITIES, m_device);
 	};
 } // namespace engine
\ No newline at end of file
@@ -0,0 +1,159 @@
+#include "BillboardBatch.hpp"
+#include "systems/CullingSystem.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace engine {
+
+    BillboardBatch::BillboardBatch(
+        Device& device,
+        PipelineBuildQueue& pipelineQueue,
+        VkRenderPass renderPass,
+        uint32_t subpass,
+        VkDescriptorSetLayout globalSetLayout,
+        const std::string& vertFilepath,
+        const std::string& fragFilepath) : m_device{ device } {
+        createFrameResources();
+        createPipelineLayout(globalSetLayout);
+        createPipeline(pipelineQueue, renderPass, subpass, vertFilepath, fragFilepath);
+    }
+
+    BillboardBatch::~BillboardBatch() {
+        vkDestroyPipelineLayout(m_device.device(), m_pipelineLayout, nullptr);
+    }
+
+    void BillboardBatch::createFrameResources() {
+        m_instanceSetLayout = DescriptorSetLayout::Builder(m_device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .build();
+        m_framePool = DescriptorPool::Builder(m_device)
+            .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .build();
+        for (auto& frame : m_frames) {
+            createInstanceBuffer(frame, INITIAL_CAPACITY);
+        }
+    }
+
+    void BillboardBatch::createInstanceBuffer(FrameResources& frame, uint32_t capacity) {
+        frame.instances = std::make_unique<Buffer>(
+            m_device,
+            sizeof(Billboard),
+            capacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        frame.instances->map();
+
+        auto instanceInfo = frame.instances->descriptorInfo();
+        DescriptorWriter writer{ *m_instanceSetLayout, *m_framePool };
+        writer.writeBuffer(0, &instanceInfo);
+        if (frame.instanceSet == VK_NULL_HANDLE) {
+            writer.build(frame.instanceSet);
+        } else {
+            writer.overwrite(frame.instanceSet);
+        }
+    }
+
+    void BillboardBatch::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
+        std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+            globalSetLayout, m_instanceSetLayout->getDescriptorSetLayout() };
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = 0;
+        pipelineLayoutInfo.pPushConstantRanges = nullptr;
+        if (vkCreatePipelineLayout(m_device.device(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("error while creating billboard pipelineLayout");
+        }
+    }
+
+    void BillboardBatch::createPipeline(
+        PipelineBuildQueue& pipelineQueue,
+        VkRenderPass renderPass,
+        uint32_t subpass,
+        const std::string& vertFilepath,
+        const std::string& fragFilepath) {
+        assert(m_pipelineLayout != VK_NULL_HANDLE && "Cannot create pipeline before pipeline layout");
+
+        auto pipelineConfig = std::make_unique<PipelineConfigInfo>();
+        Pipeline::defaultPipelineConfigInfo(*pipelineConfig);
+        Pipeline::enableAlphaBlending(*pipelineConfig);
+        pipelineConfig->attributeDescriptions.clear();
+        pipelineConfig->bindingDescriptions.clear();
+        // Sorted back to front and drawn after opaque geometry, so only depth testing is needed
+        pipelineConfig->depthStencilInfo.depthWriteEnable = VK_FALSE;
+        pipelineConfig->renderPass = renderPass;
+        pipelineConfig->subpass = subpass;
+        pipelineConfig->pipelineLayout = m_pipelineLayout;
+        m_pendingPipeline = pipelineQueue.submit(vertFilepath, fragFilepath, std::move(pipelineConfig));
+    }
+
+    void BillboardBatch::prepare(FrameInfo& frameInfo) {
+        // render() may be recorded on a worker thread, so the pipeline is collected here
+        if (m_pendingPipeline.valid()) {
+            m_pipeline = m_pendingPipeline.get();
+        }
+        FrameResources& frame = m_frames[frameInfo.frameIndex];
+
+        const Frustum frustum = frameInfo.camera.getFrustum();
+        const glm::mat4 projectionView = frameInfo.camera.getProjection() * frameInfo.camera.getView();
+        m_sortQueue.clear();
+        const uint32_t count = static_cast<uint32_t>(m_billboards.size());
+        for (uint32_t i = 0; i < count; i++) {
+            const glm::vec3 center{ m_billboards[i].position };
+            if (!CullingSystem::isSphereVisible(frustum, center, m_billboards[i].position.w)) {
+                continue;
+            }
+            // Inverted, so ascending keys run back to front; the sort is stable, so billboards
+            // at the same depth all stay and keep the order they were added in
+            const glm::vec4 clip = projectionView * glm::vec4(center, 1.f);
+            const float depth = clip.w > 0.f ? clip.z / clip.w : 0.f;
+            m_sortQueue.push(RenderQueue::makeKey(0, 0, 0, 1.f - depth), i);
+        }
+        m_sortQueue.sort();
+
+        const auto& items = m_sortQueue.getItems();
+        const uint32_t drawCount = static_cast<uint32_t>(items.size());
+        m_stats.submitted = count;
+        m_stats.drawn = drawCount;
+        frame.drawCount = drawCount;
+        if (drawCount == 0) {
+            return;
+        }
+
+        // This frame's fence has been waited on, so neither the buffer nor its set is in use
+        if (drawCount > frame.instances->getInstanceCount()) {
+            createInstanceBuffer(frame, std::max(drawCount, frame.instances->getInstanceCount() * 2));
+        }
+        auto* instances = static_cast<Billboard*>(frame.instances->getMappedMemory());
+        for (uint32_t i = 0; i < drawCount; i++) {
+            instances[i] = m_billboards[items[i].payload];
+        }
+        frame.instances->flush();
+    }
+
+    void BillboardBatch::render(FrameInfo& frameInfo) {
+        const FrameResources& frame = m_frames[frameInfo.frameIndex];
+        if (frame.drawCount == 0) {
+            return;
+        }
+        assert(m_pipeline && "prepare must run before render");
+
+        m_pipeline->bind(frameInfo.commandBuffer);
+        std::array<VkDescriptorSet, 2> sets{ frameInfo.globalDescriptorSet, frame.instanceSet };
+        vkCmdBindDescriptorSets(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            m_pipelineLayout,
+            0,
+            static_cast<uint32_t>(sets.size()),
+            sets.data(),
+            0,
+            nullptr);
+        vkCmdDraw(frameInfo.commandBuffer, 6, frame.drawCount, 0, 0);
+    }
+} // namespace engine
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Pipeline.hpp"
+#include "PipelineBuildQueue.hpp"
+#include "FrameInfo.hpp"
+#include "Descriptors.hpp"
+#include "RenderQueue.hpp"
+#include "SwapChain.hpp"
+
+#include <array>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace engine {
+
+    // Matches Billboard in the billboard vertex shaders (std430)
+    struct Billboard {
+        glm::vec4 position{}; // w is the radius in world units
+        glm::vec4 color{};
+    };
+
+    struct BillboardStats {
+        uint32_t submitted{ 0 };
+        // Left after frustum culling, all drawn by one instanced call
+        uint32_t drawn{ 0 };
+    };
+
+    // Draws camera facing, alpha blended quads in a single instanced call. Billboards are
+    // gathered on the host each frame, culled against the frustum, radix sorted back to front
+    // on quantized depth and written to a per-frame storage buffer. The vertex shader expands
+    // vertices 0-5 of instance gl_InstanceIndex into the quad of billboard gl_InstanceIndex,
+    // read from set 1 binding 0; the fragment shader decides what the quad looks like.
+    class BillboardBatch {
+    public:
+        static constexpr uint32_t INITIAL_CAPACITY = 1024;
+
+        BillboardBatch(
+            Device& device,
+            PipelineBuildQueue& pipelineQueue,
+            VkRenderPass renderPass,
+            uint32_t subpass,
+            VkDescriptorSetLayout globalSetLayout,
+            const std::string& vertFilepath,
+            const std::string& fragFilepath);
+        ~BillboardBatch();
+
+        BillboardBatch(const BillboardBatch&) = delete;
+        BillboardBatch& operator=(const BillboardBatch&) = delete;
+
+        void clear() { m_billboards.clear(); }
+        void add(const Billboard& billboard) { m_billboards.push_back(billboard); }
+        // Culls, sorts and uploads what was added since clear into this frame's buffer. Runs on
+        // the thread that owns the frame, before render is recorded.
+        void prepare(FrameInfo& frameInfo);
+        // May be recorded on any one thread once prepare has run
+        void render(FrameInfo& frameInfo);
+
+        const BillboardStats& getStats() const { return m_stats; }
+
+    private:
+        struct FrameResources {
+            std::unique_ptr<Buffer> instances;
+            VkDescriptorSet instanceSet = VK_NULL_HANDLE;
+            uint32_t drawCount = 0;
+        };
+
+        void createFrameResources();
+        void createInstanceBuffer(FrameResources& frame, uint32_t capacity);
+        void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+        void createPipeline(
+            PipelineBuildQueue& pipelineQueue,
+            VkRenderPass renderPass,
+            uint32_t subpass,
+            const std::string& vertFilepath,
+            const std::string& fragFilepath);
+
+        Device& m_device;
+        std::shared_ptr<Pipeline> m_pipeline;
+        std::future<std::shared_ptr<Pipeline>> m_pendingPipeline;
+        VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+
+        std::unique_ptr<DescriptorSetLayout> m_instanceSetLayout;
+        std::unique_ptr<DescriptorPool> m_framePool;
+        std::array<FrameResources, SwapChain::MAX_FRAMES_IN_FLIGHT> m_frames;
+
+        std::vector<Billboard> m_billboards;
+        // Only the depth bits of the keys are used
+        RenderQueue m_sortQueue;
+        BillboardStats m_stats{};
+    };
+} // namespace engine
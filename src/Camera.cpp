@@ -91,6 +91,8 @@ namespace engine {
 		projectionMatrix[3][0] = -(right + left) / (right - left);
 		projectionMatrix[3][1] = -(bottom + top) / (bottom - top);
 		projectionMatrix[3][2] = -near / (far - near);
+		nearPlane = near;
+		farPlane = far;
 	}
 
 	void Camera::setPerspectiveProjection(float fovy, float aspect, float near, float far) {
@@ -102,5 +104,27 @@ namespace engine {
 		projectionMatrix[2][2] = far / (far - near);
 		projectionMatrix[2][3] = 1.f;
 		projectionMatrix[3][2] = -(far * near) / (far - near);
+		nearPlane = near;
+		farPlane = far;
+	}
+
+	Frustum Camera::getFrustum() const {
+		// Gribb/Hartmann: combine rows of the clip matrix, with clip z in [0, w]
+		const glm::mat4 clip = projectionMatrix * viewMatrix;
+		auto row = [&clip](int i) {
+			return glm::vec4{clip[0][i], clip[1][i], clip[2][i], clip[3][i]};
+		};
+
+		Frustum frustum{};
+		frustum.planes[0] = row(3) + row(0);
+		frustum.planes[1] = row(3) - row(0);
+		frustum.planes[2] = row(3) + row(1);
+		frustum.planes[3] = row(3) - row(1);
+		frustum.planes[4] = row(2);
+		frustum.planes[5] = row(3) - row(2);
+		for (auto& plane : frustum.planes) {
+			plane = plane / glm::length(glm::vec3(plane));
+		}
+		return frustum;
 	}
 } // engine namespace
@@ -7,6 +7,11 @@
 namespace engine
 {
 
+	// Plane normals point into the frustum: p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+	struct Frustum {
+		glm::vec4 planes[6];
+	};
+
 	class Camera
 	{
 	public:
@@ -31,10 +36,16 @@ namespace engine
 		const glm::mat4 getView() const { return viewMatrix; }
 		const glm::mat4 getInverseView() const { return inverseViewMatrix; }
 		const glm::vec3 getPosition() const { return glm::vec3(inverseViewMatrix[3]); }
+		float getNearPlane() const { return nearPlane; }
+		float getFarPlane() const { return farPlane; }
+		// World-space planes of projection * view, normalized so plane distances are in world units
+		Frustum getFrustum() const;
 
 	private:
 		glm::mat4 projectionMatrix{1.f};
 		glm::mat4 viewMatrix{1.f};
 		glm::mat4 inverseViewMatrix{1.f};
+		float nearPlane{.1f};
+		float farPlane{100.f};
 	};
 } // engine namespace
@@ -0,0 +1,132 @@
+#include "CommandRecorder.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <stdexcept>
+
+namespace engine {
+
+    CommandRecorder::CommandRecorder(Device& device, JobPool& jobPool)
+        : m_device{ device }, m_jobPool{ jobPool } {
+        m_workers.resize(jobPool.getWorkerCount());
+        for (auto& worker : m_workers) {
+            createCommandPools(worker);
+        }
+    }
+
+    CommandRecorder::~CommandRecorder() {
+        // Destroying a pool frees the buffers allocated from it
+        for (auto& worker : m_workers) {
+            for (auto& frame : worker.frames) {
+                vkDestroyCommandPool(m_device.device(), frame.commandPool, nullptr);
+            }
+        }
+    }
+
+    void CommandRecorder::createCommandPools(Worker& worker) {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = m_device.findPhysicalQueueFamilies().graphicsFamily;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        for (auto& frame : worker.frames) {
+            if (vkCreateCommandPool(m_device.device(), &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create worker command pool!");
+            }
+        }
+    }
+
+    void CommandRecorder::beginFrame(
+        int frameIndex, VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent) {
+        m_frameIndex = frameIndex;
+        for (auto& worker : m_workers) {
+            WorkerFrame& frame = worker.frames[frameIndex];
+            if (vkResetCommandPool(m_device.device(), frame.commandPool, 0) != VK_SUCCESS) {
+                throw std::runtime_error("failed to reset worker command pool!");
+            }
+            frame.usedBuffers = 0;
+        }
+
+        m_inheritanceInfo = {};
+        m_inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        m_inheritanceInfo.renderPass = renderPass;
+        m_inheritanceInfo.subpass = 0;
+        m_inheritanceInfo.framebuffer = framebuffer;
+        m_extent = extent;
+        m_recorded.clear();
+        m_frameRecordMs = 0.f;
+    }
+
+    void CommandRecorder::record(uint32_t jobCount, const Job& job) {
+        if (jobCount == 0) {
+            return;
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+
+        m_jobBuffers.assign(jobCount, VK_NULL_HANDLE);
+        m_jobPool.run(jobCount, [&](uint32_t workerIndex, uint32_t jobIndex) {
+            VkCommandBuffer commandBuffer = beginSecondary(workerIndex);
+            job(jobIndex, commandBuffer);
+            if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to end secondary command buffer!");
+            }
+            m_jobBuffers[jobIndex] = commandBuffer;
+        });
+
+        m_recorded.insert(m_recorded.end(), m_jobBuffers.begin(), m_jobBuffers.end());
+        m_frameRecordMs += std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    void CommandRecorder::execute(VkCommandBuffer primaryCommandBuffer) {
+        execute(primaryCommandBuffer, 0, getRecordedCount());
+    }
+
+    void CommandRecorder::execute(VkCommandBuffer primaryCommandBuffer, uint32_t firstBuffer, uint32_t endBuffer) {
+        assert(firstBuffer <= endBuffer && endBuffer <= m_recorded.size() && "Buffer range out of bounds");
+        if (firstBuffer == endBuffer) {
+            return;
+        }
+        vkCmdExecuteCommands(primaryCommandBuffer, endBuffer - firstBuffer, m_recorded.data() + firstBuffer);
+    }
+
+    VkCommandBuffer CommandRecorder::beginSecondary(uint32_t workerIndex) {
+        WorkerFrame& frame = m_workers[workerIndex].frames[m_frameIndex];
+        if (frame.usedBuffers == frame.commandBuffers.size()) {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandPool = frame.commandPool;
+            allocInfo.commandBufferCount = 1;
+
+            VkCommandBuffer commandBuffer;
+            if (vkAllocateCommandBuffers(m_device.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("Could not allocate secondary commandBuffer");
+            }
+            frame.commandBuffers.push_back(commandBuffer);
+        }
+        VkCommandBuffer commandBuffer = frame.commandBuffers[frame.usedBuffers++];
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags =
+            VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &m_inheritanceInfo;
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to begin secondary command buffer!");
+        }
+
+        // Secondary buffers inherit no dynamic state from the primary
+        VkViewport viewport{};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(m_extent.width);
+        viewport.height = static_cast<float>(m_extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        VkRect2D scissor{ {0, 0}, m_extent };
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        return commandBuffer;
+    }
+} // namespace engine
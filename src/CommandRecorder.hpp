@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Device.hpp"
+#include "JobPool.hpp"
+#include "SwapChain.hpp"
+
+#include <array>
+#include <functional>
+#include <vector>
+
+namespace engine {
+
+    // Records draw work into secondary command buffers on the workers of a JobPool.
+    // Every worker owns one command pool per frame in flight, so no pool is ever touched
+    // by two threads and a whole frame's buffers are recycled with a single pool reset.
+    // The calling thread takes part as worker 0.
+    class CommandRecorder {
+    public:
+        using Job = std::function<void(uint32_t jobIndex, VkCommandBuffer commandBuffer)>;
+
+        CommandRecorder(Device& device, JobPool& jobPool);
+        ~CommandRecorder();
+
+        CommandRecorder(const CommandRecorder&) = delete;
+        CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+        // Resets this frame's pools; the frame's fence must already have been waited on.
+        // Secondary buffers recorded until the next beginFrame continue the given subpass.
+        void beginFrame(int frameIndex, VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent);
+        // Runs job(0..jobCount-1) across the workers, each job into its own secondary buffer
+        // with viewport and scissor already set. Blocks until every job is recorded.
+        void record(uint32_t jobCount, const Job& job);
+        // Executes everything recorded this frame, in record order, inside the current render pass
+        void execute(VkCommandBuffer primaryCommandBuffer);
+        // Executes buffers [firstBuffer, endBuffer) of this frame, for frames whose secondary
+        // buffers are split across several compatible render passes
+        void execute(VkCommandBuffer primaryCommandBuffer, uint32_t firstBuffer, uint32_t endBuffer);
+        // Buffers recorded so far this frame; the next record() continues from here
+        uint32_t getRecordedCount() const { return static_cast<uint32_t>(m_recorded.size()); }
+
+        uint32_t getWorkerCount() const { return static_cast<uint32_t>(m_workers.size()); }
+        // Wall time of every record() call since beginFrame
+        float getFrameRecordMs() const { return m_frameRecordMs; }
+
+    private:
+        struct WorkerFrame {
+            VkCommandPool commandPool = VK_NULL_HANDLE;
+            std::vector<VkCommandBuffer> commandBuffers;
+            uint32_t usedBuffers = 0;
+        };
+
+        struct Worker {
+            std::array<WorkerFrame, SwapChain::MAX_FRAMES_IN_FLIGHT> frames;
+        };
+
+        void createCommandPools(Worker& worker);
+        VkCommandBuffer beginSecondary(uint32_t workerIndex);
+
+        Device& m_device;
+        JobPool& m_jobPool;
+        // Indexed by JobPool worker
+        std::vector<Worker> m_workers;
+
+        int m_frameIndex = 0;
+        VkCommandBufferInheritanceInfo m_inheritanceInfo{};
+        VkExtent2D m_extent{};
+        std::vector<VkCommandBuffer> m_recorded;
+        // Buffers of the record() call in flight, by job
+        std::vector<VkCommandBuffer> m_jobBuffers;
+
+        float m_frameRecordMs = 0.f;
+    };
+} // namespace engine
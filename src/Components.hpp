@@ -89,6 +89,11 @@ namespace engine {
     struct ModelComponent {
         std::shared_ptr<Model> model;
         glm::vec3 color{};
+        // Level of detail to draw, picked each frame by the LodSystem
+        uint32_t lod{ 0 };
+        // Rasterized into the software occlusion buffer to hide what lies behind it; best
+        // kept to a few large, simple meshes
+        bool occluder{ false };
     };
 
     struct ImageComponent {
@@ -107,5 +112,7 @@ namespace engine {
         glm::vec3 gravity{ 0.0f, GRAVITY, 0.0f };
         float mass{ 1.0f };
         float coefRes{ 0.5f };
+        // Triggers report collision events but are never pushed or pushed against
+        bool isTrigger{ false };
     };
 } //namepsace engine
@@ -1,8 +1,11 @@
 #include "Descriptors.hpp"
 
 // std
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <stdexcept>
+#include <string>
 
 namespace engine {
 
@@ -12,7 +15,8 @@ namespace engine {
         uint32_t binding,
         VkDescriptorType descriptorType,
         VkShaderStageFlags stageFlags,
-        uint32_t count) {
+        uint32_t count,
+        VkDescriptorBindingFlags flags) {
         assert(bindings.count(binding) == 0 && "Binding already in use");
         VkDescriptorSetLayoutBinding layoutBinding{};
         layoutBinding.binding = binding;
@@ -20,21 +24,33 @@ namespace engine {
         layoutBinding.descriptorCount = count;
         layoutBinding.stageFlags = stageFlags;
         bindings[binding] = layoutBinding;
+        if (flags != 0) {
+            bindingFlags[binding] = flags;
+        }
         return *this;
     }
 
     std::unique_ptr<DescriptorSetLayout> DescriptorSetLayout::Builder::build() const {
-        return std::make_unique<DescriptorSetLayout>(Device, bindings);
+        return std::make_unique<DescriptorSetLayout>(Device, bindings, bindingFlags);
+    }
+
+    std::shared_ptr<DescriptorSetLayout> DescriptorSetLayout::Builder::build(DescriptorLayoutCache& cache) const {
+        return cache.getLayout(bindings, bindingFlags);
     }
 
     // *************** Descriptor Set Layout *********************
 
     DescriptorSetLayout::DescriptorSetLayout(
-        Device& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings)
+        Device& device,
+        std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+        std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags)
         : m_device{ device }, bindings{ bindings } {
         std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings{};
+        std::vector<VkDescriptorBindingFlags> setLayoutBindingFlags{};
         for (auto kv : bindings) {
             setLayoutBindings.push_back(kv.second);
+            auto flags = bindingFlags.find(kv.first);
+            setLayoutBindingFlags.push_back(flags != bindingFlags.end() ? flags->second : 0);
         }
 
         VkDescriptorSetLayoutCreateInfo descriptorSetLayoutInfo{};
@@ -42,6 +58,15 @@ namespace engine {
         descriptorSetLayoutInfo.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
         descriptorSetLayoutInfo.pBindings = setLayoutBindings.data();
 
+        // Only chained when used, so devices without descriptor indexing never see it
+        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+        if (!bindingFlags.empty()) {
+            bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+            bindingFlagsInfo.bindingCount = static_cast<uint32_t>(setLayoutBindingFlags.size());
+            bindingFlagsInfo.pBindingFlags = setLayoutBindingFlags.data();
+            descriptorSetLayoutInfo.pNext = &bindingFlagsInfo;
+        }
+
         if (vkCreateDescriptorSetLayout(
             m_device.device(),
             &descriptorSetLayoutInfo,
@@ -103,19 +128,32 @@ namespace engine {
     }
 
     bool DescriptorPool::allocateDescriptor(
-        const VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptor) const {
+        const VkDescriptorSetLayout descriptorSetLayout,
+        VkDescriptorSet& descriptor,
+        uint32_t variableDescriptorCount) const {
+        // DescriptorAllocator chains pools for callers that cannot size this one up front
+        return tryAllocateDescriptor(descriptorSetLayout, descriptor, variableDescriptorCount) == VK_SUCCESS;
+    }
+
+    VkResult DescriptorPool::tryAllocateDescriptor(
+        const VkDescriptorSetLayout descriptorSetLayout,
+        VkDescriptorSet& descriptor,
+        uint32_t variableDescriptorCount) const {
         VkDescriptorSetAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
         allocInfo.descriptorPool = descriptorPool;
         allocInfo.pSetLayouts = &descriptorSetLayout;
         allocInfo.descriptorSetCount = 1;
 
-        // Might want to create a "DescriptorPoolManager" class that handles this case, and builds
-        // a new pool whenever an old pool fills up. But this is beyond our current scope
-        if (vkAllocateDescriptorSets(m_device.device(), &allocInfo, &descriptor) != VK_SUCCESS) {
-            return false;
+        VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountInfo{};
+        if (variableDescriptorCount > 0) {
+            variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+            variableCountInfo.descriptorSetCount = 1;
+            variableCountInfo.pDescriptorCounts = &variableDescriptorCount;
+            allocInfo.pNext = &variableCountInfo;
         }
-        return true;
+
+        return vkAllocateDescriptorSets(m_device.device(), &allocInfo, &descriptor);
     }
 
     void DescriptorPool::freeDescriptors(std::vector<VkDescriptorSet>& descriptors) const {
@@ -130,10 +168,154 @@ namespace engine {
         vkResetDescriptorPool(m_device.device(), descriptorPool, 0);
     }
 
+    // *************** Descriptor Allocator Builder *********************
+
+    DescriptorAllocator::Builder& DescriptorAllocator::Builder::addPoolRatio(
+        VkDescriptorType descriptorType, float descriptorsPerSet) {
+        poolRatios.push_back({ descriptorType, descriptorsPerSet });
+        return *this;
+    }
+
+    DescriptorAllocator::Builder& DescriptorAllocator::Builder::setPoolFlags(
+        VkDescriptorPoolCreateFlags flags) {
+        poolFlags = flags;
+        return *this;
+    }
+
+    DescriptorAllocator::Builder& DescriptorAllocator::Builder::setInitialSets(uint32_t count) {
+        initialSets = count;
+        return *this;
+    }
+
+    std::unique_ptr<DescriptorAllocator> DescriptorAllocator::Builder::build() const {
+        return std::make_unique<DescriptorAllocator>(Device, initialSets, poolFlags, poolRatios);
+    }
+
+    // *************** Descriptor Allocator *********************
+
+    DescriptorAllocator::DescriptorAllocator(
+        Device& device,
+        uint32_t initialSets,
+        VkDescriptorPoolCreateFlags poolFlags,
+        const std::vector<std::pair<VkDescriptorType, float>>& poolRatios)
+        : m_device{ device },
+        poolFlags{ poolFlags },
+        poolRatios{ poolRatios },
+        setsPerPool{ std::max(1u, std::min(initialSets, MAX_SETS_PER_POOL)) } {
+        assert(!poolRatios.empty() && "DescriptorAllocator needs at least one pool ratio");
+    }
+
+    DescriptorAllocator::~DescriptorAllocator() {}
+
+    void DescriptorAllocator::nextPool(const DescriptorSetLayout& setLayout, uint32_t variableDescriptorCount) {
+        if (currentPool) {
+            fullPools.push_back(std::move(currentPool));
+            // Each new pool is twice the size of the last, so the chain stays short
+            setsPerPool = std::min(setsPerPool * 2, MAX_SETS_PER_POOL);
+        }
+
+        std::vector<VkDescriptorPoolSize> poolSizes;
+        for (const auto& ratio : poolRatios) {
+            const uint32_t count = static_cast<uint32_t>(std::ceil(ratio.second * setsPerPool));
+            poolSizes.push_back({ ratio.first, std::max(count, 1u) });
+        }
+        // A variable count binding has to be the layout's last, and its set holds only the
+        // requested count of it
+        uint32_t lastBinding = 0;
+        for (const auto& kv : setLayout.bindings) {
+            lastBinding = std::max(lastBinding, kv.first);
+        }
+        for (const auto& kv : setLayout.bindings) {
+            const VkDescriptorSetLayoutBinding& binding = kv.second;
+            const uint32_t needed = variableDescriptorCount > 0 && kv.first == lastBinding ?
+                variableDescriptorCount : binding.descriptorCount;
+            auto size = std::find_if(poolSizes.begin(), poolSizes.end(), [&](const VkDescriptorPoolSize& poolSize) {
+                return poolSize.type == binding.descriptorType;
+            });
+            if (size == poolSizes.end()) {
+                poolSizes.push_back({ binding.descriptorType, needed });
+            } else {
+                size->descriptorCount = std::max(size->descriptorCount, needed);
+            }
+        }
+        currentPool = std::make_unique<DescriptorPool>(m_device, setsPerPool, poolFlags, poolSizes);
+    }
+
+    bool DescriptorAllocator::allocateDescriptor(
+        const DescriptorSetLayout& setLayout,
+        VkDescriptorSet& descriptor,
+        uint32_t variableDescriptorCount) {
+        if (!currentPool) {
+            nextPool(setLayout, variableDescriptorCount);
+        }
+
+        const VkDescriptorSetLayout layout = setLayout.getDescriptorSetLayout();
+        VkResult result = currentPool->tryAllocateDescriptor(layout, descriptor, variableDescriptorCount);
+        if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+            nextPool(setLayout, variableDescriptorCount);
+            result = currentPool->tryAllocateDescriptor(layout, descriptor, variableDescriptorCount);
+            if (result != VK_SUCCESS) {
+                // The pool was sized for this set, so something other than its size is wrong
+                throw std::runtime_error(
+                    "failed to allocate a descriptor set from a pool sized for it (VkResult " +
+                    std::to_string(result) + ")");
+            }
+        }
+        return result == VK_SUCCESS;
+    }
+
+    // *************** Descriptor Layout Cache *********************
+
+    size_t DescriptorLayoutCache::LayoutKeyHash::operator()(const std::vector<BindingKey>& key) const {
+        size_t hash = key.size();
+        auto combine = [&hash](size_t value) {
+            hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+        };
+        for (const BindingKey& binding : key) {
+            combine(binding.binding);
+            combine(static_cast<size_t>(binding.descriptorType));
+            combine(binding.descriptorCount);
+            combine(binding.stageFlags);
+            combine(binding.bindingFlags);
+        }
+        return hash;
+    }
+
+    std::shared_ptr<DescriptorSetLayout> DescriptorLayoutCache::getLayout(
+        const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>& bindings,
+        const std::unordered_map<uint32_t, VkDescriptorBindingFlags>& bindingFlags) {
+        std::vector<BindingKey> key;
+        key.reserve(bindings.size());
+        for (const auto& kv : bindings) {
+            auto flags = bindingFlags.find(kv.first);
+            key.push_back({
+                kv.second.binding,
+                kv.second.descriptorType,
+                kv.second.descriptorCount,
+                kv.second.stageFlags,
+                flags != bindingFlags.end() ? flags->second : 0 });
+        }
+        // unordered_map iteration order is arbitrary, the key must not be
+        std::sort(key.begin(), key.end(), [](const BindingKey& a, const BindingKey& b) {
+            return a.binding < b.binding;
+        });
+
+        auto cached = layouts.find(key);
+        if (cached != layouts.end()) {
+            return cached->second;
+        }
+        auto layout = std::make_shared<DescriptorSetLayout>(m_device, bindings, bindingFlags);
+        layouts.emplace(std::move(key), layout);
+        return layout;
+    }
+
     // *************** Descriptor Writer *********************
 
     DescriptorWriter::DescriptorWriter(DescriptorSetLayout& setLayout, DescriptorPool& pool)
-        : setLayout{ setLayout }, pool{ pool } {}
+        : setLayout{ setLayout }, pool{ &pool } {}
+
+    DescriptorWriter::DescriptorWriter(DescriptorSetLayout& setLayout, DescriptorAllocator& allocator)
+        : setLayout{ setLayout }, allocator{ &allocator } {}
 
     DescriptorWriter& DescriptorWriter::writeBuffer(
         uint32_t binding, VkDescriptorBufferInfo* bufferInfo) {
@@ -163,8 +345,8 @@ namespace engine {
         auto& bindingDescription = setLayout.bindings[binding];
 
         assert(
-            bindingDescription.descriptorCount == 1 &&
-            "Binding single descriptor info, but binding expects multiple");
+            count <= bindingDescription.descriptorCount &&
+            "Writing more image infos than the binding holds");
 
         VkWriteDescriptorSet write{};
         write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -177,8 +359,10 @@ namespace engine {
         return *this;
     }
 
-    bool DescriptorWriter::build(VkDescriptorSet& set) {
-        bool success = pool.allocateDescriptor(setLayout.getDescriptorSetLayout(), set);
+    bool DescriptorWriter::build(VkDescriptorSet& set, uint32_t variableDescriptorCount) {
+        bool success = pool != nullptr ?
+            pool->allocateDescriptor(setLayout.getDescriptorSetLayout(), set, variableDescriptorCount) :
+            allocator->allocateDescriptor(setLayout, set, variableDescriptorCount);
         assert(success && "Failed to allocate descriptorSetLayout");
         if (!success) {
             return false;
@@ -191,7 +375,7 @@ namespace engine {
         for (auto& write : writes) {
             write.dstSet = set;
         }
-        vkUpdateDescriptorSets(pool.m_device.device(), writes.size(), writes.data(), 0, nullptr);
+        vkUpdateDescriptorSets(setLayout.m_device.device(), writes.size(), writes.data(), 0, nullptr);
     }
 
 }  // namespace engine
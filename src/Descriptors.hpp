@@ -9,26 +9,37 @@
 
 namespace engine {
 
+    class DescriptorLayoutCache;
+    class DescriptorAllocator;
+
     class DescriptorSetLayout {
     public:
         class Builder {
         public:
             Builder(Device& Device) : Device{ Device } {}
 
+            // bindingFlags (descriptor indexing) such as PARTIALLY_BOUND or VARIABLE_DESCRIPTOR_COUNT;
+            // with VARIABLE_DESCRIPTOR_COUNT, count is the upper bound
             Builder& addBinding(
                 uint32_t binding,
                 VkDescriptorType descriptorType,
                 VkShaderStageFlags stageFlags,
-                uint32_t count = 1);
+                uint32_t count = 1,
+                VkDescriptorBindingFlags bindingFlags = 0);
             std::unique_ptr<DescriptorSetLayout> build() const;
+            // Returns the cache's layout for identical bindings, creating it on first use
+            std::shared_ptr<DescriptorSetLayout> build(DescriptorLayoutCache& cache) const;
 
         private:
             Device& Device;
             std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings{};
+            std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags{};
         };
 
         DescriptorSetLayout(
-            Device& device, std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings);
+            Device& device,
+            std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings,
+            std::unordered_map<uint32_t, VkDescriptorBindingFlags> bindingFlags = {});
         ~DescriptorSetLayout();
         DescriptorSetLayout(const DescriptorSetLayout&) = delete;
         DescriptorSetLayout& operator=(const DescriptorSetLayout&) = delete;
@@ -41,6 +52,7 @@ namespace engine {
         std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings;
 
         friend class DescriptorWriter;
+        friend class DescriptorAllocator;
     };
 
     class DescriptorPool {
@@ -70,8 +82,16 @@ namespace engine {
         DescriptorPool(const DescriptorPool&) = delete;
         DescriptorPool& operator=(const DescriptorPool&) = delete;
 
+        // variableDescriptorCount sizes the layout's VARIABLE_DESCRIPTOR_COUNT binding, if any
         bool allocateDescriptor(
-            const VkDescriptorSetLayout descriptorSetLayout, VkDescriptorSet& descriptor) const;
+            const VkDescriptorSetLayout descriptorSetLayout,
+            VkDescriptorSet& descriptor,
+            uint32_t variableDescriptorCount = 0) const;
+        // Same, but reports why it failed so callers can tell an exhausted pool from an error
+        VkResult tryAllocateDescriptor(
+            const VkDescriptorSetLayout descriptorSetLayout,
+            VkDescriptorSet& descriptor,
+            uint32_t variableDescriptorCount = 0) const;
 
         void freeDescriptors(std::vector<VkDescriptorSet>& descriptors) const;
 
@@ -84,19 +104,117 @@ namespace engine {
         friend class DescriptorWriter;
     };
 
+    // Hands out sets from a chain of DescriptorPools, adding a larger pool whenever the current
+    // one runs out, so callers never need to know up front how many sets they will allocate.
+    // Pool sizes are given per set and scaled by the pool's set count; every new pool also
+    // holds at least the descriptors of the set being allocated, so a set the ratios did not
+    // foresee still fits. Sets live as long as the allocator. Not thread safe.
+    class DescriptorAllocator {
+    public:
+        static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+        class Builder {
+        public:
+            Builder(Device& Device) : Device{ Device } {}
+
+            Builder& addPoolRatio(VkDescriptorType descriptorType, float descriptorsPerSet);
+            Builder& setPoolFlags(VkDescriptorPoolCreateFlags flags);
+            Builder& setInitialSets(uint32_t count);
+            std::unique_ptr<DescriptorAllocator> build() const;
+
+        private:
+            Device& Device;
+            std::vector<std::pair<VkDescriptorType, float>> poolRatios{};
+            uint32_t initialSets = 64;
+            VkDescriptorPoolCreateFlags poolFlags = 0;
+        };
+
+        DescriptorAllocator(
+            Device& device,
+            uint32_t initialSets,
+            VkDescriptorPoolCreateFlags poolFlags,
+            const std::vector<std::pair<VkDescriptorType, float>>& poolRatios);
+        ~DescriptorAllocator();
+        DescriptorAllocator(const DescriptorAllocator&) = delete;
+        DescriptorAllocator& operator=(const DescriptorAllocator&) = delete;
+
+        // Throws when the set fits neither the current pool nor a fresh one sized for it
+        bool allocateDescriptor(
+            const DescriptorSetLayout& setLayout,
+            VkDescriptorSet& descriptor,
+            uint32_t variableDescriptorCount = 0);
+
+        uint32_t getPoolCount() const {
+            return static_cast<uint32_t>(fullPools.size() + (currentPool ? 1 : 0));
+        }
+
+    private:
+        // Starts a new pool large enough for the ratios and for one set of setLayout
+        void nextPool(const DescriptorSetLayout& setLayout, uint32_t variableDescriptorCount);
+
+        Device& m_device;
+        VkDescriptorPoolCreateFlags poolFlags;
+        std::vector<std::pair<VkDescriptorType, float>> poolRatios;
+        uint32_t setsPerPool;
+
+        std::unique_ptr<DescriptorPool> currentPool;
+        std::vector<std::unique_ptr<DescriptorPool>> fullPools;
+    };
+
+    // Shares one DescriptorSetLayout between every request with the same bindings, so systems
+    // can ask for the layouts they need without creating duplicates. Not thread safe.
+    class DescriptorLayoutCache {
+    public:
+        DescriptorLayoutCache(Device& device) : m_device{ device } {}
+
+        DescriptorLayoutCache(const DescriptorLayoutCache&) = delete;
+        DescriptorLayoutCache& operator=(const DescriptorLayoutCache&) = delete;
+
+        std::shared_ptr<DescriptorSetLayout> getLayout(
+            const std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding>& bindings,
+            const std::unordered_map<uint32_t, VkDescriptorBindingFlags>& bindingFlags);
+
+        size_t size() const { return layouts.size(); }
+
+    private:
+        struct BindingKey {
+            uint32_t binding;
+            VkDescriptorType descriptorType;
+            uint32_t descriptorCount;
+            VkShaderStageFlags stageFlags;
+            VkDescriptorBindingFlags bindingFlags;
+
+            bool operator==(const BindingKey& other) const {
+                return binding == other.binding && descriptorType == other.descriptorType &&
+                    descriptorCount == other.descriptorCount && stageFlags == other.stageFlags &&
+                    bindingFlags == other.bindingFlags;
+            }
+        };
+
+        struct LayoutKeyHash {
+            size_t operator()(const std::vector<BindingKey>& key) const;
+        };
+
+        Device& m_device;
+        std::unordered_map<std::vector<BindingKey>, std::shared_ptr<DescriptorSetLayout>, LayoutKeyHash> layouts;
+    };
+
     class DescriptorWriter {
     public:
         DescriptorWriter(DescriptorSetLayout& setLayout, DescriptorPool& pool);
+        DescriptorWriter(DescriptorSetLayout& setLayout, DescriptorAllocator& allocator);
 
         DescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
         DescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo, uint32_t count = 1);
 
-        bool build(VkDescriptorSet& set);
+        bool build(VkDescriptorSet& set, uint32_t variableDescriptorCount = 0);
         void overwrite(VkDescriptorSet& set);
 
     private:
         DescriptorSetLayout& setLayout;
-        DescriptorPool& pool;
+        // Exactly one of these is set
+        DescriptorPool* pool = nullptr;
+        DescriptorAllocator* allocator = nullptr;
         std::vector<VkWriteDescriptorSet> writes;
     };
 
@@ -1,11 +1,22 @@
 #include "Device.hpp"
 
 // std headers
+#include <algorithm>
+#include <cassert>
+#include <chrono>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
 #include <iostream>
 #include <set>
 #include <unordered_set>
 
+#ifndef ENGINE_DIR
+#define ENGINE_DIR "../"
+#endif // !ENGINE_DIR
+
 namespace engine {
 
     // local callback functions
@@ -48,16 +59,28 @@ namespace engine {
     }
 
     // class member functions
-    Device::Device(Window& window) : window{ window } {
+    Device::Device(Window& window) : window{ &window }, deviceExtensions{ VK_KHR_SWAPCHAIN_EXTENSION_NAME } {
         createInstance();
         setupDebugMessenger();
         createSurface();
         pickPhysicalDevice();
         createLogicalDevice();
         createCommandPool();
+        createPipelineCache();
+    }
+
+    Device::Device() {
+        createInstance();
+        setupDebugMessenger();
+        pickPhysicalDevice();
+        createLogicalDevice();
+        createCommandPool();
+        createPipelineCache();
     }
 
     Device::~Device() {
+        savePipelineCache();
+        vkDestroyPipelineCache(device_, pipelineCache, nullptr);
         vkDestroyCommandPool(device_, commandPool, nullptr);
         vkDestroyDevice(device_, nullptr);
 
@@ -65,7 +88,9 @@ namespace engine {
             DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
         }
 
-        vkDestroySurfaceKHR(instance, surface_, nullptr);
+        if (surface_ != VK_NULL_HANDLE) {
+            vkDestroySurfaceKHR(instance, surface_, nullptr);
+        }
         vkDestroyInstance(instance, nullptr);
     }
 
@@ -80,7 +105,15 @@ namespace engine {
         appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         appInfo.pEngineName = "No Engine";
         appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        appInfo.apiVersion = VK_API_VERSION_1_0;
+        // Ask for 1.2 when the loader knows about it; a 1.0 loader rejects any newer version
+        auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+            vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+        uint32_t loaderVersion = VK_API_VERSION_1_0;
+        if (enumerateInstanceVersion != nullptr) {
+            enumerateInstanceVersion(&loaderVersion);
+        }
+        instanceApiVersion = loaderVersion >= VK_API_VERSION_1_2 ? VK_API_VERSION_1_2 : loaderVersion;
+        appInfo.apiVersion = instanceApiVersion;
 
         VkInstanceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -132,9 +165,47 @@ namespace engine {
         }
 
         vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+        queryDescriptorIndexingSupport();
         std::cout << "physical device: " << properties.deviceName << std::endl;
     }
 
+    void Device::queryDescriptorIndexingSupport() {
+        // vkGetPhysicalDeviceFeatures2 is core from 1.1
+        if (instanceApiVersion < VK_API_VERSION_1_1) {
+            return;
+        }
+        bool supported = std::min(instanceApiVersion, properties.apiVersion) >= VK_API_VERSION_1_2;
+        if (!supported) {
+            uint32_t extensionCount;
+            vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+            std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+            vkEnumerateDeviceExtensionProperties(
+                physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+            for (const auto& extension : availableExtensions) {
+                if (strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0) {
+                    supported = true;
+                }
+            }
+        }
+        if (!supported) {
+            return;
+        }
+
+        VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+        indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &indexingFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+        bindlessTextures =
+            indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+            indexingFeatures.runtimeDescriptorArray &&
+            indexingFeatures.descriptorBindingPartiallyBound &&
+            indexingFeatures.descriptorBindingVariableDescriptorCount;
+    }
+
     void Device::createLogicalDevice() {
         QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
@@ -153,6 +224,11 @@ namespace engine {
 
         VkPhysicalDeviceFeatures deviceFeatures = {};
         deviceFeatures.samplerAnisotropy = VK_TRUE;
+        // Optional: GPU-driven draws need a non-zero firstInstance in indirect commands
+        deviceFeatures.drawIndirectFirstInstance = features.drawIndirectFirstInstance;
+        deviceFeatures.multiDrawIndirect = features.multiDrawIndirect;
+        // Optional: keeps deferred light volumes from being clipped by the far plane
+        deviceFeatures.depthClamp = features.depthClamp;
 
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -161,8 +237,26 @@ namespace engine {
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
         createInfo.pEnabledFeatures = &deviceFeatures;
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+
+        std::vector<const char*> enabledExtensions = deviceExtensions;
+        VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+        if (bindlessTextures) {
+            indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+            indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+            indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+            indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+            createInfo.pNext = &indexingFeatures;
+            if (std::min(instanceApiVersion, properties.apiVersion) < VK_API_VERSION_1_2) {
+                // The extension depends on maintenance3, which is core from 1.1
+                if (properties.apiVersion < VK_API_VERSION_1_1) {
+                    enabledExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+                }
+                enabledExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+            }
+        }
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
         // might not really be necessary anymore because device specific validation layers
         // have been deprecated
@@ -196,16 +290,113 @@ namespace engine {
         }
     }
 
-    void Device::createSurface() { window.createWindowSurface(instance, &surface_); }
-    void Device::recreateSurface() { window.recreateWindowSurface(instance, &surface_); }
+    std::string Device::getPipelineCachePath() const {
+        // The driver rejects caches from other devices or drivers anyway; keying the file name
+        // on them lets several GPUs and driver updates each keep their own warm cache. Kept
+        // beside the compiled shaders and found through ENGINE_DIR, as they are.
+        std::ostringstream path;
+        path << ENGINE_DIR << "shaders/pipeline_cache_" << std::hex << std::setfill('0')
+            << std::setw(4) << properties.vendorID << '_'
+            << std::setw(4) << properties.deviceID << '_'
+            << std::setw(8) << properties.driverVersion << '_';
+        for (uint8_t byte : properties.pipelineCacheUUID) {
+            path << std::setw(2) << static_cast<uint32_t>(byte);
+        }
+        path << ".bin";
+        return path.str();
+    }
+
+    bool Device::isPipelineCacheCompatible(const std::vector<char>& data) const {
+        VkPipelineCacheHeaderVersionOne header{};
+        if (data.size() < sizeof(header)) {
+            return false;
+        }
+        memcpy(&header, data.data(), sizeof(header));
+        return header.headerSize >= sizeof(header) &&
+            header.headerSize <= data.size() &&
+            header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+            header.vendorID == properties.vendorID &&
+            header.deviceID == properties.deviceID &&
+            memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    void Device::createPipelineCache() {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<char> data;
+        std::ifstream file{ getPipelineCachePath(), std::ios::binary | std::ios::ate };
+        if (file.is_open()) {
+            data.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(data.data(), data.size());
+            if (!file || !isPipelineCacheCompatible(data)) {
+                std::cout << "ignoring stale or corrupt pipeline cache " << getPipelineCachePath() << std::endl;
+                data.clear();
+            }
+        }
+
+        VkPipelineCacheCreateInfo cacheInfo{};
+        cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheInfo.initialDataSize = data.size();
+        cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+        if (vkCreatePipelineCache(device_, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+        pipelineCacheWarm = !data.empty();
+
+        float loadMs = std::chrono::duration<float, std::chrono::milliseconds::period>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << "pipeline cache: " << (pipelineCacheWarm ? "warm, " : "cold, ")
+            << data.size() << " bytes loaded in " << loadMs << " ms" << std::endl;
+    }
+
+    void Device::savePipelineCache() {
+        size_t size = 0;
+        if (vkGetPipelineCacheData(device_, pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0) {
+            return;
+        }
+        std::vector<char> data(size);
+        if (vkGetPipelineCacheData(device_, pipelineCache, &size, data.data()) != VK_SUCCESS) {
+            return;
+        }
+        data.resize(size);
+
+        // Written next to the real file and renamed over it, so a crash mid-write never
+        // leaves a truncated cache behind
+        const std::string path = getPipelineCachePath();
+        const std::string tempPath = path + ".tmp";
+        std::error_code error;
+        {
+            std::ofstream file{ tempPath, std::ios::binary | std::ios::trunc };
+            file.write(data.data(), data.size());
+            // Buffered data only reaches the disk on close, so a full disk may only fail here
+            file.close();
+            if (!file) {
+                std::cerr << "failed to write pipeline cache " << tempPath << std::endl;
+                std::filesystem::remove(tempPath, error);
+                return;
+            }
+        }
+        std::filesystem::rename(tempPath, path, error);
+        if (error) {
+            std::cerr << "failed to replace pipeline cache " << path << ": " << error.message() << std::endl;
+            std::filesystem::remove(tempPath, error);
+        }
+    }
+
+    void Device::createSurface() { window->createWindowSurface(instance, &surface_); }
+    void Device::recreateSurface() {
+        assert(window != nullptr && "A headless device has no surface to recreate");
+        window->recreateWindowSurface(instance, &surface_);
+    }
 
     bool Device::isDeviceSuitable(VkPhysicalDevice device) {
         QueueFamilyIndices indices = findQueueFamilies(device);
 
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-        bool swapChainAdequate = false;
-        if (extensionsSupported) {
+        // Nothing is presented without a window
+        bool swapChainAdequate = window == nullptr;
+        if (extensionsSupported && !swapChainAdequate) {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
         }
@@ -265,13 +456,16 @@ namespace engine {
     }
 
     std::vector<const char*> Device::getRequiredExtensions() {
-        unsigned extension_count;
-        if (!SDL_Vulkan_GetInstanceExtensions(window.window, &extension_count, NULL)) {
-            throw std::runtime_error("Could not get the number of required instance extensions from SDL.");
-        }
-        std::vector<const char*> extensions(extension_count);
-        if (!SDL_Vulkan_GetInstanceExtensions(window.window, &extension_count, extensions.data())) {
-            throw std::runtime_error("Could not get the names of required instance extensions from SDL.");
+        std::vector<const char*> extensions;
+        if (window != nullptr) {
+            unsigned extension_count;
+            if (!SDL_Vulkan_GetInstanceExtensions(window->window, &extension_count, NULL)) {
+                throw std::runtime_error("Could not get the number of required instance extensions from SDL.");
+            }
+            extensions.resize(extension_count);
+            if (!SDL_Vulkan_GetInstanceExtensions(window->window, &extension_count, extensions.data())) {
+                throw std::runtime_error("Could not get the names of required instance extensions from SDL.");
+            }
         }
         if (enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -336,10 +530,14 @@ namespace engine {
         for (const auto& queueFamily : queueFamilies) {
             if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
                 indices.graphicsFamily = i;
+                indices.graphicsTimestampValidBits = queueFamily.timestampValidBits;
                 indices.graphicsFamilyHasValue = true;
             }
-            VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+            // Headless, the graphics queue stands in for the present queue
+            VkBool32 presentSupport = surface_ == VK_NULL_HANDLE && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+            if (surface_ != VK_NULL_HANDLE) {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+            }
             if (queueFamily.queueCount > 0 && presentSupport) {
                 indices.presentFamily = i;
                 indices.presentFamilyHasValue = true;
@@ -383,23 +581,35 @@ namespace engine {
     VkFormat Device::findSupportedFormat(
         const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
         for (VkFormat format : candidates) {
-            VkFormatProperties props;
-            vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
-
-            if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
-                return format;
-            }
-            else if (
-                tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
+            if (isFormatSupported(format, tiling, features)) {
                 return format;
             }
         }
         throw std::runtime_error("failed to find supported format!");
     }
 
-    uint32_t Device::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    bool Device::isFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+        if (tiling == VK_IMAGE_TILING_LINEAR) {
+            return (props.linearTilingFeatures & features) == features;
+        }
+        return tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features;
+    }
+
+    uint32_t Device::findMemoryType(
+        uint32_t typeFilter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferredProperties) {
         VkPhysicalDeviceMemoryProperties memProperties;
         vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+        if (preferredProperties != 0) {
+            const VkMemoryPropertyFlags wanted = properties | preferredProperties;
+            for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+                if ((typeFilter & (1 << i)) &&
+                    (memProperties.memoryTypes[i].propertyFlags & wanted) == wanted) {
+                    return i;
+                }
+            }
+        }
         for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
             if ((typeFilter & (1 << i)) &&
                 (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
@@ -473,12 +683,12 @@ namespace engine {
         vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
     }
 
-    void Device::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+    void Device::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset) {
         VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
         VkBufferCopy copyRegion{};
         copyRegion.srcOffset = 0;  // Optional
-        copyRegion.dstOffset = 0;  // Optional
+        copyRegion.dstOffset = dstOffset;  // Optional
         copyRegion.size = size;
         vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
@@ -516,7 +726,8 @@ namespace engine {
         const VkImageCreateInfo& imageInfo,
         VkMemoryPropertyFlags properties,
         VkImage& image,
-        VkDeviceMemory& imageMemory) {
+        VkDeviceMemory& imageMemory,
+        VkMemoryPropertyFlags preferredProperties) {
         if (vkCreateImage(device_, &imageInfo, nullptr, &image) != VK_SUCCESS) {
             throw std::runtime_error("failed to create image!");
         }
@@ -527,7 +738,7 @@ namespace engine {
         VkMemoryAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
         allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties, preferredProperties);
 
         if (vkAllocateMemory(device_, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
             throw std::runtime_error("failed to allocate image memory!");
@@ -17,6 +17,8 @@ namespace engine {
     struct QueueFamilyIndices {
         uint32_t graphicsFamily;
         uint32_t presentFamily;
+        // Bits of a timestamp written on the graphics queue; 0 when it has no timestamps
+        uint32_t graphicsTimestampValidBits = 0;
         bool graphicsFamilyHasValue = false;
         bool presentFamilyHasValue = false;
         bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
@@ -31,6 +33,9 @@ namespace engine {
 #endif
 
         Device(Window& window);
+        // Headless: no surface and no swap chain, for compute and offscreen work in tools
+        // that run without a window. surface() is null and present work goes nowhere.
+        Device();
         ~Device();
 
         // Not copyable or movable
@@ -40,16 +45,25 @@ namespace engine {
         Device &operator=(Device&&) = delete;
 
         VkCommandPool getCommandPool() { return commandPool; }
+        // Shared by every pipeline; persisted between runs, see createPipelineCache
+        VkPipelineCache getPipelineCache() { return pipelineCache; }
+        // True when the cache was seeded from a compatible file written by an earlier run
+        bool isPipelineCacheWarm() const { return pipelineCacheWarm; }
+        // Writes the cache to disk; also done on destruction
+        void savePipelineCache();
         VkDevice device() { return device_; }
         VkSurfaceKHR surface() { return surface_; }
         VkQueue graphicsQueue() { return graphicsQueue_; }
         VkQueue presentQueue() { return presentQueue_; }
 
         SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
-        uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+        // Prefers a type that also has preferredProperties, falling back to one with just properties
+        uint32_t findMemoryType(
+            uint32_t typeFilter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferredProperties = 0);
         QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
         VkFormat findSupportedFormat(
             const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+        bool isFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features);
 
         // Buffer Helper Functions
         void createBuffer(
@@ -60,7 +74,7 @@ namespace engine {
             VkDeviceMemory& bufferMemory);
         VkCommandBuffer beginSingleTimeCommands();
         void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset = 0);
         void copyBufferToImage(
             VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
 
@@ -68,10 +82,15 @@ namespace engine {
             const VkImageCreateInfo& imageInfo,
             VkMemoryPropertyFlags properties,
             VkImage& image,
-            VkDeviceMemory& imageMemory);
+            VkDeviceMemory& imageMemory,
+            VkMemoryPropertyFlags preferredProperties = 0);
         void recreateSurface();
 
         VkPhysicalDeviceProperties properties;
+        VkPhysicalDeviceFeatures features;
+        // Descriptor indexing (Vulkan 1.2 or VK_EXT_descriptor_indexing) with everything a
+        // partially bound, variable sized sampler array needs; enabled when true
+        bool bindlessTextures = false;
 
     private:
         void createInstance();
@@ -80,6 +99,10 @@ namespace engine {
         void pickPhysicalDevice();
         void createLogicalDevice();
         void createCommandPool();
+        void queryDescriptorIndexingSupport();
+        void createPipelineCache();
+        std::string getPipelineCachePath() const;
+        bool isPipelineCacheCompatible(const std::vector<char>& data) const;
 
         // helper functions
         bool isDeviceSuitable(VkPhysicalDevice device);
@@ -92,18 +115,23 @@ namespace engine {
         SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
         VkInstance instance;
+        uint32_t instanceApiVersion = VK_API_VERSION_1_0;
         VkDebugUtilsMessengerEXT debugMessenger;
         VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-        Window& window;
+        // Null when headless
+        Window* window = nullptr;
         VkCommandPool commandPool;
+        VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+        bool pipelineCacheWarm = false;
 
         VkDevice device_;
-        VkSurfaceKHR surface_;
+        VkSurfaceKHR surface_ = VK_NULL_HANDLE;
         VkQueue graphicsQueue_;
         VkQueue presentQueue_;
 
         const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
-        const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+        // The swap chain extension, unless headless
+        std::vector<const char*> deviceExtensions;
     };
 
 }  // namespace engine
\ No newline at end of file
@@ -3,13 +3,17 @@
 #include <cassert>
 
 namespace engine {
-    EntityManager::EntityManager(size_t t_maxEntities, Device& device) : maxEntities{t_maxEntities} {
+    EntityManager::EntityManager(size_t t_maxEntities, Device& device) : EntityManager(t_maxEntities) {
+        noTexture = std::make_shared<Image>(device, "textures/noTexture.png", 0);
+        noTextureComp.textureInfo.push_back(noTexture->textureInfo());
+    }
+
+    EntityManager::EntityManager(size_t t_maxEntities) : maxEntities{t_maxEntities} {
         entities.reserve(maxEntities);
         entityComponentMasks.resize(maxEntities);
+        transformVersions.resize(maxEntities, 0);
         componentPools.resize(static_cast<size_t>(ComponentType::Count));
-        noTexture = std::make_shared<Image>(device, "textures/noTexture.png", 0);
         noTextureComp.imagesIndex.push_back(0);
-        noTextureComp.textureInfo.push_back(noTexture->textureInfo());
     }
 
     EntityManager::~EntityManager() {
@@ -34,6 +38,7 @@ namespace engine {
         if (entityExists(entityID)) {
             entities.erase(std::remove(entities.begin(), entities.end(), entityID), entities.end());
             entityComponentMasks[entityID].reset();
+            transformVersions[entityID]++;
             entityCount--;
         }
     }
@@ -67,6 +72,7 @@ namespace engine {
             componentPools[static_cast<size_t>(type)].resize(entityID + 1);
         }
         componentPools[static_cast<size_t>(type)][entityID] = nullptr;
+        transformVersions[entityID]++;
     }
 
     void EntityManager::addComponents(uint32_t entityID, const std::vector<ComponentType>& componentTypes) {
@@ -78,6 +84,7 @@ namespace engine {
             }
             componentPools[static_cast<size_t>(type)][entityID] = nullptr;
         }
+        transformVersions[entityID]++;
     }
 
     void EntityManager::removeComponent(uint32_t entityID, ComponentType type) {
@@ -89,6 +96,7 @@ namespace engine {
                 // Clear the component data for the specified entity
                 componentPools[static_cast<size_t>(type)][entityID].reset();
             }
+            transformVersions[entityID]++;
         }
     }
 
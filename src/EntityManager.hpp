@@ -11,6 +11,8 @@ namespace engine {
     class EntityManager {
     public:
         EntityManager(size_t t_maxEntities, Device& device);
+        // Headless manager: no default texture is loaded, so it never touches a Device
+        explicit EntityManager(size_t t_maxEntities);
         ~EntityManager();
 
         uint32_t createEntity();
@@ -35,6 +37,9 @@ namespace engine {
                     componentPools[static_cast<size_t>(type)][entityID] = std::make_unique<T>(componentData);
                 }
             }
+            if constexpr (std::is_same<T, TransformComponent>::value) {
+                transformVersions[entityID]++;
+            }
         }
 
         template <typename T>
@@ -59,6 +64,10 @@ namespace engine {
         }
 
         std::vector<uint32_t> getEntitiesWithComponent(ComponentType type);
+        // Changes whenever the entity's transform is set or its components are added or removed,
+        // so systems caching per-entity results know which ones may be stale. Setting an
+        // unchanged transform still counts as a change.
+        uint32_t getTransformVersion(uint32_t entityID) const { return transformVersions[entityID]; }
         std::shared_ptr<Image> noTexture;
     private:
         uint32_t findAvailableEntityID();
@@ -82,6 +91,7 @@ namespace engine {
         size_t entityCount = 0;
         std::vector<uint32_t> entities;
         std::vector<std::bitset<64>> entityComponentMasks;
+        std::vector<uint32_t> transformVersions;
 
     	ImageComponent noTextureComp;
 
@@ -2,14 +2,16 @@
 
 #include "Camera.hpp"
 #include "EntityManager.hpp"
+#include "GpuTimer.hpp"
 
 #include <vulkan/vulkan.h>
 
 namespace engine {
-	#define MAX_LIGHTS 10
-
+	// Matches PointLight in clustered_lighting.glsl (std430)
 	struct PointLight {
+		// w is the range, filled in by LightClusterSystem
 		glm::vec4 position{};
+		// w is the intensity
 		glm::vec4 color{};
 	};
 
@@ -18,14 +20,12 @@ namespace engine {
         glm::mat4 view{ 1.f };
 		glm::mat4 inverseView{ 1.f };
         glm::vec4 ambientLightColor{ 1.f, 1.f, 1.f ,.02f };
-        PointLight pointLights[MAX_LIGHTS];
-		int numLights;
+		// Cluster grid of the light lists, see LightClusterSystem
+		glm::uvec4 clusterCounts{ 0 };  // clusters along x, y and z; w is the light count
+		glm::vec4 clusterDepth{ 0.f };  // near, far, depth slice scale and bias
+		glm::vec4 clusterTileSize{ 1.f };  // pixels covered by one cluster in x and y
     };
 
-	struct TextureData {
-		int texIndex;
-	};
-
 	struct FrameInfo {
 		int frameIndex;
 		float frameTime;
@@ -33,6 +33,7 @@ namespace engine {
 		Camera& camera;
 		VkDescriptorSet globalDescriptorSet;
 		EntityManager& entityManager;
-		std::vector<std::shared_ptr<Buffer>> textureBuffers;
+		// Systems time their passes with it when set
+		GpuTimer* gpuTimer = nullptr;
 	};
 } //namespace engine
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace engine {
+
+    // Buffers and push constants of instance_cull.comp, shared by SimpleRenderSystem and the
+    // headless check that runs the shader on its own
+
+    // local_size_x of instance_cull.comp
+    static constexpr uint32_t CULL_WORKGROUP_SIZE = 64;
+
+    // Matches InstanceData in simple_shader.vert and instance_cull.comp (std430)
+    struct InstanceData {
+        glm::mat4 modelMatrix{ 1.f };
+        glm::mat4 normalMatrix{ 1.f };
+        uint32_t textureIndex{ 0 };
+        uint32_t padding[3]{};
+    };
+
+    // Matches CullData in instance_cull.comp (std430)
+    struct CullData {
+        glm::vec4 sphere{};
+        uint32_t drawIndex;
+        uint32_t firstMeshlet;
+        uint32_t meshletCount;
+        uint32_t flags;
+    };
+
+    // CullData flags
+    static constexpr uint32_t CULL_CONE = 1;
+
+    // Matches MeshletBounds in instance_cull.comp (std430)
+    struct MeshletBounds {
+        glm::vec4 sphere;
+        glm::vec4 cone;
+    };
+
+    struct CullPushConstantData {
+        glm::vec4 planes[6];
+        glm::vec4 cameraPosition;
+        uint32_t instanceCount;
+        uint32_t phase;
+        uint32_t drawCount;
+        uint32_t occlusion;
+    };
+} // namespace engine
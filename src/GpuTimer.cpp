@@ -0,0 +1,80 @@
+#include "GpuTimer.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+namespace engine {
+
+    GpuTimer::GpuTimer(Device& device) : m_device{ device } {
+        const uint32_t validBits = m_device.findPhysicalQueueFamilies().graphicsTimestampValidBits;
+        if (validBits == 0) {
+            std::cout << "graphics queue has no timestamps, GPU timings disabled" << std::endl;
+            return;
+        }
+        m_validMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+        // timestampPeriod is in nanoseconds per tick
+        m_periodMs = m_device.properties.limits.timestampPeriod * 1e-6f;
+
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = SwapChain::MAX_FRAMES_IN_FLIGHT * SCOPE_COUNT * 2;
+        if (vkCreateQueryPool(m_device.device(), &poolInfo, nullptr, &m_queryPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create timestamp query pool");
+        }
+    }
+
+    GpuTimer::~GpuTimer() {
+        if (m_queryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(m_device.device(), m_queryPool, nullptr);
+        }
+    }
+
+    void GpuTimer::beginFrame(int frameIndex, VkCommandBuffer commandBuffer) {
+        if (!isSupported()) {
+            return;
+        }
+        m_frameIndex = frameIndex;
+
+        const uint32_t written = m_writtenScopes[frameIndex].exchange(0);
+        for (uint32_t scope = 0; scope < SCOPE_COUNT; scope++) {
+            m_results[scope] = 0.f;
+            if ((written & (1u << scope)) == 0) {
+                continue;
+            }
+            // The frame's fence has been waited on, so anything but VK_SUCCESS means no result
+            uint64_t timestamps[2];
+            if (vkGetQueryPoolResults(
+                m_device.device(),
+                m_queryPool,
+                getQuery(frameIndex, static_cast<GpuScope>(scope)),
+                2,
+                sizeof(timestamps),
+                timestamps,
+                sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+                const uint64_t ticks = ((timestamps[1] & m_validMask) - (timestamps[0] & m_validMask)) & m_validMask;
+                m_results[scope] = static_cast<float>(ticks) * m_periodMs;
+            }
+        }
+
+        vkCmdResetQueryPool(commandBuffer, m_queryPool, frameIndex * SCOPE_COUNT * 2, SCOPE_COUNT * 2);
+    }
+
+    void GpuTimer::begin(VkCommandBuffer commandBuffer, GpuScope scope) {
+        if (!isSupported()) {
+            return;
+        }
+        vkCmdWriteTimestamp(
+            commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, getQuery(m_frameIndex, scope));
+    }
+
+    void GpuTimer::end(VkCommandBuffer commandBuffer, GpuScope scope) {
+        if (!isSupported()) {
+            return;
+        }
+        vkCmdWriteTimestamp(
+            commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, getQuery(m_frameIndex, scope) + 1);
+        m_writtenScopes[m_frameIndex].fetch_or(1u << static_cast<uint32_t>(scope));
+    }
+} // namespace engine
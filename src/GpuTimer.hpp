@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Device.hpp"
+#include "SwapChain.hpp"
+
+#include <array>
+#include <atomic>
+
+namespace engine {
+
+    // Spans of a frame measured on the GPU
+    enum class GpuScope : uint32_t {
+        DepthPrePass,
+        // Opaque geometry after the pre-pass, or all of it without one
+        Opaque,
+        // Occlusion culling: reducing the early pass's depth into the Hi-Z pyramid
+        HiZBuild,
+        // Occlusion culling: geometry only the second culling phase found, pre-pass included
+        Disoccluded,
+        Count
+    };
+
+    // Measures GPU time between pairs of timestamps. Every frame in flight owns its own range of
+    // queries, read back once that frame's fence has been waited on, so results trail the
+    // current frame by MAX_FRAMES_IN_FLIGHT frames and reading them never stalls.
+    class GpuTimer {
+    public:
+        static constexpr uint32_t SCOPE_COUNT = static_cast<uint32_t>(GpuScope::Count);
+
+        explicit GpuTimer(Device& device);
+        ~GpuTimer();
+
+        GpuTimer(const GpuTimer&) = delete;
+        GpuTimer& operator=(const GpuTimer&) = delete;
+
+        // False when the graphics queue has no timestamps; every call is then a no-op
+        bool isSupported() const { return m_queryPool != VK_NULL_HANDLE; }
+
+        // Collects what this frame index measured last time round and resets its queries. Must
+        // be recorded outside a render pass, before any begin or end of the frame.
+        void beginFrame(int frameIndex, VkCommandBuffer commandBuffer);
+        // Either may go into the primary buffer or into a secondary buffer executed this frame,
+        // from any thread
+        void begin(VkCommandBuffer commandBuffer, GpuScope scope);
+        void end(VkCommandBuffer commandBuffer, GpuScope scope);
+
+        // Milliseconds of the latest completed measurement, 0 if the scope was not recorded
+        float getMs(GpuScope scope) const { return m_results[static_cast<uint32_t>(scope)]; }
+
+    private:
+        uint32_t getQuery(int frameIndex, GpuScope scope) const {
+            return (frameIndex * SCOPE_COUNT + static_cast<uint32_t>(scope)) * 2;
+        }
+
+        Device& m_device;
+        VkQueryPool m_queryPool = VK_NULL_HANDLE;
+        float m_periodMs = 0.f;
+        uint64_t m_validMask = 0;
+
+        int m_frameIndex = 0;
+        // Bit per scope whose end was written, so queries left unwritten are never read back
+        std::array<std::atomic<uint32_t>, SwapChain::MAX_FRAMES_IN_FLIGHT> m_writtenScopes{};
+        std::array<float, SCOPE_COUNT> m_results{};
+    };
+} // namespace engine
@@ -0,0 +1,214 @@
+#include "HiZPyramid.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace engine {
+
+    // std430 places depths[] right after the last level entry
+    static_assert(sizeof(HiZPyramid::Header) == 336, "Header must match HiZBuffer in the shaders");
+
+    struct HiZBuildPushConstantData {
+        glm::uvec2 sourceSize;
+        glm::uvec2 destinationSize;
+        // Offsets into depths[]; the source is the depth image when fromDepth is set
+        uint32_t sourceOffset;
+        uint32_t destinationOffset;
+        uint32_t fromDepth;
+    };
+
+    static void memoryBarrier(
+        VkCommandBuffer commandBuffer,
+        VkPipelineStageFlags srcStage,
+        VkAccessFlags srcAccess,
+        VkPipelineStageFlags dstStage,
+        VkAccessFlags dstAccess) {
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    HiZPyramid::HiZPyramid(Device& device, PipelineBuildQueue& pipelineQueue, VkExtent2D extent)
+        : m_device{ device } {
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.maxLod = 0.f;
+        if (vkCreateSampler(m_device.device(), &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create Hi-Z depth sampler!");
+        }
+        createDescriptorSets();
+        createPipeline(pipelineQueue);
+        resize(extent);
+    }
+
+    HiZPyramid::~HiZPyramid() {
+        vkDestroyPipelineLayout(m_device.device(), m_pipelineLayout, nullptr);
+        vkDestroySampler(m_device.device(), m_sampler, nullptr);
+    }
+
+    void HiZPyramid::createDescriptorSets() {
+        m_setLayout = DescriptorSetLayout::Builder(m_device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
+        m_pool = DescriptorPool::Builder(m_device)
+            .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .build();
+        // Written once the first build knows its depth image
+        for (auto& set : m_sets) {
+            if (!DescriptorWriter(*m_setLayout, *m_pool).build(set)) {
+                throw std::runtime_error("failed to allocate Hi-Z descriptor set");
+            }
+        }
+    }
+
+    void HiZPyramid::createPipeline(PipelineBuildQueue& pipelineQueue) {
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(HiZBuildPushConstantData);
+
+        VkDescriptorSetLayout setLayout = m_setLayout->getDescriptorSetLayout();
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(m_device.device(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("error while creating Hi-Z pipelineLayout");
+        }
+
+        m_pendingPipeline = pipelineQueue.submitCompute("shaders/hiz_build.comp.spv", m_pipelineLayout);
+    }
+
+    void HiZPyramid::resize(VkExtent2D extent) {
+        if (extent.width == m_extent.width && extent.height == m_extent.height) {
+            return;
+        }
+        if (m_buffer) {
+            vkDeviceWaitIdle(m_device.device());
+        }
+        m_extent = extent;
+
+        m_header.depthSize = { extent.width, extent.height };
+        uint32_t texelCount = 0;
+        glm::uvec2 size = m_header.depthSize;
+        uint32_t level = 0;
+        do {
+            assert(level < MAX_LEVELS && "Depth buffer too large for the Hi-Z pyramid");
+            size = (size + 1u) / 2u;
+            m_header.levels[level] = { texelCount, size.x, size.y, 0 };
+            texelCount += size.x * size.y;
+            level++;
+        } while (size.x > 1 || size.y > 1);
+        m_header.levelCount = level;
+
+        m_buffer = std::make_unique<Buffer>(
+            m_device,
+            sizeof(float),
+            static_cast<uint32_t>(sizeof(Header) / sizeof(float)) + texelCount,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        m_depthViews.fill(VK_NULL_HANDLE);
+        m_generation++;
+        m_built = false;
+    }
+
+    void HiZPyramid::writeDepthSet(int frameIndex, VkImageView depthView) {
+        if (m_depthViews[frameIndex] == depthView) {
+            return;
+        }
+        // This frame's fence has been waited on, so the set is no longer in use
+        VkDescriptorImageInfo depthInfo{ m_sampler, depthView, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+        auto bufferInfo = m_buffer->descriptorInfo();
+        DescriptorWriter(*m_setLayout, *m_pool)
+            .writeImage(0, &depthInfo)
+            .writeBuffer(1, &bufferInfo)
+            .overwrite(m_sets[frameIndex]);
+        m_depthViews[frameIndex] = depthView;
+    }
+
+    void HiZPyramid::build(FrameInfo& frameInfo, VkImageView depthView, const glm::mat4& viewProjection) {
+        if (m_pendingPipeline.valid()) {
+            // get() rethrows anything the build threw on its worker
+            m_pipeline = m_pendingPipeline.get();
+        }
+        writeDepthSet(frameInfo.frameIndex, depthView);
+        VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+        if (frameInfo.gpuTimer != nullptr) {
+            frameInfo.gpuTimer->begin(commandBuffer, GpuScope::HiZBuild);
+        }
+
+        // Culling, this frame's and the previous one's, must be done reading the last pyramid
+        memoryBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+        m_header.viewProjection = viewProjection;
+        vkCmdUpdateBuffer(commandBuffer, m_buffer->getBuffer(), 0, sizeof(Header), &m_header);
+
+        m_pipeline->bind(commandBuffer);
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_pipelineLayout,
+            0,
+            1,
+            &m_sets[frameInfo.frameIndex],
+            0,
+            nullptr
+        );
+        glm::uvec2 sourceSize = m_header.depthSize;
+        for (uint32_t level = 0; level < m_header.levelCount; level++) {
+            const glm::uvec4& entry = m_header.levels[level];
+            HiZBuildPushConstantData push{};
+            push.sourceSize = sourceSize;
+            push.destinationSize = { entry.y, entry.z };
+            push.sourceOffset = level > 0 ? m_header.levels[level - 1].x : 0;
+            push.destinationOffset = entry.x;
+            push.fromDepth = level == 0 ? 1 : 0;
+            vkCmdPushConstants(
+                commandBuffer,
+                m_pipelineLayout,
+                VK_SHADER_STAGE_COMPUTE_BIT,
+                0,
+                sizeof(HiZBuildPushConstantData),
+                &push
+            );
+            vkCmdDispatch(
+                commandBuffer,
+                (entry.y + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                (entry.z + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE,
+                1);
+            // Each level reads the one before it; after the last, the header and every level
+            // become visible to the culling that follows
+            memoryBarrier(
+                commandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_SHADER_READ_BIT);
+            sourceSize = push.destinationSize;
+        }
+
+        if (frameInfo.gpuTimer != nullptr) {
+            frameInfo.gpuTimer->end(commandBuffer, GpuScope::HiZBuild);
+        }
+        m_built = true;
+    }
+} // namespace engine
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Buffer.hpp"
+#include "Descriptors.hpp"
+#include "Device.hpp"
+#include "FrameInfo.hpp"
+#include "Pipeline.hpp"
+#include "PipelineBuildQueue.hpp"
+#include "SwapChain.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <array>
+#include <future>
+#include <memory>
+#include <vector>
+
+namespace engine {
+
+    // Max-depth pyramid of a depth buffer, for occlusion tests in compute shaders. Level 0 keeps
+    // the farthest of each 2x2 block of depth pixels and every further level does the same to
+    // the one below, rounding sizes up, so texel i of level L covers depth pixels
+    // [i * 2^(L+1), (i + 1) * 2^(L+1)). A sphere whose nearest depth lies behind every texel
+    // under its screen rectangle is hidden by what was drawn.
+    //
+    // The levels live in one storage buffer after a header holding the transform the depth
+    // was rendered with, so readers can project into the pyramid without knowing which frame
+    // built it. Laid out as HiZBuffer in hiz_build.comp and instance_cull.comp.
+    class HiZPyramid {
+    public:
+        static constexpr uint32_t MAX_LEVELS = 16;
+        static constexpr uint32_t WORKGROUP_SIZE = 8;
+
+        // Matches the start of HiZBuffer (std430); depths[] follows it
+        struct Header {
+            glm::mat4 viewProjection{ 1.f };
+            glm::uvec2 depthSize{ 0 };
+            uint32_t levelCount{ 0 };
+            uint32_t padding{ 0 };
+            // Offset into depths[], width and height of each level
+            std::array<glm::uvec4, MAX_LEVELS> levels{};
+        };
+
+        HiZPyramid(Device& device, PipelineBuildQueue& pipelineQueue, VkExtent2D extent);
+        ~HiZPyramid();
+
+        HiZPyramid(const HiZPyramid&) = delete;
+        HiZPyramid& operator=(const HiZPyramid&) = delete;
+
+        // Reallocates for a new depth extent, waiting for the device first since frames in
+        // flight may still read the old buffer. Does nothing if the extent is unchanged. Call
+        // before recording anything that reads the pyramid this frame.
+        void resize(VkExtent2D extent);
+        // Call once the swap chain is recreated: the sets still point at destroyed depth views,
+        // and a new view may get the same handle, so every set is rewritten on its next build
+        void invalidateDepthSets() { m_depthViews.fill(VK_NULL_HANDLE); }
+        // Records the reduction of depthView, which must be in DEPTH_STENCIL_READ_ONLY_OPTIMAL with
+        // its writes visible to compute shaders, and makes the result visible to them. Timed as
+        // GpuScope::HiZBuild. viewProjection is the transform the depth was rendered with.
+        void build(FrameInfo& frameInfo, VkImageView depthView, const glm::mat4& viewProjection);
+
+        // False until the first build after construction or a resize
+        bool isBuilt() const { return m_built; }
+        VkDescriptorBufferInfo descriptorInfo() { return m_buffer->descriptorInfo(); }
+        // Changes whenever resize reallocates, so sets holding descriptorInfo know to rewrite
+        uint32_t getGeneration() const { return m_generation; }
+
+    private:
+        void createDescriptorSets();
+        void createPipeline(PipelineBuildQueue& pipelineQueue);
+        void writeDepthSet(int frameIndex, VkImageView depthView);
+
+        Device& m_device;
+        VkExtent2D m_extent{ 0, 0 };
+        Header m_header{};
+        std::unique_ptr<Buffer> m_buffer;
+        uint32_t m_generation = 0;
+        bool m_built = false;
+
+        VkSampler m_sampler = VK_NULL_HANDLE;
+        std::unique_ptr<DescriptorSetLayout> m_setLayout;
+        std::unique_ptr<DescriptorPool> m_pool;
+        // One set per frame in flight, pointed at whichever depth image that frame renders
+        std::array<VkDescriptorSet, SwapChain::MAX_FRAMES_IN_FLIGHT> m_sets{};
+        std::array<VkImageView, SwapChain::MAX_FRAMES_IN_FLIGHT> m_depthViews{};
+
+        VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+        std::shared_ptr<ComputePipeline> m_pipeline;
+        std::future<std::shared_ptr<ComputePipeline>> m_pendingPipeline;
+    };
+} // namespace engine
@@ -0,0 +1,133 @@
+#include "JobPool.hpp"
+
+#include <algorithm>
+
+namespace engine {
+
+    JobPool::JobPool(uint32_t workerCount) {
+        if (workerCount == 0) {
+            workerCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        // Worker 0 is whichever thread calls run()
+        for (uint32_t i = 1; i < workerCount; i++) {
+            m_threads.emplace_back(&JobPool::workerLoop, this, i);
+        }
+    }
+
+    JobPool::~JobPool() {
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            m_stopping = true;
+        }
+        m_workReady.notify_all();
+        for (auto& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    void JobPool::run(uint32_t jobCount, const Job& job) {
+        if (jobCount == 0) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            m_job = &job;
+            m_jobCount = jobCount;
+            m_nextJob = 0;
+            m_error = nullptr;
+            m_generation++;
+        }
+        m_workReady.notify_all();
+
+        takeJobs(0);
+        // Every job has been handed out once takeJobs returns, so only the workers still
+        // running theirs are left to wait for
+        std::unique_lock<std::mutex> lock{ m_mutex };
+        m_workDone.wait(lock, [this] { return m_joinedWorkers == 0; });
+        m_job = nullptr;
+        if (m_error) {
+            std::rethrow_exception(m_error);
+        }
+    }
+
+    void JobPool::submit(std::function<void()> task) {
+        if (m_threads.empty()) {
+            task();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            m_tasks.push_back(std::move(task));
+        }
+        m_workReady.notify_one();
+    }
+
+    void JobPool::waitIdle() {
+        std::unique_lock<std::mutex> lock{ m_mutex };
+        m_idle.wait(lock, [this] { return m_tasks.empty() && m_runningTasks == 0; });
+    }
+
+    void JobPool::workerLoop(uint32_t workerIndex) {
+        uint64_t seenGeneration = 0;
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock{ m_mutex };
+                m_workReady.wait(lock, [&] {
+                    return m_stopping || !m_tasks.empty() || (m_job && m_generation != seenGeneration);
+                });
+                if (m_job && m_generation != seenGeneration) {
+                    seenGeneration = m_generation;
+                    m_joinedWorkers++;
+                } else if (!m_tasks.empty()) {
+                    // Queued tasks still run when stopping, their results may be waited on
+                    task = std::move(m_tasks.front());
+                    m_tasks.pop_front();
+                    m_runningTasks++;
+                } else {
+                    return;
+                }
+            }
+
+            if (task) {
+                task();
+                bool idle;
+                {
+                    std::lock_guard<std::mutex> lock{ m_mutex };
+                    m_runningTasks--;
+                    idle = m_tasks.empty() && m_runningTasks == 0;
+                }
+                if (idle) {
+                    m_idle.notify_all();
+                }
+                continue;
+            }
+
+            takeJobs(workerIndex);
+            bool lastWorker;
+            {
+                std::lock_guard<std::mutex> lock{ m_mutex };
+                lastWorker = --m_joinedWorkers == 0;
+            }
+            if (lastWorker) {
+                m_workDone.notify_one();
+            }
+        }
+    }
+
+    void JobPool::takeJobs(uint32_t workerIndex) {
+        try {
+            for (uint32_t jobIndex = m_nextJob++; jobIndex < m_jobCount; jobIndex = m_nextJob++) {
+                (*m_job)(workerIndex, jobIndex);
+            }
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock{ m_mutex };
+            if (!m_error) {
+                m_error = std::current_exception();
+            }
+            // Let the other workers drain quickly
+            m_nextJob = m_jobCount;
+        }
+    }
+} // namespace engine
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace engine {
+
+    // Fixed set of worker threads shared by everything that splits work across the CPU, so the
+    // engine keeps one thread per hardware thread however many systems go parallel.
+    //
+    // run() is a blocking parallel for: the calling thread takes part as worker 0 and the
+    // workers 1..n-1 join in. submit() queues a task for the workers to pick up in the
+    // background; a worker in the middle of one simply joins the next run() late. run() must
+    // always be called from the same thread.
+    class JobPool {
+    public:
+        using Job = std::function<void(uint32_t workerIndex, uint32_t jobIndex)>;
+
+        // workerCount 0 picks one worker per hardware thread; the calling thread counts as one
+        explicit JobPool(uint32_t workerCount = 0);
+        // Finishes every submitted task before joining the workers
+        ~JobPool();
+
+        JobPool(const JobPool&) = delete;
+        JobPool& operator=(const JobPool&) = delete;
+
+        // Runs job(workerIndex, 0..jobCount-1) across the workers and blocks until every job is
+        // done. Jobs are handed out one at a time, so uneven jobs still balance. The first
+        // exception a job throws is rethrown here once the others have drained.
+        void run(uint32_t jobCount, const Job& job);
+
+        // Runs task on a worker thread, or right away when the pool has none. Tasks must not
+        // throw; wrap them in a std::packaged_task to carry errors back.
+        void submit(std::function<void()> task);
+        // Blocks until every submitted task has finished
+        void waitIdle();
+
+        // Including the thread calling run()
+        uint32_t getWorkerCount() const { return static_cast<uint32_t>(m_threads.size()) + 1; }
+        // Threads that run submitted tasks
+        uint32_t getThreadCount() const { return static_cast<uint32_t>(m_threads.size()); }
+
+    private:
+        void workerLoop(uint32_t workerIndex);
+        void takeJobs(uint32_t workerIndex);
+
+        std::vector<std::thread> m_threads;
+
+        // Guards everything below except m_nextJob
+        std::mutex m_mutex;
+        std::condition_variable m_workReady;
+        std::condition_variable m_workDone;
+        std::condition_variable m_idle;
+        bool m_stopping = false;
+
+        // The run() call in flight. Only workers that joined it are counted, so one busy with
+        // a task does not hold it up.
+        uint64_t m_generation = 0;
+        const Job* m_job = nullptr;
+        uint32_t m_jobCount = 0;
+        std::atomic<uint32_t> m_nextJob{ 0 };
+        uint32_t m_joinedWorkers = 0;
+        std::exception_ptr m_error;
+
+        std::deque<std::function<void()>> m_tasks;
+        uint32_t m_runningTasks = 0;
+    };
+} // namespace engine
@@ -0,0 +1,306 @@
+#include "MaskedOcclusionBuffer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define ENGINE_OCCLUSION_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace engine {
+
+    static_assert(
+        MaskedOcclusionBuffer::TILE_WIDTH * MaskedOcclusionBuffer::TILE_HEIGHT == 32,
+        "Tile coverage must fit a 32 bit mask");
+
+    MaskedOcclusionBuffer::MaskedOcclusionBuffer(uint32_t width, uint32_t height, JobPool& jobPool)
+        : m_jobPool{ jobPool } {
+        assert(width > 0 && height > 0 && "Occlusion buffer must not be empty");
+        m_tilesX = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+        m_tilesY = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+        m_width = m_tilesX * TILE_WIDTH;
+        m_height = m_tilesY * TILE_HEIGHT;
+        m_tiles.resize(m_tilesX * m_tilesY);
+    }
+
+    void MaskedOcclusionBuffer::clear() {
+        std::fill(m_tiles.begin(), m_tiles.end(), Tile{});
+        m_occluders.clear();
+        m_triangleCount = 0;
+    }
+
+    void MaskedOcclusionBuffer::addOccluder(const Occluder& occluder) {
+        assert(occluder.indexCount % 3 == 0 && "Occluders are triangle lists");
+        m_occluders.push_back(occluder);
+    }
+
+    void MaskedOcclusionBuffer::rasterize() {
+        const uint32_t occluderCount = static_cast<uint32_t>(m_occluders.size());
+        if (m_triangles.size() < occluderCount) {
+            m_triangles.resize(occluderCount);
+        }
+        m_jobPool.run(occluderCount, [this](uint32_t, uint32_t occluderIndex) {
+            m_triangles[occluderIndex].clear();
+            setupOccluder(m_occluders[occluderIndex], m_triangles[occluderIndex]);
+        });
+
+        m_triangleCount = 0;
+        for (uint32_t i = 0; i < occluderCount; i++) {
+            m_triangleCount += static_cast<uint32_t>(m_triangles[i].size());
+        }
+        if (m_triangleCount == 0) {
+            return;
+        }
+        // Every row of tiles is written by one worker only, so tiles need no locking. Rows are
+        // handed out one at a time, since rows under large occluders take longer.
+        m_jobPool.run(m_tilesY, [this](uint32_t, uint32_t tileRow) { rasterizeTileRow(tileRow); });
+    }
+
+    void MaskedOcclusionBuffer::setupOccluder(const Occluder& occluder, std::vector<Triangle>& triangles) const {
+        const auto* positions = reinterpret_cast<const unsigned char*>(occluder.positions);
+        auto transform = [&](uint32_t index) {
+            const glm::vec3& position = *reinterpret_cast<const glm::vec3*>(positions + index * occluder.stride);
+            return occluder.modelViewProjection * glm::vec4(position, 1.f);
+        };
+
+        for (uint32_t i = 0; i + 2 < occluder.indexCount; i += 3) {
+            const glm::vec4 clip[3] = {
+                transform(occluder.indices[i]),
+                transform(occluder.indices[i + 1]),
+                transform(occluder.indices[i + 2]) };
+            const int inFront = (clip[0].z >= 0.f) + (clip[1].z >= 0.f) + (clip[2].z >= 0.f);
+            if (inFront == 3) {
+                setupTriangle(clip, triangles);
+                continue;
+            }
+            if (inFront == 0) {
+                continue;
+            }
+
+            // Cut along the near plane, z = 0 in clip space, leaving a triangle or a quad
+            glm::vec4 polygon[4];
+            uint32_t corners = 0;
+            for (uint32_t k = 0; k < 3; k++) {
+                const glm::vec4& a = clip[k];
+                const glm::vec4& b = clip[(k + 1) % 3];
+                if (a.z >= 0.f) {
+                    polygon[corners++] = a;
+                }
+                if ((a.z >= 0.f) != (b.z >= 0.f)) {
+                    polygon[corners++] = a + (b - a) * (a.z / (a.z - b.z));
+                }
+            }
+            const glm::vec4 first[3] = { polygon[0], polygon[1], polygon[2] };
+            setupTriangle(first, triangles);
+            if (corners == 4) {
+                const glm::vec4 second[3] = { polygon[0], polygon[2], polygon[3] };
+                setupTriangle(second, triangles);
+            }
+        }
+    }
+
+    void MaskedOcclusionBuffer::setupTriangle(const glm::vec4 clip[3], std::vector<Triangle>& triangles) const {
+        glm::vec3 v[3];
+        for (int i = 0; i < 3; i++) {
+            if (clip[i].w <= 0.f) {
+                return;
+            }
+            const float invW = 1.f / clip[i].w;
+            v[i] = {
+                (clip[i].x * invW * 0.5f + 0.5f) * static_cast<float>(m_width),
+                (clip[i].y * invW * 0.5f + 0.5f) * static_cast<float>(m_height),
+                clip[i].z * invW };
+        }
+        const float minZ = std::min({ v[0].z, v[1].z, v[2].z });
+        if (minZ >= 1.f) {
+            return;
+        }
+        const float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+        // Also drops triangles whose projection overflowed to NaN
+        if (!(std::abs(area) > FLT_EPSILON)) {
+            return;
+        }
+
+        // Pixels whose centers the bounding rectangle may contain
+        const float maxX = static_cast<float>(m_width - 1);
+        const float maxY = static_cast<float>(m_height - 1);
+        Triangle triangle;
+        triangle.minX = static_cast<int>(std::max(0.f, std::ceil(std::min({ v[0].x, v[1].x, v[2].x }) - 0.5f)));
+        triangle.maxX = static_cast<int>(std::min(maxX, std::floor(std::max({ v[0].x, v[1].x, v[2].x }) - 0.5f)));
+        triangle.minY = static_cast<int>(std::max(0.f, std::ceil(std::min({ v[0].y, v[1].y, v[2].y }) - 0.5f)));
+        triangle.maxY = static_cast<int>(std::min(maxY, std::floor(std::max({ v[0].y, v[1].y, v[2].y }) - 0.5f)));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+            return;
+        }
+
+        // Edges face inwards whichever way the triangle winds, so both faces rasterize
+        const float orientation = area > 0.f ? 1.f : -1.f;
+        for (int i = 0; i < 3; i++) {
+            const glm::vec3& a = v[i];
+            const glm::vec3& b = v[(i + 1) % 3];
+            triangle.edgeA[i] = (a.y - b.y) * orientation;
+            triangle.edgeB[i] = (b.x - a.x) * orientation;
+            triangle.edgeC[i] = -(triangle.edgeA[i] * a.x + triangle.edgeB[i] * a.y);
+        }
+
+        // z / w is linear in screen space
+        const float dz1 = v[1].z - v[0].z;
+        const float dz2 = v[2].z - v[0].z;
+        triangle.zA = (dz1 * (v[2].y - v[0].y) - dz2 * (v[1].y - v[0].y)) / area;
+        triangle.zB = (dz2 * (v[1].x - v[0].x) - dz1 * (v[2].x - v[0].x)) / area;
+        triangle.zC = v[0].z - triangle.zA * v[0].x - triangle.zB * v[0].y;
+        triangle.maxZ = std::max({ v[0].z, v[1].z, v[2].z });
+        triangles.push_back(triangle);
+    }
+
+    void MaskedOcclusionBuffer::rasterizeTileRow(uint32_t tileRow) {
+        Tile* tiles = &m_tiles[tileRow * m_tilesX];
+        const int rowMinY = static_cast<int>(tileRow * TILE_HEIGHT);
+        const int rowMaxY = rowMinY + static_cast<int>(TILE_HEIGHT) - 1;
+
+        for (size_t occluder = 0; occluder < m_occluders.size(); occluder++) {
+            for (const Triangle& triangle : m_triangles[occluder]) {
+                if (triangle.maxY < rowMinY || triangle.minY > rowMaxY) {
+                    continue;
+                }
+                // Farthest the depth plane gets over a tile, from the tile corner it rises towards
+                const float rowZ = triangle.zC + triangle.zB * static_cast<float>(triangle.zB > 0.f ? rowMaxY + 1 : rowMinY);
+                const uint32_t firstTile = static_cast<uint32_t>(triangle.minX) / TILE_WIDTH;
+                const uint32_t lastTile = static_cast<uint32_t>(triangle.maxX) / TILE_WIDTH;
+                for (uint32_t tileX = firstTile; tileX <= lastTile; tileX++) {
+                    const float x0 = static_cast<float>(tileX * TILE_WIDTH);
+                    const float zTriangle = std::min(
+                        triangle.maxZ, rowZ + triangle.zA * (triangle.zA > 0.f ? x0 + TILE_WIDTH : x0));
+                    Tile& tile = tiles[tileX];
+                    // Entirely behind what the tile already holds
+                    if (zTriangle >= tile.zMax0) {
+                        continue;
+                    }
+                    const uint32_t coverage = computeCoverage(triangle, x0, static_cast<float>(rowMinY));
+                    if (coverage != 0) {
+                        updateTile(tile, coverage, zTriangle);
+                    }
+                }
+            }
+        }
+    }
+
+    uint32_t MaskedOcclusionBuffer::computeCoverage(const Triangle& triangle, float tileX, float tileY) {
+        uint32_t coverage = 0;
+#ifdef ENGINE_OCCLUSION_SSE
+        // Pixel centers of the left and right halves of a tile row
+        const __m128 left = _mm_add_ps(_mm_set1_ps(tileX), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+        const __m128 right = _mm_add_ps(left, _mm_set1_ps(4.f));
+        __m128 edgeLeft[3], edgeRight[3], edgeB[3];
+        for (int i = 0; i < 3; i++) {
+            const __m128 a = _mm_set1_ps(triangle.edgeA[i]);
+            const __m128 rowStart = _mm_set1_ps(triangle.edgeB[i] * (tileY + 0.5f) + triangle.edgeC[i]);
+            edgeLeft[i] = _mm_add_ps(_mm_mul_ps(a, left), rowStart);
+            edgeRight[i] = _mm_add_ps(_mm_mul_ps(a, right), rowStart);
+            edgeB[i] = _mm_set1_ps(triangle.edgeB[i]);
+        }
+
+        const __m128 zero = _mm_setzero_ps();
+        for (uint32_t row = 0; row < TILE_HEIGHT; row++) {
+            const __m128 insideLeft = _mm_and_ps(
+                _mm_and_ps(_mm_cmpge_ps(edgeLeft[0], zero), _mm_cmpge_ps(edgeLeft[1], zero)),
+                _mm_cmpge_ps(edgeLeft[2], zero));
+            const __m128 insideRight = _mm_and_ps(
+                _mm_and_ps(_mm_cmpge_ps(edgeRight[0], zero), _mm_cmpge_ps(edgeRight[1], zero)),
+                _mm_cmpge_ps(edgeRight[2], zero));
+            const uint32_t rowMask = static_cast<uint32_t>(_mm_movemask_ps(insideLeft)) |
+                (static_cast<uint32_t>(_mm_movemask_ps(insideRight)) << 4);
+            coverage |= rowMask << (row * TILE_WIDTH);
+            for (int i = 0; i < 3; i++) {
+                edgeLeft[i] = _mm_add_ps(edgeLeft[i], edgeB[i]);
+                edgeRight[i] = _mm_add_ps(edgeRight[i], edgeB[i]);
+            }
+        }
+#else
+        for (uint32_t row = 0; row < TILE_HEIGHT; row++) {
+            const float y = tileY + static_cast<float>(row) + 0.5f;
+            for (uint32_t column = 0; column < TILE_WIDTH; column++) {
+                const float x = tileX + static_cast<float>(column) + 0.5f;
+                bool inside = true;
+                for (int i = 0; i < 3; i++) {
+                    inside = inside && triangle.edgeA[i] * x + triangle.edgeB[i] * y + triangle.edgeC[i] >= 0.f;
+                }
+                if (inside) {
+                    coverage |= 1u << (column + row * TILE_WIDTH);
+                }
+            }
+        }
+#endif
+        return coverage;
+    }
+
+    void MaskedOcclusionBuffer::updateTile(Tile& tile, uint32_t coverage, float zTriangle) {
+        // A triangle much nearer than the working layer starts a new one, rather than being
+        // merged into a layer whose depth would hide nothing
+        if (tile.mask != 0 && tile.zMax1 - zTriangle > tile.zMax0 - tile.zMax1) {
+            tile.mask = 0;
+        }
+        tile.zMax1 = tile.mask != 0 ? std::max(tile.zMax1, zTriangle) : zTriangle;
+        tile.mask |= coverage;
+        if (tile.mask == ~0u) {
+            tile.zMax0 = tile.zMax1;
+            tile.zMax1 = 0.f;
+            tile.mask = 0;
+        }
+    }
+
+    bool MaskedOcclusionBuffer::isBoxVisible(
+        const glm::vec3& min, const glm::vec3& max, const glm::mat4& modelViewProjection) const {
+        glm::vec2 minScreen{ FLT_MAX };
+        glm::vec2 maxScreen{ -FLT_MAX };
+        float nearest = FLT_MAX;
+        for (int i = 0; i < 8; i++) {
+            const glm::vec3 corner{ (i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z };
+            const glm::vec4 clip = modelViewProjection * glm::vec4(corner, 1.f);
+            // Reaching past the near plane, the rectangle is unbounded
+            if (clip.z < 0.f || clip.w <= 0.f) {
+                return true;
+            }
+            const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            const glm::vec2 screen{
+                (ndc.x * 0.5f + 0.5f) * static_cast<float>(m_width),
+                (ndc.y * 0.5f + 0.5f) * static_cast<float>(m_height) };
+            minScreen = glm::min(minScreen, screen);
+            maxScreen = glm::max(maxScreen, screen);
+            nearest = std::min(nearest, ndc.z);
+        }
+        // Off the buffer nothing is known; frustum culling decides those
+        if (maxScreen.x < 0.f || maxScreen.y < 0.f ||
+            minScreen.x > static_cast<float>(m_width) || minScreen.y > static_cast<float>(m_height)) {
+            return true;
+        }
+
+        // Every tile the rectangle touches, even partly
+        auto toTile = [](float coordinate, uint32_t size, uint32_t tileSize) {
+            const float clamped = std::min(std::max(coordinate, 0.f), static_cast<float>(size - 1));
+            return static_cast<uint32_t>(clamped) / tileSize;
+        };
+        const uint32_t firstTileX = toTile(minScreen.x, m_width, TILE_WIDTH);
+        const uint32_t lastTileX = toTile(maxScreen.x, m_width, TILE_WIDTH);
+        const uint32_t firstTileY = toTile(minScreen.y, m_height, TILE_HEIGHT);
+        const uint32_t lastTileY = toTile(maxScreen.y, m_height, TILE_HEIGHT);
+        for (uint32_t tileY = firstTileY; tileY <= lastTileY; tileY++) {
+            for (uint32_t tileX = firstTileX; tileX <= lastTileX; tileX++) {
+                if (nearest <= m_tiles[tileX + tileY * m_tilesX].zMax0) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    float MaskedOcclusionBuffer::getPixelDepth(uint32_t x, uint32_t y) const {
+        assert(x < m_width && y < m_height && "Pixel out of the occlusion buffer");
+        const Tile& tile = m_tiles[x / TILE_WIDTH + (y / TILE_HEIGHT) * m_tilesX];
+        const uint32_t bit = 1u << (x % TILE_WIDTH + (y % TILE_HEIGHT) * TILE_WIDTH);
+        return (tile.mask & bit) != 0 ? tile.zMax1 : tile.zMax0;
+    }
+} // namespace engine
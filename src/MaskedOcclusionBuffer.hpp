@@ -0,0 +1,115 @@
+#pragma once
+
+#include "JobPool.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace engine {
+
+    // Low resolution depth buffer that occluder triangles are rasterized into on the CPU, so
+    // bounding boxes can be tested against it before their draws are recorded. Follows masked
+    // software occlusion culling: rather than a depth per pixel, every 8x4 pixel tile keeps the
+    // farthest depth of the whole tile plus a working layer, a coverage mask and the farthest
+    // depth of the triangles that set it. Once the mask is full the working layer becomes the
+    // tile's depth. Depths only ever err towards far, so a box never tests hidden unless what
+    // was rasterized covers it.
+    //
+    // Depth is NDC z, 0 near and 1 far like the engine's projections, and pixel rows run down
+    // like NDC y. Rows of tiles are rasterized across the workers of a JobPool, the calling
+    // thread taking part as worker 0. Nothing here touches the GPU.
+    class MaskedOcclusionBuffer {
+    public:
+        static constexpr uint32_t TILE_WIDTH = 8;
+        static constexpr uint32_t TILE_HEIGHT = 4;
+
+        // Mesh to rasterize; both faces of every triangle are drawn
+        struct Occluder {
+            // Vertex positions, stride bytes apart
+            const glm::vec3* positions = nullptr;
+            size_t stride = sizeof(glm::vec3);
+            // Three per triangle
+            const uint32_t* indices = nullptr;
+            uint32_t indexCount = 0;
+            glm::mat4 modelViewProjection{ 1.f };
+        };
+
+        // width and height are rounded up to whole tiles
+        MaskedOcclusionBuffer(uint32_t width, uint32_t height, JobPool& jobPool);
+
+        MaskedOcclusionBuffer(const MaskedOcclusionBuffer&) = delete;
+        MaskedOcclusionBuffer& operator=(const MaskedOcclusionBuffer&) = delete;
+
+        // Empties the depth and the occluder list
+        void clear();
+        // Queued until rasterize(); the arrays must stay alive until then
+        void addOccluder(const Occluder& occluder);
+        // Transforms, clips against the near plane and rasterizes every queued occluder
+        void rasterize();
+
+        // False only when every pixel under the screen rectangle of the box, transformed by
+        // modelViewProjection, is covered nearer than its nearest corner. Boxes reaching
+        // behind the near plane are always visible.
+        bool isBoxVisible(const glm::vec3& min, const glm::vec3& max, const glm::mat4& modelViewProjection) const;
+        // Farthest depth the pixel is known to be covered at, 1 where nothing covers it
+        float getPixelDepth(uint32_t x, uint32_t y) const;
+
+        uint32_t getWidth() const { return m_width; }
+        uint32_t getHeight() const { return m_height; }
+        uint32_t getWorkerCount() const { return m_jobPool.getWorkerCount(); }
+        // Triangles that reached the tiles in the last rasterize(), after clipping
+        uint32_t getTriangleCount() const { return m_triangleCount; }
+
+    private:
+        struct Tile {
+            // Farthest depth of the whole tile
+            float zMax0 = 1.f;
+            // Farthest depth of the pixels in mask, meaningless while mask is empty
+            float zMax1 = 0.f;
+            // Bit x + y * TILE_WIDTH per pixel
+            uint32_t mask = 0;
+        };
+
+        // Screen-space triangle ready for rasterization
+        struct Triangle {
+            // a * x + b * y + c is non-negative inside every edge
+            float edgeA[3];
+            float edgeB[3];
+            float edgeC[3];
+            // Depth plane z = zA * x + zB * y + zC
+            float zA;
+            float zB;
+            float zC;
+            float maxZ;
+            // Pixel bounds, clamped to the buffer
+            int minX;
+            int maxX;
+            int minY;
+            int maxY;
+        };
+
+        void setupOccluder(const Occluder& occluder, std::vector<Triangle>& triangles) const;
+        void setupTriangle(const glm::vec4 clip[3], std::vector<Triangle>& triangles) const;
+        void rasterizeTileRow(uint32_t tileRow);
+        static uint32_t computeCoverage(const Triangle& triangle, float tileX, float tileY);
+        static void updateTile(Tile& tile, uint32_t coverage, float zTriangle);
+
+        uint32_t m_width;
+        uint32_t m_height;
+        uint32_t m_tilesX;
+        uint32_t m_tilesY;
+        std::vector<Tile> m_tiles;
+
+        std::vector<Occluder> m_occluders;
+        // Triangles of each occluder, kept across frames for their capacity
+        std::vector<std::vector<Triangle>> m_triangles;
+        uint32_t m_triangleCount = 0;
+
+        JobPool& m_jobPool;
+    };
+} // namespace engine
@@ -0,0 +1,71 @@
+#include "MeshPool.hpp"
+
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+namespace engine {
+
+    MeshPool::MeshPool(Device& device, VkDeviceSize vertexSize, uint32_t maxVertices, uint32_t maxIndices)
+        : m_device{ device }, m_vertexSize{ vertexSize }, m_maxVertices{ maxVertices }, m_maxIndices{ maxIndices } {
+        m_vertexBuffer = std::make_unique<Buffer>(
+            m_device,
+            m_vertexSize,
+            m_maxVertices,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        m_indexBuffer = std::make_unique<Buffer>(
+            m_device,
+            sizeof(uint32_t),
+            m_maxIndices,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+
+    MeshPool::~MeshPool() {}
+
+    MeshAllocation MeshPool::allocate(
+        const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount) {
+        assert(vertexCount > 0 && indexCount > 0 && "Pooled meshes need vertices and indices");
+        if (m_usedVertices + vertexCount > m_maxVertices || m_usedIndices + indexCount > m_maxIndices) {
+            throw std::runtime_error(
+                "mesh pool is full: " + std::to_string(vertexCount) + " vertices and " +
+                std::to_string(indexCount) + " indices requested");
+        }
+
+        MeshAllocation allocation{};
+        allocation.vertexOffset = static_cast<int32_t>(m_usedVertices);
+        allocation.firstIndex = m_usedIndices;
+        allocation.vertexCount = vertexCount;
+        allocation.indexCount = indexCount;
+
+        upload(vertices, m_vertexSize * vertexCount, *m_vertexBuffer, m_vertexSize * m_usedVertices);
+        upload(indices, sizeof(uint32_t) * indexCount, *m_indexBuffer, sizeof(uint32_t) * m_usedIndices);
+
+        m_usedVertices += vertexCount;
+        m_usedIndices += indexCount;
+        return allocation;
+    }
+
+    void MeshPool::bind(VkCommandBuffer commandBuffer) const {
+        VkBuffer buffers[] = { m_vertexBuffer->getBuffer() };
+        VkDeviceSize offsets[] = { 0 };
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+    }
+
+    void MeshPool::upload(const void* data, VkDeviceSize size, Buffer& dstBuffer, VkDeviceSize dstOffset) {
+        Buffer stagingBuffer{
+            m_device,
+            size,
+            1,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+        };
+
+        stagingBuffer.map();
+        stagingBuffer.writeToBuffer(const_cast<void*>(data));
+
+        m_device.copyBuffer(stagingBuffer.getBuffer(), dstBuffer.getBuffer(), size, dstOffset);
+    }
+} // namespace engine
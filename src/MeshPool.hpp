@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Buffer.hpp"
+
+#include <memory>
+
+namespace engine {
+
+    // Where a mesh lives inside the pool, in elements rather than bytes
+    struct MeshAllocation {
+        int32_t vertexOffset{ 0 };
+        uint32_t firstIndex{ 0 };
+        uint32_t vertexCount{ 0 };
+        uint32_t indexCount{ 0 };
+    };
+
+    // One device-local vertex buffer and one index buffer shared by every pooled Model, so
+    // a single bind covers all of them and draws select a mesh with vertexOffset/firstIndex.
+    // Meshes are suballocated linearly and live as long as the pool.
+    class MeshPool {
+    public:
+        MeshPool(Device& device, VkDeviceSize vertexSize, uint32_t maxVertices, uint32_t maxIndices);
+        ~MeshPool();
+
+        MeshPool(const MeshPool&) = delete;
+        MeshPool& operator=(const MeshPool&) = delete;
+
+        MeshAllocation allocate(
+            const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+        void bind(VkCommandBuffer commandBuffer) const;
+
+        uint32_t getUsedVertices() const { return m_usedVertices; }
+        uint32_t getUsedIndices() const { return m_usedIndices; }
+
+    private:
+        void upload(const void* data, VkDeviceSize size, Buffer& dstBuffer, VkDeviceSize dstOffset);
+
+        Device& m_device;
+        VkDeviceSize m_vertexSize;
+        uint32_t m_maxVertices;
+        uint32_t m_maxIndices;
+        uint32_t m_usedVertices = 0;
+        uint32_t m_usedIndices = 0;
+
+        std::unique_ptr<Buffer> m_vertexBuffer;
+        std::unique_ptr<Buffer> m_indexBuffer;
+    };
+} // namespace engine
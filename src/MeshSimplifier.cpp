@@ -0,0 +1,339 @@
+#include "MeshSimplifier.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+
+namespace engine {
+
+    namespace {
+        // Constraint planes along borders and seams weigh this much more than surface planes
+        constexpr double BORDER_WEIGHT = 10.0;
+
+        // Sum of squared distances to a set of weighted planes, as the upper triangle of the
+        // symmetric 4x4 matrix
+        struct Quadric {
+            double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+            double b2 = 0.0, bc = 0.0, bd = 0.0;
+            double c2 = 0.0, cd = 0.0;
+            double d2 = 0.0;
+            // Sum of the plane weights, so evaluate(p) / weight is a mean squared distance
+            double weight = 0.0;
+
+            // normal must be unit length
+            void addPlane(const glm::vec3& normal, const glm::vec3& point, double planeWeight) {
+                const double a = normal.x;
+                const double b = normal.y;
+                const double c = normal.z;
+                const double d = -(a * point.x + b * point.y + c * point.z);
+                a2 += planeWeight * a * a;
+                ab += planeWeight * a * b;
+                ac += planeWeight * a * c;
+                ad += planeWeight * a * d;
+                b2 += planeWeight * b * b;
+                bc += planeWeight * b * c;
+                bd += planeWeight * b * d;
+                c2 += planeWeight * c * c;
+                cd += planeWeight * c * d;
+                d2 += planeWeight * d * d;
+                weight += planeWeight;
+            }
+
+            Quadric& operator+=(const Quadric& other) {
+                a2 += other.a2;
+                ab += other.ab;
+                ac += other.ac;
+                ad += other.ad;
+                b2 += other.b2;
+                bc += other.bc;
+                bd += other.bd;
+                c2 += other.c2;
+                cd += other.cd;
+                d2 += other.d2;
+                weight += other.weight;
+                return *this;
+            }
+
+            double evaluate(const glm::vec3& p) const {
+                const double x = p.x;
+                const double y = p.y;
+                const double z = p.z;
+                const double error =
+                    a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x +
+                    b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y +
+                    c2 * z * z + 2.0 * cd * z +
+                    d2;
+                // Rounding can leave a tiny negative sum
+                return std::max(error, 0.0);
+            }
+        };
+
+        // Moves position from onto position to. The versions go stale as soon as either end
+        // takes part in another collapse, which retires the entry.
+        struct Collapse {
+            // Area weighted, so collapses over small triangles go first
+            double cost;
+            // Mean squared distance from the planes around both ends
+            double squaredError;
+            uint32_t from;
+            uint32_t to;
+            uint32_t fromVersion;
+            uint32_t toVersion;
+
+            bool operator>(const Collapse& other) const { return cost > other.cost; }
+        };
+
+        uint64_t edgeKey(uint32_t a, uint32_t b) {
+            return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+        }
+    } // namespace
+
+    std::vector<uint32_t> simplifyMesh(
+        const std::vector<Model::Vertex>& vertices,
+        const std::vector<uint32_t>& indices,
+        uint32_t targetIndexCount,
+        float maxError) {
+        const double maxSquaredError = static_cast<double>(maxError) * maxError;
+        const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+        const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+        // Weld vertices that differ only in attributes; sortedVertices[positionFirst[p]] up to
+        // positionFirst[p + 1] are the vertices at position p
+        std::vector<uint32_t> sortedVertices(vertexCount);
+        std::iota(sortedVertices.begin(), sortedVertices.end(), 0);
+        std::sort(sortedVertices.begin(), sortedVertices.end(), [&](uint32_t a, uint32_t b) {
+            const glm::vec3& pa = vertices[a].position;
+            const glm::vec3& pb = vertices[b].position;
+            return std::tie(pa.x, pa.y, pa.z) < std::tie(pb.x, pb.y, pb.z);
+        });
+        std::vector<uint32_t> positionOf(vertexCount);
+        std::vector<glm::vec3> positions;
+        std::vector<uint32_t> positionFirst;
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            const uint32_t vertex = sortedVertices[i];
+            if (positions.empty() || vertices[vertex].position != positions.back()) {
+                positions.push_back(vertices[vertex].position);
+                positionFirst.push_back(i);
+            }
+            positionOf[vertex] = static_cast<uint32_t>(positions.size() - 1);
+        }
+        positionFirst.push_back(vertexCount);
+        const uint32_t positionCount = static_cast<uint32_t>(positions.size());
+
+        // Surviving position of every position, with path halving
+        std::vector<uint32_t> parent(positionCount);
+        std::iota(parent.begin(), parent.end(), 0);
+        auto find = [&](uint32_t p) {
+            while (parent[p] != p) {
+                parent[p] = parent[parent[p]];
+                p = parent[p];
+            }
+            return p;
+        };
+        auto trianglePositions = [&](uint32_t t) {
+            return std::array<uint32_t, 3>{
+                find(positionOf[indices[3 * t + 0]]),
+                find(positionOf[indices[3 * t + 1]]),
+                find(positionOf[indices[3 * t + 2]]) };
+        };
+
+        // Triangles that are already degenerate carry no surface and are dropped up front
+        std::vector<bool> triangleAlive(triangleCount, true);
+        uint32_t liveTriangles = triangleCount;
+        std::vector<Quadric> quadrics(positionCount);
+        std::vector<std::vector<uint32_t>> positionTriangles(positionCount);
+        std::unordered_map<uint64_t, uint32_t> vertexEdgeUses;
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            const auto p = trianglePositions(t);
+            if (p[0] == p[1] || p[1] == p[2] || p[0] == p[2]) {
+                triangleAlive[t] = false;
+                liveTriangles--;
+                continue;
+            }
+            const glm::vec3 normal = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+            const float length = glm::length(normal);
+            for (uint32_t k = 0; k < 3; k++) {
+                // Weighted by area, so a finely tessellated region does not dominate
+                if (length > 0.f) {
+                    quadrics[p[k]].addPlane(normal / length, positions[p[0]], .5 * length);
+                }
+                positionTriangles[p[k]].push_back(t);
+                vertexEdgeUses[edgeKey(indices[3 * t + k], indices[3 * t + (k + 1) % 3])]++;
+            }
+        }
+
+        // An edge only one triangle uses in vertex space is an open border, or a seam where the
+        // triangles on either side use different vertices. Planes through the edge,
+        // perpendicular to the surface, keep it from sliding.
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            const auto p = trianglePositions(t);
+            const glm::vec3 normal = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+            if (!triangleAlive[t] || glm::length(normal) == 0.f) {
+                continue;
+            }
+            for (uint32_t k = 0; k < 3; k++) {
+                if (vertexEdgeUses[edgeKey(indices[3 * t + k], indices[3 * t + (k + 1) % 3])] != 1) {
+                    continue;
+                }
+                const glm::vec3 edge = positions[p[(k + 1) % 3]] - positions[p[k]];
+                const glm::vec3 planeNormal = glm::cross(edge, normal);
+                const float planeLength = glm::length(planeNormal);
+                if (planeLength == 0.f) {
+                    continue;
+                }
+                const double weight = BORDER_WEIGHT * glm::dot(edge, edge);
+                quadrics[p[k]].addPlane(planeNormal / planeLength, positions[p[k]], weight);
+                quadrics[p[(k + 1) % 3]].addPlane(planeNormal / planeLength, positions[p[k]], weight);
+            }
+        }
+
+        std::vector<uint32_t> versions(positionCount, 0);
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+        // Both directions go in, so a collapse rejected one way can still happen the other
+        auto pushEdge = [&](uint32_t a, uint32_t b) {
+            Quadric quadric = quadrics[a];
+            quadric += quadrics[b];
+            const double weight = std::max(quadric.weight, std::numeric_limits<double>::min());
+            const double toB = quadric.evaluate(positions[b]);
+            const double toA = quadric.evaluate(positions[a]);
+            heap.push({ toB, toB / weight, a, b, versions[a], versions[b] });
+            heap.push({ toA, toA / weight, b, a, versions[b], versions[a] });
+        };
+
+        std::vector<uint64_t> edges;
+        edges.reserve(indices.size());
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            if (!triangleAlive[t]) {
+                continue;
+            }
+            const auto p = trianglePositions(t);
+            for (uint32_t k = 0; k < 3; k++) {
+                edges.push_back(edgeKey(p[k], p[(k + 1) % 3]));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+        for (const uint64_t edge : edges) {
+            pushEdge(static_cast<uint32_t>(edge >> 32), static_cast<uint32_t>(edge & 0xffffffffu));
+        }
+
+        // A collapse may not turn any remaining triangle around from over to
+        auto flipsTriangle = [&](uint32_t from, uint32_t to) {
+            for (const uint32_t t : positionTriangles[from]) {
+                if (!triangleAlive[t]) {
+                    continue;
+                }
+                const auto p = trianglePositions(t);
+                if (p[0] == to || p[1] == to || p[2] == to) {
+                    continue;
+                }
+                std::array<glm::vec3, 3> moved{ positions[p[0]], positions[p[1]], positions[p[2]] };
+                for (uint32_t k = 0; k < 3; k++) {
+                    if (p[k] == from) {
+                        moved[k] = positions[to];
+                    }
+                }
+                const glm::vec3 before =
+                    glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+                const glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                if (glm::dot(before, after) <= 0.f) {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        std::vector<uint32_t> neighbours;
+        while (liveTriangles * 3 > targetIndexCount && !heap.empty()) {
+            const Collapse collapse = heap.top();
+            heap.pop();
+            if (parent[collapse.from] != collapse.from || parent[collapse.to] != collapse.to ||
+                versions[collapse.from] != collapse.fromVersion || versions[collapse.to] != collapse.toVersion) {
+                continue;
+            }
+            if (collapse.squaredError > maxSquaredError || flipsTriangle(collapse.from, collapse.to)) {
+                continue;
+            }
+
+            parent[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            versions[collapse.from]++;
+            versions[collapse.to]++;
+
+            // Triangles across the collapsed edge vanish, the rest now hang off to
+            std::vector<uint32_t>& toTriangles = positionTriangles[collapse.to];
+            for (const uint32_t t : positionTriangles[collapse.from]) {
+                if (!triangleAlive[t]) {
+                    continue;
+                }
+                const auto p = trianglePositions(t);
+                if (p[0] == p[1] || p[1] == p[2] || p[0] == p[2]) {
+                    triangleAlive[t] = false;
+                    liveTriangles--;
+                } else {
+                    toTriangles.push_back(t);
+                }
+            }
+            positionTriangles[collapse.from].clear();
+            positionTriangles[collapse.from].shrink_to_fit();
+            toTriangles.erase(
+                std::remove_if(toTriangles.begin(), toTriangles.end(), [&](uint32_t t) { return !triangleAlive[t]; }),
+                toTriangles.end());
+
+            // Every edge around the merged position has a new cost
+            neighbours.clear();
+            for (const uint32_t t : toTriangles) {
+                for (const uint32_t p : trianglePositions(t)) {
+                    if (p != collapse.to) {
+                        neighbours.push_back(p);
+                    }
+                }
+            }
+            std::sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+            for (const uint32_t neighbour : neighbours) {
+                pushEdge(collapse.to, neighbour);
+            }
+        }
+
+        // A corner whose position moved takes the vertex at its new position whose attributes
+        // are closest to the ones it had
+        auto closestVertex = [&](uint32_t vertex, uint32_t position) {
+            const Model::Vertex& original = vertices[vertex];
+            uint32_t best = sortedVertices[positionFirst[position]];
+            float bestDistance = std::numeric_limits<float>::max();
+            for (uint32_t i = positionFirst[position]; i < positionFirst[position + 1]; i++) {
+                const Model::Vertex& candidate = vertices[sortedVertices[i]];
+                const float distance =
+                    glm::length(candidate.normal - original.normal) +
+                    glm::length(candidate.uv - original.uv) +
+                    glm::length(candidate.color - original.color);
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = sortedVertices[i];
+                }
+            }
+            return best;
+        };
+
+        std::vector<uint32_t> result;
+        result.reserve(liveTriangles * 3);
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            if (!triangleAlive[t]) {
+                continue;
+            }
+            for (uint32_t k = 0; k < 3; k++) {
+                const uint32_t vertex = indices[3 * t + k];
+                const uint32_t position = find(positionOf[vertex]);
+                result.push_back(position == positionOf[vertex] ? vertex : closestVertex(vertex, position));
+            }
+        }
+        return result;
+    }
+} // namespace engine
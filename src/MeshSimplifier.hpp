@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Model.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace engine {
+
+    // Quadric error metric simplification (Garland and Heckbert). Every collapse moves one
+    // position onto a neighbouring one, cheapest first, so no vertices are created and the
+    // result indexes the same vertex array as the input. Vertices sharing a position but not
+    // their attributes move together. Open borders and attribute seams are held in place by
+    // constraint planes, and collapses that would flip a triangle are skipped, as are those
+    // moving the surface further than maxError (model units, root mean square over the planes
+    // around the collapse). Returns at most targetIndexCount indices if enough collapses
+    // stay within those limits, otherwise as few as it reached.
+    std::vector<uint32_t> simplifyMesh(
+        const std::vector<Model::Vertex>& vertices,
+        const std::vector<uint32_t>& indices,
+        uint32_t targetIndexCount,
+        float maxError);
+} // namespace engine
@@ -0,0 +1,250 @@
+#include "MeshletBuilder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
+
+namespace engine {
+
+    namespace {
+        constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+        // Cone of a meshlet that can always face the camera
+        const glm::vec4 NO_CONE{ 0.f, 0.f, 0.f, 1.f };
+
+        uint64_t edgeKey(uint32_t a, uint32_t b) {
+            return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+        }
+
+        // Closed when every edge between welded positions is shared by an even number of triangles
+        bool isClosed(const std::vector<uint32_t>& positionOf, const uint32_t* triangles, uint32_t triangleCount) {
+            std::unordered_map<uint64_t, uint32_t> edgeUses;
+            for (uint32_t t = 0; t < triangleCount; t++) {
+                for (uint32_t k = 0; k < 3; k++) {
+                    const uint32_t a = positionOf[triangles[3 * t + k]];
+                    const uint32_t b = positionOf[triangles[3 * t + (k + 1) % 3]];
+                    if (a != b) {
+                        edgeUses[edgeKey(a, b)]++;
+                    }
+                }
+            }
+            for (const auto& [edge, uses] : edgeUses) {
+                if (uses % 2 != 0) {
+                    return false;
+                }
+            }
+            return !edgeUses.empty();
+        }
+
+        void computeBounds(
+            const std::vector<Model::Vertex>& vertices,
+            const uint32_t* triangles,
+            uint32_t triangleCount,
+            bool buildCone,
+            Meshlet& meshlet) {
+            glm::vec3 min = vertices[triangles[0]].position;
+            glm::vec3 max = min;
+            for (uint32_t i = 0; i < triangleCount * 3; i++) {
+                min = glm::min(min, vertices[triangles[i]].position);
+                max = glm::max(max, vertices[triangles[i]].position);
+            }
+            const glm::vec3 center = (min + max) * .5f;
+            float radius = 0.f;
+            for (uint32_t i = 0; i < triangleCount * 3; i++) {
+                radius = std::max(radius, glm::distance(vertices[triangles[i]].position, center));
+            }
+            meshlet.sphere = glm::vec4(center, radius);
+            meshlet.cone = NO_CONE;
+            if (!buildCone) {
+                return;
+            }
+
+            // Counter-clockwise winding faces the cross product
+            std::vector<glm::vec3> normals;
+            normals.reserve(triangleCount);
+            glm::vec3 axis{ 0.f };
+            for (uint32_t t = 0; t < triangleCount; t++) {
+                const glm::vec3& p0 = vertices[triangles[3 * t + 0]].position;
+                const glm::vec3 normal = glm::cross(
+                    vertices[triangles[3 * t + 1]].position - p0, vertices[triangles[3 * t + 2]].position - p0);
+                const float length = glm::length(normal);
+                if (length > 0.f) {
+                    normals.push_back(normal / length);
+                    axis += normals.back();
+                }
+            }
+            const float axisLength = glm::length(axis);
+            if (axisLength <= 0.f) {
+                return;
+            }
+            axis /= axisLength;
+            float minDot = 1.f;
+            for (const glm::vec3& normal : normals) {
+                minDot = std::min(minDot, glm::dot(normal, axis));
+            }
+            // A spread of 90 degrees or more always has a triangle facing the camera
+            if (minDot <= 0.f) {
+                return;
+            }
+            meshlet.cone = glm::vec4(axis, std::sqrt(1.f - minDot * minDot));
+        }
+    } // namespace
+
+    std::vector<Meshlet> buildMeshlets(
+        const std::vector<Model::Vertex>& vertices,
+        std::vector<uint32_t>& indices,
+        uint32_t firstIndex,
+        uint32_t indexCount) {
+        const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+        const uint32_t triangleCount = indexCount / 3;
+        const uint32_t* triangles = indices.data() + firstIndex;
+        if (triangleCount == 0) {
+            return {};
+        }
+
+        // Vertices that differ only in attributes are neighbours too
+        std::vector<uint32_t> sortedVertices(vertexCount);
+        std::iota(sortedVertices.begin(), sortedVertices.end(), 0);
+        std::sort(sortedVertices.begin(), sortedVertices.end(), [&](uint32_t a, uint32_t b) {
+            const glm::vec3& pa = vertices[a].position;
+            const glm::vec3& pb = vertices[b].position;
+            return std::tie(pa.x, pa.y, pa.z) < std::tie(pb.x, pb.y, pb.z);
+        });
+        std::vector<uint32_t> positionOf(vertexCount);
+        uint32_t positionCount = 0;
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            if (i > 0 && vertices[sortedVertices[i]].position != vertices[sortedVertices[i - 1]].position) {
+                positionCount++;
+            }
+            positionOf[sortedVertices[i]] = positionCount;
+        }
+        positionCount++;
+
+        // Triangles around position p are adjacency[adjacencyFirst[p]] up to adjacencyFirst[p + 1]
+        std::vector<uint32_t> adjacencyFirst(positionCount + 1, 0);
+        for (uint32_t i = 0; i < triangleCount * 3; i++) {
+            adjacencyFirst[positionOf[triangles[i]] + 1]++;
+        }
+        std::partial_sum(adjacencyFirst.begin(), adjacencyFirst.end(), adjacencyFirst.begin());
+        std::vector<uint32_t> adjacency(triangleCount * 3);
+        std::vector<uint32_t> adjacencyFill(adjacencyFirst.begin(), adjacencyFirst.end() - 1);
+        std::vector<glm::vec3> centroids(triangleCount);
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            for (uint32_t k = 0; k < 3; k++) {
+                adjacency[adjacencyFill[positionOf[triangles[3 * t + k]]]++] = t;
+            }
+            centroids[t] = (vertices[triangles[3 * t + 0]].position +
+                vertices[triangles[3 * t + 1]].position +
+                vertices[triangles[3 * t + 2]].position) / 3.f;
+        }
+
+        std::vector<Meshlet> meshlets;
+        std::vector<uint32_t> ordered;
+        ordered.reserve(triangleCount * 3);
+        std::vector<uint32_t> meshletOf(triangleCount, NONE);
+        // Meshlet each vertex and position was last added to
+        std::vector<uint32_t> vertexStamp(vertexCount, NONE);
+        std::vector<uint32_t> positionStamp(positionCount, NONE);
+        std::vector<uint32_t> meshletPositions;
+        uint32_t scan = 0;
+        uint32_t next = NONE;
+
+        while (ordered.size() < triangleCount * 3) {
+            const uint32_t current = static_cast<uint32_t>(meshlets.size());
+            // Continue next to the last meshlet, or from the first triangle not yet placed
+            if (next == NONE) {
+                while (meshletOf[scan] != NONE) {
+                    scan++;
+                }
+                next = scan;
+            }
+            Meshlet meshlet{};
+            meshlet.firstIndex = firstIndex + static_cast<uint32_t>(ordered.size());
+            meshletPositions.clear();
+            uint32_t meshletVertices = 0;
+            uint32_t meshletTriangles = 0;
+            glm::vec3 centroidSum{ 0.f };
+
+            auto addedVertices = [&](uint32_t t) {
+                uint32_t added = 0;
+                for (uint32_t k = 0; k < 3; k++) {
+                    const uint32_t vertex = triangles[3 * t + k];
+                    const bool repeated = (k > 0 && triangles[3 * t] == vertex) ||
+                        (k > 1 && triangles[3 * t + 1] == vertex);
+                    if (vertexStamp[vertex] != current && !repeated) {
+                        added++;
+                    }
+                }
+                return added;
+            };
+
+            uint32_t candidate = next;
+            while (true) {
+                meshletOf[candidate] = current;
+                for (uint32_t k = 0; k < 3; k++) {
+                    const uint32_t vertex = triangles[3 * candidate + k];
+                    if (vertexStamp[vertex] != current) {
+                        vertexStamp[vertex] = current;
+                        meshletVertices++;
+                    }
+                    const uint32_t position = positionOf[vertex];
+                    if (positionStamp[position] != current) {
+                        positionStamp[position] = current;
+                        meshletPositions.push_back(position);
+                    }
+                    ordered.push_back(vertex);
+                }
+                centroidSum += centroids[candidate];
+                meshletTriangles++;
+
+                // Best neighbour that still fits, and the closest one that does not, which
+                // seeds the following meshlet
+                const glm::vec3 center = centroidSum / static_cast<float>(meshletTriangles);
+                uint32_t fit = NONE;
+                uint32_t fitAdded = 0;
+                float fitDistance = 0.f;
+                uint32_t overflow = NONE;
+                float overflowDistance = 0.f;
+                for (const uint32_t position : meshletPositions) {
+                    for (uint32_t a = adjacencyFirst[position]; a < adjacencyFirst[position + 1]; a++) {
+                        const uint32_t t = adjacency[a];
+                        if (meshletOf[t] != NONE) {
+                            continue;
+                        }
+                        const uint32_t added = addedVertices(t);
+                        const glm::vec3 offset = centroids[t] - center;
+                        const float distance = glm::dot(offset, offset);
+                        if (meshletVertices + added > MAX_MESHLET_VERTICES) {
+                            if (overflow == NONE || distance < overflowDistance) {
+                                overflow = t;
+                                overflowDistance = distance;
+                            }
+                        } else if (fit == NONE || added < fitAdded || (added == fitAdded && distance < fitDistance)) {
+                            fit = t;
+                            fitAdded = added;
+                            fitDistance = distance;
+                        }
+                    }
+                }
+                if (fit == NONE || meshletTriangles == MAX_MESHLET_TRIANGLES) {
+                    next = fit != NONE ? fit : overflow;
+                    break;
+                }
+                candidate = fit;
+            }
+
+            meshlet.indexCount = meshletTriangles * 3;
+            meshlets.push_back(meshlet);
+        }
+
+        std::copy(ordered.begin(), ordered.end(), indices.begin() + firstIndex);
+        const bool closed = isClosed(positionOf, triangles, triangleCount);
+        for (Meshlet& meshlet : meshlets) {
+            computeBounds(
+                vertices, indices.data() + meshlet.firstIndex, meshlet.indexCount / 3, closed, meshlet);
+        }
+        return meshlets;
+    }
+} // namespace engine
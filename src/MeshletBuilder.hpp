@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Model.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace engine {
+
+    static constexpr uint32_t MAX_MESHLET_VERTICES = 64;
+    static constexpr uint32_t MAX_MESHLET_TRIANGLES = 124;
+
+    // Splits indices[firstIndex, firstIndex + indexCount) into meshlets and reorders that range
+    // so each meshlet's triangles are contiguous; the range still draws the same triangles.
+    // Meshlets grow greedily through neighbouring triangles, preferring those that add the
+    // fewest vertices and then the closest ones, which keeps them compact. Normal cones are
+    // only built for closed meshes, since on an open one a back face can be the visible side.
+    std::vector<Meshlet> buildMeshlets(
+        const std::vector<Model::Vertex>& vertices,
+        std::vector<uint32_t>& indices,
+        uint32_t firstIndex,
+        uint32_t indexCount);
+} // namespace engine
@@ -1,4 +1,6 @@
 #include "Model.hpp"
+#include "MeshSimplifier.hpp"
+#include "MeshletBuilder.hpp"
 #include "utils.hpp"
 
 #define TINYOBJLOADER_IMPLEMENTATION
@@ -6,6 +8,7 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/hash.hpp>
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <unordered_map>
@@ -14,6 +17,14 @@
 #define ENGINE_DIR "../"
 #endif // !ENGINE_DIR
 
+namespace {
+	// A level keeping more than this share of the previous level's indices is not worth storing
+	constexpr float MIN_LOD_REDUCTION = 0.9f;
+	// Largest surface deviation of the first simplified level, as a share of the mesh's
+	// bounding radius. It doubles for each coarser level, which is drawn at half the size.
+	constexpr float LOD_MAX_ERROR = 0.01f;
+}
+
 namespace std {
 	template<> 
 	struct hash<engine::Model::Vertex> {
@@ -60,11 +71,44 @@ namespace engine {
 		return attributeDescriptions;
 	}
 
-	Model::Model(Device& device, const Model::Builder& builder) : m_device{ device } {
+	Model::Model(Device& device, const Model::Builder& builder) : m_device{ &device } {
 		createVertexBuffers(builder.vertices);
 		createIndexBuffers(builder.indices);
 		m_vertices = builder.vertices;
 		m_indices = builder.indices;
+		createLods(builder.lods);
+		m_meshlets = builder.meshlets;
+		m_bbox = createBoundingBox();
+		m_bsphere = createBoundingSphere();
+	}
+
+	Model::Model(MeshPool& meshPool, const Model::Builder& builder) : m_meshPool{ &meshPool } {
+		m_vertices = builder.vertices;
+		m_indices = builder.indices;
+		if (m_indices.empty()) {
+			m_indices.resize(m_vertices.size());
+			for (uint32_t i = 0; i < m_indices.size(); i++) {
+				m_indices[i] = i;
+			}
+		}
+		vertexCount = static_cast<uint32_t>(m_vertices.size());
+		indexCount = static_cast<uint32_t>(m_indices.size());
+		hasIndexBuffer = true;
+		createLods(builder.lods);
+		m_meshlets = builder.meshlets;
+		m_meshAllocation = meshPool.allocate(m_vertices.data(), vertexCount, m_indices.data(), indexCount);
+		m_bbox = createBoundingBox();
+		m_bsphere = createBoundingSphere();
+	}
+
+	Model::Model(const Model::Builder& builder) {
+		vertexCount = static_cast<uint32_t>(builder.vertices.size());
+		indexCount = static_cast<uint32_t>(builder.indices.size());
+		hasIndexBuffer = false;
+		m_vertices = builder.vertices;
+		m_indices = builder.indices;
+		createLods(builder.lods);
+		m_meshlets = builder.meshlets;
 		m_bbox = createBoundingBox();
 		m_bsphere = createBoundingSphere();
 	}
@@ -72,14 +116,27 @@ namespace engine {
 	Model::~Model() {}
 
 	std::unique_ptr<Model> Model::createModelFromFile(
-		Device& device, const std::string& filepath
+		Device& device, const std::string& filepath, uint32_t lodCount
 	) {
 		Builder builder{};
 		std::string enginePath = ENGINE_DIR + filepath;
 		builder.loadModel(enginePath);
+		builder.generateLods(lodCount);
+		builder.buildMeshlets();
 		return std::make_unique<Model>(device, builder);
 	}
 
+	std::unique_ptr<Model> Model::createModelFromFile(
+		MeshPool& meshPool, const std::string& filepath, uint32_t lodCount
+	) {
+		Builder builder{};
+		std::string enginePath = ENGINE_DIR + filepath;
+		builder.loadModel(enginePath);
+		builder.generateLods(lodCount);
+		builder.buildMeshlets();
+		return std::make_unique<Model>(meshPool, builder);
+	}
+
 	void Model::createVertexBuffers(const std::vector<Vertex>& vertices) {
 		vertexCount = static_cast<uint32_t>(vertices.size());
 		assert(vertexCount >= 3 && "Vertex count must be at least 3");
@@ -87,7 +144,7 @@ namespace engine {
 		uint32_t vertexSize = sizeof(vertices[0]);
 
 		Buffer stagingBuffer{
-			m_device,
+			*m_device,
 			vertexSize,
 			vertexCount,
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
@@ -98,14 +155,14 @@ namespace engine {
 		stagingBuffer.writeToBuffer((void*)vertices.data());
 
 		vertexBuffer = std::make_unique<Buffer>(
-			m_device,
+			*m_device,
 			vertexSize,
 			vertexCount,
 			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
 			);
 
-		m_device.copyBuffer(
+		m_device->copyBuffer(
 			stagingBuffer.getBuffer(),
 			vertexBuffer->getBuffer(),
 			bufferSize
@@ -122,7 +179,7 @@ namespace engine {
 		uint32_t indexSize = sizeof(indices[0]);
 
 		Buffer stagingBuffer{
-			m_device,
+			*m_device,
 			indexSize,
 			indexCount,
 			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
@@ -133,21 +190,36 @@ namespace engine {
 		stagingBuffer.writeToBuffer((void*)indices.data());
 
 		indexBuffer = std::make_unique<Buffer>(
-			m_device,
+			*m_device,
 			indexSize,
 			indexCount,
 			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
 			);
 
-		m_device.copyBuffer(
+		m_device->copyBuffer(
 			stagingBuffer.getBuffer(),
 			indexBuffer->getBuffer(),
 			bufferSize
 		);
 	}
 
+	void Model::createLods(const std::vector<MeshLod>& lods) {
+		m_lods = lods;
+		if (m_lods.empty()) {
+			m_lods.push_back({ 0, static_cast<uint32_t>(m_indices.size()) });
+		}
+		for (const MeshLod& lod : m_lods) {
+			assert(lod.firstIndex + lod.indexCount <= m_indices.size() && "Level of detail out of index range");
+		}
+	}
+
 	void Model::bind(VkCommandBuffer commandBuffer) {
+		if (m_meshPool != nullptr) {
+			m_meshPool->bind(commandBuffer);
+			return;
+		}
+		assert(vertexBuffer && "Cannot bind a model created without a device");
 		VkBuffer buffers[] = { vertexBuffer->getBuffer()};
 		VkDeviceSize offsets[] = { 0 };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
@@ -156,15 +228,27 @@ namespace engine {
 		}
 	}
 
-	void Model::draw(VkCommandBuffer commandBuffer) {
+	void Model::draw(VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance, uint32_t lod) {
 		if (hasIndexBuffer) {
-			vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+			vkCmdDrawIndexed(
+				commandBuffer,
+				getIndexCount(lod),
+				instanceCount,
+				getFirstIndex(lod),
+				m_meshAllocation.vertexOffset,
+				firstInstance);
 		}
 		else {
-			vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+			vkCmdDraw(commandBuffer, vertexCount, instanceCount, 0, firstInstance);
 		}
 	}
 
+	void Model::drawIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount) {
+		assert(hasIndexBuffer && "Indirect draws require an index buffer");
+		assert((drawCount == 1 || m_meshPool != nullptr) && "Multi-draws need pooled models");
+		vkCmdDrawIndexedIndirect(commandBuffer, buffer, offset, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+	}
+
 	void Model::Builder::loadModel(const std::string& filepath) {
 		tinyobj::attrib_t attrib;
 		std::vector<tinyobj::shape_t> shapes;
@@ -220,6 +304,47 @@ namespace engine {
 		}
 	}
 
+	void Model::Builder::generateLods(uint32_t lodCount, float reduction) {
+		lods.clear();
+		if (lodCount <= 1 || indices.empty()) {
+			return;
+		}
+		lods.push_back({ 0, static_cast<uint32_t>(indices.size()) });
+
+		glm::vec3 min = vertices.front().position;
+		glm::vec3 max = min;
+		for (const Vertex& vertex : vertices) {
+			min = glm::min(min, vertex.position);
+			max = glm::max(max, vertex.position);
+		}
+		float maxError = LOD_MAX_ERROR * 0.5f * glm::length(max - min);
+
+		std::vector<uint32_t> previous = indices;
+		while (lods.size() < lodCount) {
+			const uint32_t target = static_cast<uint32_t>(previous.size() / 3 * reduction) * 3;
+			std::vector<uint32_t> simplified = simplifyMesh(vertices, previous, target, maxError);
+			if (simplified.empty() || simplified.size() > previous.size() * MIN_LOD_REDUCTION) {
+				break;
+			}
+			lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(simplified.size()) });
+			indices.insert(indices.end(), simplified.begin(), simplified.end());
+			previous = std::move(simplified);
+			maxError *= 2.0f;
+		}
+		if (lods.size() == 1) {
+			lods.clear();
+		}
+	}
+
+	void Model::Builder::buildMeshlets() {
+		const MeshLod full = lods.empty() ? MeshLod{ 0, static_cast<uint32_t>(indices.size()) } : lods[0];
+		if (full.indexCount / 3 < MESHLET_MIN_TRIANGLES) {
+			meshlets.clear();
+			return;
+		}
+		meshlets = engine::buildMeshlets(vertices, indices, full.firstIndex, full.indexCount);
+	}
+
 	BoundingBox Model::createBoundingBox() const {
 		BoundingBox bbox;
 		if (m_vertices.empty()) {
@@ -227,11 +352,10 @@ namespace engine {
 			return bbox;
 		}
 
-		int i = 0;
+		bbox.min = bbox.max = m_vertices.front().position;
 		for (const auto& vertice: m_vertices) {
 			bbox.min = glm::min(bbox.min, vertice.position);
 			bbox.max = glm::max(bbox.max, vertice.position);
-			i++;
 		}
 		return bbox;
 	}
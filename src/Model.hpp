@@ -3,6 +3,7 @@
 #include "Buffer.hpp"
 #include "Image.hpp"
 #include "Descriptors.hpp"
+#include "MeshPool.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -28,8 +29,29 @@ namespace engine {
 		float radius;
 	};
 
+	// One level of detail: a run of the model's indices, relative to its first index.
+	// Every level indexes the same vertices.
+	struct MeshLod {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
+	// A small cluster of the full detail level's triangles, culled on its own by the GPU
+	struct Meshlet {
+		// xyz center and w radius of a sphere around the triangles, in model space
+		glm::vec4 sphere;
+		// xyz unit axis the front faces point around and w the sine of their widest angle
+		// to it; w is 1 when some triangle may always face the camera
+		glm::vec4 cone;
+		// Relative to the model's first index, like MeshLod
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+
 	class Model {
 	public:
+		// Smaller meshes are cheap enough to cull whole
+		static constexpr uint32_t MESHLET_MIN_TRIANGLES = 1024;
 
 		struct Vertex {
 			glm::vec3 position;
@@ -49,33 +71,74 @@ namespace engine {
 		struct Builder {
 			std::vector<Vertex> vertices{};
 			std::vector<uint32_t> indices{};
+			// Empty means a single level covering all indices
+			std::vector<MeshLod> lods{};
+			// Cover level 0 only; coarser levels are drawn whole
+			std::vector<Meshlet> meshlets{};
 
 			void loadModel(const std::string& filepath);
+			// Appends up to lodCount - 1 simplified levels to indices, each keeping about
+			// reduction of the triangles of the one before. Stops early once a level no
+			// longer shrinks, so small meshes may end up with fewer levels.
+			void generateLods(uint32_t lodCount, float reduction = 0.5f);
+			// Reorders level 0 into meshlets if it has at least MESHLET_MIN_TRIANGLES triangles
+			void buildMeshlets();
 		};
 
 		Model(Device& device, const Model::Builder& builder);
+		// Pooled model: suballocates its vertices and indices from a shared MeshPool
+		Model(MeshPool& meshPool, const Model::Builder& builder);
+		// CPU-only model: keeps the mesh and its bounds but creates no GPU buffers
+		explicit Model(const Model::Builder& builder);
 		~Model();
 
 		Model(const Model&) = delete;
 		Model& operator=(const Model&) = delete;
 
+		// lodCount above 1 generates simplified levels of detail at load time; dense meshes
+		// are also split into meshlets
+		static std::unique_ptr<Model> createModelFromFile(
+			Device& device, const std::string& filepath, uint32_t lodCount = 1);
 		static std::unique_ptr<Model> createModelFromFile(
-			Device& device, const std::string& filepath);
+			MeshPool& meshPool, const std::string& filepath, uint32_t lodCount = 1);
 
 		void bind(VkCommandBuffer commandBuffer);
-		void draw(VkCommandBuffer commandBuffer);
+		void draw(VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0, uint32_t lod = 0);
+		// Draws drawCount consecutive VkDrawIndexedIndirectCommands starting at offset in buffer.
+		// Indexed models only; more than one draw needs every command to target the same MeshPool.
+		void drawIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount = 1);
 		// void drawTexture(VkDescriptorSet set, DescriptorSetLayout& setLayout, DescriptorPool& pool);
 
 		BoundingBox getBoundingBox() const { return m_bbox; };
 		BoundingSphere getBoundingSphere() const { return m_bsphere; };
+		// Level 0 is the full mesh, higher levels are coarser
+		uint32_t getLodCount() const { return static_cast<uint32_t>(m_lods.size()); }
+		const MeshLod& getLod(uint32_t lod) const { return m_lods[lod]; }
+		uint32_t getIndexCount(uint32_t lod = 0) const { return hasIndexBuffer ? m_lods[lod].indexCount : 0; }
+		uint32_t getFirstIndex(uint32_t lod = 0) const { return m_meshAllocation.firstIndex + m_lods[lod].firstIndex; }
+		// CPU copy of the mesh, for software rasterization; indices are empty for unindexed
+		// device-owned models
+		const std::vector<Vertex>& getVertices() const { return m_vertices; }
+		const std::vector<uint32_t>& getIndices() const { return m_indices; }
+		// Empty unless the builder built them
+		const std::vector<Meshlet>& getMeshlets() const { return m_meshlets; }
+		uint32_t getFirstIndex(const Meshlet& meshlet) const { return m_meshAllocation.firstIndex + meshlet.firstIndex; }
+		int32_t getVertexOffset() const { return m_meshAllocation.vertexOffset; }
+		// Null for models that own their buffers; all models of one pool share a single bind
+		const MeshPool* getMeshPool() const { return m_meshPool; }
 	private:
 		void createVertexBuffers(const std::vector<Vertex>& vertices);
 		void createIndexBuffers(const std::vector<uint32_t>& indices);
+		void createLods(const std::vector<MeshLod>& lods);
 		BoundingBox createBoundingBox() const;
 		BoundingSphere createBoundingSphere() const;
-		Device& m_device;
+		Device* m_device = nullptr;
+		MeshPool* m_meshPool = nullptr;
+		MeshAllocation m_meshAllocation{};
 		std::vector<Vertex> m_vertices{};
 		std::vector<uint32_t> m_indices{};
+		std::vector<MeshLod> m_lods{};
+		std::vector<Meshlet> m_meshlets{};
 		BoundingBox m_bbox;
 		BoundingSphere m_bsphere;
 
@@ -12,18 +12,43 @@
 
 namespace engine {
 
+	ShaderModule::ShaderModule(Device& device, const std::vector<char>& code) : m_device{ device } {
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = code.size();
+		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+		if (vkCreateShaderModule(m_device.device(), &createInfo, nullptr, &m_shaderModule) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create shader module");
+		}
+	}
+
+	ShaderModule::~ShaderModule() {
+		vkDestroyShaderModule(m_device.device(), m_shaderModule, nullptr);
+	}
+
 	Pipeline::Pipeline(
 		Device& device,
 		const std::string& vertFilepath,
 		const std::string& fragFilepath,
 		const PipelineConfigInfo& configInfo
-	) : m_device{ device } {
-		createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
+	) : Pipeline{
+		device,
+		std::make_shared<ShaderModule>(device, readFile(vertFilepath)),
+		fragFilepath.empty() ? nullptr : std::make_shared<ShaderModule>(device, readFile(fragFilepath)),
+		configInfo } {}
+
+	Pipeline::Pipeline(
+		Device& device,
+		std::shared_ptr<ShaderModule> vertShader,
+		std::shared_ptr<ShaderModule> fragShader,
+		const PipelineConfigInfo& configInfo
+	) : m_device{ device }, vertShaderModule{ std::move(vertShader) }, fragShaderModule{ std::move(fragShader) } {
+		createGraphicsPipeline(configInfo);
 	}
 
 	Pipeline::~Pipeline() {
-		vkDestroyShaderModule(m_device.device(), vertShaderModule, nullptr);
-		vkDestroyShaderModule(m_device.device(), fragShaderModule, nullptr);
+		// The shader modules go away with the last pipeline holding them
 		vkDestroyPipeline(m_device.device(), graphicsPipeline, nullptr);
 	}
 
@@ -49,39 +74,37 @@ namespace engine {
 		return buffer;
 	}
 
-	void Pipeline::createGraphicsPipeline(
-		const std::string& vertFilepath,
-		const std::string& fragFilepath,
-		const PipelineConfigInfo& configInfo
-	) {
+	void Pipeline::createGraphicsPipeline(const PipelineConfigInfo& configInfo) {
 		assert(configInfo.pipelineLayout != VK_NULL_HANDLE &&
 			"Cannot create graphics pipeline: no pipelineLayout provided in configInfo");
 		assert(configInfo.renderPass != VK_NULL_HANDLE &&
 			"Cannot create graphics pipeline: no renderPass provided in configInfo");
 
-		auto vertCode = readFile(vertFilepath);
-		auto fragCode = readFile(fragFilepath);
-
-		createShaderModule(vertCode, &vertShaderModule);
-		createShaderModule(fragCode, &fragShaderModule);
+		VkSpecializationInfo specializationInfo{};
+		specializationInfo.mapEntryCount = static_cast<uint32_t>(configInfo.specializationEntries.size());
+		specializationInfo.pMapEntries = configInfo.specializationEntries.data();
+		specializationInfo.dataSize = configInfo.specializationData.size() * sizeof(uint32_t);
+		specializationInfo.pData = configInfo.specializationData.data();
+		const VkSpecializationInfo* pSpecializationInfo =
+			configInfo.specializationEntries.empty() ? nullptr : &specializationInfo;
 
 		VkPipelineShaderStageCreateInfo shaderStages[2];
 
 		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		shaderStages[0].module = vertShaderModule;
+		shaderStages[0].module = vertShaderModule->getShaderModule();
 		shaderStages[0].pName = "main";
 		shaderStages[0].flags = 0;
 		shaderStages[0].pNext = nullptr;
-		shaderStages[0].pSpecializationInfo = nullptr;
+		shaderStages[0].pSpecializationInfo = pSpecializationInfo;
 
 		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		shaderStages[1].module = fragShaderModule;
+		shaderStages[1].module = fragShaderModule ? fragShaderModule->getShaderModule() : VK_NULL_HANDLE;
 		shaderStages[1].pName = "main";
 		shaderStages[1].flags = 0;
 		shaderStages[1].pNext = nullptr;
-		shaderStages[1].pSpecializationInfo = nullptr;
+		shaderStages[1].pSpecializationInfo = pSpecializationInfo;
 
 		auto& bindingDescriptions = configInfo.bindingDescriptions;
 		auto& attributeDescriptions = configInfo.attributeDescriptions;
@@ -92,16 +115,23 @@ namespace engine {
 		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 		vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
 
+		std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(
+			configInfo.colorAttachmentCount, configInfo.colorBlendAttachment);
+		VkPipelineColorBlendStateCreateInfo colorBlendInfo = configInfo.colorBlendInfo;
+		colorBlendInfo.attachmentCount = configInfo.colorAttachmentCount;
+		colorBlendInfo.pAttachments = colorBlendAttachments.data();
+
 		VkGraphicsPipelineCreateInfo pipelineInfo{};
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2;
+		// Without a fragment stage only depth is written
+		pipelineInfo.stageCount = fragShaderModule ? 2 : 1;
 		pipelineInfo.pStages = shaderStages;
 		pipelineInfo.pVertexInputState = &vertexInputInfo;
 		pipelineInfo.pInputAssemblyState = &configInfo.inputAssemblyInfo;
 		pipelineInfo.pViewportState = &configInfo.viewPortInfo;
 		pipelineInfo.pRasterizationState = &configInfo.rasterizationInfo;
 		pipelineInfo.pMultisampleState = &configInfo.multisampleInfo;
-		pipelineInfo.pColorBlendState = &configInfo.colorBlendInfo;
+		pipelineInfo.pColorBlendState = &colorBlendInfo;
 		pipelineInfo.pDepthStencilState = &configInfo.depthStencilInfo;
 		pipelineInfo.pDynamicState = &configInfo.dynamicStateInfo;
 
@@ -114,7 +144,7 @@ namespace engine {
 
 		if (vkCreateGraphicsPipelines(
 			m_device.device(),
-			VK_NULL_HANDLE,
+			m_device.getPipelineCache(),
 			1,
 			&pipelineInfo,
 			nullptr,
@@ -125,20 +155,6 @@ namespace engine {
 
 	}
 
-	void Pipeline::createShaderModule(
-		const std::vector<char>& code, 
-		VkShaderModule* shaderModule
-	) {
-		VkShaderModuleCreateInfo createInfo{};
-		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-		createInfo.codeSize = code.size();
-		createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-		if (vkCreateShaderModule(m_device.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create shader module");
-		}
-	}
-
 	void Pipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
 
 		configInfo.inputAssemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -226,4 +242,79 @@ namespace engine {
 		configInfo.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;  // Optional
 		configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;              // Optional
 	}
+
+	void Pipeline::enableAdditiveBlending(PipelineConfigInfo& configInfo) {
+		configInfo.colorBlendAttachment.blendEnable = VK_TRUE;
+		configInfo.colorBlendAttachment.colorWriteMask =
+			VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT |
+			VK_COLOR_COMPONENT_A_BIT;
+		configInfo.colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		configInfo.colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		configInfo.colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+		configInfo.colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		configInfo.colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		configInfo.colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	}
+
+	void Pipeline::setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, uint32_t value) {
+		for (const auto& entry : configInfo.specializationEntries) {
+			if (entry.constantID == constantId) {
+				configInfo.specializationData[entry.offset / sizeof(uint32_t)] = value;
+				return;
+			}
+		}
+		VkSpecializationMapEntry entry{};
+		entry.constantID = constantId;
+		entry.offset = static_cast<uint32_t>(configInfo.specializationData.size() * sizeof(uint32_t));
+		entry.size = sizeof(uint32_t);
+		configInfo.specializationEntries.push_back(entry);
+		configInfo.specializationData.push_back(value);
+	}
+
+	ComputePipeline::ComputePipeline(
+		Device& device,
+		const std::string& compFilepath,
+		VkPipelineLayout pipelineLayout
+	) : ComputePipeline{
+		device,
+		std::make_shared<ShaderModule>(device, Pipeline::readFile(compFilepath)),
+		pipelineLayout } {}
+
+	ComputePipeline::ComputePipeline(
+		Device& device,
+		std::shared_ptr<ShaderModule> compShader,
+		VkPipelineLayout pipelineLayout
+	) : m_device{ device }, compShaderModule{ std::move(compShader) } {
+		assert(pipelineLayout != VK_NULL_HANDLE &&
+			"Cannot create compute pipeline: no pipelineLayout provided");
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = compShaderModule->getShaderModule();
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.basePipelineIndex = -1;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+		if (vkCreateComputePipelines(
+			m_device.device(),
+			m_device.getPipelineCache(),
+			1,
+			&pipelineInfo,
+			nullptr,
+			&computePipeline
+		) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline");
+		}
+	}
+
+	ComputePipeline::~ComputePipeline() {
+		vkDestroyPipeline(m_device.device(), computePipeline, nullptr);
+	}
+
+	void ComputePipeline::bind(VkCommandBuffer commandBuffer) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+	}
 } //namespace engine
@@ -2,6 +2,7 @@
 
 #include "Device.hpp"
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -20,14 +21,38 @@ namespace engine {
 		VkPipelineMultisampleStateCreateInfo multisampleInfo;
 		VkPipelineColorBlendAttachmentState colorBlendAttachment;
 		VkPipelineColorBlendStateCreateInfo colorBlendInfo;
+		// Color attachments of the subpass, all blended with colorBlendAttachment
+		uint32_t colorAttachmentCount = 1;
 		VkPipelineDepthStencilStateCreateInfo depthStencilInfo;
 		std::vector<VkDynamicState> dynamicStateEnables;
 		VkPipelineDynamicStateCreateInfo dynamicStateInfo;
 		VkPipelineLayout pipelineLayout = nullptr;
 		VkRenderPass renderPass = nullptr;
 		uint32_t subpass = 0;
+		// Specialization constants, given to every stage; stages ignore ids they do not declare
+		std::vector<VkSpecializationMapEntry> specializationEntries{};
+		std::vector<uint32_t> specializationData{};
 	};
 
+	// Owns one VkShaderModule, shared by every pipeline built from the same SPIR-V
+	class ShaderModule
+	{
+	public:
+		ShaderModule(Device& device, const std::vector<char>& code);
+		~ShaderModule();
+
+		ShaderModule(const ShaderModule&) = delete;
+		ShaderModule& operator=(const ShaderModule&) = delete;
+
+		VkShaderModule getShaderModule() const { return m_shaderModule; }
+
+	private:
+		Device& m_device;
+		VkShaderModule m_shaderModule;
+	};
+
+	// An empty fragFilepath (or null fragShader) builds a pipeline with only a vertex stage,
+	// for passes that write nothing but depth
 	class Pipeline
 	{
 	public:
@@ -36,6 +61,12 @@ namespace engine {
 			const std::string& vertFilepath,
 			const std::string& fragFilepath,
 			const PipelineConfigInfo& config);
+		// Builds from modules that may already be in use by other pipelines
+		Pipeline(
+			Device& device,
+			std::shared_ptr<ShaderModule> vertShader,
+			std::shared_ptr<ShaderModule> fragShader,
+			const PipelineConfigInfo& config);
 		~Pipeline();
 
 		Pipeline(const Pipeline&) = delete;
@@ -44,20 +75,43 @@ namespace engine {
 		void bind(VkCommandBuffer commandBuffer);
 		static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
 		static void enableAlphaBlending(PipelineConfigInfo& configInfo);
-
-	private:
+		// Adds color to what is already in the attachment, for accumulating light
+		static void enableAdditiveBlending(PipelineConfigInfo& configInfo);
+		// Sets a 32-bit constant_id in the shaders; pass VK_TRUE/VK_FALSE for bool constants
+		static void setSpecializationConstant(PipelineConfigInfo& configInfo, uint32_t constantId, uint32_t value);
+		// Reads a file relative to ENGINE_DIR
 		static std::vector<char> readFile(const std::string& filepath);
 
-		void createGraphicsPipeline(
-			const std::string& vertFilepath,
-			const std::string& fragFilepath,
-			const PipelineConfigInfo& config);
-
-		void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+	private:
+		void createGraphicsPipeline(const PipelineConfigInfo& config);
 		
 		Device& m_device;
 		VkPipeline graphicsPipeline;
-		VkShaderModule vertShaderModule;
-		VkShaderModule fragShaderModule;
+		std::shared_ptr<ShaderModule> vertShaderModule;
+		std::shared_ptr<ShaderModule> fragShaderModule;
+	};
+
+	class ComputePipeline
+	{
+	public:
+		ComputePipeline(
+			Device& device,
+			const std::string& compFilepath,
+			VkPipelineLayout pipelineLayout);
+		ComputePipeline(
+			Device& device,
+			std::shared_ptr<ShaderModule> compShader,
+			VkPipelineLayout pipelineLayout);
+		~ComputePipeline();
+
+		ComputePipeline(const ComputePipeline&) = delete;
+		ComputePipeline& operator=(const ComputePipeline&) = delete;
+
+		void bind(VkCommandBuffer commandBuffer);
+
+	private:
+		Device& m_device;
+		VkPipeline computePipeline;
+		std::shared_ptr<ShaderModule> compShaderModule;
 	};
 } //namespace engine
@@ -0,0 +1,42 @@
+#include "PipelineBuildQueue.hpp"
+
+namespace engine {
+
+    PipelineBuildQueue::PipelineBuildQueue(PipelineRegistry& registry, JobPool& jobPool)
+        : m_registry{ registry }, m_jobPool{ jobPool } {}
+
+    PipelineBuildQueue::~PipelineBuildQueue() {
+        waitIdle();
+    }
+
+    std::future<std::shared_ptr<Pipeline>> PipelineBuildQueue::submit(
+        const std::string& vertFilepath,
+        const std::string& fragFilepath,
+        std::unique_ptr<PipelineConfigInfo> config) {
+        // std::function needs a copyable target, so the move-only task sits behind a shared_ptr
+        auto task = std::make_shared<std::packaged_task<std::shared_ptr<Pipeline>()>>(
+            [this, vertFilepath, fragFilepath, config = std::shared_ptr<PipelineConfigInfo>(std::move(config))] {
+                return m_registry.getPipeline(vertFilepath, fragFilepath, *config);
+            });
+        auto future = task->get_future();
+        // packaged_task stores any exception in the future instead of throwing on the worker
+        m_jobPool.submit([task] { (*task)(); });
+        return future;
+    }
+
+    std::future<std::shared_ptr<ComputePipeline>> PipelineBuildQueue::submitCompute(
+        const std::string& compFilepath,
+        VkPipelineLayout pipelineLayout) {
+        auto task = std::make_shared<std::packaged_task<std::shared_ptr<ComputePipeline>()>>(
+            [this, compFilepath, pipelineLayout] {
+                return m_registry.getComputePipeline(compFilepath, pipelineLayout);
+            });
+        auto future = task->get_future();
+        m_jobPool.submit([task] { (*task)(); });
+        return future;
+    }
+
+    void PipelineBuildQueue::waitIdle() {
+        m_jobPool.waitIdle();
+    }
+} // namespace engine
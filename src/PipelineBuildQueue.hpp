@@ -0,0 +1,46 @@
+#pragma once
+
+#include "JobPool.hpp"
+#include "PipelineRegistry.hpp"
+
+#include <algorithm>
+#include <future>
+#include <memory>
+
+namespace engine {
+
+    // Compiles pipelines as background tasks on a JobPool's threads. Reading SPIR-V, creating shader modules
+    // and vkCreate*Pipelines all run off the calling thread, and several pipelines compile at
+    // once; the pipeline cache is internally synchronized, so they can all share it. Builds go
+    // through the registry, so a pipeline another system already holds is shared, not rebuilt.
+    // Exceptions thrown while building surface from the returned future's get().
+    class PipelineBuildQueue {
+    public:
+        PipelineBuildQueue(PipelineRegistry& registry, JobPool& jobPool);
+        // Finishes every submitted job, which all refer to the queue
+        ~PipelineBuildQueue();
+
+        PipelineBuildQueue(const PipelineBuildQueue&) = delete;
+        PipelineBuildQueue& operator=(const PipelineBuildQueue&) = delete;
+
+        // The config is heap allocated because PipelineConfigInfo points into itself and
+        // cannot be copied; the job owns it until the pipeline is built
+        std::future<std::shared_ptr<Pipeline>> submit(
+            const std::string& vertFilepath,
+            const std::string& fragFilepath,
+            std::unique_ptr<PipelineConfigInfo> config);
+        std::future<std::shared_ptr<ComputePipeline>> submitCompute(
+            const std::string& compFilepath,
+            VkPipelineLayout pipelineLayout);
+
+        // Blocks until every submitted pipeline has been built
+        void waitIdle();
+
+        // Threads compiling at once, at least one: without any the calling thread builds
+        uint32_t getWorkerCount() const { return std::max(m_jobPool.getThreadCount(), 1u); }
+
+    private:
+        PipelineRegistry& m_registry;
+        JobPool& m_jobPool;
+    };
+} // namespace engine
@@ -0,0 +1,246 @@
+#include "PipelineRegistry.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace engine {
+
+    namespace {
+        // Appends fields to a key exactly, so equal keys always mean equal pipelines
+        class KeyWriter {
+        public:
+            explicit KeyWriter(std::vector<uint64_t>& key) : m_key{ key } {}
+
+            void add(uint64_t value) { m_key.push_back(value); }
+            void add(float value) {
+                uint32_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                m_key.push_back(bits);
+            }
+            void add(const std::string& value) { addBytes(value.data(), value.size()); }
+            void add(const std::vector<char>& value) { addBytes(value.data(), value.size()); }
+            template <typename Handle>
+            void addHandle(Handle handle) {
+                uint64_t bits = 0;
+                std::memcpy(&bits, &handle, sizeof(handle));
+                m_key.push_back(bits);
+            }
+            void add(const VkStencilOpState& state) {
+                add(static_cast<uint64_t>(state.failOp));
+                add(static_cast<uint64_t>(state.passOp));
+                add(static_cast<uint64_t>(state.depthFailOp));
+                add(static_cast<uint64_t>(state.compareOp));
+                add(static_cast<uint64_t>(state.compareMask));
+                add(static_cast<uint64_t>(state.writeMask));
+                add(static_cast<uint64_t>(state.reference));
+            }
+
+        private:
+            // Length first, so runs of different lengths never compare equal
+            void addBytes(const char* data, size_t size) {
+                m_key.push_back(size);
+                for (size_t i = 0; i < size; i += sizeof(uint64_t)) {
+                    uint64_t chunk = 0;
+                    std::memcpy(&chunk, data + i, std::min(sizeof(uint64_t), size - i));
+                    m_key.push_back(chunk);
+                }
+            }
+
+            std::vector<uint64_t>& m_key;
+        };
+    } // namespace
+
+    size_t PipelineRegistry::KeyHash::operator()(const Key& key) const {
+        size_t hash = key.size();
+        for (uint64_t value : key) {
+            hash ^= static_cast<size_t>(value) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+        }
+        return hash;
+    }
+
+    PipelineRegistry::Key PipelineRegistry::makePipelineKey(
+        const std::string& vertFilepath,
+        const std::string& fragFilepath,
+        const PipelineConfigInfo& config) {
+        Key key;
+        KeyWriter writer{ key };
+        writer.add(vertFilepath);
+        writer.add(fragFilepath);
+
+        writer.add(static_cast<uint64_t>(config.bindingDescriptions.size()));
+        for (const auto& binding : config.bindingDescriptions) {
+            writer.add(static_cast<uint64_t>(binding.binding));
+            writer.add(static_cast<uint64_t>(binding.stride));
+            writer.add(static_cast<uint64_t>(binding.inputRate));
+        }
+        writer.add(static_cast<uint64_t>(config.attributeDescriptions.size()));
+        for (const auto& attribute : config.attributeDescriptions) {
+            writer.add(static_cast<uint64_t>(attribute.location));
+            writer.add(static_cast<uint64_t>(attribute.binding));
+            writer.add(static_cast<uint64_t>(attribute.format));
+            writer.add(static_cast<uint64_t>(attribute.offset));
+        }
+
+        writer.add(static_cast<uint64_t>(config.viewPortInfo.viewportCount));
+        writer.add(static_cast<uint64_t>(config.viewPortInfo.scissorCount));
+
+        writer.add(static_cast<uint64_t>(config.inputAssemblyInfo.topology));
+        writer.add(static_cast<uint64_t>(config.inputAssemblyInfo.primitiveRestartEnable));
+
+        const auto& raster = config.rasterizationInfo;
+        writer.add(static_cast<uint64_t>(raster.depthClampEnable));
+        writer.add(static_cast<uint64_t>(raster.rasterizerDiscardEnable));
+        writer.add(static_cast<uint64_t>(raster.polygonMode));
+        writer.add(static_cast<uint64_t>(raster.cullMode));
+        writer.add(static_cast<uint64_t>(raster.frontFace));
+        writer.add(static_cast<uint64_t>(raster.depthBiasEnable));
+        writer.add(raster.depthBiasConstantFactor);
+        writer.add(raster.depthBiasClamp);
+        writer.add(raster.depthBiasSlopeFactor);
+        writer.add(raster.lineWidth);
+
+        const auto& multisample = config.multisampleInfo;
+        writer.add(static_cast<uint64_t>(multisample.rasterizationSamples));
+        writer.add(static_cast<uint64_t>(multisample.sampleShadingEnable));
+        writer.add(multisample.minSampleShading);
+        writer.add(static_cast<uint64_t>(multisample.alphaToCoverageEnable));
+        writer.add(static_cast<uint64_t>(multisample.alphaToOneEnable));
+
+        const auto& blend = config.colorBlendAttachment;
+        writer.add(static_cast<uint64_t>(blend.blendEnable));
+        writer.add(static_cast<uint64_t>(blend.srcColorBlendFactor));
+        writer.add(static_cast<uint64_t>(blend.dstColorBlendFactor));
+        writer.add(static_cast<uint64_t>(blend.colorBlendOp));
+        writer.add(static_cast<uint64_t>(blend.srcAlphaBlendFactor));
+        writer.add(static_cast<uint64_t>(blend.dstAlphaBlendFactor));
+        writer.add(static_cast<uint64_t>(blend.alphaBlendOp));
+        writer.add(static_cast<uint64_t>(blend.colorWriteMask));
+        writer.add(static_cast<uint64_t>(config.colorBlendInfo.logicOpEnable));
+        writer.add(static_cast<uint64_t>(config.colorBlendInfo.logicOp));
+        writer.add(static_cast<uint64_t>(config.colorAttachmentCount));
+        for (float constant : config.colorBlendInfo.blendConstants) {
+            writer.add(constant);
+        }
+
+        const auto& depth = config.depthStencilInfo;
+        writer.add(static_cast<uint64_t>(depth.depthTestEnable));
+        writer.add(static_cast<uint64_t>(depth.depthWriteEnable));
+        writer.add(static_cast<uint64_t>(depth.depthCompareOp));
+        writer.add(static_cast<uint64_t>(depth.depthBoundsTestEnable));
+        writer.add(static_cast<uint64_t>(depth.stencilTestEnable));
+        writer.add(depth.front);
+        writer.add(depth.back);
+        writer.add(depth.minDepthBounds);
+        writer.add(depth.maxDepthBounds);
+
+        writer.add(static_cast<uint64_t>(config.dynamicStateEnables.size()));
+        for (VkDynamicState state : config.dynamicStateEnables) {
+            writer.add(static_cast<uint64_t>(state));
+        }
+
+        writer.add(static_cast<uint64_t>(config.specializationEntries.size()));
+        for (const auto& entry : config.specializationEntries) {
+            writer.add(static_cast<uint64_t>(entry.constantID));
+            writer.add(static_cast<uint64_t>(entry.offset));
+            writer.add(static_cast<uint64_t>(entry.size));
+        }
+        for (uint32_t value : config.specializationData) {
+            writer.add(static_cast<uint64_t>(value));
+        }
+
+        writer.addHandle(config.pipelineLayout);
+        writer.addHandle(config.renderPass);
+        writer.add(static_cast<uint64_t>(config.subpass));
+        return key;
+    }
+
+    template <typename T>
+    std::shared_ptr<T> PipelineRegistry::find(
+        std::unordered_map<Key, std::weak_ptr<T>, KeyHash>& map, const Key& key) {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        auto it = map.find(key);
+        if (it == map.end()) {
+            return nullptr;
+        }
+        auto cached = it->second.lock();
+        if (!cached) {
+            // Nothing uses the object anymore; drop the entry so the map does not keep growing
+            map.erase(it);
+        }
+        return cached;
+    }
+
+    template <typename T>
+    std::shared_ptr<T> PipelineRegistry::insert(
+        std::unordered_map<Key, std::weak_ptr<T>, KeyHash>& map, Key key, std::shared_ptr<T> created) {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        std::weak_ptr<T>& entry = map[std::move(key)];
+        if (auto existing = entry.lock()) {
+            return existing;
+        }
+        entry = created;
+        return created;
+    }
+
+    std::shared_ptr<ShaderModule> PipelineRegistry::getShaderModule(const std::string& filepath) {
+        std::vector<char> code = Pipeline::readFile(filepath);
+        // The key holds the whole SPIR-V, so a hit is byte for byte the same module
+        Key key;
+        KeyWriter{ key }.add(code);
+        if (auto cached = find(m_shaderModules, key)) {
+            return cached;
+        }
+        return insert(m_shaderModules, std::move(key), std::make_shared<ShaderModule>(m_device, code));
+    }
+
+    std::shared_ptr<Pipeline> PipelineRegistry::getPipeline(
+        const std::string& vertFilepath,
+        const std::string& fragFilepath,
+        const PipelineConfigInfo& config) {
+        Key key = makePipelineKey(vertFilepath, fragFilepath, config);
+        if (auto cached = find(m_pipelines, key)) {
+            return cached;
+        }
+        auto pipeline = std::make_shared<Pipeline>(
+            m_device,
+            getShaderModule(vertFilepath),
+            fragFilepath.empty() ? nullptr : getShaderModule(fragFilepath),
+            config);
+        return insert(m_pipelines, std::move(key), std::move(pipeline));
+    }
+
+    std::shared_ptr<ComputePipeline> PipelineRegistry::getComputePipeline(
+        const std::string& compFilepath,
+        VkPipelineLayout pipelineLayout) {
+        Key key;
+        KeyWriter writer{ key };
+        writer.add(compFilepath);
+        writer.addHandle(pipelineLayout);
+        if (auto cached = find(m_computePipelines, key)) {
+            return cached;
+        }
+        auto pipeline = std::make_shared<ComputePipeline>(m_device, getShaderModule(compFilepath), pipelineLayout);
+        return insert(m_computePipelines, std::move(key), std::move(pipeline));
+    }
+
+    size_t PipelineRegistry::getShaderModuleCount() {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        size_t count = 0;
+        for (const auto& entry : m_shaderModules) {
+            count += entry.second.expired() ? 0 : 1;
+        }
+        return count;
+    }
+
+    size_t PipelineRegistry::getPipelineCount() {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+        size_t count = 0;
+        for (const auto& entry : m_pipelines) {
+            count += entry.second.expired() ? 0 : 1;
+        }
+        for (const auto& entry : m_computePipelines) {
+            count += entry.second.expired() ? 0 : 1;
+        }
+        return count;
+    }
+} // namespace engine
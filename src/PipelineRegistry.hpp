@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Pipeline.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace engine {
+
+    // Hands out shared pipelines and shader modules. A pipeline is looked up by its shader
+    // paths plus every PipelineConfigInfo field that reaches vkCreateGraphicsPipelines, and a
+    // shader module by its SPIR-V, so identical requests from different systems get the same
+    // objects. The registry only holds weak references: modules and pipelines are destroyed as
+    // soon as nothing uses them, and their entries are pruned when next looked up. Safe to
+    // call from several threads.
+    class PipelineRegistry {
+    public:
+        explicit PipelineRegistry(Device& device) : m_device{ device } {}
+
+        PipelineRegistry(const PipelineRegistry&) = delete;
+        PipelineRegistry& operator=(const PipelineRegistry&) = delete;
+
+        std::shared_ptr<ShaderModule> getShaderModule(const std::string& filepath);
+        std::shared_ptr<Pipeline> getPipeline(
+            const std::string& vertFilepath,
+            const std::string& fragFilepath,
+            const PipelineConfigInfo& config);
+        std::shared_ptr<ComputePipeline> getComputePipeline(
+            const std::string& compFilepath,
+            VkPipelineLayout pipelineLayout);
+
+        // Objects currently alive, for startup logging
+        size_t getShaderModuleCount();
+        size_t getPipelineCount();
+
+    private:
+        using Key = std::vector<uint64_t>;
+
+        struct KeyHash {
+            size_t operator()(const Key& key) const;
+        };
+
+        static Key makePipelineKey(
+            const std::string& vertFilepath,
+            const std::string& fragFilepath,
+            const PipelineConfigInfo& config);
+
+        // Returns the live entry for key, or stores created under it if there is none. Two
+        // threads may build the same object at once; the loser's copy is simply dropped.
+        template <typename T>
+        std::shared_ptr<T> insert(
+            std::unordered_map<Key, std::weak_ptr<T>, KeyHash>& map, Key key, std::shared_ptr<T> created);
+        template <typename T>
+        std::shared_ptr<T> find(std::unordered_map<Key, std::weak_ptr<T>, KeyHash>& map, const Key& key);
+
+        Device& m_device;
+        std::mutex m_mutex;
+        // Keyed by the SPIR-V bytes
+        std::unordered_map<Key, std::weak_ptr<ShaderModule>, KeyHash> m_shaderModules;
+        std::unordered_map<Key, std::weak_ptr<Pipeline>, KeyHash> m_pipelines;
+        std::unordered_map<Key, std::weak_ptr<ComputePipeline>, KeyHash> m_computePipelines;
+    };
+} // namespace engine
@@ -0,0 +1,631 @@
+#include "RenderBvh.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define ENGINE_BVH_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace engine {
+
+    // Past this depth nodes split at the median, which bounds the depth of degenerate inputs
+    static constexpr uint32_t MAX_SAH_DEPTH = 48;
+    static constexpr uint32_t ALL_PLANES = 0x3F;
+
+    static_assert(RenderBvh::MAX_LEAF_OBJECTS <= 4, "Leaves are tested four objects at a time");
+
+    static BvhBounds emptyBounds() {
+        BvhBounds bounds;
+        bounds.min = glm::vec3{ FLT_MAX };
+        bounds.max = glm::vec3{ -FLT_MAX };
+        return bounds;
+    }
+
+    static bool isEmpty(const BvhBounds& bounds) {
+        return bounds.min.x > bounds.max.x;
+    }
+
+    static void grow(BvhBounds& bounds, const BvhBounds& other) {
+        bounds.min = glm::min(bounds.min, other.min);
+        bounds.max = glm::max(bounds.max, other.max);
+    }
+
+    static float surfaceArea(const BvhBounds& bounds) {
+        if (isEmpty(bounds)) {
+            return 0.f;
+        }
+        const glm::vec3 size = bounds.max - bounds.min;
+        return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    // Like a walk from the root: false when the box, grown by margin, is outside a plane,
+    // otherwise the planes it lies inside of
+    static bool testBox(const Frustum& frustum, const BvhBounds& bounds, float margin, uint32_t& insideMask, float& insideSlack) {
+        const glm::vec3 center = (bounds.min + bounds.max) * .5f;
+        const glm::vec3 extent = (bounds.max - bounds.min) * .5f;
+        insideMask = 0;
+        insideSlack = FLT_MAX;
+        for (uint32_t p = 0; p < 6; p++) {
+            const glm::vec4& plane = frustum.planes[p];
+            const glm::vec3 normal{ plane };
+            const float distance = glm::dot(normal, center) + plane.w;
+            const float reach = glm::dot(glm::abs(normal), extent);
+            if (distance < -(reach + margin)) {
+                return false;
+            }
+            if (distance >= reach) {
+                insideMask |= 1u << p;
+                insideSlack = std::min(insideSlack, distance - reach);
+            }
+        }
+        return true;
+    }
+
+    RenderBvh::RenderBvh() {}
+
+    RenderBvh::~RenderBvh() {
+        if (m_build.valid()) {
+            m_build.wait();
+        }
+    }
+
+    uint32_t RenderBvh::insert(uint32_t id, const BvhBounds& bounds) {
+        uint32_t handle;
+        if (!m_freeHandles.empty()) {
+            handle = m_freeHandles.back();
+            m_freeHandles.pop_back();
+        } else {
+            handle = static_cast<uint32_t>(m_objects.size());
+            m_objects.emplace_back();
+        }
+        Object& object = m_objects[handle];
+        object.id = id;
+        object.bounds = bounds;
+        object.alive = true;
+        object.free = false;
+        m_objectCount++;
+
+        if (object.leafIndex != INVALID_HANDLE) {
+            // Freed while pending but taken into a build since, so it still holds a leaf
+            m_deadLeaves--;
+            writeLeaf(object.leafIndex, object);
+            m_dirtyLeaves.push_back(object.leafNode);
+        } else {
+            pushPending(handle);
+        }
+        return handle;
+    }
+
+    void RenderBvh::update(uint32_t handle, const BvhBounds& bounds) {
+        Object& object = m_objects[handle];
+        assert(object.alive && "Updating an object that was removed");
+        object.bounds = bounds;
+        if (object.leafIndex != INVALID_HANDLE) {
+            writeLeaf(object.leafIndex, object);
+            m_dirtyLeaves.push_back(object.leafNode);
+        }
+    }
+
+    void RenderBvh::remove(uint32_t handle) {
+        Object& object = m_objects[handle];
+        assert(object.alive && "Removing an object twice");
+        object.alive = false;
+        m_objectCount--;
+        if (object.leafIndex != INVALID_HANDLE) {
+            // The leaf keeps its place until the next build; the handle is freed then
+            m_leafAlive[object.leafIndex] = 0;
+            m_deadLeaves++;
+            m_dirtyLeaves.push_back(object.leafNode);
+        } else {
+            removePending(handle);
+            releaseHandle(handle);
+        }
+    }
+
+    void RenderBvh::maintain() {
+        if (m_build.valid() && m_build.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            swapIn(m_build.get());
+        }
+
+        for (const uint32_t leaf : m_dirtyLeaves) {
+            refitLeaf(leaf);
+        }
+        m_dirtyLeaves.clear();
+
+        if (!m_build.valid() && shouldRebuild()) {
+            if (m_nodes.empty()) {
+                // Without a tree every object is tested on its own, so the first one is not deferred
+                swapIn(buildTree(snapshot()));
+            } else {
+                m_build = std::async(std::launch::async, &RenderBvh::buildTree, snapshot());
+            }
+        }
+    }
+
+    void RenderBvh::rebuild() {
+        // Whatever is in flight was built from older boxes
+        if (m_build.valid()) {
+            m_build.get();
+        }
+        swapIn(buildTree(snapshot()));
+    }
+
+    float RenderBvh::getCostRatio() const {
+        if (m_nodes.empty() || m_builtCost <= 0.f) {
+            return 1.f;
+        }
+        const float rootArea = surfaceArea(m_nodes[0].bounds);
+        if (rootArea <= 0.f) {
+            return 1.f;
+        }
+        return static_cast<float>(m_areaSum / rootArea) / m_builtCost;
+    }
+
+    void RenderBvh::cull(const Frustum& frustum, float margin, std::vector<BvhCullHit>& visible, BvhCullStats& stats) {
+        if (!m_nodes.empty()) {
+            m_stack.clear();
+            m_stack.push_back({ 0, ALL_PLANES, FLT_MAX });
+            while (!m_stack.empty()) {
+                const StackEntry entry = m_stack.back();
+                m_stack.pop_back();
+                const Node& node = m_nodes[entry.node];
+                stats.nodesVisited++;
+                // Every object under it was removed
+                if (isEmpty(node.bounds)) {
+                    continue;
+                }
+
+                const glm::vec3 center = (node.bounds.min + node.bounds.max) * .5f;
+                const glm::vec3 extent = (node.bounds.max - node.bounds.min) * .5f;
+                // Starting from the plane that rejected the node last time, the likeliest to again;
+                // planes the box lies entirely inside of hold for the whole subtree
+                StackEntry child{ 0, entry.planeMask, entry.insideSlack };
+                const uint32_t firstPlane = m_rejectingPlane[entry.node];
+                bool rejected = false;
+                for (uint32_t i = 0; i < 6; i++) {
+                    const uint32_t p = (firstPlane + i) % 6;
+                    if ((child.planeMask & (1u << p)) == 0) {
+                        continue;
+                    }
+                    const glm::vec4& plane = frustum.planes[p];
+                    const glm::vec3 normal{ plane };
+                    const float distance = glm::dot(normal, center) + plane.w;
+                    const float reach = glm::dot(glm::abs(normal), extent);
+                    if (distance < -(reach + margin)) {
+                        m_rejectingPlane[entry.node] = static_cast<uint8_t>(p);
+                        rejected = true;
+                        break;
+                    }
+                    if (distance >= reach) {
+                        child.planeMask &= ~(1u << p);
+                        // Boxes below lie inside this one, so at least as far inside the plane
+                        child.insideSlack = std::min(child.insideSlack, distance - reach);
+                    }
+                }
+
+                if (rejected) {
+                    stats.subtreesRejected++;
+                } else if (child.planeMask == 0) {
+                    stats.subtreesAccepted++;
+                    acceptRange(node, child.insideSlack, visible);
+                } else if (node.rightChild == 0) {
+                    child.node = entry.node;
+                    cullLeaf(node, frustum, child, margin, visible);
+                } else {
+                    child.node = node.rightChild;
+                    m_stack.push_back(child);
+                    child.node = entry.node + 1;
+                    m_stack.push_back(child);
+                }
+            }
+        }
+
+        // Objects added since the tree was built wait for the next one
+        for (const uint32_t handle : m_pending) {
+            const Object& object = m_objects[handle];
+            BvhCullHit hit{ object.id, 0, FLT_MAX };
+            if (testBox(frustum, object.bounds, margin, hit.insideMask, hit.insideSlack)) {
+                visible.push_back(hit);
+            }
+        }
+    }
+
+    void RenderBvh::cullLeaf(
+        const Node& node,
+        const Frustum& frustum,
+        const StackEntry& entry,
+        float margin,
+        std::vector<BvhCullHit>& visible) const {
+        const uint32_t first = node.firstLeaf;
+        const uint32_t planeMask = entry.planeMask;
+        int outsideBits = 0;
+        // Per lane, planes inside of and by how much, on top of what the ancestors hold
+        uint32_t insideMasks[4] = { 0, 0, 0, 0 };
+        float insideSlacks[4] = { FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX };
+#ifdef ENGINE_BVH_SSE
+        // Every object of the leaf at once; lanes past its end read padding or the next leaf
+        const __m128 x = _mm_loadu_ps(&m_leafCenterX[first]);
+        const __m128 y = _mm_loadu_ps(&m_leafCenterY[first]);
+        const __m128 z = _mm_loadu_ps(&m_leafCenterZ[first]);
+        const __m128 extentX = _mm_loadu_ps(&m_leafExtentX[first]);
+        const __m128 extentY = _mm_loadu_ps(&m_leafExtentY[first]);
+        const __m128 extentZ = _mm_loadu_ps(&m_leafExtentZ[first]);
+        const __m128 grownBy = _mm_set1_ps(margin);
+        const __m128 none = _mm_set1_ps(FLT_MAX);
+        __m128 outside = _mm_setzero_ps();
+        __m128 slack = none;
+        for (uint32_t p = 0; p < 6; p++) {
+            if ((planeMask & (1u << p)) == 0) {
+                continue;
+            }
+            const glm::vec4& plane = frustum.planes[p];
+            const __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_mul_ps(_mm_set1_ps(plane.y), y)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), z), _mm_set1_ps(plane.w)));
+            const __m128 reach = _mm_add_ps(
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), extentX),
+                    _mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), extentY)),
+                _mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), extentZ));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_sub_ps(_mm_setzero_ps(), _mm_add_ps(reach, grownBy))));
+            const __m128 gap = _mm_sub_ps(distance, reach);
+            const __m128 inside = _mm_cmpge_ps(gap, _mm_setzero_ps());
+            slack = _mm_min_ps(slack, _mm_or_ps(_mm_and_ps(inside, gap), _mm_andnot_ps(inside, none)));
+            const int insideBits = _mm_movemask_ps(inside);
+            for (uint32_t lane = 0; lane < 4; lane++) {
+                insideMasks[lane] |= ((insideBits >> lane) & 1) != 0 ? 1u << p : 0u;
+            }
+        }
+        outsideBits = _mm_movemask_ps(outside);
+        _mm_storeu_ps(insideSlacks, slack);
+#else
+        for (uint32_t lane = 0; lane < node.leafCount; lane++) {
+            const uint32_t i = first + lane;
+            const glm::vec3 center{ m_leafCenterX[i], m_leafCenterY[i], m_leafCenterZ[i] };
+            const glm::vec3 extent{ m_leafExtentX[i], m_leafExtentY[i], m_leafExtentZ[i] };
+            for (uint32_t p = 0; p < 6; p++) {
+                if ((planeMask & (1u << p)) == 0) {
+                    continue;
+                }
+                const glm::vec4& plane = frustum.planes[p];
+                const glm::vec3 normal{ plane };
+                const float distance = glm::dot(normal, center) + plane.w;
+                const float reach = glm::dot(glm::abs(normal), extent);
+                if (distance < -(reach + margin)) {
+                    outsideBits |= 1 << lane;
+                    break;
+                }
+                if (distance >= reach) {
+                    insideMasks[lane] |= 1u << p;
+                    insideSlacks[lane] = std::min(insideSlacks[lane], distance - reach);
+                }
+            }
+        }
+#endif
+        for (uint32_t lane = 0; lane < node.leafCount; lane++) {
+            if ((outsideBits & (1 << lane)) == 0 && m_leafAlive[first + lane] != 0) {
+                visible.push_back({
+                    m_leafIds[first + lane],
+                    (ALL_PLANES & ~planeMask) | insideMasks[lane],
+                    std::min(entry.insideSlack, insideSlacks[lane]) });
+            }
+        }
+    }
+
+    void RenderBvh::acceptRange(const Node& node, float insideSlack, std::vector<BvhCullHit>& visible) const {
+        const uint32_t end = node.firstLeaf + node.leafCount;
+        for (uint32_t i = node.firstLeaf; i < end; i++) {
+            if (m_leafAlive[i] != 0) {
+                visible.push_back({ m_leafIds[i], ALL_PLANES, insideSlack });
+            }
+        }
+    }
+
+    bool RenderBvh::shouldRebuild() const {
+        const bool manyDead = m_deadLeaves > 0 && m_deadLeaves * 4 >= m_leafObjects.size();
+        return !m_pending.empty() || manyDead || getCostRatio() > REBUILD_COST_RATIO;
+    }
+
+    double RenderBvh::costWeight(const Node& node) {
+        // A traversal step per inner node and a box test per object in a leaf, weighed alike
+        return node.rightChild == 0 ? static_cast<double>(node.leafCount) : 1.0;
+    }
+
+    RenderBvh::BuildInput RenderBvh::snapshot() const {
+        BuildInput input;
+        input.handles.reserve(m_objectCount);
+        input.bounds.reserve(m_objectCount);
+        input.centroids.reserve(m_objectCount);
+        for (uint32_t handle = 0; handle < m_objects.size(); handle++) {
+            const Object& object = m_objects[handle];
+            if (!object.alive) {
+                continue;
+            }
+            input.handles.push_back(handle);
+            input.bounds.push_back(object.bounds);
+            input.centroids.push_back((object.bounds.min + object.bounds.max) * .5f);
+        }
+        input.order.resize(input.handles.size());
+        std::iota(input.order.begin(), input.order.end(), 0u);
+        return input;
+    }
+
+    RenderBvh::Build RenderBvh::buildTree(BuildInput input) {
+        Build build;
+        const uint32_t count = static_cast<uint32_t>(input.handles.size());
+        if (count == 0) {
+            return build;
+        }
+        build.nodes.reserve(2 * (count / MAX_LEAF_OBJECTS + 1));
+        buildNode(input, build, 0, count, 0, 0);
+
+        build.leafObjects.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            build.leafObjects[i] = input.handles[input.order[i]];
+        }
+        return build;
+    }
+
+    uint32_t RenderBvh::buildNode(BuildInput& input, Build& build, uint32_t begin, uint32_t end, uint32_t parent, uint32_t depth) {
+        BvhBounds bounds = emptyBounds();
+        BvhBounds centroidBounds = emptyBounds();
+        for (uint32_t i = begin; i < end; i++) {
+            const uint32_t index = input.order[i];
+            grow(bounds, input.bounds[index]);
+            centroidBounds.min = glm::min(centroidBounds.min, input.centroids[index]);
+            centroidBounds.max = glm::max(centroidBounds.max, input.centroids[index]);
+        }
+
+        const uint32_t nodeIndex = static_cast<uint32_t>(build.nodes.size());
+        Node node;
+        node.bounds = bounds;
+        node.firstLeaf = begin;
+        node.leafCount = end - begin;
+        node.parent = parent;
+        build.nodes.push_back(node);
+        if (end - begin <= MAX_LEAF_OBJECTS) {
+            return nodeIndex;
+        }
+
+        // Split across the axis the centroids spread furthest along
+        const glm::vec3 spread = centroidBounds.max - centroidBounds.min;
+        int axis = 0;
+        if (spread.y > spread[axis]) {
+            axis = 1;
+        }
+        if (spread.z > spread[axis]) {
+            axis = 2;
+        }
+
+        uint32_t mid = begin;
+        if (spread[axis] > 0.f && depth < MAX_SAH_DEPTH) {
+            const float axisMin = centroidBounds.min[axis];
+            const float binScale = SAH_BINS / spread[axis];
+            auto binOf = [&](uint32_t index) {
+                const uint32_t bin = static_cast<uint32_t>((input.centroids[index][axis] - axisMin) * binScale);
+                return std::min(bin, SAH_BINS - 1);
+            };
+
+            BvhBounds binBounds[SAH_BINS];
+            uint32_t binCounts[SAH_BINS] = {};
+            for (auto& binBound : binBounds) {
+                binBound = emptyBounds();
+            }
+            for (uint32_t i = begin; i < end; i++) {
+                const uint32_t index = input.order[i];
+                const uint32_t bin = binOf(index);
+                grow(binBounds[bin], input.bounds[index]);
+                binCounts[bin]++;
+            }
+
+            // Cost of everything right of each split plane, then swept in from the left
+            float rightArea[SAH_BINS] = {};
+            uint32_t rightCount[SAH_BINS] = {};
+            BvhBounds accumulated = emptyBounds();
+            uint32_t accumulatedCount = 0;
+            for (uint32_t bin = SAH_BINS - 1; bin > 0; bin--) {
+                grow(accumulated, binBounds[bin]);
+                accumulatedCount += binCounts[bin];
+                rightArea[bin] = surfaceArea(accumulated);
+                rightCount[bin] = accumulatedCount;
+            }
+            accumulated = emptyBounds();
+            accumulatedCount = 0;
+            float bestCost = FLT_MAX;
+            uint32_t bestSplit = 0;
+            for (uint32_t split = 1; split < SAH_BINS; split++) {
+                grow(accumulated, binBounds[split - 1]);
+                accumulatedCount += binCounts[split - 1];
+                if (accumulatedCount == 0 || rightCount[split] == 0) {
+                    continue;
+                }
+                const float cost = surfaceArea(accumulated) * accumulatedCount + rightArea[split] * rightCount[split];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestSplit = split;
+                }
+            }
+
+            if (bestSplit != 0) {
+                auto first = input.order.begin();
+                mid = static_cast<uint32_t>(std::partition(first + begin, first + end, [&](uint32_t index) {
+                    return binOf(index) < bestSplit;
+                }) - first);
+            }
+        }
+        if (mid == begin || mid == end) {
+            // Coincident centroids or a degenerate run; halving at least bounds the depth
+            mid = begin + (end - begin) / 2;
+            auto first = input.order.begin();
+            std::nth_element(first + begin, first + mid, first + end, [&](uint32_t a, uint32_t b) {
+                return input.centroids[a][axis] < input.centroids[b][axis];
+            });
+        }
+
+        // The left child lands right after this node
+        buildNode(input, build, begin, mid, nodeIndex, depth + 1);
+        const uint32_t rightChild = buildNode(input, build, mid, end, nodeIndex, depth + 1);
+        build.nodes[nodeIndex].rightChild = rightChild;
+        return nodeIndex;
+    }
+
+    void RenderBvh::swapIn(Build build) {
+        const std::vector<uint32_t> previous = std::move(m_leafObjects);
+        for (const uint32_t handle : previous) {
+            m_objects[handle].leafIndex = INVALID_HANDLE;
+        }
+
+        m_nodes = std::move(build.nodes);
+        m_leafObjects = std::move(build.leafObjects);
+        const size_t leafCount = m_leafObjects.size();
+        m_leafIds.resize(leafCount);
+        m_leafAlive.resize(leafCount);
+        m_leafCenterX.assign(leafCount + 3, 0.f);
+        m_leafCenterY.assign(leafCount + 3, 0.f);
+        m_leafCenterZ.assign(leafCount + 3, 0.f);
+        m_leafExtentX.assign(leafCount + 3, 0.f);
+        m_leafExtentY.assign(leafCount + 3, 0.f);
+        m_leafExtentZ.assign(leafCount + 3, 0.f);
+
+        // The copy was taken a while ago: objects removed since keep a dead leaf, and handles
+        // freed and reused since take their old leaf with their new object
+        m_deadLeaves = 0;
+        for (uint32_t i = 0; i < leafCount; i++) {
+            const uint32_t handle = m_leafObjects[i];
+            Object& object = m_objects[handle];
+            object.leafIndex = i;
+            if (object.pendingIndex != INVALID_HANDLE) {
+                removePending(handle);
+            }
+            writeLeaf(i, object);
+            if (!object.alive) {
+                m_deadLeaves++;
+            }
+        }
+        for (uint32_t n = 0; n < m_nodes.size(); n++) {
+            const Node& node = m_nodes[n];
+            if (node.rightChild != 0) {
+                continue;
+            }
+            for (uint32_t i = node.firstLeaf; i < node.firstLeaf + node.leafCount; i++) {
+                m_objects[m_leafObjects[i]].leafNode = n;
+            }
+        }
+        // What the old tree held and the new one lacks was either removed or reinserted into a
+        // dead leaf after the copy
+        for (const uint32_t handle : previous) {
+            const Object& object = m_objects[handle];
+            if (object.leafIndex != INVALID_HANDLE) {
+                continue;
+            }
+            if (object.alive) {
+                pushPending(handle);
+            } else {
+                releaseHandle(handle);
+            }
+        }
+
+        // Boxes may have moved since the copy too
+        m_rejectingPlane.assign(m_nodes.size(), 0);
+        m_dirtyLeaves.clear();
+        refitAll();
+        m_builtCost = 0.f;
+        if (!m_nodes.empty() && surfaceArea(m_nodes[0].bounds) > 0.f) {
+            m_builtCost = static_cast<float>(m_areaSum / surfaceArea(m_nodes[0].bounds));
+        }
+        m_buildCount++;
+    }
+
+    void RenderBvh::writeLeaf(uint32_t leafIndex, const Object& object) {
+        const glm::vec3 center = (object.bounds.min + object.bounds.max) * .5f;
+        const glm::vec3 extent = (object.bounds.max - object.bounds.min) * .5f;
+        m_leafIds[leafIndex] = object.id;
+        m_leafAlive[leafIndex] = object.alive ? 1 : 0;
+        m_leafCenterX[leafIndex] = center.x;
+        m_leafCenterY[leafIndex] = center.y;
+        m_leafCenterZ[leafIndex] = center.z;
+        m_leafExtentX[leafIndex] = extent.x;
+        m_leafExtentY[leafIndex] = extent.y;
+        m_leafExtentZ[leafIndex] = extent.z;
+    }
+
+    BvhBounds RenderBvh::leafBounds(const Node& node) const {
+        BvhBounds bounds = emptyBounds();
+        for (uint32_t i = node.firstLeaf; i < node.firstLeaf + node.leafCount; i++) {
+            if (m_leafAlive[i] != 0) {
+                grow(bounds, m_objects[m_leafObjects[i]].bounds);
+            }
+        }
+        return bounds;
+    }
+
+    bool RenderBvh::setNodeBounds(uint32_t nodeIndex, const BvhBounds& bounds) {
+        Node& node = m_nodes[nodeIndex];
+        if (node.bounds.min == bounds.min && node.bounds.max == bounds.max) {
+            return false;
+        }
+        const double weight = costWeight(node);
+        m_areaSum += weight * (surfaceArea(bounds) - surfaceArea(node.bounds));
+        node.bounds = bounds;
+        return true;
+    }
+
+    void RenderBvh::refitLeaf(uint32_t nodeIndex) {
+        if (!setNodeBounds(nodeIndex, leafBounds(m_nodes[nodeIndex]))) {
+            return;
+        }
+        // Up until a box comes out the same, above which nothing changes either
+        while (nodeIndex != 0) {
+            nodeIndex = m_nodes[nodeIndex].parent;
+            BvhBounds bounds = m_nodes[nodeIndex + 1].bounds;
+            grow(bounds, m_nodes[m_nodes[nodeIndex].rightChild].bounds);
+            if (!setNodeBounds(nodeIndex, bounds)) {
+                return;
+            }
+        }
+    }
+
+    void RenderBvh::refitAll() {
+        // Children come after their parent, so going backwards visits them first
+        m_areaSum = 0.0;
+        for (size_t n = m_nodes.size(); n-- > 0;) {
+            Node& node = m_nodes[n];
+            if (node.rightChild == 0) {
+                node.bounds = leafBounds(node);
+            } else {
+                node.bounds = m_nodes[n + 1].bounds;
+                grow(node.bounds, m_nodes[node.rightChild].bounds);
+            }
+            m_areaSum += costWeight(node) * surfaceArea(node.bounds);
+        }
+    }
+
+    void RenderBvh::pushPending(uint32_t handle) {
+        m_objects[handle].pendingIndex = static_cast<uint32_t>(m_pending.size());
+        m_pending.push_back(handle);
+    }
+
+    void RenderBvh::removePending(uint32_t handle) {
+        const uint32_t index = m_objects[handle].pendingIndex;
+        const uint32_t last = m_pending.back();
+        m_pending[index] = last;
+        m_objects[last].pendingIndex = index;
+        m_pending.pop_back();
+        m_objects[handle].pendingIndex = INVALID_HANDLE;
+    }
+
+    void RenderBvh::releaseHandle(uint32_t handle) {
+        // A handle freed while pending may be freed again once the tree it was copied into goes
+        Object& object = m_objects[handle];
+        if (!object.free) {
+            object.free = true;
+            m_freeHandles.push_back(handle);
+        }
+    }
+} // namespace engine
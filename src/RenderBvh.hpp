@@ -0,0 +1,186 @@
+#pragma once
+
+#include "Camera.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <future>
+#include <vector>
+
+namespace engine {
+
+    struct BvhBounds {
+        glm::vec3 min{ 0.f };
+        glm::vec3 max{ 0.f };
+    };
+
+    // An object cull() did not find outside the frustum
+    struct BvhCullHit {
+        uint32_t id;
+        // Frustum planes the object's box lies entirely inside of, a bit per plane
+        uint32_t insideMask;
+        // Least distance the box lies inside those planes by, FLT_MAX when there are none
+        float insideSlack;
+    };
+
+    struct BvhCullStats {
+        uint32_t nodesVisited{ 0 };
+        // Subtrees taken whole for lying inside every plane, and dropped whole for lying outside one
+        uint32_t subtreesAccepted{ 0 };
+        uint32_t subtreesRejected{ 0 };
+    };
+
+    // Bounding volume hierarchy over object boxes for render culling. Built top-down with a
+    // binned surface area heuristic; an object that moves refits the boxes above it instead of
+    // restructuring the tree. Refitting loosens the tree, so once its SAH cost has grown by
+    // REBUILD_COST_RATIO, or objects were added or removed, a new one is built on a background
+    // thread from a copy of the boxes and swapped in by a later maintain(). Objects added in the
+    // meantime are culled one by one.
+    //
+    // Every node covers a contiguous run of the leaf order, so a subtree inside the frustum is
+    // taken whole without visiting it. A walk hands each node the planes its parent already
+    // lies inside of, which the node and everything under it skip. Not thread safe; only the
+    // build runs elsewhere.
+    class RenderBvh {
+    public:
+        static constexpr uint32_t MAX_LEAF_OBJECTS = 4;
+        static constexpr uint32_t SAH_BINS = 16;
+        static constexpr float REBUILD_COST_RATIO = 1.5f;
+        static constexpr uint32_t INVALID_HANDLE = ~0u;
+
+        RenderBvh();
+        // Waits for a background build in flight
+        ~RenderBvh();
+
+        RenderBvh(const RenderBvh&) = delete;
+        RenderBvh& operator=(const RenderBvh&) = delete;
+
+        // Returns the handle to update and remove the object with; id is what cull() reports
+        uint32_t insert(uint32_t id, const BvhBounds& bounds);
+        void update(uint32_t handle, const BvhBounds& bounds);
+        void remove(uint32_t handle);
+
+        // Refits the boxes above updated objects, swaps in a finished background build and
+        // starts another when the tree has degraded. Call once per frame before cull().
+        void maintain();
+        // Builds a tree of every object on the calling thread, e.g. once a scene is loaded
+        void rebuild();
+
+        // Appends every object whose box, grown by margin, is not entirely outside some plane
+        // of the frustum, with the planes it lies inside of
+        void cull(const Frustum& frustum, float margin, std::vector<BvhCullHit>& visible, BvhCullStats& stats);
+
+        uint32_t getObjectCount() const { return m_objectCount; }
+        uint32_t getNodeCount() const { return static_cast<uint32_t>(m_nodes.size()); }
+        // Objects added since the current tree was built
+        uint32_t getPendingCount() const { return static_cast<uint32_t>(m_pending.size()); }
+        // SAH cost of the tree relative to right after it was built
+        float getCostRatio() const;
+        bool isRebuilding() const { return m_build.valid(); }
+        uint32_t getBuildCount() const { return m_buildCount; }
+
+    private:
+        struct Node {
+            BvhBounds bounds;
+            // Covers leaf positions [firstLeaf, firstLeaf + leafCount)
+            uint32_t firstLeaf = 0;
+            uint32_t leafCount = 0;
+            // The left child directly follows its parent; 0 marks a leaf
+            uint32_t rightChild = 0;
+            uint32_t parent = 0;
+        };
+
+        struct Object {
+            uint32_t id = 0;
+            BvhBounds bounds;
+            // Position in the leaf order and leaf node while the object is in the tree
+            uint32_t leafIndex = INVALID_HANDLE;
+            uint32_t leafNode = 0;
+            // Position in m_pending while it is not
+            uint32_t pendingIndex = INVALID_HANDLE;
+            bool alive = false;
+            bool free = false;
+        };
+
+        struct StackEntry {
+            uint32_t node;
+            // Planes the node's box may still straddle
+            uint32_t planeMask;
+            // Least distance an ancestor lies inside the other planes by
+            float insideSlack;
+        };
+
+        struct Build {
+            std::vector<Node> nodes;
+            // Object handle at every leaf position
+            std::vector<uint32_t> leafObjects;
+        };
+
+        // Input of a build, indexed alike
+        struct BuildInput {
+            std::vector<uint32_t> handles;
+            std::vector<BvhBounds> bounds;
+            std::vector<glm::vec3> centroids;
+            // Permutation of the input, partitioned in place into the leaf order
+            std::vector<uint32_t> order;
+        };
+
+        static Build buildTree(BuildInput input);
+        static uint32_t buildNode(BuildInput& input, Build& build, uint32_t begin, uint32_t end, uint32_t parent, uint32_t depth);
+        BuildInput snapshot() const;
+        void swapIn(Build build);
+        bool shouldRebuild() const;
+        // Traversal steps and object tests weighed in the SAH cost
+        static double costWeight(const Node& node);
+
+        void writeLeaf(uint32_t leafIndex, const Object& object);
+        BvhBounds leafBounds(const Node& node) const;
+        // Sets the box of node, keeping m_areaSum in step; false when it did not change
+        bool setNodeBounds(uint32_t nodeIndex, const BvhBounds& bounds);
+        void refitLeaf(uint32_t nodeIndex);
+        void refitAll();
+
+        void pushPending(uint32_t handle);
+        void removePending(uint32_t handle);
+        void releaseHandle(uint32_t handle);
+
+        void cullLeaf(const Node& node, const Frustum& frustum, const StackEntry& entry, float margin, std::vector<BvhCullHit>& visible) const;
+        void acceptRange(const Node& node, float insideSlack, std::vector<BvhCullHit>& visible) const;
+
+        // Indexed by handle
+        std::vector<Object> m_objects;
+        std::vector<uint32_t> m_freeHandles;
+        uint32_t m_objectCount = 0;
+        // Live objects not in the tree
+        std::vector<uint32_t> m_pending;
+
+        std::vector<Node> m_nodes;
+        // Plane that last rejected each node, tried first on the next walk
+        std::vector<uint8_t> m_rejectingPlane;
+        // Per leaf position; boxes as center and half extent arrays padded by three for
+        // four-wide leaf tests
+        std::vector<uint32_t> m_leafObjects;
+        std::vector<uint32_t> m_leafIds;
+        std::vector<uint8_t> m_leafAlive;
+        std::vector<float> m_leafCenterX;
+        std::vector<float> m_leafCenterY;
+        std::vector<float> m_leafCenterZ;
+        std::vector<float> m_leafExtentX;
+        std::vector<float> m_leafExtentY;
+        std::vector<float> m_leafExtentZ;
+        uint32_t m_deadLeaves = 0;
+        // Leaves holding objects updated or removed since the last maintain()
+        std::vector<uint32_t> m_dirtyLeaves;
+
+        // Surface area of every node weighted by its SAH cost, unnormalized
+        double m_areaSum = 0.0;
+        float m_builtCost = 0.f;
+
+        std::future<Build> m_build;
+        uint32_t m_buildCount = 0;
+        std::vector<StackEntry> m_stack;
+    };
+} // namespace engine
@@ -0,0 +1,101 @@
+#include "RenderQueue.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+namespace engine {
+
+    RenderQueue::RenderQueue() {}
+
+    RenderQueue::~RenderQueue() {}
+
+    uint64_t RenderQueue::makeKey(uint8_t pipeline, uint16_t material, uint16_t mesh, float depth) {
+        const float maxDepth = static_cast<float>((1u << DEPTH_BITS) - 1);
+        const uint64_t quantizedDepth = static_cast<uint64_t>(std::min(std::max(depth, 0.f), 1.f) * maxDepth);
+        return (static_cast<uint64_t>(pipeline) << (DEPTH_BITS + MESH_BITS + MATERIAL_BITS)) |
+            (static_cast<uint64_t>(material) << (DEPTH_BITS + MESH_BITS)) |
+            (static_cast<uint64_t>(mesh) << DEPTH_BITS) |
+            quantizedDepth;
+    }
+
+    void RenderQueue::clear() {
+        m_items.clear();
+        if (++m_frame % ID_RETIRE_FRAMES == 0) {
+            retireIds(m_materialIds);
+            retireIds(m_meshIds);
+        }
+    }
+
+    uint16_t RenderQueue::getId(IdTable& table, const void* object) {
+        auto it = table.ids.find(object);
+        if (it != table.ids.end()) {
+            it->second.lastFrame = m_frame;
+            return it->second.id;
+        }
+        uint16_t id;
+        if (!table.freeIds.empty()) {
+            id = table.freeIds.back();
+            table.freeIds.pop_back();
+        } else if (table.nextId <= UINT16_MAX) {
+            id = static_cast<uint16_t>(table.nextId++);
+        } else {
+            throw std::runtime_error("render queue ran out of sort key ids");
+        }
+        table.ids.emplace(object, SortId{ id, m_frame });
+        return id;
+    }
+
+    void RenderQueue::retireIds(IdTable& table) {
+        for (auto it = table.ids.begin(); it != table.ids.end();) {
+            if (m_frame - it->second.lastFrame >= ID_RETIRE_FRAMES) {
+                table.freeIds.push_back(it->second.id);
+                it = table.ids.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void RenderQueue::sort() {
+        const size_t count = m_items.size();
+        if (count < 2) {
+            return;
+        }
+        m_scratch.resize(count);
+
+        // One histogram per byte, all gathered in a single read of the keys
+        std::array<std::array<uint32_t, 256>, 8> histograms{};
+        for (const RenderItem& item : m_items) {
+            for (uint32_t pass = 0; pass < 8; pass++) {
+                histograms[pass][(item.key >> (pass * 8)) & 0xFF]++;
+            }
+        }
+
+        RenderItem* source = m_items.data();
+        RenderItem* destination = m_scratch.data();
+        for (uint32_t pass = 0; pass < 8; pass++) {
+            auto& histogram = histograms[pass];
+            const uint32_t firstByte = (source[0].key >> (pass * 8)) & 0xFF;
+            if (histogram[firstByte] == count) {
+                continue;
+            }
+
+            uint32_t offset = 0;
+            for (auto& bucket : histogram) {
+                uint32_t bucketCount = bucket;
+                bucket = offset;
+                offset += bucketCount;
+            }
+            for (size_t i = 0; i < count; i++) {
+                destination[histogram[(source[i].key >> (pass * 8)) & 0xFF]++] = source[i];
+            }
+            std::swap(source, destination);
+        }
+
+        if (source != m_items.data()) {
+            m_items.swap(m_scratch);
+        }
+    }
+} // namespace engine
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace engine {
+
+    struct RenderItem {
+        uint64_t key;
+        uint32_t payload;
+    };
+
+    // Sorts draws by a packed 64-bit key so that state changes cluster together:
+    //   [63..56] pipeline  [55..40] material  [39..24] mesh  [23..0] depth (front to back)
+    // Material and mesh pointers are mapped to small ids that stay stable across frames.
+    // Every ID_RETIRE_FRAMES frames, ids nobody has asked for in that long are retired and
+    // handed out again, so pointers to freed meshes and materials don't use up the id space.
+    class RenderQueue {
+    public:
+        static constexpr uint32_t DEPTH_BITS = 24;
+        static constexpr uint32_t MESH_BITS = 16;
+        static constexpr uint32_t MATERIAL_BITS = 16;
+        // Keys that share everything above the depth bits can be drawn in one batch
+        static constexpr uint32_t STATE_SHIFT = DEPTH_BITS;
+        static constexpr uint64_t ID_RETIRE_FRAMES = 120;
+
+        RenderQueue();
+        ~RenderQueue();
+
+        RenderQueue(const RenderQueue&) = delete;
+        RenderQueue& operator=(const RenderQueue&) = delete;
+
+        // depth is normalized device depth in [0, 1]; values outside are clamped
+        static uint64_t makeKey(uint8_t pipeline, uint16_t material, uint16_t mesh, float depth);
+
+        uint16_t getMaterialId(const void* material) { return getId(m_materialIds, material); }
+        uint16_t getMeshId(const void* mesh) { return getId(m_meshIds, mesh); }
+
+        // Starts a new frame of draws
+        void clear();
+        void push(uint64_t key, uint32_t payload) { m_items.push_back({ key, payload }); }
+        // LSD radix sort, one byte per pass; passes where every key has the same byte are skipped
+        void sort();
+
+        const std::vector<RenderItem>& getItems() const { return m_items; }
+        size_t getMaterialIdCount() const { return m_materialIds.ids.size(); }
+        size_t getMeshIdCount() const { return m_meshIds.ids.size(); }
+
+    private:
+        struct SortId {
+            uint16_t id;
+            uint64_t lastFrame;
+        };
+
+        struct IdTable {
+            std::unordered_map<const void*, SortId> ids;
+            std::vector<uint16_t> freeIds;
+            uint32_t nextId{ 0 };
+        };
+
+        uint16_t getId(IdTable& table, const void* object);
+        void retireIds(IdTable& table);
+
+        std::vector<RenderItem> m_items;
+        std::vector<RenderItem> m_scratch;
+        IdTable m_materialIds;
+        IdTable m_meshIds;
+        uint64_t m_frame{ 0 };
+    };
+} // namespace engine
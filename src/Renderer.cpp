@@ -1,9 +1,11 @@
 #include "Renderer.hpp"
 
 namespace engine{
-	Renderer::Renderer(Window& window, Device& device) :
+	Renderer::Renderer(Window& window, Device& device, RenderPath renderPath, bool sampledDepth) :
 		m_window{ window },
-		m_device{ device } {
+		m_device{ device },
+		m_renderPath{ renderPath },
+		m_sampledDepth{ sampledDepth } {
 		recreateSwapChain();
 		createCommandBuffers();
 	}
@@ -20,7 +22,7 @@ namespace engine{
         vkDeviceWaitIdle(m_device.device());
 
         if (m_swapChain == nullptr) {
-            m_swapChain = std::make_unique<SwapChain>(m_device, extent);
+            m_swapChain = std::make_unique<SwapChain>(m_device, extent, m_renderPath, m_sampledDepth);
         }
         else {
             std::shared_ptr<SwapChain> oldSwapChain = std::move(m_swapChain);
@@ -30,6 +32,7 @@ namespace engine{
 
             }
         }
+        m_swapChainGeneration++;
     }
 
     void Renderer::createCommandBuffers() {
@@ -103,27 +106,57 @@ namespace engine{
         currentFrameIndex = (currentFrameIndex + 1) % SwapChain::MAX_FRAMES_IN_FLIGHT;
     }
 
-    void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+    void Renderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents) {
+        beginRenderPass(commandBuffer, m_swapChain->getRenderPass(), contents);
+    }
+
+    void Renderer::beginEarlyRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents) {
+        assert(getRenderPath() == RenderPath::Forward && "Only the forward render pass is split");
+        beginRenderPass(commandBuffer, m_swapChain->getEarlyRenderPass(), contents);
+    }
+
+    void Renderer::beginLateRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents) {
+        assert(getRenderPath() == RenderPath::Forward && "Only the forward render pass is split");
+        beginRenderPass(commandBuffer, m_swapChain->getLateRenderPass(), contents);
+    }
+
+    void Renderer::beginRenderPass(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkSubpassContents contents) {
         assert(isFrameStarted && "Cannot call beginSwapChainRenderPass while frame is not in progress");
         assert(commandBuffer == getCurrentCommandBuffer() &&
             "Cannot begin render pass on commandBuffer from a different frame");
         VkRenderPassBeginInfo renderPassInfo{};
         renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = m_swapChain->getRenderPass();
+        renderPassInfo.renderPass = renderPass;
         renderPassInfo.framebuffer = m_swapChain->getFrameBuffer(currentImageIndex);
 
         renderPassInfo.renderArea.offset = { 0,0 };
         renderPassInfo.renderArea.extent = m_swapChain->getSwapChainExtent();
 
-        std::array<VkClearValue, 2> clearValues{};
+        // The deferred G-buffer clears to zero albedo and normal, so the background gets no light.
+        // The late pass loads instead and ignores these.
+        std::vector<VkClearValue> clearValues(m_swapChain->attachmentCount());
         clearValues[0].color = { 0.01f,0.01f ,0.01f ,1.0f };
         clearValues[1].depthStencil = { 1.0f, 0 };
 
         renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
         renderPassInfo.pClearValues = clearValues.data();
 
-        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+        if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+            setViewportAndScissor(commandBuffer);
+        }
+    }
+
+    void Renderer::nextSubpass(VkCommandBuffer commandBuffer, VkSubpassContents contents) {
+        assert(isFrameStarted && "Cannot call nextSubpass while frame is not in progress");
+        assert(getRenderPath() == RenderPath::Deferred && "Only the deferred render pass has subpasses");
+        vkCmdNextSubpass(commandBuffer, contents);
+        if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+            setViewportAndScissor(commandBuffer);
+        }
+    }
 
+    void Renderer::setViewportAndScissor(VkCommandBuffer commandBuffer) {
         VkViewport viewport{};
         viewport.x = 0.0f;
         viewport.y = 0.0f;
@@ -11,20 +11,46 @@ namespace engine {
 	class Renderer {
 	public:
 
-		Renderer(Window& window, Device& device);
+		// sampledDepth asks for depth the Hi-Z build can sample, see isDepthSampled
+		Renderer(Window& window, Device& device, RenderPath renderPath = RenderPath::Forward, bool sampledDepth = false);
 		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer& operator=(const Renderer&) = delete;
 		VkRenderPass getSwapChainRenderPass() const { return m_swapChain->getRenderPass(); }
+		VkExtent2D getSwapChainExtent() const { return m_swapChain->getSwapChainExtent(); }
 		float getAspectRatio() const { return m_swapChain->extentAspectRatio(); }
+		RenderPath getRenderPath() const { return m_swapChain->getRenderPath(); }
+		// False when sampling was not asked for or the depth format cannot be sampled
+		bool isDepthSampled() const { return m_swapChain->isDepthSampled(); }
 		bool isFrameInProgress() const { return isFrameStarted; }
+		// Changes whenever the swap chain and its attachments are recreated
+		uint32_t getSwapChainGeneration() const { return m_swapChainGeneration; }
 
 		VkCommandBuffer getCurrentCommandBuffer() const {
 			assert(isFrameStarted && "Cannot get command buffer when frame not in progress");
 			return m_commandBuffers[currentFrameIndex];
 		}
 
+		VkFramebuffer getCurrentFramebuffer() const {
+			assert(isFrameStarted && "Cannot get framebuffer when frame not in progress");
+			return m_swapChain->getFrameBuffer(currentImageIndex);
+		}
+
+		// Deferred path only; views of the image being rendered, recreated with the swap chain
+		GBufferViews getCurrentGBufferViews() const {
+			assert(isFrameStarted && "Cannot get G-buffer when frame not in progress");
+			assert(getRenderPath() == RenderPath::Deferred && "Only the deferred path has a G-buffer");
+			return m_swapChain->getGBufferViews(currentImageIndex);
+		}
+
+		// Forward path; depth of the image being rendered, recreated with the swap chain
+		VkImageView getCurrentDepthView() const {
+			assert(isFrameStarted && "Cannot get depth view when frame not in progress");
+			assert(getRenderPath() == RenderPath::Forward && "Only the forward path samples depth");
+			return m_swapChain->getDepthImageView(currentImageIndex);
+		}
+
 		int getFrameIndex() const { 
 			assert(isFrameStarted && "Cannot get frameIndex when frame not in progress");
 			return currentFrameIndex; 
@@ -32,20 +58,37 @@ namespace engine {
 
 		VkCommandBuffer beginFrame();
 		void endFrame();
-		void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+		// With SECONDARY_COMMAND_BUFFERS the pass may only contain vkCmdExecuteCommands, and the
+		// secondary buffers set their own viewport and scissor
+		void beginSwapChainRenderPass(
+			VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+		// Forward path: the same pass split around compute work that reads its depth, see
+		// SwapChain::getEarlyRenderPass. Each is closed with endSwapChainRenderPass.
+		void beginEarlyRenderPass(
+			VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+		void beginLateRenderPass(
+			VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+		// Deferred path: moves from the geometry subpass to the lighting subpass
+		void nextSubpass(
+			VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
 	private:
+		void beginRenderPass(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkSubpassContents contents);
+		void setViewportAndScissor(VkCommandBuffer commandBuffer);
 		void createCommandBuffers();
 		void freeCommandBuffers();
 		void recreateSwapChain();
 
 		Window& m_window;
 		Device& m_device;
+		RenderPath m_renderPath;
+		bool m_sampledDepth;
 		std::unique_ptr<SwapChain> m_swapChain;
 		std::vector<VkCommandBuffer> m_commandBuffers;
 		uint32_t currentImageIndex{ 0 };
 		int currentFrameIndex{ 0 };
 		bool isFrameStarted{ false };
+		uint32_t m_swapChainGeneration{ 0 };
 	};
 } // namespace engine
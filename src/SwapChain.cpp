@@ -12,13 +12,17 @@
 
 namespace engine {
 
-SwapChain::SwapChain(Device &deviceRef, VkExtent2D extent)
-    : device{deviceRef}, windowExtent{extent} {
+SwapChain::SwapChain(Device &deviceRef, VkExtent2D extent, RenderPath renderPath, bool sampledDepth)
+    : device{deviceRef}, windowExtent{extent}, renderPath{renderPath}, sampledDepth{sampledDepth} {
     init();
 }
 
 SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent, std::shared_ptr<SwapChain> previous)
-    : device{ deviceRef }, windowExtent{ extent }, oldSwapChain{ previous } {
+    : device{ deviceRef },
+      windowExtent{ extent },
+      oldSwapChain{ previous },
+      renderPath{ previous->renderPath },
+      sampledDepth{ previous->sampledDepth } {
     init();
     oldSwapChain = nullptr;
 }
@@ -26,8 +30,13 @@ SwapChain::SwapChain(Device& deviceRef, VkExtent2D extent, std::shared_ptr<SwapC
 void SwapChain::init() {
     createSwapChain();
     createImageViews();
-    createRenderPass();
+    if (renderPath == RenderPath::Deferred) {
+        createDeferredRenderPass();
+    } else {
+        createRenderPass();
+    }
     createDepthResources();
+    createGBufferResources();
     createFramebuffers();
     createSyncObjects();
 }
@@ -49,11 +58,23 @@ SwapChain::~SwapChain() {
     vkFreeMemory(device.device(), depthImageMemorys[i], nullptr);
   }
 
+  for (auto *attachments : {&albedoAttachments, &normalAttachments}) {
+    for (auto &attachment : *attachments) {
+      vkDestroyImageView(device.device(), attachment.view, nullptr);
+      vkDestroyImage(device.device(), attachment.image, nullptr);
+      vkFreeMemory(device.device(), attachment.memory, nullptr);
+    }
+  }
+
   for (auto framebuffer : swapChainFramebuffers) {
     vkDestroyFramebuffer(device.device(), framebuffer, nullptr);
   }
 
   vkDestroyRenderPass(device.device(), renderPass, nullptr);
+  if (earlyRenderPass != VK_NULL_HANDLE) {
+    vkDestroyRenderPass(device.device(), earlyRenderPass, nullptr);
+    vkDestroyRenderPass(device.device(), lateRenderPass, nullptr);
+  }
 
   // cleanup synchronization objects
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
@@ -257,12 +278,170 @@ void SwapChain::createRenderPass() {
   if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
     throw std::runtime_error("failed to create render pass!");
   }
+
+  // The early pass clears and leaves both attachments for a later pass, with depth readable by
+  // compute shaders in between; the late pass picks them up again and presents
+  VkAttachmentDescription earlyColor = colorAttachment;
+  earlyColor.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  VkAttachmentDescription earlyDepth = depthAttachment;
+  earlyDepth.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  earlyDepth.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+  std::array<VkSubpassDependency, 2> earlyDependencies = {dependency, {}};
+  earlyDependencies[1].srcSubpass = 0;
+  earlyDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  earlyDependencies[1].srcAccessMask =
+      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  earlyDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+  earlyDependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+      VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  earlyDependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT |
+      VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  attachments = {earlyColor, earlyDepth};
+  renderPassInfo.dependencyCount = static_cast<uint32_t>(earlyDependencies.size());
+  renderPassInfo.pDependencies = earlyDependencies.data();
+  if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &earlyRenderPass) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create early render pass!");
+  }
+
+  VkAttachmentDescription lateColor = colorAttachment;
+  lateColor.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+  lateColor.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  VkAttachmentDescription lateDepth = depthAttachment;
+  lateDepth.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+  lateDepth.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+  // The early pass already made its writes visible; this waits for the compute reads of depth
+  // to finish before it goes back to being an attachment
+  VkSubpassDependency lateDependency = {};
+  lateDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+  lateDependency.srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  lateDependency.srcAccessMask = 0;
+  lateDependency.dstSubpass = 0;
+  lateDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  lateDependency.dstAccessMask =
+      VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  attachments = {lateColor, lateDepth};
+  renderPassInfo.dependencyCount = 1;
+  renderPassInfo.pDependencies = &lateDependency;
+  if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &lateRenderPass) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create late render pass!");
+  }
+}
+
+void SwapChain::createDeferredRenderPass() {
+  // Attachment order matches createFramebuffers: color, depth, albedo, normal
+  VkAttachmentDescription colorAttachment = {};
+  colorAttachment.format = getSwapChainImageFormat();
+  colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+  VkAttachmentDescription depthAttachment{};
+  depthAttachment.format = findDepthFormat();
+  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+  // G-buffer targets only live for the duration of the pass
+  VkAttachmentDescription albedoAttachment = colorAttachment;
+  albedoAttachment.format = ALBEDO_FORMAT;
+  albedoAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  albedoAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  VkAttachmentDescription normalAttachment = albedoAttachment;
+  normalAttachment.format = NORMAL_FORMAT;
+
+  // Geometry subpass: writes albedo, normal and depth
+  std::array<VkAttachmentReference, 2> gBufferRefs{};
+  gBufferRefs[0] = {2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  gBufferRefs[1] = {3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkAttachmentReference depthWriteRef = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+  // Lighting subpass: reads the G-buffer at the current pixel and adds light into the swap
+  // chain image. Depth stays bound read-only so light volumes and billboards are depth tested.
+  VkAttachmentReference colorRef = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  std::array<VkAttachmentReference, 3> inputRefs{};
+  inputRefs[0] = {2, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  inputRefs[1] = {3, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  inputRefs[2] = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+  VkAttachmentReference depthReadRef = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+
+  std::array<VkSubpassDescription, 2> subpasses{};
+  subpasses[GEOMETRY_SUBPASS].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpasses[GEOMETRY_SUBPASS].colorAttachmentCount = static_cast<uint32_t>(gBufferRefs.size());
+  subpasses[GEOMETRY_SUBPASS].pColorAttachments = gBufferRefs.data();
+  subpasses[GEOMETRY_SUBPASS].pDepthStencilAttachment = &depthWriteRef;
+  subpasses[LIGHTING_SUBPASS].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpasses[LIGHTING_SUBPASS].colorAttachmentCount = 1;
+  subpasses[LIGHTING_SUBPASS].pColorAttachments = &colorRef;
+  subpasses[LIGHTING_SUBPASS].inputAttachmentCount = static_cast<uint32_t>(inputRefs.size());
+  subpasses[LIGHTING_SUBPASS].pInputAttachments = inputRefs.data();
+  subpasses[LIGHTING_SUBPASS].pDepthStencilAttachment = &depthReadRef;
+
+  std::array<VkSubpassDependency, 2> dependencies{};
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].srcAccessMask = 0;
+  dependencies[0].srcStageMask =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstSubpass = GEOMETRY_SUBPASS;
+  dependencies[0].dstStageMask =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstAccessMask =
+      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  // Each pixel only reads what the geometry subpass wrote at the same pixel
+  dependencies[1].srcSubpass = GEOMETRY_SUBPASS;
+  dependencies[1].srcStageMask =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[1].srcAccessMask =
+      VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstSubpass = LIGHTING_SUBPASS;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+      VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[1].dstAccessMask =
+      VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+  dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+  std::array<VkAttachmentDescription, 4> attachments = {
+      colorAttachment, depthAttachment, albedoAttachment, normalAttachment};
+  VkRenderPassCreateInfo renderPassInfo = {};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+  renderPassInfo.pAttachments = attachments.data();
+  renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+  renderPassInfo.pSubpasses = subpasses.data();
+  renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+  renderPassInfo.pDependencies = dependencies.data();
+
+  if (vkCreateRenderPass(device.device(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create deferred render pass!");
+  }
 }
 
 void SwapChain::createFramebuffers() {
   swapChainFramebuffers.resize(imageCount());
   for (size_t i = 0; i < imageCount(); i++) {
-    std::array<VkImageView, 2> attachments = {swapChainImageViews[i], depthImageViews[i]};
+    std::vector<VkImageView> attachments = {swapChainImageViews[i], depthImageViews[i]};
+    if (renderPath == RenderPath::Deferred) {
+      attachments.push_back(albedoAttachments[i].view);
+      attachments.push_back(normalAttachments[i].view);
+    }
 
     VkExtent2D swapChainExtent = getSwapChainExtent();
     VkFramebufferCreateInfo framebufferInfo = {};
@@ -287,6 +466,8 @@ void SwapChain::createFramebuffers() {
 void SwapChain::createDepthResources() {
   VkFormat depthFormat = findDepthFormat();
   swapChainDepthFormat = depthFormat;
+  depthSampled = sampledDepth && renderPath == RenderPath::Forward &&
+      device.isFormatSupported(depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
   VkExtent2D swapChainExtent = getSwapChainExtent();
 
   depthImages.resize(imageCount());
@@ -306,6 +487,13 @@ void SwapChain::createDepthResources() {
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if (renderPath == RenderPath::Deferred) {
+      // The lighting subpass reconstructs positions from it
+      imageInfo.usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+    } else if (depthSampled) {
+      // Read between the early and late passes to build the Hi-Z pyramid
+      imageInfo.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+    }
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.flags = 0;
@@ -333,6 +521,53 @@ void SwapChain::createDepthResources() {
   }
 }
 
+void SwapChain::createGBufferResources() {
+  if (renderPath != RenderPath::Deferred) {
+    return;
+  }
+  // Written and read within one render pass and never stored, so tilers can keep them on chip
+  const VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+      VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+  albedoAttachments.resize(imageCount());
+  normalAttachments.resize(imageCount());
+  for (size_t i = 0; i < imageCount(); i++) {
+    createAttachment(ALBEDO_FORMAT, usage, albedoAttachments[i]);
+    createAttachment(NORMAL_FORMAT, usage, normalAttachments[i]);
+  }
+}
+
+void SwapChain::createAttachment(VkFormat format, VkImageUsageFlags usage, Attachment &attachment) {
+  VkExtent2D swapChainExtent = getSwapChainExtent();
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = swapChainExtent.width;
+  imageInfo.extent.height = swapChainExtent.height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = format;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = usage;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.flags = 0;
+
+  // Transient attachments may never need backing memory on tilers, so take lazily allocated
+  // memory where the device has it
+  const VkMemoryPropertyFlags preferredProperties =
+      (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0;
+  device.createImageWithInfo(
+      imageInfo,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      attachment.image,
+      attachment.memory,
+      preferredProperties);
+  attachment.view = Image::createImageView(device, attachment.image, format);
+}
+
 void SwapChain::createSyncObjects() {
   imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
   renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
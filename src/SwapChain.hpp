@@ -12,11 +12,37 @@
 
 namespace engine {
 
+// Picked once at startup; decides the layout of the swap chain render pass
+enum class RenderPath {
+  // One subpass: geometry is shaded as it is drawn
+  Forward,
+  // Subpass 0 fills a G-buffer, subpass 1 shades every pixel once from it
+  Deferred
+};
+
+// Per swap chain image attachments the deferred lighting subpass reads as input attachments
+struct GBufferViews {
+  VkImageView albedo;
+  VkImageView normal;
+  VkImageView depth;
+};
+
 class SwapChain {
  public:
   static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
-
-  SwapChain(Device &deviceRef, VkExtent2D windowExtent);
+  // Subpasses of the deferred render pass; the forward pass only has GEOMETRY_SUBPASS
+  static constexpr uint32_t GEOMETRY_SUBPASS = 0;
+  static constexpr uint32_t LIGHTING_SUBPASS = 1;
+  static constexpr VkFormat ALBEDO_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+  static constexpr VkFormat NORMAL_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+  // sampledDepth asks for forward path depth images compute shaders can sample, see isDepthSampled
+  SwapChain(
+      Device &deviceRef,
+      VkExtent2D windowExtent,
+      RenderPath renderPath = RenderPath::Forward,
+      bool sampledDepth = false);
+  // Keeps the render path and depth sampling of previous
   SwapChain(Device& deviceRef, VkExtent2D windowExtent, std::shared_ptr<SwapChain> previous);
   ~SwapChain();
 
@@ -25,7 +51,23 @@ class SwapChain {
 
   VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
   VkRenderPass getRenderPass() { return renderPass; }
+  // Forward path only: the render pass split in two around compute work that reads the depth
+  // drawn so far. The early pass clears and ends with depth in DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+  // visible to compute shaders; the late pass loads both attachments and presents. Both are
+  // compatible with getRenderPass(), so they share its framebuffers and pipelines.
+  VkRenderPass getEarlyRenderPass() { return earlyRenderPass; }
+  VkRenderPass getLateRenderPass() { return lateRenderPass; }
   VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+  GBufferViews getGBufferViews(int index) {
+    return {albedoAttachments[index].view, normalAttachments[index].view, depthImageViews[index]};
+  }
+  // Forward path: sampleable once the early render pass has ended, if isDepthSampled()
+  VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
+  // Whether sampling was asked for and the depth format supports it
+  bool isDepthSampled() { return depthSampled; }
+  RenderPath getRenderPath() { return renderPath; }
+  // Color, depth and, for the deferred path, albedo and normal, in framebuffer order
+  uint32_t attachmentCount() { return renderPath == RenderPath::Deferred ? 4 : 2; }
   size_t imageCount() { return swapChainImages.size(); }
   VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
   VkExtent2D getSwapChainExtent() { return swapChainExtent; }
@@ -47,7 +89,9 @@ class SwapChain {
   void createSwapChain();
   void createImageViews();
   void createDepthResources();
+  void createGBufferResources();
   void createRenderPass();
+  void createDeferredRenderPass();
   void createFramebuffers();
   void createSyncObjects();
 
@@ -58,16 +102,27 @@ class SwapChain {
       const std::vector<VkPresentModeKHR> &availablePresentModes);
   VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
 
+  struct Attachment {
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+  };
+  void createAttachment(VkFormat format, VkImageUsageFlags usage, Attachment &attachment);
+
   VkFormat swapChainImageFormat;
   VkFormat swapChainDepthFormat;
   VkExtent2D swapChainExtent;
 
   std::vector<VkFramebuffer> swapChainFramebuffers;
   VkRenderPass renderPass;
+  VkRenderPass earlyRenderPass = VK_NULL_HANDLE;
+  VkRenderPass lateRenderPass = VK_NULL_HANDLE;
 
   std::vector<VkImage> depthImages;
   std::vector<VkDeviceMemory> depthImageMemorys;
   std::vector<VkImageView> depthImageViews;
+  std::vector<Attachment> albedoAttachments;
+  std::vector<Attachment> normalAttachments;
   std::vector<VkImage> swapChainImages;
   std::vector<VkImageView> swapChainImageViews;
 
@@ -76,6 +131,9 @@ class SwapChain {
 
   VkSwapchainKHR swapChain;
   std::shared_ptr<SwapChain> oldSwapChain;
+  RenderPath renderPath;
+  bool sampledDepth;
+  bool depthSampled = false;
 
   std::vector<VkSemaphore> imageAvailableSemaphores;
   std::vector<VkSemaphore> renderFinishedSemaphores;
@@ -4,13 +4,36 @@
 #include "App.hpp"
 
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
-int main() {
-	engine::App app{};
-
+int main(int argc, char* argv[]) {
+	// --deferred picks the G-buffer path, clustered forward shading otherwise.
+	// --depth-prepass draws scene depth before shading it.
+	// --occlusion-culling skips what the previous frame's depth hides.
+	// --software-occlusion culls on the CPU against a software rasterized depth buffer.
+	// --verify-gpu-culling checks GPU culling against the CPU reference for a while, then exits.
+	engine::RenderPath renderPath = engine::RenderPath::Forward;
+	bool depthPrePass = false;
+	bool occlusionCulling = false;
+	bool softwareOcclusion = false;
+	bool verifyGpuCulling = false;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--deferred") == 0) {
+			renderPath = engine::RenderPath::Deferred;
+		} else if (std::strcmp(argv[i], "--depth-prepass") == 0) {
+			depthPrePass = true;
+		} else if (std::strcmp(argv[i], "--occlusion-culling") == 0) {
+			occlusionCulling = true;
+		} else if (std::strcmp(argv[i], "--software-occlusion") == 0) {
+			softwareOcclusion = true;
+		} else if (std::strcmp(argv[i], "--verify-gpu-culling") == 0) {
+			verifyGpuCulling = true;
+		}
+	}
 	try {
+		engine::App app{ renderPath, depthPrePass, occlusionCulling, softwareOcclusion, verifyGpuCulling };
 		app.run();
 	}
 	catch (const std::exception& e) {
@@ -2,10 +2,12 @@
 
 #include "Components.hpp"
 
-namespace engine {
+#include <algorithm>
 
-    CollisionSystem::CollisionSystem() {
+namespace engine {
 
+    CollisionSystem::CollisionSystem(size_t maxEvents) : m_maxEvents{ maxEvents } {
+        m_events.reserve(m_maxEvents);
     }
 
     CollisionSystem::~CollisionSystem() {
@@ -14,47 +16,129 @@ namespace engine {
 
     void CollisionSystem::update(FrameInfo& frameInfo) {
         EntityManager& eManager = frameInfo.entityManager;
-        auto physicsEntities = eManager.getEntitiesWithComponent(ComponentType::Physics);
-        for (int i = 0; i < physicsEntities.size(); i++) {
-            auto entityA = physicsEntities.at(i);
-            if (eManager.hasComponent<ModelComponent>(entityA)) {
-                const auto& modelCompA = eManager.getComponentData<ModelComponent>(entityA);
-                const auto& physicsCompA = eManager.getComponentData<PhysicsComponent>(entityA);
-                const auto& transformCompA = eManager.getComponentData<TransformComponent>(entityA);
-                auto boundingBoxA = modelCompA.model->getBoundingBox();
-                boundingBoxA.min = boundingBoxA.min * transformCompA.scale;
-                boundingBoxA.max = boundingBoxA.max * transformCompA.scale;
-                for (int j = i; j < physicsEntities.size(); j++) {
-                    auto entityB = physicsEntities.at(j);
-                    if (eManager.hasComponent<ModelComponent>(entityB) 
-                        && entityA != entityB) {
-                        const auto& modelCompB = eManager.getComponentData<ModelComponent>(entityB);
-                        const auto& physicsCompB = eManager.getComponentData<PhysicsComponent>(entityB);
-                        const auto& transformCompB = eManager.getComponentData<TransformComponent>(entityB);
-                        auto boundingBoxB = modelCompB.model->getBoundingBox();
-                        boundingBoxB.min = boundingBoxB.min * transformCompB.scale;
-                        boundingBoxB.max = boundingBoxB.max * transformCompB.scale;
-
-                        // Check for collision between entityA and entityB
-                        if (checkCollision(transformCompA, boundingBoxA, transformCompB, boundingBoxB)) {
-                            // Handle collision between entityA and entityB
-                            handleCollision(entityA, entityB, eManager);
-                        }
-                    }
+        m_events.clear();
+        std::swap(m_previousPairs, m_currentPairs);
+
+        gatherBodies(eManager);
+        findOverlappingPairs();
+        emitEvents();
+        m_stats.bodies = static_cast<uint32_t>(m_bodies.size());
+        m_stats.pairsColliding = static_cast<uint32_t>(m_currentPairs.size());
+
+        // Trigger bodies only report events, they never take part in the response. Resolving a
+        // pair pushes its bodies apart, so every pair is tested again on the current transforms
+        // before it is resolved; the cached overlap only drives the events.
+        for (const auto& pair : m_currentPairs) {
+            if (pair.trigger) {
+                continue;
+            }
+            const uint32_t entityA = static_cast<uint32_t>(pair.key >> 32);
+            const uint32_t entityB = static_cast<uint32_t>(pair.key & 0xffffffff);
+            if (checkCollision(getWorldBox(entityA, eManager), getWorldBox(entityB, eManager))) {
+                handleCollision(entityA, entityB, eManager);
+            }
+        }
+    }
+
+    bool CollisionSystem::areColliding(uint32_t entityA, uint32_t entityB) const {
+        uint64_t key = makePairKey(entityA, entityB);
+        auto it = std::lower_bound(m_currentPairs.begin(), m_currentPairs.end(), key,
+            [](const ContactPair& pair, uint64_t value) { return pair.key < value; });
+        return it != m_currentPairs.end() && it->key == key;
+    }
+
+    uint64_t CollisionSystem::makePairKey(uint32_t entityA, uint32_t entityB) {
+        if (entityA > entityB) {
+            std::swap(entityA, entityB);
+        }
+        return (static_cast<uint64_t>(entityA) << 32) | entityB;
+    }
+
+    void CollisionSystem::gatherBodies(EntityManager& eManager) {
+        m_bodies.clear();
+        for (const uint32_t entityID : eManager.getEntitiesWithComponent(ComponentType::Physics)) {
+            if (!eManager.hasComponent<ModelComponent>(entityID)) {
+                continue;
+            }
+            const auto& physicsComp = eManager.getComponentData<PhysicsComponent>(entityID);
+            m_bodies.push_back({ entityID, getWorldBox(entityID, eManager), physicsComp.isTrigger });
+        }
+    }
+
+    BoundingBox CollisionSystem::getWorldBox(uint32_t entityID, EntityManager& eManager) {
+        const auto& modelComp = eManager.getComponentData<ModelComponent>(entityID);
+        const auto& transformComp = eManager.getComponentData<TransformComponent>(entityID);
+        BoundingBox boundingBox = modelComp.model->getBoundingBox();
+        boundingBox.scale(transformComp.scale);
+        boundingBox.min += transformComp.translation;
+        boundingBox.max += transformComp.translation;
+        return boundingBox;
+    }
+
+    void CollisionSystem::findOverlappingPairs() {
+        m_currentPairs.clear();
+        m_stats.pairsTested = 0;
+
+        // Sweep and prune along x: once a body starts past the end of the current one,
+        // no later body can overlap it either
+        std::sort(m_bodies.begin(), m_bodies.end(), [](const CollisionBody& a, const CollisionBody& b) {
+            return a.worldBox.min.x < b.worldBox.min.x;
+        });
+        for (size_t i = 0; i < m_bodies.size(); i++) {
+            const CollisionBody& bodyA = m_bodies[i];
+            for (size_t j = i + 1; j < m_bodies.size(); j++) {
+                const CollisionBody& bodyB = m_bodies[j];
+                if (bodyB.worldBox.min.x > bodyA.worldBox.max.x) {
+                    break;
+                }
+                m_stats.pairsTested++;
+                if (checkCollision(bodyA.worldBox, bodyB.worldBox)) {
+                    m_currentPairs.push_back({
+                        makePairKey(bodyA.entity, bodyB.entity), bodyA.trigger || bodyB.trigger });
                 }
             }
         }
+
+        std::sort(m_currentPairs.begin(), m_currentPairs.end(), [](const ContactPair& a, const ContactPair& b) {
+            return a.key < b.key;
+        });
     }
 
-    bool CollisionSystem::checkCollision(const TransformComponent& transformCompA, const BoundingBox& boundingBoxA,
-                                const TransformComponent& transformCompB, const BoundingBox& boundingBoxB) {
-        
-        return (transformCompA.translation.x + boundingBoxA.max.x >= transformCompB.translation.x + boundingBoxB.min.x &&
-                transformCompA.translation.x + boundingBoxA.min.x <= transformCompB.translation.x + boundingBoxB.max.x &&
-                transformCompA.translation.y + boundingBoxA.max.y >= transformCompB.translation.y + boundingBoxB.min.y &&
-                transformCompA.translation.y + boundingBoxA.min.y <= transformCompB.translation.y + boundingBoxB.max.y &&
-                transformCompA.translation.z + boundingBoxA.max.z >= transformCompB.translation.z + boundingBoxB.min.z &&
-                transformCompA.translation.z + boundingBoxA.min.z <= transformCompB.translation.z + boundingBoxB.max.z);
+    void CollisionSystem::emitEvents() {
+        // Both pair lists are sorted by key, so one merge pass classifies every pair
+        size_t current = 0;
+        size_t previous = 0;
+        while (current < m_currentPairs.size() || previous < m_previousPairs.size()) {
+            if (previous == m_previousPairs.size() ||
+                (current < m_currentPairs.size() && m_currentPairs[current].key < m_previousPairs[previous].key)) {
+                pushEvent(m_currentPairs[current++], CollisionEventType::Enter);
+            } else if (current == m_currentPairs.size() ||
+                m_previousPairs[previous].key < m_currentPairs[current].key) {
+                pushEvent(m_previousPairs[previous++], CollisionEventType::Exit);
+            } else {
+                pushEvent(m_currentPairs[current++], CollisionEventType::Stay);
+                previous++;
+            }
+        }
+    }
+
+    void CollisionSystem::pushEvent(const ContactPair& pair, CollisionEventType type) {
+        if (m_events.size() >= m_maxEvents) {
+            m_droppedEvents++;
+            return;
+        }
+        CollisionEvent event{};
+        event.entityA = static_cast<uint32_t>(pair.key >> 32);
+        event.entityB = static_cast<uint32_t>(pair.key & 0xffffffff);
+        event.type = type;
+        event.trigger = pair.trigger;
+        m_events.push_back(event);
+    }
+
+    bool CollisionSystem::checkCollision(const BoundingBox& boundingBoxA, const BoundingBox& boundingBoxB) {
+        return (boundingBoxA.max.x >= boundingBoxB.min.x && boundingBoxA.min.x <= boundingBoxB.max.x &&
+                boundingBoxA.max.y >= boundingBoxB.min.y && boundingBoxA.min.y <= boundingBoxB.max.y &&
+                boundingBoxA.max.z >= boundingBoxB.min.z && boundingBoxA.min.z <= boundingBoxB.max.z);
     }
 
     void CollisionSystem::handleCollision(uint32_t entityA, uint32_t entityB, EntityManager& eManager) {
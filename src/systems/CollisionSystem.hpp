@@ -2,11 +2,34 @@
 
 #include "FrameInfo.hpp"
 
+#include <vector>
+
 namespace engine {
 
+    enum class CollisionEventType {
+        Enter,
+        Stay,
+        Exit
+    };
+
+    struct CollisionEvent {
+        uint32_t entityA;
+        uint32_t entityB;
+        CollisionEventType type;
+        bool trigger{ false };
+    };
+
+    struct CollisionStats {
+        uint32_t bodies{ 0 };
+        uint64_t pairsTested{ 0 };
+        uint32_t pairsColliding{ 0 };
+    };
+
     class CollisionSystem {
     public:
-        CollisionSystem();
+        static constexpr size_t MAX_COLLISION_EVENTS = 1024;
+
+        CollisionSystem(size_t maxEvents = MAX_COLLISION_EVENTS);
         ~CollisionSystem();
 
         CollisionSystem(const CollisionSystem&) = delete;
@@ -15,10 +38,43 @@ namespace engine {
         void update(FrameInfo& frameInfo);
         static glm::vec3 calculateMTV(uint32_t entityA, uint32_t entityB, EntityManager& eManager);
 
+        // Events produced by the last update, valid until the next one. Every consumer reads the
+        // same queue, so pairs are only tested once per frame no matter how many systems listen.
+        const std::vector<CollisionEvent>& getEvents() const { return m_events; }
+        size_t getDroppedEventCount() const { return m_droppedEvents; }
+        const CollisionStats& getStats() const { return m_stats; }
+        bool areColliding(uint32_t entityA, uint32_t entityB) const;
+
     private:
-        static bool checkCollision(const TransformComponent& transformCompA, const BoundingBox& bBoxA,
-                                    const TransformComponent& transformCompB, const BoundingBox& bBoxB);
+        struct CollisionBody {
+            uint32_t entity;
+            BoundingBox worldBox;
+            bool trigger;
+        };
+
+        struct ContactPair {
+            uint64_t key;
+            bool trigger;
+        };
+
+        static uint64_t makePairKey(uint32_t entityA, uint32_t entityB);
+        static bool checkCollision(const BoundingBox& bBoxA, const BoundingBox& bBoxB);
+        // Model box moved to the entity's current scale and translation
+        static BoundingBox getWorldBox(uint32_t entityID, EntityManager& eManager);
 
         static void handleCollision(uint32_t entityA, uint32_t entityB, EntityManager& eManager);
+
+        void gatherBodies(EntityManager& eManager);
+        void findOverlappingPairs();
+        void emitEvents();
+        void pushEvent(const ContactPair& pair, CollisionEventType type);
+
+        std::vector<CollisionBody> m_bodies;
+        std::vector<ContactPair> m_currentPairs;
+        std::vector<ContactPair> m_previousPairs;
+        std::vector<CollisionEvent> m_events;
+        size_t m_maxEvents;
+        size_t m_droppedEvents = 0;
+        CollisionStats m_stats{};
     };
 } // namespace engine
@@ -0,0 +1,325 @@
+#include "CullingSystem.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define ENGINE_CULLING_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace engine {
+
+    CullingSystem::CullingSystem() {}
+
+    CullingSystem::~CullingSystem() {}
+
+    void CullingSystem::update(FrameInfo& frameInfo) {
+        m_frame++;
+        m_stats = {};
+        const Frustum frustum = frameInfo.camera.getFrustum();
+        const glm::vec3 cameraPosition = frameInfo.camera.getPosition();
+        const bool planesTurned = updatePlaneNormals(frustum);
+        syncEntities(frameInfo.entityManager);
+        m_staticTree.maintain();
+        m_dynamicTree.maintain();
+
+        // Bounds how far any plane distance of a still sphere can have moved since the last walk
+        const float cameraMotion = glm::length(cameraPosition - m_walkedCamera) + getPlaneShift(frustum, cameraPosition);
+        if (!m_walked || planesTurned || cameraMotion > MOTION_THRESHOLD) {
+            walk(frustum, cameraPosition);
+        } else {
+            m_stats.reused = true;
+            for (const uint32_t entityID : m_movedEntities) {
+                CacheEntry& entry = m_cache[entityID];
+                if (entry.handle != RenderBvh::INVALID_HANDLE) {
+                    retest(entityID, entry);
+                    m_stats.retested++;
+                }
+            }
+        }
+        for (const uint32_t entityID : m_movedEntities) {
+            m_cache[entityID].moved = false;
+        }
+        m_movedEntities.clear();
+        m_stats.visible = static_cast<uint32_t>(m_visibleEntities.size());
+        m_stats.culled = static_cast<uint32_t>(m_entities.size()) - m_stats.visible;
+    }
+
+    void CullingSystem::walk(const Frustum& frustum, const glm::vec3& cameraPosition) {
+        for (const uint32_t entityID : m_visibleEntities) {
+            CacheEntry& entry = m_cache[entityID];
+            entry.visible = false;
+            entry.insideMask = 0;
+        }
+        m_visibleEntities.clear();
+        m_hits.clear();
+        m_staticTree.cull(frustum, MOTION_THRESHOLD, m_hits, m_stats.walk);
+        m_dynamicTree.cull(frustum, MOTION_THRESHOLD, m_hits, m_stats.walk);
+        for (const BvhCullHit& hit : m_hits) {
+            CacheEntry& entry = m_cache[hit.id];
+            setVisible(hit.id, entry, true);
+            entry.insideMask = hit.insideMask;
+            entry.insideSlack = hit.insideSlack;
+        }
+        // Everything else was tested as it is now
+        for (const uint32_t entityID : m_movedEntities) {
+            CacheEntry& entry = m_cache[entityID];
+            entry.testedCenter = entry.center;
+            entry.testedRadius = entry.radius;
+        }
+
+        m_walked = true;
+        m_walkedFrustum = frustum;
+        m_walkedCamera = cameraPosition;
+        for (int p = 0; p < 6; p++) {
+            m_walkedPlaneOffsets[p] = glm::dot(glm::vec3{ frustum.planes[p] }, cameraPosition) + frustum.planes[p].w;
+        }
+    }
+
+    void CullingSystem::retest(uint32_t entityID, CacheEntry& entry) {
+        // Planes the box lay inside of by more than it has moved since still hold
+        const float motion = glm::length(entry.center - entry.testedCenter) +
+            std::max(0.f, entry.radius - entry.testedRadius);
+        uint32_t insideMask = 0;
+        float insideSlack = FLT_MAX;
+        if (entry.visible && motion <= entry.insideSlack) {
+            insideMask = entry.insideMask;
+            insideSlack = entry.insideSlack - motion;
+        }
+        const uint32_t skippedPlanes = insideMask;
+
+        // Same box and margin as the tree walk
+        const glm::vec3 extent{ entry.radius };
+        bool visible = true;
+        for (uint32_t p = 0; p < 6; p++) {
+            if ((skippedPlanes & (1u << p)) != 0) {
+                continue;
+            }
+            const glm::vec4& plane = m_walkedFrustum.planes[p];
+            const glm::vec3 normal{ plane };
+            const float distance = glm::dot(normal, entry.center) + plane.w;
+            const float reach = glm::dot(glm::abs(normal), extent);
+            if (distance < -(reach + MOTION_THRESHOLD)) {
+                visible = false;
+                break;
+            }
+            if (distance >= reach) {
+                insideMask |= 1u << p;
+                insideSlack = std::min(insideSlack, distance - reach);
+            }
+        }
+
+        entry.testedCenter = entry.center;
+        entry.testedRadius = entry.radius;
+        setVisible(entityID, entry, visible);
+        entry.insideMask = visible ? insideMask : 0;
+        entry.insideSlack = insideSlack;
+    }
+
+    void CullingSystem::setVisible(uint32_t entityID, CacheEntry& entry, bool visible) {
+        if (visible == entry.visible) {
+            return;
+        }
+        entry.visible = visible;
+        if (visible) {
+            entry.visibleIndex = static_cast<uint32_t>(m_visibleEntities.size());
+            m_visibleEntities.push_back(entityID);
+            return;
+        }
+        const uint32_t last = m_visibleEntities.back();
+        m_visibleEntities[entry.visibleIndex] = last;
+        m_cache[last].visibleIndex = entry.visibleIndex;
+        m_visibleEntities.pop_back();
+        entry.insideMask = 0;
+    }
+
+    bool CullingSystem::isSphereVisible(const Frustum& frustum, const glm::vec3& center, float radius) {
+        for (const auto& plane : frustum.planes) {
+            if (plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void CullingSystem::testSpheres(
+        const Frustum& frustum, const std::vector<glm::vec4>& spheres, std::vector<uint8_t>& visible) {
+        const uint32_t count = static_cast<uint32_t>(spheres.size());
+        visible.resize(count);
+        uint32_t first = 0;
+#ifdef ENGINE_CULLING_SSE
+        for (; first + 4 <= count; first += 4) {
+            // Four spheres to one lane each; the sums keep isSphereVisible's order so the
+            // results match it bit for bit
+            __m128 x = _mm_loadu_ps(&spheres[first].x);
+            __m128 y = _mm_loadu_ps(&spheres[first + 1].x);
+            __m128 z = _mm_loadu_ps(&spheres[first + 2].x);
+            __m128 radius = _mm_loadu_ps(&spheres[first + 3].x);
+            _MM_TRANSPOSE4_PS(x, y, z, radius);
+            const __m128 reach = _mm_sub_ps(_mm_setzero_ps(), radius);
+            __m128 outside = _mm_setzero_ps();
+            for (const auto& plane : frustum.planes) {
+                const __m128 distance = _mm_add_ps(
+                    _mm_add_ps(
+                        _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_mul_ps(_mm_set1_ps(plane.y), y)),
+                        _mm_mul_ps(_mm_set1_ps(plane.z), z)),
+                    _mm_set1_ps(plane.w));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, reach));
+            }
+            const int outsideBits = _mm_movemask_ps(outside);
+            for (uint32_t lane = 0; lane < 4; lane++) {
+                visible[first + lane] = ((outsideBits >> lane) & 1) == 0 ? 1 : 0;
+            }
+        }
+#endif
+        for (uint32_t i = first; i < count; i++) {
+            visible[i] = isSphereVisible(frustum, glm::vec3{ spheres[i] }, spheres[i].w) ? 1 : 0;
+        }
+    }
+
+    BoundingSphere CullingSystem::getWorldSphere(const Model& model, TransformComponent& transform) {
+        const BoundingSphere sphere = model.getBoundingSphere();
+        const float maxScale = std::max({
+            std::abs(transform.scale.x), std::abs(transform.scale.y), std::abs(transform.scale.z) });
+
+        BoundingSphere worldSphere;
+        worldSphere.center = glm::vec3(transform.mat4() * glm::vec4(sphere.center, 1.f));
+        worldSphere.radius = sphere.radius * maxScale;
+        return worldSphere;
+    }
+
+    bool CullingSystem::isMeshletVisible(
+        const Frustum& frustum,
+        const glm::vec3& cameraPosition,
+        const Meshlet& meshlet,
+        const glm::mat4& modelMatrix,
+        const glm::mat3& normalMatrix,
+        bool coneCulling,
+        float margin) {
+        const float scale = std::max({
+            glm::length(glm::vec3(modelMatrix[0])),
+            glm::length(glm::vec3(modelMatrix[1])),
+            glm::length(glm::vec3(modelMatrix[2])) });
+        const glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(glm::vec3(meshlet.sphere), 1.f));
+        const float radius = meshlet.sphere.w * scale + margin;
+        if (!isSphereVisible(frustum, center, radius)) {
+            return false;
+        }
+        if (!coneCulling || meshlet.cone.w >= 1.f) {
+            return true;
+        }
+        // Back facing throughout when every point of the sphere lies within 90 degrees minus
+        // the cone's spread of the axis, as seen from the camera
+        const glm::vec3 axis = glm::normalize(normalMatrix * glm::vec3(meshlet.cone));
+        const glm::vec3 offset = center - cameraPosition;
+        const float cutoff = meshlet.cone.w;
+        return glm::dot(offset, axis) < cutoff * glm::length(offset) + radius * (1.f + cutoff);
+    }
+
+    bool CullingSystem::updatePlaneNormals(const Frustum& frustum) {
+        // Moving the camera only shifts the planes; their normals follow its rotation and projection
+        bool changed = false;
+        for (int p = 0; p < 6; p++) {
+            const glm::vec3 normal{ frustum.planes[p] };
+            changed = changed || normal != m_planeNormals[p];
+            m_planeNormals[p] = normal;
+        }
+        return changed;
+    }
+
+    float CullingSystem::getPlaneShift(const Frustum& frustum, const glm::vec3& cameraPosition) const {
+        // With the normals unchanged, a sphere's distance to a plane changes by its own motion,
+        // the camera's and this
+        float shift = 0.f;
+        for (int p = 0; p < 6; p++) {
+            const float offset = glm::dot(glm::vec3{ frustum.planes[p] }, cameraPosition) + frustum.planes[p].w;
+            shift = std::max(shift, std::abs(offset - m_walkedPlaneOffsets[p]));
+        }
+        return shift;
+    }
+
+    void CullingSystem::syncEntities(EntityManager& eManager) {
+        std::swap(m_entities, m_lastEntities);
+        m_entities.clear();
+
+        for (const uint32_t entityID : eManager.getEntitiesWithComponent(ComponentType::Model)) {
+            if (!eManager.entityExists(entityID)) {
+                continue;
+            }
+            if (entityID >= m_cache.size()) {
+                m_cache.resize(entityID + 1);
+            }
+            CacheEntry& entry = m_cache[entityID];
+            const Model* model = eManager.getComponentData<ModelComponent>(entityID).model.get();
+            const uint32_t transformVersion = eManager.getTransformVersion(entityID);
+            m_entities.push_back(entityID);
+
+            const bool tracked = entry.handle != RenderBvh::INVALID_HANDLE && entry.model == model;
+            if (!tracked || entry.transformVersion != transformVersion) {
+                TransformComponent transform = eManager.getComponentData<TransformComponent>(entityID);
+                const BoundingSphere sphere = getWorldSphere(*model, transform);
+                const bool moved = sphere.center != entry.center || sphere.radius != entry.radius;
+                entry.transformVersion = transformVersion;
+                entry.center = sphere.center;
+                entry.radius = sphere.radius;
+
+                if (!tracked) {
+                    if (entry.handle != RenderBvh::INVALID_HANDLE) {
+                        removeEntity(entityID, entry);
+                    }
+                    entry.model = model;
+                    entry.dynamic = eManager.hasComponent<PhysicsComponent>(entityID) &&
+                        eManager.getComponentData<PhysicsComponent>(entityID).movable;
+                    insertEntity(entityID, entry);
+                } else if (moved && !entry.dynamic) {
+                    // Refitting would loosen the static tree for everything in it
+                    removeEntity(entityID, entry);
+                    entry.dynamic = true;
+                    insertEntity(entityID, entry);
+                } else if (moved) {
+                    m_dynamicTree.update(entry.handle, sphereBounds(entry));
+                    markMoved(entityID, entry);
+                }
+            }
+            entry.frame = m_frame;
+        }
+
+        for (const uint32_t entityID : m_lastEntities) {
+            CacheEntry& entry = m_cache[entityID];
+            if (entry.frame != m_frame && entry.handle != RenderBvh::INVALID_HANDLE) {
+                removeEntity(entityID, entry);
+            }
+        }
+    }
+
+    void CullingSystem::insertEntity(uint32_t entityID, CacheEntry& entry) {
+        RenderBvh& tree = entry.dynamic ? m_dynamicTree : m_staticTree;
+        entry.handle = tree.insert(entityID, sphereBounds(entry));
+        entry.testedCenter = entry.center;
+        entry.testedRadius = entry.radius;
+        markMoved(entityID, entry);
+    }
+
+    void CullingSystem::removeEntity(uint32_t entityID, CacheEntry& entry) {
+        RenderBvh& tree = entry.dynamic ? m_dynamicTree : m_staticTree;
+        tree.remove(entry.handle);
+        entry.handle = RenderBvh::INVALID_HANDLE;
+        setVisible(entityID, entry, false);
+    }
+
+    void CullingSystem::markMoved(uint32_t entityID, CacheEntry& entry) {
+        if (!entry.moved) {
+            entry.moved = true;
+            m_movedEntities.push_back(entityID);
+        }
+    }
+
+    BvhBounds CullingSystem::sphereBounds(const CacheEntry& entry) {
+        BvhBounds bounds;
+        bounds.min = entry.center - glm::vec3{ entry.radius };
+        bounds.max = entry.center + glm::vec3{ entry.radius };
+        return bounds;
+    }
+} // namespace engine
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "FrameInfo.hpp"
+#include "RenderBvh.hpp"
+
+#include <vector>
+
+namespace engine {
+
+    struct CullingStats {
+        uint32_t visible{ 0 };
+        uint32_t culled{ 0 };
+        // Set when the camera moved too little to change the last walk, so it was kept
+        bool reused{ false };
+        // Entities tested on their own against the last walk's frustum for having moved,
+        // appeared or disappeared since
+        uint32_t retested{ 0 };
+        // Summed over both trees by the last walk
+        BvhCullStats walk{};
+    };
+
+    // Culls the world-space bounding sphere of every Model entity against the camera frustum
+    // by walking two RenderBvh trees, one of static entities and one of moving ones. An entity
+    // starts out static unless its PhysicsComponent is movable, and moves to the dynamic tree
+    // for good the first time its sphere changes, so the static tree rarely needs a refit.
+    //
+    // Every entity keeps its own result, the planes its box lay entirely inside of and the least
+    // distance by which. A walk is kept while the camera and its near and far planes have moved
+    // less than MOTION_THRESHOLD since it; boxes are culled grown by that threshold, which keeps
+    // culled ones culled until then. Turning the camera or changing its field of view or aspect
+    // ratio turns the planes, so it always walks again. In between, only entities that moved or
+    // appeared are tested again, against the walk's frustum, skipping the planes they lay inside
+    // of by more than they moved. Run it before any system that records draws.
+    //
+    // Only CullingMode::Cpu draws from its result. The GPU path hands every instance to
+    // instance_cull.comp, which tests each one anyway, and only borrows the static helpers
+    // below as the reference its results are verified against.
+    class CullingSystem {
+    public:
+        // World units
+        static constexpr float MOTION_THRESHOLD = 0.05f;
+        // World units by which the GPU may round a sphere or cone test differently from the
+        // reference tests below; results that flip within it are accepted either way
+        static constexpr float REFERENCE_TOLERANCE = 1e-3f;
+
+        CullingSystem();
+        ~CullingSystem();
+
+        CullingSystem(const CullingSystem&) = delete;
+        CullingSystem& operator=(const CullingSystem&) = delete;
+
+        void update(FrameInfo& frameInfo);
+
+        // Entities that passed the last update, in no particular order
+        const std::vector<uint32_t>& getVisibleEntities() const { return m_visibleEntities; }
+        const CullingStats& getStats() const { return m_stats; }
+        const RenderBvh& getStaticTree() const { return m_staticTree; }
+        const RenderBvh& getDynamicTree() const { return m_dynamicTree; }
+
+        // Sphere against every plane; the tree walk tests the box around the sphere instead
+        static bool isSphereVisible(const Frustum& frustum, const glm::vec3& center, float radius);
+        // isSphereVisible over many spheres, four at a time where SSE is available, with the
+        // same result for each. spheres hold the center in xyz and the radius in w; visible
+        // gets one 0 or 1 per sphere.
+        static void testSpheres(
+            const Frustum& frustum, const std::vector<glm::vec4>& spheres, std::vector<uint8_t>& visible);
+        // Model bounding sphere moved into world space; rotation keeps the radius, so only
+        // the largest scale axis can grow it
+        static BoundingSphere getWorldSphere(const Model& model, TransformComponent& transform);
+        // Scalar reference for the meshlet test in instance_cull.comp: the meshlet's sphere
+        // against the frustum, then, with coneCulling, its normal cone against the camera.
+        // The cone only holds while modelMatrix scales uniformly. margin grows the world sphere
+        // for both tests, or shrinks it when negative.
+        static bool isMeshletVisible(
+            const Frustum& frustum,
+            const glm::vec3& cameraPosition,
+            const Meshlet& meshlet,
+            const glm::mat4& modelMatrix,
+            const glm::mat3& normalMatrix,
+            bool coneCulling,
+            float margin = 0.f);
+
+    private:
+        struct CacheEntry {
+            const Model* model = nullptr;
+            // Last frame the entity was seen on; entities missing from a frame leave their tree
+            uint64_t frame = 0;
+            uint32_t transformVersion = 0;
+            // Tree handle, INVALID_HANDLE while the entity is in neither tree
+            uint32_t handle = RenderBvh::INVALID_HANDLE;
+            bool dynamic = false;
+            // Whether it is in m_movedEntities
+            bool moved = false;
+            // World sphere of the current transform, and as of the last test
+            glm::vec3 center{ 0.f };
+            float radius = 0.f;
+            glm::vec3 testedCenter{ 0.f };
+            float testedRadius = 0.f;
+            // Result of the last test, and the entity's position in m_visibleEntities while visible
+            bool visible = false;
+            uint32_t visibleIndex = 0;
+            // Planes of the walked frustum the box lay inside of at the last test, and the least
+            // distance it did by; none while culled
+            uint32_t insideMask = 0;
+            float insideSlack = 0.f;
+        };
+
+        bool updatePlaneNormals(const Frustum& frustum);
+        // Most any plane moved relative to the camera since the last walk
+        float getPlaneShift(const Frustum& frustum, const glm::vec3& cameraPosition) const;
+        // Brings both trees in line with the Model entities and notes which moved
+        void syncEntities(EntityManager& eManager);
+        void insertEntity(uint32_t entityID, CacheEntry& entry);
+        void removeEntity(uint32_t entityID, CacheEntry& entry);
+        void markMoved(uint32_t entityID, CacheEntry& entry);
+        // Culls everything by walking both trees
+        void walk(const Frustum& frustum, const glm::vec3& cameraPosition);
+        // Tests one entity against the walked frustum, the way the walk would have
+        void retest(uint32_t entityID, CacheEntry& entry);
+        void setVisible(uint32_t entityID, CacheEntry& entry, bool visible);
+        static BvhBounds sphereBounds(const CacheEntry& entry);
+
+        // Indexed by entity id
+        std::vector<CacheEntry> m_cache;
+        uint64_t m_frame = 0;
+        glm::vec3 m_planeNormals[6]{};
+
+        RenderBvh m_staticTree;
+        RenderBvh m_dynamicTree;
+        // Model entities of this frame and the last
+        std::vector<uint32_t> m_entities;
+        std::vector<uint32_t> m_lastEntities;
+
+        // Entities moved or added since the last update
+        std::vector<uint32_t> m_movedEntities;
+        bool m_walked = false;
+        Frustum m_walkedFrustum{};
+        glm::vec3 m_walkedCamera{ 0.f };
+        // Signed distance from the camera to each plane as of the last walk; only the
+        // projection changes it, e.g. the near and far distance
+        float m_walkedPlaneOffsets[6]{};
+
+        std::vector<uint32_t> m_visibleEntities;
+        std::vector<BvhCullHit> m_hits;
+        CullingStats m_stats{};
+    };
+} // namespace engine
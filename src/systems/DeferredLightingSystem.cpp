@@ -0,0 +1,199 @@
+#include "DeferredLightingSystem.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+namespace engine {
+
+    // constant_id of DEPTH_CLAMPED in light_volume.vert
+    static constexpr uint32_t DEPTH_CLAMPED_CONSTANT_ID = 0;
+
+    // Unit sphere with every triangle wound so its right-hand normal points outward. The
+    // vertices sit slightly outside radius 1 so the flat facets still enclose the unit sphere.
+    static Model::Builder createSphereBuilder(uint32_t rings, uint32_t segments) {
+        const float ringStep = glm::pi<float>() / rings;
+        const float segmentStep = glm::two_pi<float>() / segments;
+        const float scale = 1.f / (std::cos(ringStep * .5f) * std::cos(segmentStep * .5f));
+
+        Model::Builder builder{};
+        for (uint32_t ring = 0; ring <= rings; ring++) {
+            const float theta = ring * ringStep;
+            for (uint32_t segment = 0; segment <= segments; segment++) {
+                const float phi = segment * segmentStep;
+                Model::Vertex vertex{};
+                vertex.normal = glm::vec3(
+                    std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+                vertex.position = vertex.normal * scale;
+                vertex.color = glm::vec3(1.f);
+                builder.vertices.push_back(vertex);
+            }
+        }
+
+        const uint32_t rowLength = segments + 1;
+        for (uint32_t ring = 0; ring < rings; ring++) {
+            for (uint32_t segment = 0; segment < segments; segment++) {
+                const uint32_t a = ring * rowLength + segment;
+                const uint32_t b = a + rowLength;
+                const uint32_t c = b + 1;
+                const uint32_t d = a + 1;
+                builder.indices.insert(builder.indices.end(), { a, c, b, a, d, c });
+            }
+        }
+        return builder;
+    }
+
+    DeferredLightingSystem::DeferredLightingSystem(
+        Device& device,
+        PipelineBuildQueue& pipelineQueue,
+        VkRenderPass renderPass,
+        VkDescriptorSetLayout globalSetLayout) : m_device{ device } {
+        m_sphere = std::make_unique<Model>(m_device, createSphereBuilder(SPHERE_RINGS, SPHERE_SEGMENTS));
+        createGBufferSets();
+        createPipelineLayout(globalSetLayout);
+        createPipelines(pipelineQueue, renderPass);
+    }
+
+    DeferredLightingSystem::~DeferredLightingSystem() {
+        vkDestroyPipelineLayout(m_device.device(), m_pipelineLayout, nullptr);
+    }
+
+    void DeferredLightingSystem::createGBufferSets() {
+        m_gBufferSetLayout = DescriptorSetLayout::Builder(m_device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, VK_SHADER_STAGE_FRAGMENT_BIT)
+            .build();
+        m_gBufferPool = DescriptorPool::Builder(m_device)
+            .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, SwapChain::MAX_FRAMES_IN_FLIGHT * 3)
+            .build();
+        // Written once the first frame knows its swap chain image
+        for (auto& set : m_gBufferSets) {
+            if (!DescriptorWriter(*m_gBufferSetLayout, *m_gBufferPool).build(set)) {
+                throw std::runtime_error("failed to allocate G-buffer descriptor set");
+            }
+        }
+    }
+
+    void DeferredLightingSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout) {
+        std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+            globalSetLayout, m_gBufferSetLayout->getDescriptorSetLayout() };
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = 0;
+        pipelineLayoutInfo.pPushConstantRanges = nullptr;
+        if (vkCreatePipelineLayout(m_device.device(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("error while creating deferred lighting pipelineLayout");
+        }
+    }
+
+    void DeferredLightingSystem::createPipelines(PipelineBuildQueue& pipelineQueue, VkRenderPass renderPass) {
+        assert(m_pipelineLayout != VK_NULL_HANDLE && "Cannot create pipeline before pipeline layout");
+
+        // Both passes add into the swap chain image and never write the read-only depth
+        auto ambientConfig = std::make_unique<PipelineConfigInfo>();
+        Pipeline::defaultPipelineConfigInfo(*ambientConfig);
+        Pipeline::enableAdditiveBlending(*ambientConfig);
+        ambientConfig->bindingDescriptions.clear();
+        ambientConfig->attributeDescriptions.clear();
+        ambientConfig->depthStencilInfo.depthTestEnable = VK_FALSE;
+        ambientConfig->depthStencilInfo.depthWriteEnable = VK_FALSE;
+        ambientConfig->renderPass = renderPass;
+        ambientConfig->pipelineLayout = m_pipelineLayout;
+        ambientConfig->subpass = SwapChain::LIGHTING_SUBPASS;
+        m_pendingAmbientPipeline = pipelineQueue.submit(
+            "shaders/fullscreen.vert.spv", "shaders/deferred_ambient.frag.spv", std::move(ambientConfig));
+
+        auto lightConfig = std::make_unique<PipelineConfigInfo>();
+        Pipeline::defaultPipelineConfigInfo(*lightConfig);
+        Pipeline::enableAdditiveBlending(*lightConfig);
+        // light_volume.vert only reads the position
+        auto& attributes = lightConfig->attributeDescriptions;
+        attributes.erase(
+            std::remove_if(attributes.begin(), attributes.end(),
+                [](const VkVertexInputAttributeDescription& attribute) { return attribute.location != 0; }),
+            attributes.end());
+        // Only the far side of each volume is drawn, and only where the stored surface lies in
+        // front of it, so a light still covers its pixels when the camera is inside its range.
+        // Outward winding looks counter-clockwise in the y-down framebuffer.
+        lightConfig->rasterizationInfo.cullMode = VK_CULL_MODE_FRONT_BIT;
+        lightConfig->rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        lightConfig->depthStencilInfo.depthWriteEnable = VK_FALSE;
+        lightConfig->depthStencilInfo.depthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+        // That far side must not be clipped by the far plane either. Without depth clamping
+        // light_volume.vert flattens it onto the far plane instead.
+        lightConfig->rasterizationInfo.depthClampEnable = m_device.features.depthClamp;
+        Pipeline::setSpecializationConstant(
+            *lightConfig, DEPTH_CLAMPED_CONSTANT_ID, m_device.features.depthClamp ? VK_TRUE : VK_FALSE);
+        lightConfig->renderPass = renderPass;
+        lightConfig->pipelineLayout = m_pipelineLayout;
+        lightConfig->subpass = SwapChain::LIGHTING_SUBPASS;
+        m_pendingLightPipeline = pipelineQueue.submit(
+            "shaders/light_volume.vert.spv", "shaders/deferred_lighting.frag.spv", std::move(lightConfig));
+    }
+
+    void DeferredLightingSystem::resolvePipelines() {
+        // get() rethrows anything the build threw on its worker
+        if (m_pendingAmbientPipeline.valid()) {
+            m_ambientPipeline = m_pendingAmbientPipeline.get();
+        }
+        if (m_pendingLightPipeline.valid()) {
+            m_lightPipeline = m_pendingLightPipeline.get();
+        }
+    }
+
+    void DeferredLightingSystem::writeGBufferSet(int frameIndex, const GBufferViews& gBuffer) {
+        const GBufferViews& written = m_gBufferViews[frameIndex];
+        if (written.albedo == gBuffer.albedo && written.normal == gBuffer.normal && written.depth == gBuffer.depth) {
+            return;
+        }
+        // This frame's fence has been waited on, so the set is no longer in use
+        VkDescriptorImageInfo albedoInfo{ VK_NULL_HANDLE, gBuffer.albedo, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        VkDescriptorImageInfo normalInfo{ VK_NULL_HANDLE, gBuffer.normal, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        VkDescriptorImageInfo depthInfo{
+            VK_NULL_HANDLE, gBuffer.depth, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+        DescriptorWriter(*m_gBufferSetLayout, *m_gBufferPool)
+            .writeImage(0, &albedoInfo)
+            .writeImage(1, &normalInfo)
+            .writeImage(2, &depthInfo)
+            .overwrite(m_gBufferSets[frameIndex]);
+        m_gBufferViews[frameIndex] = gBuffer;
+    }
+
+    void DeferredLightingSystem::render(FrameInfo& frameInfo, const GBufferViews& gBuffer, uint32_t lightCount) {
+        resolvePipelines();
+        writeGBufferSet(frameInfo.frameIndex, gBuffer);
+
+        std::array<VkDescriptorSet, 2> sets{ frameInfo.globalDescriptorSet, m_gBufferSets[frameInfo.frameIndex] };
+        vkCmdBindDescriptorSets(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            m_pipelineLayout,
+            0,
+            static_cast<uint32_t>(sets.size()),
+            sets.data(),
+            0,
+            nullptr);
+
+        m_ambientPipeline->bind(frameInfo.commandBuffer);
+        vkCmdDraw(frameInfo.commandBuffer, 3, 1, 0, 0);
+
+        if (lightCount == 0) {
+            return;
+        }
+        // Sets stay bound, both pipelines share the layout
+        m_lightPipeline->bind(frameInfo.commandBuffer);
+        m_sphere->bind(frameInfo.commandBuffer);
+        m_sphere->draw(frameInfo.commandBuffer, lightCount);
+    }
+} // namespace engine
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Pipeline.hpp"
+#include "PipelineBuildQueue.hpp"
+#include "FrameInfo.hpp"
+#include "Descriptors.hpp"
+#include "Model.hpp"
+#include "SwapChain.hpp"
+
+#include <array>
+#include <future>
+#include <memory>
+
+namespace engine {
+
+    // Lighting subpass of the deferred path. A fullscreen triangle adds the ambient term, then
+    // every point light is drawn as one instance of a sphere scaled to its range, adding that
+    // light to the pixels it covers from the albedo, normal and depth input attachments. Each
+    // pixel is shaded once per light reaching it, no matter how many meshes were drawn over it.
+    class DeferredLightingSystem {
+    public:
+        // Tessellation of the light volume sphere
+        static constexpr uint32_t SPHERE_RINGS = 8;
+        static constexpr uint32_t SPHERE_SEGMENTS = 16;
+
+        // globalSetLayout must make the light buffer at binding 1 visible to the vertex stage
+        DeferredLightingSystem(
+            Device& device,
+            PipelineBuildQueue& pipelineQueue,
+            VkRenderPass renderPass,
+            VkDescriptorSetLayout globalSetLayout);
+        ~DeferredLightingSystem();
+
+        DeferredLightingSystem(const DeferredLightingSystem&) = delete;
+        DeferredLightingSystem& operator=(const DeferredLightingSystem&) = delete;
+
+        // Records into the lighting subpass of the current frame. The lights are the first
+        // lightCount entries of the buffer LightClusterSystem uploaded for this frame.
+        void render(FrameInfo& frameInfo, const GBufferViews& gBuffer, uint32_t lightCount);
+        // Call once the swap chain is recreated: the sets still point at destroyed views, and a
+        // new view may get the same handle, so every set is rewritten on its next use
+        void invalidateGBufferSets() { m_gBufferViews.fill({}); }
+
+    private:
+        void createGBufferSets();
+        void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+        void createPipelines(PipelineBuildQueue& pipelineQueue, VkRenderPass renderPass);
+        // Takes ownership of the pipelines once their builds finish, blocking if they have not
+        void resolvePipelines();
+        void writeGBufferSet(int frameIndex, const GBufferViews& gBuffer);
+
+        Device& m_device;
+        std::unique_ptr<Model> m_sphere;
+
+        std::unique_ptr<DescriptorSetLayout> m_gBufferSetLayout;
+        std::unique_ptr<DescriptorPool> m_gBufferPool;
+        // One set per frame in flight, pointed at whichever swap chain image that frame renders
+        std::array<VkDescriptorSet, SwapChain::MAX_FRAMES_IN_FLIGHT> m_gBufferSets{};
+        std::array<GBufferViews, SwapChain::MAX_FRAMES_IN_FLIGHT> m_gBufferViews{};
+
+        VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+        std::shared_ptr<Pipeline> m_ambientPipeline;
+        std::shared_ptr<Pipeline> m_lightPipeline;
+        std::future<std::shared_ptr<Pipeline>> m_pendingAmbientPipeline;
+        std::future<std::shared_ptr<Pipeline>> m_pendingLightPipeline;
+    };
+} // namespace engine
@@ -0,0 +1,215 @@
+#include "LightClusterSystem.hpp"
+#include "SwapChain.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace engine {
+
+    // Matches the cluster entries in clustered_lighting.glsl (std430 uvec2)
+    struct ClusterData {
+        uint32_t firstIndex;
+        uint32_t lightCount;
+    };
+
+    static std::unique_ptr<Buffer> createStorageBuffer(Device& device, VkDeviceSize instanceSize, uint32_t capacity) {
+        auto buffer = std::make_unique<Buffer>(
+            device,
+            instanceSize,
+            capacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        buffer->map();
+        return buffer;
+    }
+
+    LightClusterSystem::LightClusterSystem(
+        Device& device, DescriptorSetLayout& globalSetLayout, DescriptorPool& globalPool, bool binLights)
+        : m_device{ device }, m_binLights{ binLights }, m_globalSetLayout{ globalSetLayout }, m_globalPool{ globalPool } {
+        m_frames.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        for (auto& frame : m_frames) {
+            frame.lights = createStorageBuffer(m_device, sizeof(PointLight), INITIAL_LIGHT_CAPACITY);
+            frame.clusters = createStorageBuffer(m_device, sizeof(ClusterData), CLUSTER_COUNT);
+            frame.lightIndices = createStorageBuffer(m_device, sizeof(uint32_t), INITIAL_INDEX_CAPACITY);
+        }
+    }
+
+    LightClusterSystem::~LightClusterSystem() {}
+
+    float LightClusterSystem::getLightRange(const glm::vec4& color) {
+        const float intensity = color.w * std::max({ color.x, color.y, color.z });
+        return intensity > 0.f ? std::sqrt(intensity / LIGHT_CUTOFF) : 0.f;
+    }
+
+    uint32_t LightClusterSystem::getDepthSlice(float viewDepth) const {
+        const float slice = std::log(viewDepth) * m_sliceScale + m_sliceBias;
+        return static_cast<uint32_t>(std::clamp(slice, 0.f, static_cast<float>(CLUSTERS_Z - 1)));
+    }
+
+    bool LightClusterSystem::getClusterBounds(const PointLight& light, ClusterBounds& bounds) const {
+        const float range = getLightRange(light.color);
+        const glm::vec3 center{ m_view * glm::vec4(glm::vec3(light.position), 1.f) };
+        if (range <= 0.f || center.z + range < m_nearPlane || center.z - range > m_farPlane) {
+            return false;
+        }
+        bounds.minZ = getDepthSlice(std::max(center.z - range, m_nearPlane));
+        bounds.maxZ = getDepthSlice(std::min(center.z + range, m_farPlane));
+        bounds.minX = 0;
+        bounds.maxX = CLUSTERS_X - 1;
+        bounds.minY = 0;
+        bounds.maxY = CLUSTERS_Y - 1;
+        // A box reaching behind the near plane has no finite projection; keep every tile
+        if (center.z - range <= m_nearPlane) {
+            return true;
+        }
+
+        // The projection of the light's view-space box is bounded by its projected corners
+        glm::vec2 ndcMin{ std::numeric_limits<float>::max() };
+        glm::vec2 ndcMax{ std::numeric_limits<float>::lowest() };
+        for (int corner = 0; corner < 8; corner++) {
+            const glm::vec3 offset{
+                (corner & 1) ? range : -range,
+                (corner & 2) ? range : -range,
+                (corner & 4) ? range : -range };
+            const glm::vec4 clip = m_projection * glm::vec4(center + offset, 1.f);
+            const glm::vec2 ndc = glm::vec2(clip) / clip.w;
+            ndcMin = glm::min(ndcMin, ndc);
+            ndcMax = glm::max(ndcMax, ndc);
+        }
+        if (ndcMax.x < -1.f || ndcMin.x > 1.f || ndcMax.y < -1.f || ndcMin.y > 1.f) {
+            return false;
+        }
+
+        // Vulkan NDC and framebuffer y both point down, so tiles map without a flip
+        const glm::vec2 pixelMin = (glm::clamp(ndcMin, -1.f, 1.f) * .5f + .5f) * m_extent;
+        const glm::vec2 pixelMax = (glm::clamp(ndcMax, -1.f, 1.f) * .5f + .5f) * m_extent;
+        bounds.minX = std::min(static_cast<uint32_t>(pixelMin.x / m_tileSize.x), CLUSTERS_X - 1);
+        bounds.maxX = std::min(static_cast<uint32_t>(pixelMax.x / m_tileSize.x), CLUSTERS_X - 1);
+        bounds.minY = std::min(static_cast<uint32_t>(pixelMin.y / m_tileSize.y), CLUSTERS_Y - 1);
+        bounds.maxY = std::min(static_cast<uint32_t>(pixelMax.y / m_tileSize.y), CLUSTERS_Y - 1);
+        return true;
+    }
+
+    void LightClusterSystem::update(
+        FrameInfo& frameInfo, const std::vector<PointLight>& lights, VkExtent2D extent, GlobalUbo& ubo) {
+        FrameResources& frame = m_frames[frameInfo.frameIndex];
+        const Camera& camera = frameInfo.camera;
+        m_view = camera.getView();
+        m_projection = camera.getProjection();
+        m_nearPlane = camera.getNearPlane();
+        m_farPlane = camera.getFarPlane();
+        // Slices are spaced exponentially in depth, so clusters stay roughly cube shaped
+        const float logDepthRatio = std::log(m_farPlane / m_nearPlane);
+        m_sliceScale = CLUSTERS_Z / logDepthRatio;
+        m_sliceBias = -(CLUSTERS_Z * std::log(m_nearPlane)) / logDepthRatio;
+        m_extent = glm::vec2(extent.width, extent.height);
+        m_tileSize = glm::vec2(
+            std::max(1u, (extent.width + CLUSTERS_X - 1) / CLUSTERS_X),
+            std::max(1u, (extent.height + CLUSTERS_Y - 1) / CLUSTERS_Y));
+
+        const uint32_t lightCount = static_cast<uint32_t>(lights.size());
+        m_stats = {};
+        m_stats.lights = lightCount;
+        if (m_binLights) {
+            binLights(frame, lights);
+        } else {
+            ensureCapacity(frame, lightCount, 0);
+        }
+
+        auto* gpuLights = static_cast<PointLight*>(frame.lights->getMappedMemory());
+        for (uint32_t i = 0; i < lightCount; i++) {
+            gpuLights[i] = lights[i];
+            gpuLights[i].position.w = getLightRange(lights[i].color);
+        }
+        if (lightCount > 0) {
+            frame.lights->flush();
+        }
+
+        if (frame.descriptorsDirty) {
+            writeDescriptors(frame, frameInfo.globalDescriptorSet);
+        }
+
+        ubo.clusterCounts = glm::uvec4(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z, lightCount);
+        ubo.clusterDepth = glm::vec4(m_nearPlane, m_farPlane, m_sliceScale, m_sliceBias);
+        ubo.clusterTileSize = glm::vec4(m_tileSize, 0.f, 0.f);
+    }
+
+    void LightClusterSystem::binLights(FrameResources& frame, const std::vector<PointLight>& lights) {
+        // First pass: the clusters each light overlaps and how many lights land in each cluster
+        const uint32_t lightCount = static_cast<uint32_t>(lights.size());
+        m_lightBounds.resize(lightCount);
+        m_clusterOffsets.assign(CLUSTER_COUNT + 1, 0);
+        for (uint32_t i = 0; i < lightCount; i++) {
+            ClusterBounds& bounds = m_lightBounds[i];
+            if (!getClusterBounds(lights[i], bounds)) {
+                // Empty z range, so the loops below skip it
+                bounds = { 0, 0, 0, 0, 1, 0 };
+                continue;
+            }
+            for (uint32_t z = bounds.minZ; z <= bounds.maxZ; z++) {
+                for (uint32_t y = bounds.minY; y <= bounds.maxY; y++) {
+                    for (uint32_t x = bounds.minX; x <= bounds.maxX; x++) {
+                        m_clusterOffsets[(z * CLUSTERS_Y + y) * CLUSTERS_X + x + 1]++;
+                    }
+                }
+            }
+        }
+
+        auto* clusters = static_cast<ClusterData*>(frame.clusters->getMappedMemory());
+        for (uint32_t c = 0; c < CLUSTER_COUNT; c++) {
+            const uint32_t count = m_clusterOffsets[c + 1];
+            m_stats.maxLightsPerCluster = std::max(m_stats.maxLightsPerCluster, count);
+            m_clusterOffsets[c + 1] += m_clusterOffsets[c];
+            clusters[c] = { m_clusterOffsets[c], count };
+        }
+        const uint32_t indexCount = m_clusterOffsets[CLUSTER_COUNT];
+        m_stats.lightIndices = indexCount;
+        frame.clusters->flush();
+
+        ensureCapacity(frame, lightCount, indexCount);
+
+        // Second pass: fill in the light lists, each in ascending light order
+        m_clusterCursors.assign(m_clusterOffsets.begin(), m_clusterOffsets.end() - 1);
+        auto* indices = static_cast<uint32_t*>(frame.lightIndices->getMappedMemory());
+        for (uint32_t i = 0; i < lightCount; i++) {
+            const ClusterBounds& bounds = m_lightBounds[i];
+            for (uint32_t z = bounds.minZ; z <= bounds.maxZ; z++) {
+                for (uint32_t y = bounds.minY; y <= bounds.maxY; y++) {
+                    for (uint32_t x = bounds.minX; x <= bounds.maxX; x++) {
+                        indices[m_clusterCursors[(z * CLUSTERS_Y + y) * CLUSTERS_X + x]++] = i;
+                    }
+                }
+            }
+        }
+        if (indexCount > 0) {
+            frame.lightIndices->flush();
+        }
+    }
+
+    void LightClusterSystem::ensureCapacity(FrameResources& frame, uint32_t lightCount, uint32_t indexCount) {
+        // This frame's fence has been waited on, so the old buffers are no longer in use
+        if (lightCount > frame.lights->getInstanceCount()) {
+            frame.lights = createStorageBuffer(
+                m_device, sizeof(PointLight), std::max(lightCount, frame.lights->getInstanceCount() * 2));
+            frame.descriptorsDirty = true;
+        }
+        if (indexCount > frame.lightIndices->getInstanceCount()) {
+            frame.lightIndices = createStorageBuffer(
+                m_device, sizeof(uint32_t), std::max(indexCount, frame.lightIndices->getInstanceCount() * 2));
+            frame.descriptorsDirty = true;
+        }
+    }
+
+    void LightClusterSystem::writeDescriptors(FrameResources& frame, VkDescriptorSet globalSet) {
+        auto lightInfo = frame.lights->descriptorInfo();
+        auto clusterInfo = frame.clusters->descriptorInfo();
+        auto indexInfo = frame.lightIndices->descriptorInfo();
+        DescriptorWriter(m_globalSetLayout, m_globalPool)
+            .writeBuffer(1, &lightInfo)
+            .writeBuffer(2, &clusterInfo)
+            .writeBuffer(3, &indexInfo)
+            .overwrite(globalSet);
+        frame.descriptorsDirty = false;
+    }
+} // namespace engine
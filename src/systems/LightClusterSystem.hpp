@@ -0,0 +1,99 @@
+#pragma once
+
+#include "FrameInfo.hpp"
+#include "Buffer.hpp"
+#include "Descriptors.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace engine {
+
+    struct LightClusterStats {
+        uint32_t lights{ 0 };
+        // Entries in all cluster light lists together
+        uint32_t lightIndices{ 0 };
+        uint32_t maxLightsPerCluster{ 0 };
+    };
+
+    // Clustered forward lighting. Each frame the view frustum is split into a grid of screen
+    // tiles times exponentially spaced depth slices, every light is binned into the clusters
+    // its range overlaps, and the lights, per-cluster lists and grid go into storage buffers
+    // at bindings 1-3 of the global set. A fragment then only shades the lights of its own
+    // cluster, so its cost follows local light density instead of the scene's light count.
+    class LightClusterSystem {
+    public:
+        static constexpr uint32_t CLUSTERS_X = 16;
+        static constexpr uint32_t CLUSTERS_Y = 9;
+        static constexpr uint32_t CLUSTERS_Z = 24;
+        static constexpr uint32_t CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+        static constexpr uint32_t INITIAL_LIGHT_CAPACITY = 64;
+        static constexpr uint32_t INITIAL_INDEX_CAPACITY = 4096;
+        // Lights are cut off where inverse square falloff drops below this irradiance
+        static constexpr float LIGHT_CUTOFF = 0.01f;
+
+        // globalSetLayout must declare storage buffers at bindings 1-3 for the fragment stage.
+        // Each frame's global set is pointed at that frame's buffers, again whenever they grow.
+        // Without binLights only the light buffer is filled, which is all the deferred path reads.
+        LightClusterSystem(
+            Device& device, DescriptorSetLayout& globalSetLayout, DescriptorPool& globalPool, bool binLights = true);
+        ~LightClusterSystem();
+
+        LightClusterSystem(const LightClusterSystem&) = delete;
+        LightClusterSystem& operator=(const LightClusterSystem&) = delete;
+
+        // Bins lights for this frame's camera and extent, uploads them and fills in the cluster
+        // fields of ubo. Must run before anything using frameInfo.globalDescriptorSet is recorded.
+        void update(FrameInfo& frameInfo, const std::vector<PointLight>& lights, VkExtent2D extent, GlobalUbo& ubo);
+
+        // Distance at which a light of this color and intensity (w) reaches LIGHT_CUTOFF
+        static float getLightRange(const glm::vec4& color);
+
+        const LightClusterStats& getStats() const { return m_stats; }
+
+    private:
+        struct FrameResources {
+            std::unique_ptr<Buffer> lights;
+            std::unique_ptr<Buffer> clusters;
+            std::unique_ptr<Buffer> lightIndices;
+            bool descriptorsDirty = true;
+        };
+
+        // Inclusive cluster coordinates a light overlaps
+        struct ClusterBounds {
+            uint32_t minX, maxX;
+            uint32_t minY, maxY;
+            uint32_t minZ, maxZ;
+        };
+
+        // Fills the cluster grid and light index lists; also grows the buffers to fit
+        void binLights(FrameResources& frame, const std::vector<PointLight>& lights);
+        void ensureCapacity(FrameResources& frame, uint32_t lightCount, uint32_t indexCount);
+        void writeDescriptors(FrameResources& frame, VkDescriptorSet globalSet);
+        // False when the light's range misses the view volume
+        bool getClusterBounds(const PointLight& light, ClusterBounds& bounds) const;
+        uint32_t getDepthSlice(float viewDepth) const;
+
+        Device& m_device;
+        bool m_binLights;
+        DescriptorSetLayout& m_globalSetLayout;
+        DescriptorPool& m_globalPool;
+        std::vector<FrameResources> m_frames;
+
+        // Scratch reused every frame
+        std::vector<ClusterBounds> m_lightBounds;
+        std::vector<uint32_t> m_clusterOffsets;
+        std::vector<uint32_t> m_clusterCursors;
+
+        // View of the frame being binned
+        glm::mat4 m_view{ 1.f };
+        glm::mat4 m_projection{ 1.f };
+        float m_nearPlane = 0.f;
+        float m_farPlane = 0.f;
+        float m_sliceScale = 0.f;
+        float m_sliceBias = 0.f;
+        glm::vec2 m_extent{ 0.f };
+        glm::vec2 m_tileSize{ 1.f };
+        LightClusterStats m_stats{};
+    };
+} // namespace engine
@@ -0,0 +1,70 @@
+#include "LodSystem.hpp"
+
+#include "CullingSystem.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace engine {
+
+    LodSystem::LodSystem() {}
+
+    LodSystem::~LodSystem() {}
+
+    void LodSystem::update(FrameInfo& frameInfo) {
+        EntityManager& eManager = frameInfo.entityManager;
+        const glm::mat4 view = frameInfo.camera.getView();
+        const glm::mat4 projection = frameInfo.camera.getProjection();
+        std::fill(m_stats.entitiesPerLod.begin(), m_stats.entitiesPerLod.end(), 0);
+
+        for (const uint32_t entityID : eManager.getEntitiesWithComponent(ComponentType::Model)) {
+            if (!eManager.entityExists(entityID)) {
+                continue;
+            }
+            ModelComponent modelComponent = eManager.getComponentData<ModelComponent>(entityID);
+            const uint32_t lodCount = modelComponent.model->getLodCount();
+            uint32_t lod = 0;
+            if (lodCount > 1) {
+                TransformComponent transform = eManager.getComponentData<TransformComponent>(entityID);
+                const BoundingSphere sphere = CullingSystem::getWorldSphere(*modelComponent.model, transform);
+                const glm::vec4 viewCenter = view * glm::vec4(sphere.center, 1.f);
+                // Clip w is the view depth for a perspective projection and 1 for an orthographic one
+                const float clipW = projection[2][3] * viewCenter.z + projection[3][3];
+
+                // A camera inside the sphere keeps full detail
+                if (clipW > sphere.radius) {
+                    const float screenSize = sphere.radius * std::abs(projection[1][1]) / clipW;
+                    lod = selectLod(screenSize, lodCount, modelComponent.lod);
+                }
+            }
+
+            if (lod != modelComponent.lod) {
+                modelComponent.lod = lod;
+                eManager.setComponentData(entityID, modelComponent);
+            }
+            if (m_stats.entitiesPerLod.size() <= lod) {
+                m_stats.entitiesPerLod.resize(lod + 1, 0);
+            }
+            m_stats.entitiesPerLod[lod]++;
+        }
+    }
+
+    uint32_t LodSystem::selectLod(float screenSize, uint32_t lodCount) {
+        if (lodCount <= 1 || screenSize >= FULL_DETAIL_SCREEN_SIZE) {
+            return 0;
+        }
+        if (screenSize <= 0.f) {
+            return lodCount - 1;
+        }
+        // Every halving of the screen size below the full detail threshold drops one level
+        const float halvings = std::log2(FULL_DETAIL_SCREEN_SIZE / screenSize);
+        return std::min(static_cast<uint32_t>(halvings) + 1, lodCount - 1);
+    }
+
+    uint32_t LodSystem::selectLod(float screenSize, uint32_t lodCount, uint32_t current) {
+        // Only leave the current level once the size is clear of its thresholds
+        const uint32_t finest = selectLod(screenSize * (1.f + HYSTERESIS), lodCount);
+        const uint32_t coarsest = selectLod(screenSize * (1.f - HYSTERESIS), lodCount);
+        return std::clamp(std::min(current, lodCount - 1), finest, coarsest);
+    }
+} // namespace engine
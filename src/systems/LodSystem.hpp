@@ -0,0 +1,45 @@
+#pragma once
+
+#include "FrameInfo.hpp"
+
+#include <vector>
+
+namespace engine {
+
+    struct LodStats {
+        // Entities drawn at each level of detail in the last update
+        std::vector<uint32_t> entitiesPerLod;
+    };
+
+    // Picks the level of detail of every Model entity from the height its world-space
+    // bounding sphere covers on screen. Level 0 is kept down to FULL_DETAIL_SCREEN_SIZE and
+    // each further level takes over at half the size of the one before. A hysteresis band
+    // around every threshold keeps entities near one from switching back and forth while
+    // the camera moves. Run it before any system that records draws.
+    class LodSystem {
+    public:
+        // Fraction of the viewport height below which level 1 may be used
+        static constexpr float FULL_DETAIL_SCREEN_SIZE = 0.25f;
+        // Relative change in screen size needed to leave the current level
+        static constexpr float HYSTERESIS = 0.15f;
+
+        LodSystem();
+        ~LodSystem();
+
+        LodSystem(const LodSystem&) = delete;
+        LodSystem& operator=(const LodSystem&) = delete;
+
+        void update(FrameInfo& frameInfo);
+
+        const LodStats& getStats() const { return m_stats; }
+
+        // Level for a sphere covering screenSize of the viewport height, without hysteresis
+        static uint32_t selectLod(float screenSize, uint32_t lodCount);
+        // Level for the same sphere drawn at current last frame, which it only leaves once the
+        // size is HYSTERESIS clear of the thresholds around it
+        static uint32_t selectLod(float screenSize, uint32_t lodCount, uint32_t current);
+
+    private:
+        LodStats m_stats{};
+    };
+} // namespace engine
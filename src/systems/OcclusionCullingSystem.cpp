@@ -0,0 +1,110 @@
+#include "OcclusionCullingSystem.hpp"
+
+#include <chrono>
+
+namespace engine {
+
+    static bool sameTransform(const TransformComponent& a, const TransformComponent& b) {
+        return a.translation == b.translation && a.rotation == b.rotation && a.scale == b.scale;
+    }
+
+    OcclusionCullingSystem::OcclusionCullingSystem(JobPool& jobPool)
+        : m_buffer{ BUFFER_WIDTH, BUFFER_HEIGHT, jobPool } {}
+
+    OcclusionCullingSystem::~OcclusionCullingSystem() {}
+
+    void OcclusionCullingSystem::update(FrameInfo& frameInfo, const std::vector<uint32_t>& candidates) {
+        EntityManager& eManager = frameInfo.entityManager;
+        const glm::mat4 viewProjection = frameInfo.camera.getProjection() * frameInfo.camera.getView();
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // Occluders outside the frustum cover no pixels, so only candidates are rasterized
+        m_stats = {};
+        m_occluders.clear();
+        for (const uint32_t entityID : candidates) {
+            const ModelComponent& modelComponent = eManager.getComponentData<ModelComponent>(entityID);
+            const Model& model = *modelComponent.model;
+            if (!modelComponent.occluder || model.getIndices().empty()) {
+                continue;
+            }
+            TransformComponent transform = eManager.getComponentData<TransformComponent>(entityID);
+            const MeshLod& fullDetail = model.getLod(0);
+
+            MaskedOcclusionBuffer::Occluder occluder;
+            occluder.positions = &model.getVertices()[0].position;
+            occluder.stride = sizeof(Model::Vertex);
+            occluder.indices = model.getIndices().data() + fullDetail.firstIndex;
+            occluder.indexCount = fullDetail.indexCount;
+            occluder.modelViewProjection = viewProjection * transform.mat4();
+            m_occluders.push_back(occluder);
+        }
+        m_stats.occluders = static_cast<uint32_t>(m_occluders.size());
+
+        if (occludersChanged(viewProjection)) {
+            m_buffer.clear();
+            for (const auto& occluder : m_occluders) {
+                m_buffer.addOccluder(occluder);
+            }
+            m_buffer.rasterize();
+            m_rasterizedOccluders = m_occluders;
+            m_rasterizedViewProjection = viewProjection;
+            m_bufferEpoch++;
+            m_stats.rasterized = true;
+        }
+        m_stats.triangles = m_buffer.getTriangleCount();
+
+        auto rasterized = std::chrono::high_resolution_clock::now();
+        m_visibleEntities.clear();
+        for (const uint32_t entityID : candidates) {
+            if (entityID >= m_cache.size()) {
+                m_cache.resize(entityID + 1);
+            }
+            CacheEntry& entry = m_cache[entityID];
+            const Model* model = eManager.getComponentData<ModelComponent>(entityID).model.get();
+            const uint32_t transformVersion = eManager.getTransformVersion(entityID);
+            const TransformComponent& transform = eManager.getComponentData<TransformComponent>(entityID);
+            // A transform set to the same values still bumps the version, so compare those
+            const bool unchanged = entry.model == model && entry.bufferEpoch == m_bufferEpoch &&
+                (entry.transformVersion == transformVersion || sameTransform(entry.transform, transform));
+
+            if (unchanged) {
+                m_stats.reused++;
+            } else {
+                TransformComponent modelTransform = transform;
+                const BoundingBox box = model->getBoundingBox();
+                entry.visible = m_buffer.isBoxVisible(box.min, box.max, viewProjection * modelTransform.mat4());
+                entry.model = model;
+                entry.bufferEpoch = m_bufferEpoch;
+                entry.transform = transform;
+            }
+            entry.transformVersion = transformVersion;
+            if (entry.visible) {
+                m_visibleEntities.push_back(entityID);
+            }
+        }
+        m_stats.tested = static_cast<uint32_t>(candidates.size()) - m_stats.reused;
+        m_stats.occluded = static_cast<uint32_t>(candidates.size() - m_visibleEntities.size());
+
+        auto tested = std::chrono::high_resolution_clock::now();
+        m_stats.rasterMs = std::chrono::duration<float, std::chrono::milliseconds::period>(rasterized - start).count();
+        m_stats.testMs = std::chrono::duration<float, std::chrono::milliseconds::period>(tested - rasterized).count();
+    }
+
+    bool OcclusionCullingSystem::occludersChanged(const glm::mat4& viewProjection) const {
+        // The first update always rasterizes, whatever it finds
+        if (m_bufferEpoch == 0 || viewProjection != m_rasterizedViewProjection ||
+            m_occluders.size() != m_rasterizedOccluders.size()) {
+            return true;
+        }
+        for (size_t i = 0; i < m_occluders.size(); i++) {
+            const auto& occluder = m_occluders[i];
+            const auto& rasterized = m_rasterizedOccluders[i];
+            if (occluder.positions != rasterized.positions || occluder.indices != rasterized.indices ||
+                occluder.indexCount != rasterized.indexCount ||
+                occluder.modelViewProjection != rasterized.modelViewProjection) {
+                return true;
+            }
+        }
+        return false;
+    }
+} // namespace engine
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "FrameInfo.hpp"
+#include "MaskedOcclusionBuffer.hpp"
+
+#include <vector>
+
+namespace engine {
+
+    struct OcclusionStats {
+        uint32_t occluders{ 0 };
+        // Occluder triangles rasterized after near plane clipping
+        uint32_t triangles{ 0 };
+        uint32_t tested{ 0 };
+        uint32_t occluded{ 0 };
+        // Candidates whose result was kept from the last frame instead of being tested
+        uint32_t reused{ 0 };
+        // False when nothing the buffer depends on changed, so the last one was kept
+        bool rasterized{ false };
+        // Wall time of rasterization and of the box tests in the last update
+        float rasterMs{ 0.f };
+        float testMs{ 0.f };
+    };
+
+    // CPU occlusion culling for the CPU culling path. Every candidate flagged as an occluder
+    // (ModelComponent::occluder) is rasterized into a MaskedOcclusionBuffer, then the bounding
+    // box of every candidate, occluders included, is tested against it. Run it after the
+    // CullingSystem and hand its visible entities to whatever records draws.
+    //
+    // The buffer is only rebuilt when the camera or an occluder moves, and a candidate is only
+    // retested when the buffer was rebuilt or the candidate itself moved. Unlike frustum
+    // culling there is no motion threshold: a hidden result stays right only while nothing moves.
+    class OcclusionCullingSystem {
+    public:
+        static constexpr uint32_t BUFFER_WIDTH = 256;
+        static constexpr uint32_t BUFFER_HEIGHT = 128;
+
+        // Rasterizes across the workers of jobPool
+        explicit OcclusionCullingSystem(JobPool& jobPool);
+        ~OcclusionCullingSystem();
+
+        OcclusionCullingSystem(const OcclusionCullingSystem&) = delete;
+        OcclusionCullingSystem& operator=(const OcclusionCullingSystem&) = delete;
+
+        // candidates are entity ids that passed frustum culling, e.g. CullingSystem's
+        void update(FrameInfo& frameInfo, const std::vector<uint32_t>& candidates);
+
+        // Candidates of the last update that may be visible, in candidate order
+        const std::vector<uint32_t>& getVisibleEntities() const { return m_visibleEntities; }
+        const OcclusionStats& getStats() const { return m_stats; }
+        const MaskedOcclusionBuffer& getBuffer() const { return m_buffer; }
+
+    private:
+        struct CacheEntry {
+            const Model* model = nullptr;
+            uint32_t bufferEpoch = 0;
+            uint32_t transformVersion = 0;
+            TransformComponent transform{};
+            bool visible = false;
+        };
+
+        // Whether the occluders gathered this frame rasterize differently from the last ones
+        bool occludersChanged(const glm::mat4& viewProjection) const;
+
+        MaskedOcclusionBuffer m_buffer;
+        // Occluders of this frame and of the last rasterization
+        std::vector<MaskedOcclusionBuffer::Occluder> m_occluders;
+        std::vector<MaskedOcclusionBuffer::Occluder> m_rasterizedOccluders;
+        glm::mat4 m_rasterizedViewProjection{ 0.f };
+        // Changes whenever the buffer is rebuilt
+        uint32_t m_bufferEpoch = 0;
+        // Indexed by entity id
+        std::vector<CacheEntry> m_cache;
+        std::vector<uint32_t> m_visibleEntities;
+        OcclusionStats m_stats{};
+    };
+} // namespace engine
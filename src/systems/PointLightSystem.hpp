@@ -1,6 +1,7 @@
 #pragma once
 
-#include "Pipeline.hpp"
+#include "BillboardBatch.hpp"
+#include "PipelineBuildQueue.hpp"
 #include "FrameInfo.hpp"
 
 namespace engine {
@@ -8,24 +9,25 @@ namespace engine {
 	class PointLightSystem {
 	public:
 
+		// subpass is SwapChain::LIGHTING_SUBPASS on the deferred path, where depth is read-only
 		PointLightSystem(
 			Device& device, 
+			PipelineBuildQueue& pipelineQueue,
 			VkRenderPass renderPass,
-			VkDescriptorSetLayout globalSetLayout
+			VkDescriptorSetLayout globalSetLayout,
+			uint32_t subpass = 0
 		);
 		~PointLightSystem();
 
 		PointLightSystem(const PointLightSystem&) = delete;
 		PointLightSystem& operator=(const PointLightSystem&) = delete;
 
-		void update(FrameInfo& frameInfo, GlobalUbo &ubo);
+		// Animates the lights, gathers them for LightClusterSystem and prepares their billboards
+		void update(FrameInfo& frameInfo, std::vector<PointLight>& lights);
 		void render(FrameInfo& frameInfo);
-	private:
-		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-		void createPipeline(VkRenderPass renderPass);
 
-		Device& m_device;
-		std::unique_ptr<Pipeline> m_pipeline;
-		VkPipelineLayout m_pipelineLayout;
+		const BillboardStats& getStats() const { return m_billboards.getStats(); }
+	private:
+		BillboardBatch m_billboards;
 	};
 } // namespace engine
\ No newline at end of file
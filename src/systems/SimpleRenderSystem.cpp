@@ -1,4 +1,5 @@
 #include "SimpleRenderSystem.hpp"
+#include "CullingSystem.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -8,67 +9,823 @@
 #include <stdexcept>
 #include <array>
 #include <cassert>
+#include <algorithm>
+#include <functional>
+#include <iostream>
 
 namespace engine {
 
-    struct SimplePushConstantData
-    {
-        glm::mat4 modelMatrix{ 1.f };
-        glm::mat4 normalMatrix{ 1.f };
-    };
+    // Normal cones stay valid under rotation and uniform scale only
+    static bool isUniformlyScaled(const glm::mat4& modelMatrix) {
+        const float x = glm::length(glm::vec3(modelMatrix[0]));
+        const float y = glm::length(glm::vec3(modelMatrix[1]));
+        const float z = glm::length(glm::vec3(modelMatrix[2]));
+        const float tolerance = 1e-3f * std::max({ x, y, z });
+        return std::abs(x - y) <= tolerance && std::abs(y - z) <= tolerance;
+    }
+
+    // constant_id values declared in surface_texture.glsl
+    static constexpr uint32_t TEXTURED_CONSTANT_ID = 0;
+    static constexpr uint32_t DISCARD_MODE_CONSTANT_ID = 1;
+    // DISCARD_MODE values
+    static constexpr uint32_t DISCARD_NONE = 0;
+    static constexpr uint32_t DISCARD_CUT_AWAY = 1;
+
+    static void beginScope(FrameInfo& frameInfo, VkCommandBuffer commandBuffer, GpuScope scope) {
+        if (frameInfo.gpuTimer != nullptr) {
+            frameInfo.gpuTimer->begin(commandBuffer, scope);
+        }
+    }
+
+    static void endScope(FrameInfo& frameInfo, VkCommandBuffer commandBuffer, GpuScope scope) {
+        if (frameInfo.gpuTimer != nullptr) {
+            frameInfo.gpuTimer->end(commandBuffer, scope);
+        }
+    }
 
     SimpleRenderSystem::SimpleRenderSystem(
         Device& device,
+        PipelineBuildQueue& pipelineQueue,
         VkRenderPass renderPass,
         VkDescriptorSetLayout globalSetLayout,
-        VkDescriptorSetLayout textureSetLayout
-    ) : m_device{ device } {
+        VkDescriptorSetLayout textureSetLayout,
+        VkDescriptorSet defaultTextureSet,
+        CullingMode cullingMode,
+        VkDescriptorSet bindlessTextureSet,
+        RenderPath renderPath,
+        bool depthPrePass,
+        HiZPyramid* hiZPyramid
+    ) : m_device{ device }, m_cullingMode{ cullingMode }, m_bindlessTextureSet{ bindlessTextureSet },
+        m_defaultTextureSet{ defaultTextureSet }, m_renderPath{ renderPath }, m_depthPrePass{ depthPrePass }, m_hiZPyramid{ hiZPyramid } {
+        if (m_cullingMode == CullingMode::Gpu && !m_device.features.drawIndirectFirstInstance) {
+            std::cout << "drawIndirectFirstInstance not supported, culling on the CPU" << std::endl;
+            m_cullingMode = CullingMode::Cpu;
+        }
+        // The deferred pass keeps depth in one render pass with the lighting subpass
+        if (m_hiZPyramid != nullptr && (m_cullingMode != CullingMode::Gpu || m_renderPath != RenderPath::Forward)) {
+            std::cout << "occlusion culling needs GPU culling on the forward path, disabled" << std::endl;
+            m_hiZPyramid = nullptr;
+        }
+        assert((isBindless() || m_defaultTextureSet != VK_NULL_HANDLE) &&
+            "Untextured draws need a default texture set unless textures are bindless");
+        createFrameResources();
         createPipelineLayout(globalSetLayout, textureSetLayout);
-        createPipeline(renderPass);
+        createPipelines(pipelineQueue, renderPass);
+        if (m_cullingMode == CullingMode::Gpu) {
+            createCullPipeline(pipelineQueue);
+        }
     }
 
     SimpleRenderSystem::~SimpleRenderSystem() {
         vkDestroyPipelineLayout(m_device.device(), m_pipelineLayout, nullptr);
+        if (m_cullPipelineLayout != VK_NULL_HANDLE) {
+            vkDestroyPipelineLayout(m_device.device(), m_cullPipelineLayout, nullptr);
+        }
+    }
+
+    void SimpleRenderSystem::createFrameResources() {
+        m_instanceSetLayout = DescriptorSetLayout::Builder(m_device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .build();
+        m_cullSetLayout = DescriptorSetLayout::Builder(m_device)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+            .build();
+        m_framePool = DescriptorPool::Builder(m_device)
+            .setMaxSets(SwapChain::MAX_FRAMES_IN_FLIGHT * 2)
+            .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, SwapChain::MAX_FRAMES_IN_FLIGHT * 9)
+            .build();
+
+        m_frames.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        for (auto& frame : m_frames) {
+            createInstanceBuffers(frame, INITIAL_INSTANCE_CAPACITY, INITIAL_INSTANCE_CAPACITY);
+            if (m_cullingMode == CullingMode::Gpu) {
+                createDrawBuffer(frame, INITIAL_DRAW_CAPACITY);
+                createMeshletBuffer(frame, INITIAL_MESHLET_CAPACITY);
+            }
+            writeFrameDescriptors(frame);
+        }
+    }
+
+    void SimpleRenderSystem::createInstanceBuffers(
+        FrameResources& frame, uint32_t instanceCapacity, uint32_t visibleCapacity) {
+        frame.instances = std::make_unique<Buffer>(
+            m_device,
+            sizeof(InstanceData),
+            instanceCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        frame.instances->map();
+
+        // Written by the host in Cpu mode and by instance_cull.comp in Gpu mode
+        frame.visibleIndices = std::make_unique<Buffer>(
+            m_device,
+            sizeof(uint32_t),
+            visibleCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            m_cullingMode == CullingMode::Gpu ?
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        if (m_cullingMode == CullingMode::Cpu) {
+            frame.visibleIndices->map();
+            return;
+        }
+
+        frame.cullData = std::make_unique<Buffer>(
+            m_device,
+            sizeof(CullData),
+            instanceCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        frame.cullData->map();
+
+        // Written by the first culling phase even without occlusion culling, which keeps the
+        // shader free of a variant without it
+        frame.occludedFlags = std::make_unique<Buffer>(
+            m_device,
+            sizeof(uint32_t),
+            instanceCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+
+    void SimpleRenderSystem::createDrawBuffer(FrameResources& frame, uint32_t drawCapacity) {
+        // Host visible so instance counts can be zeroed each frame and read back for stats
+        frame.drawCommands = std::make_unique<Buffer>(
+            m_device,
+            sizeof(VkDrawIndexedIndirectCommand),
+            drawCapacity,
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        frame.drawCommands->map();
+        frame.drawCount = 0;
+    }
+
+    void SimpleRenderSystem::createMeshletBuffer(FrameResources& frame, uint32_t meshletCapacity) {
+        frame.meshletBounds = std::make_unique<Buffer>(
+            m_device,
+            sizeof(MeshletBounds),
+            meshletCapacity,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        frame.meshletBounds->map();
+    }
+
+    void SimpleRenderSystem::writeFrameDescriptors(FrameResources& frame) {
+        auto instanceInfo = frame.instances->descriptorInfo();
+        auto visibleInfo = frame.visibleIndices->descriptorInfo();
+        DescriptorWriter instanceWriter{ *m_instanceSetLayout, *m_framePool };
+        instanceWriter
+            .writeBuffer(0, &instanceInfo)
+            .writeBuffer(1, &visibleInfo);
+        if (frame.instanceSet == VK_NULL_HANDLE) {
+            instanceWriter.build(frame.instanceSet);
+        } else {
+            instanceWriter.overwrite(frame.instanceSet);
+        }
+
+        if (m_cullingMode == CullingMode::Cpu) {
+            return;
+        }
+        auto cullInfo = frame.cullData->descriptorInfo();
+        auto drawInfo = frame.drawCommands->descriptorInfo();
+        auto meshletInfo = frame.meshletBounds->descriptorInfo();
+        auto occludedInfo = frame.occludedFlags->descriptorInfo();
+        // Without a pyramid the shader never reads binding 5, but it still needs a valid buffer
+        auto hiZInfo = m_hiZPyramid != nullptr ? m_hiZPyramid->descriptorInfo() : occludedInfo;
+        DescriptorWriter cullWriter{ *m_cullSetLayout, *m_framePool };
+        cullWriter
+            .writeBuffer(0, &cullInfo)
+            .writeBuffer(1, &drawInfo)
+            .writeBuffer(2, &visibleInfo)
+            .writeBuffer(3, &instanceInfo)
+            .writeBuffer(4, &meshletInfo)
+            .writeBuffer(5, &hiZInfo)
+            .writeBuffer(6, &occludedInfo);
+        frame.hiZGeneration = m_hiZPyramid != nullptr ? m_hiZPyramid->getGeneration() : 0;
+        if (frame.cullSet == VK_NULL_HANDLE) {
+            cullWriter.build(frame.cullSet);
+        } else {
+            cullWriter.overwrite(frame.cullSet);
+        }
+    }
+
+    void SimpleRenderSystem::ensureCapacity(
+        FrameResources& frame,
+        uint32_t instanceCount,
+        uint32_t visibleCount,
+        uint32_t drawCount,
+        uint32_t meshletCount) {
+        // The fence for this frame index has already been waited on, so neither the old
+        // buffers nor the descriptor sets pointing at them are still in use by the GPU
+        bool resized = false;
+        if (instanceCount > frame.instances->getInstanceCount() ||
+            visibleCount > frame.visibleIndices->getInstanceCount()) {
+            createInstanceBuffers(
+                frame,
+                std::max(instanceCount, frame.instances->getInstanceCount() * 2),
+                std::max(visibleCount, frame.visibleIndices->getInstanceCount() * 2));
+            resized = true;
+        }
+        if (m_cullingMode == CullingMode::Gpu && drawCount > frame.drawCommands->getInstanceCount()) {
+            createDrawBuffer(frame, std::max(drawCount, frame.drawCommands->getInstanceCount() * 2));
+            resized = true;
+        }
+        if (m_cullingMode == CullingMode::Gpu && meshletCount > frame.meshletBounds->getInstanceCount()) {
+            createMeshletBuffer(frame, std::max(meshletCount, frame.meshletBounds->getInstanceCount() * 2));
+            resized = true;
+        }
+        // A resized pyramid was waited out like the buffers above
+        if (m_hiZPyramid != nullptr && frame.hiZGeneration != m_hiZPyramid->getGeneration()) {
+            resized = true;
+        }
+        if (resized) {
+            writeFrameDescriptors(frame);
+        }
     }
 
     void SimpleRenderSystem::createPipelineLayout(
         VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout textureSetLayout) {
-        VkPushConstantRange pushConstantRange{};
-        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-        pushConstantRange.offset = 0;
-        pushConstantRange.size = sizeof(SimplePushConstantData);
-
-        std::vector<VkDescriptorSetLayout> descriptorSetLayouts{ globalSetLayout, textureSetLayout };
+        std::vector<VkDescriptorSetLayout> descriptorSetLayouts{
+            globalSetLayout, textureSetLayout, m_instanceSetLayout->getDescriptorSetLayout() };
 
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
         pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-        pipelineLayoutInfo.pushConstantRangeCount = 1;
-        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        pipelineLayoutInfo.pushConstantRangeCount = 0;
+        pipelineLayoutInfo.pPushConstantRanges = nullptr;
         if (vkCreatePipelineLayout(m_device.device(), &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
             throw std::runtime_error("error while creating pipelineLayout");
         }
     }
-    void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
+    void SimpleRenderSystem::createPipelines(PipelineBuildQueue& pipelineQueue, VkRenderPass renderPass) {
         assert(m_pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
-        PipelineConfigInfo pipelineConfig{};
-        Pipeline::defaultPipelineConfigInfo(pipelineConfig);
+        const bool deferred = m_renderPath == RenderPath::Deferred;
+        std::string fragFilepath;
+        if (deferred) {
+            fragFilepath = isBindless() ? "shaders/gbuffer_bindless.frag.spv" : "shaders/gbuffer.frag.spv";
+        } else {
+            fragFilepath = isBindless() ? "shaders/simple_shader_bindless.frag.spv" : "shaders/simple_shader.frag.spv";
+        }
+        for (uint8_t permutation = 0; permutation < PERMUTATION_COUNT; permutation++) {
+            auto pipelineConfig = std::make_unique<PipelineConfigInfo>();
+            Pipeline::defaultPipelineConfigInfo(*pipelineConfig);
+            pipelineConfig->renderPass = renderPass;
+            pipelineConfig->pipelineLayout = m_pipelineLayout;
+            if (deferred) {
+                // Albedo and normal
+                pipelineConfig->colorAttachmentCount = 2;
+                pipelineConfig->subpass = SwapChain::GEOMETRY_SUBPASS;
+            }
+            if (m_depthPrePass && !(permutation & PERMUTATION_CUT_AWAY)) {
+                // Only the surface the pre-pass kept passes, and the depth it wrote stays
+                pipelineConfig->depthStencilInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+                pipelineConfig->depthStencilInfo.depthWriteEnable = VK_FALSE;
+            }
 
-        pipelineConfig.renderPass = renderPass;
-        pipelineConfig.pipelineLayout = m_pipelineLayout;
-        m_pipeline = std::make_unique<Pipeline>(
-            m_device,
-            "shaders/simple_shader.vert.spv",
-            "shaders/simple_shader.frag.spv",
-            pipelineConfig);
+            Pipeline::setSpecializationConstant(
+                *pipelineConfig, TEXTURED_CONSTANT_ID, (permutation & PERMUTATION_TEXTURED) ? VK_TRUE : VK_FALSE);
+            Pipeline::setSpecializationConstant(
+                *pipelineConfig, DISCARD_MODE_CONSTANT_ID,
+                (permutation & PERMUTATION_CUT_AWAY) ? DISCARD_CUT_AWAY : DISCARD_NONE);
+
+            m_pendingPipelines[permutation] = pipelineQueue.submit(
+                "shaders/simple_shader.vert.spv", fragFilepath, std::move(pipelineConfig));
+        }
+
+        if (!m_depthPrePass) {
+            return;
+        }
+        auto depthConfig = std::make_unique<PipelineConfigInfo>();
+        Pipeline::defaultPipelineConfigInfo(*depthConfig);
+        // Position only; the vertex buffer binding keeps its stride, so the same geometry binds
+        auto& attributes = depthConfig->attributeDescriptions;
+        attributes.erase(
+            std::remove_if(attributes.begin(), attributes.end(),
+                [](const VkVertexInputAttributeDescription& attribute) { return attribute.location != 0; }),
+            attributes.end());
+        // There is no fragment stage, but the subpass still has its color attachments
+        depthConfig->colorBlendAttachment.colorWriteMask = 0;
+        depthConfig->renderPass = renderPass;
+        depthConfig->pipelineLayout = m_pipelineLayout;
+        if (deferred) {
+            depthConfig->colorAttachmentCount = 2;
+            depthConfig->subpass = SwapChain::GEOMETRY_SUBPASS;
+        }
+        m_pendingDepthPipeline = pipelineQueue.submit("shaders/depth_only.vert.spv", "", std::move(depthConfig));
     }
 
-    void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
-        m_pipeline->bind(frameInfo.commandBuffer);
+    void SimpleRenderSystem::createCullPipeline(PipelineBuildQueue& pipelineQueue) {
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(CullPushConstantData);
+
+        VkDescriptorSetLayout cullSetLayout = m_cullSetLayout->getDescriptorSetLayout();
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &cullSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(m_device.device(), &pipelineLayoutInfo, nullptr, &m_cullPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("error while creating cull pipelineLayout");
+        }
+
+        m_pendingCullPipeline = pipelineQueue.submitCompute("shaders/instance_cull.comp.spv", m_cullPipelineLayout);
+    }
+
+    void SimpleRenderSystem::resolvePipelines() {
+        // get() rethrows anything the build threw on its worker
+        for (uint32_t i = 0; i < PERMUTATION_COUNT; i++) {
+            if (m_pendingPipelines[i].valid()) {
+                m_pipelines[i] = m_pendingPipelines[i].get();
+            }
+        }
+        if (m_pendingDepthPipeline.valid()) {
+            m_depthPipeline = m_pendingDepthPipeline.get();
+        }
+        if (m_pendingCullPipeline.valid()) {
+            m_cullPipeline = m_pendingCullPipeline.get();
+        }
+    }
+
+    bool SimpleRenderSystem::usesMeshlets(const DrawGroup& group) const {
+        // Multi-draws of several commands need pooled geometry
+        return m_cullingMode == CullingMode::Gpu && group.lod == 0 &&
+            !group.model->getMeshlets().empty() && group.model->getMeshPool() != nullptr;
+    }
+
+    void SimpleRenderSystem::readBackGpuCounts(FrameResources& frame) {
+        m_stats.gpuVisibleInstances = 0;
+        m_stats.gpuVisibleTriangles = 0;
+        m_stats.gpuDisoccludedInstances = 0;
+        m_stats.gpuCullingMismatches = 0;
+        m_stats.gpuCullingVerified = false;
+        if (frame.drawCount == 0) {
+            return;
+        }
+
+        frame.drawCommands->invalidate();
+        auto* commands = static_cast<VkDrawIndexedIndirectCommand*>(frame.drawCommands->getMappedMemory());
+        for (uint32_t i = 0; i < frame.drawCount * getPhaseCount(); i++) {
+            m_stats.gpuVisibleInstances += commands[i].instanceCount;
+            m_stats.gpuVisibleTriangles += commands[i].instanceCount * (commands[i].indexCount / 3);
+            if (i >= frame.drawCount) {
+                m_stats.gpuDisoccludedInstances += commands[i].instanceCount;
+            }
+        }
+        if (!m_verifyGpuCulling || frame.expectedCounts.size() != frame.drawCount) {
+            return;
+        }
+        // Each instance is drawn by at most one phase. Occlusion only ever removes instances,
+        // so then only the upper bound holds.
+        for (uint32_t i = 0; i < frame.drawCount; i++) {
+            uint32_t count = commands[i].instanceCount;
+            if (hasOcclusionCulling()) {
+                count += commands[frame.drawCount + i].instanceCount;
+            }
+            const uint32_t minCount = hasOcclusionCulling() ? 0 : frame.expectedCounts[i];
+            if (count < minCount || count > frame.expectedMaxCounts[i]) {
+                m_stats.gpuCullingMismatches++;
+            }
+        }
+        m_stats.gpuCullingVerified = true;
+        if (m_stats.gpuCullingMismatches > 0) {
+            std::cerr << "GPU culling disagrees with CullingSystem on "
+                << m_stats.gpuCullingMismatches << " of " << frame.drawCount << " draws" << std::endl;
+        }
+    }
+
+    void SimpleRenderSystem::prepareDraws(FrameInfo& frameInfo, const std::vector<uint32_t>& entities) {
+        resolvePipelines();
+        EntityManager& eManager = frameInfo.entityManager;
+        FrameResources& frame = m_frames[frameInfo.frameIndex];
+        if (m_cullingMode == CullingMode::Gpu) {
+            readBackGpuCounts(frame);
+        }
+
+        // Every (entity, texture) pair becomes one draw; entities without an ImageComponent
+        // draw with the default texture set. Transforms and bounds are computed once per
+        // entity and shared by all of its draws.
+        const glm::mat4 projectionView = frameInfo.camera.getProjection() * frameInfo.camera.getView();
+        m_drawInstances.clear();
+        m_entityData.clear();
+        m_entitySpheres.clear();
+        m_renderQueue.clear();
+        for (const uint32_t entityID : entities) {
+            if (!eManager.entityExists(entityID)) {
+                continue;
+            }
+            const ModelComponent& modelComponent = eManager.getComponentData<ModelComponent>(entityID);
+            Model* model = modelComponent.model.get();
+            const uint8_t lod = static_cast<uint8_t>(std::min(modelComponent.lod, model->getLodCount() - 1));
+            TransformComponent transform = eManager.getComponentData<TransformComponent>(entityID);
+            const BoundingSphere sphere = CullingSystem::getWorldSphere(*model, transform);
+
+            const uint32_t dataIndex = static_cast<uint32_t>(m_entityData.size());
+            m_entityData.push_back({ transform.mat4(), transform.normalMatrix() });
+            m_entitySpheres.push_back(glm::vec4(sphere.center, sphere.radius));
+
+            const glm::vec4 clip = projectionView * glm::vec4(sphere.center, 1.f);
+            const float depth = clip.w > 0.f ? clip.z / clip.w : 0.f;
+            // Each level of detail draws a different index range, so it counts as its own mesh
+            const uint16_t meshId = m_renderQueue.getMeshId(&model->getLod(lod));
+            // With bindless textures the texture travels with the instance, so it no longer
+            // splits draws into separate groups
+            auto pushDraw = [&](VkDescriptorSet* material, uint16_t textureBufferIndex, uint8_t permutation) {
+                if (isBindless()) {
+                    material = nullptr;
+                }
+                const uint32_t payload = static_cast<uint32_t>(m_drawInstances.size());
+                m_drawInstances.push_back({ model, material, textureBufferIndex, permutation, lod, dataIndex });
+                m_renderQueue.push(
+                    RenderQueue::makeKey(permutation, m_renderQueue.getMaterialId(material), meshId, depth),
+                    payload);
+            };
+
+            if (eManager.hasComponent<ImageComponent>(entityID)) {
+                const ImageComponent& imageComponent = eManager.getComponentData<ImageComponent>(entityID);
+                for (size_t i = 0; i < imageComponent.pDescriptorSet.size(); i++) {
+                    const uint16_t textureBufferIndex = imageComponent.textureBufferIndex.at(i);
+                    pushDraw(
+                        imageComponent.pDescriptorSet[i],
+                        textureBufferIndex,
+                        PERMUTATION_TEXTURED | (textureBufferIndex == 1 ? PERMUTATION_CUT_AWAY : 0));
+                }
+            } else {
+                pushDraw(nullptr, 0, 0);
+            }
+        }
+
+        const uint32_t instanceCount = static_cast<uint32_t>(m_drawInstances.size());
+        m_stats.instances = instanceCount;
+        m_stats.triangles = 0;
+        m_groups.clear();
+        frame.drawCount = 0;
+        if (instanceCount == 0) {
+            return;
+        }
+
+        // Keys order draws by pipeline, material, mesh and then front to back, so each run
+        // with the same state bits is one instanced group in the instance buffer
+        m_renderQueue.sort();
+        const auto& items = m_renderQueue.getItems();
+        for (uint32_t i = 0; i < instanceCount; i++) {
+            const uint64_t state = items[i].key >> RenderQueue::STATE_SHIFT;
+            if (i == 0 || state != (items[i - 1].key >> RenderQueue::STATE_SHIFT)) {
+                const DrawInstance& instance = m_drawInstances[items[i].payload];
+                m_groups.push_back({
+                    instance.model, instance.material, instance.textureBufferIndex, instance.permutation,
+                    instance.lod, i, 0, 0, 0, 0 });
+            }
+            m_groups.back().instanceCount++;
+        }
+        for (const DrawGroup& group : m_groups) {
+            m_stats.triangles += group.model->getIndexCount(group.lod) / 3 * group.instanceCount;
+        }
+        const uint32_t groupCount = static_cast<uint32_t>(m_groups.size());
+
+        // In Gpu mode each meshlet is a draw of its own, whose visible indices follow the
+        // per-group slices. Models share their meshlet bounds across groups.
+        uint32_t drawCount = 0;
+        uint32_t visibleCount = instanceCount;
+        uint32_t meshletCount = 0;
+        m_meshletOffsets.clear();
+        for (DrawGroup& group : m_groups) {
+            group.firstDraw = drawCount;
+            group.drawCount = 1;
+            group.firstMeshlet = 0;
+            if (usesMeshlets(group)) {
+                const auto [offset, inserted] = m_meshletOffsets.try_emplace(group.model, meshletCount);
+                group.drawCount = static_cast<uint32_t>(group.model->getMeshlets().size());
+                group.firstMeshlet = offset->second;
+                if (inserted) {
+                    meshletCount += group.drawCount;
+                }
+                visibleCount += group.drawCount * group.instanceCount;
+            }
+            drawCount += group.drawCount;
+        }
+
+        const uint32_t phaseCount = getPhaseCount();
+        ensureCapacity(frame, instanceCount, visibleCount * phaseCount, drawCount * phaseCount, meshletCount);
+        if (meshletCount > 0) {
+            auto* bounds = static_cast<MeshletBounds*>(frame.meshletBounds->getMappedMemory());
+            for (const auto& [model, offset] : m_meshletOffsets) {
+                const std::vector<Meshlet>& meshlets = model->getMeshlets();
+                for (size_t m = 0; m < meshlets.size(); m++) {
+                    bounds[offset + m] = { meshlets[m].sphere, meshlets[m].cone };
+                }
+            }
+            frame.meshletBounds->flush();
+        }
+        auto* instances = static_cast<InstanceData*>(frame.instances->getMappedMemory());
+        auto* cullData = m_cullingMode == CullingMode::Gpu ?
+            static_cast<CullData*>(frame.cullData->getMappedMemory()) : nullptr;
+        auto* visibleIndices = m_cullingMode == CullingMode::Cpu ?
+            static_cast<uint32_t*>(frame.visibleIndices->getMappedMemory()) : nullptr;
+        for (uint32_t g = 0; g < groupCount; g++) {
+            const DrawGroup& group = m_groups[g];
+            for (uint32_t i = group.firstInstance; i < group.firstInstance + group.instanceCount; i++) {
+                const DrawInstance& drawInstance = m_drawInstances[items[i].payload];
+                const uint32_t dataIndex = drawInstance.dataIndex;
+                instances[i] = m_entityData[dataIndex];
+                instances[i].textureIndex = drawInstance.textureBufferIndex;
+                if (cullData != nullptr) {
+                    const bool meshlets = usesMeshlets(group);
+                    cullData[i].sphere = m_entitySpheres[dataIndex];
+                    cullData[i].drawIndex = group.firstDraw;
+                    cullData[i].firstMeshlet = group.firstMeshlet;
+                    cullData[i].meshletCount = meshlets ? group.drawCount : 0;
+                    cullData[i].flags = meshlets && isUniformlyScaled(instances[i].modelMatrix) ? CULL_CONE : 0;
+                } else {
+                    visibleIndices[i] = i;
+                }
+            }
+        }
+        frame.instances->flush();
+
+        if (m_cullingMode == CullingMode::Cpu) {
+            frame.visibleIndices->flush();
+            return;
+        }
+        frame.cullData->flush();
+        recordCulling(frameInfo, frame);
+    }
+
+    void SimpleRenderSystem::recordCulling(FrameInfo& frameInfo, FrameResources& frame) {
+        const uint32_t groupCount = static_cast<uint32_t>(m_groups.size());
+
+        // The compute pass only fills in instanceCount; everything else is known on the host.
+        // Meshlet draws take their visible index slices after the per-group ones.
+        auto* commands = static_cast<VkDrawIndexedIndirectCommand*>(frame.drawCommands->getMappedMemory());
+        uint32_t nextVisible = m_stats.instances;
+        uint32_t drawCount = 0;
+        for (uint32_t g = 0; g < groupCount; g++) {
+            const DrawGroup& group = m_groups[g];
+            if (!usesMeshlets(group)) {
+                VkDrawIndexedIndirectCommand& command = commands[group.firstDraw];
+                command.indexCount = group.model->getIndexCount(group.lod);
+                command.instanceCount = 0;
+                command.firstIndex = group.model->getFirstIndex(group.lod);
+                command.vertexOffset = group.model->getVertexOffset();
+                command.firstInstance = group.firstInstance;
+            } else {
+                const std::vector<Meshlet>& meshlets = group.model->getMeshlets();
+                for (uint32_t m = 0; m < group.drawCount; m++) {
+                    VkDrawIndexedIndirectCommand& command = commands[group.firstDraw + m];
+                    command.indexCount = meshlets[m].indexCount;
+                    command.instanceCount = 0;
+                    command.firstIndex = group.model->getFirstIndex(meshlets[m]);
+                    command.vertexOffset = group.model->getVertexOffset();
+                    command.firstInstance = nextVisible;
+                    nextVisible += group.instanceCount;
+                }
+            }
+            drawCount += group.drawCount;
+        }
+        // The second phase's draws repeat the first's, each with the same slice shifted past
+        // every slice of the first
+        if (hasOcclusionCulling()) {
+            for (uint32_t i = 0; i < drawCount; i++) {
+                commands[drawCount + i] = commands[i];
+                commands[drawCount + i].firstInstance += nextVisible;
+            }
+        }
+        frame.drawCommands->flush();
+        frame.drawCount = drawCount;
+
+        // CPU reference, compared against the GPU result once this frame's fence is waited on
+        frame.expectedCounts.clear();
+        frame.expectedMaxCounts.clear();
+        if (m_verifyGpuCulling) {
+            computeExpectedCounts(frameInfo, frame, drawCount);
+        }
+
+        dispatchCulling(frameInfo, frame, 0);
+    }
+
+    void SimpleRenderSystem::computeExpectedCounts(FrameInfo& frameInfo, FrameResources& frame, uint32_t drawCount) {
+        const Frustum frustum = frameInfo.camera.getFrustum();
+        auto* cullData = static_cast<CullData*>(frame.cullData->getMappedMemory());
+        auto* instances = static_cast<InstanceData*>(frame.instances->getMappedMemory());
+        // Once with every sphere shrunk by the tolerance and once with them grown, which
+        // brackets whatever rounding the GPU does at a boundary
+        auto countDraws = [&](float margin, std::vector<uint32_t>& counts) {
+            counts.assign(drawCount, 0);
+            // Every instance's sphere in one batch, then the meshlets of the ones that passed
+            m_referenceSpheres.resize(m_stats.instances);
+            for (uint32_t i = 0; i < m_stats.instances; i++) {
+                m_referenceSpheres[i] = cullData[i].sphere + glm::vec4{ 0.f, 0.f, 0.f, margin };
+            }
+            CullingSystem::testSpheres(frustum, m_referenceSpheres, m_referenceVisible);
+            for (const DrawGroup& group : m_groups) {
+                for (uint32_t i = group.firstInstance; i < group.firstInstance + group.instanceCount; i++) {
+                    if (!m_referenceVisible[i]) {
+                        continue;
+                    }
+                    if (cullData[i].meshletCount == 0) {
+                        counts[cullData[i].drawIndex]++;
+                        continue;
+                    }
+                    for (uint32_t m = 0; m < cullData[i].meshletCount; m++) {
+                        if (CullingSystem::isMeshletVisible(
+                            frustum,
+                            frameInfo.camera.getPosition(),
+                            group.model->getMeshlets()[m],
+                            instances[i].modelMatrix,
+                            glm::mat3(instances[i].normalMatrix),
+                            (cullData[i].flags & CULL_CONE) != 0,
+                            margin)) {
+                            counts[cullData[i].drawIndex + m]++;
+                        }
+                    }
+                }
+            }
+        };
+        countDraws(-CullingSystem::REFERENCE_TOLERANCE, frame.expectedCounts);
+        countDraws(CullingSystem::REFERENCE_TOLERANCE, frame.expectedMaxCounts);
+    }
+
+    void SimpleRenderSystem::cullDisoccluded(FrameInfo& frameInfo, VkImageView depthView) {
+        assert(hasOcclusionCulling() && "cullDisoccluded needs occlusion culling");
+        m_hiZPyramid->build(
+            frameInfo, depthView, frameInfo.camera.getProjection() * frameInfo.camera.getView());
+        // The build ends with a compute to compute barrier, which also makes the first phase's
+        // flags visible here
+        FrameResources& frame = m_frames[frameInfo.frameIndex];
+        if (frame.drawCount > 0) {
+            dispatchCulling(frameInfo, frame, 1);
+        }
+    }
+
+    void SimpleRenderSystem::dispatchCulling(FrameInfo& frameInfo, FrameResources& frame, uint32_t phase) {
+        const Frustum frustum = frameInfo.camera.getFrustum();
+        CullPushConstantData push{};
+        for (int i = 0; i < 6; i++) {
+            push.planes[i] = frustum.planes[i];
+        }
+        push.cameraPosition = glm::vec4(frameInfo.camera.getPosition(), 1.f);
+        push.instanceCount = m_stats.instances;
+        push.phase = phase;
+        push.drawCount = frame.drawCount;
+        push.occlusion = hasOcclusionCulling() && m_hiZPyramid->isBuilt() ? 1 : 0;
+
+        m_cullPipeline->bind(frameInfo.commandBuffer);
         vkCmdBindDescriptorSets(
             frameInfo.commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_cullPipelineLayout,
+            0,
+            1,
+            &frame.cullSet,
+            0,
+            nullptr
+        );
+        vkCmdPushConstants(
+            frameInfo.commandBuffer,
+            m_cullPipelineLayout,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0,
+            sizeof(CullPushConstantData),
+            &push
+        );
+        vkCmdDispatch(
+            frameInfo.commandBuffer,
+            (m_stats.instances + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE,
+            1,
+            1);
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        // The host reads the counts back once the frame's fence signals, see readBackGpuCounts
+        barrier.dstAccessMask =
+            VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+            0,
+            1,
+            &barrier,
+            0,
+            nullptr,
+            0,
+            nullptr
+        );
+    }
+
+    void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
+        assert(m_pipelines[0] && "prepareDraws must run before renderGameObjects");
+        assert(!hasOcclusionCulling() &&
+            "Occlusion culling draws its second phase through renderDisoccluded; record with a CommandRecorder");
+        m_stats.drawCalls = 0;
+        m_stats.pipelineBinds = 0;
+        m_stats.descriptorSetBinds = 0;
+        m_stats.geometryBinds = 0;
+        if (m_depthPrePass) {
+            beginScope(frameInfo, frameInfo.commandBuffer, GpuScope::DepthPrePass);
+            recordGroups(frameInfo, frameInfo.commandBuffer, 0, m_groups.size(), 0, true, m_stats);
+            endScope(frameInfo, frameInfo.commandBuffer, GpuScope::DepthPrePass);
+        }
+        beginScope(frameInfo, frameInfo.commandBuffer, GpuScope::Opaque);
+        recordGroups(frameInfo, frameInfo.commandBuffer, 0, m_groups.size(), 0, false, m_stats);
+        endScope(frameInfo, frameInfo.commandBuffer, GpuScope::Opaque);
+    }
+
+    void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo, CommandRecorder& recorder) {
+        assert(m_pipelines[0] && "prepareDraws must run before renderGameObjects");
+        m_stats.drawCalls = 0;
+        m_stats.pipelineBinds = 0;
+        m_stats.descriptorSetBinds = 0;
+        m_stats.geometryBinds = 0;
+        if (m_groups.empty()) {
+            return;
+        }
+        // A separate set of jobs, so every pre-pass buffer executes before any shading one
+        if (m_depthPrePass) {
+            recordJobs(frameInfo, recorder, 0, true, GpuScope::DepthPrePass, true, true);
+        }
+        recordJobs(frameInfo, recorder, 0, false, GpuScope::Opaque, true, true);
+    }
+
+    void SimpleRenderSystem::renderDisoccluded(FrameInfo& frameInfo, CommandRecorder& recorder) {
+        assert(hasOcclusionCulling() && "renderDisoccluded needs occlusion culling");
+        if (m_groups.empty()) {
+            return;
+        }
+        // One scope over both sets of jobs, since each scope is timed once per frame
+        if (m_depthPrePass) {
+            recordJobs(frameInfo, recorder, 1, true, GpuScope::Disoccluded, true, false);
+        }
+        recordJobs(frameInfo, recorder, 1, false, GpuScope::Disoccluded, !m_depthPrePass, true);
+    }
+
+    void SimpleRenderSystem::recordJobs(
+        FrameInfo& frameInfo,
+        CommandRecorder& recorder,
+        uint32_t phase,
+        bool depthOnly,
+        GpuScope scope,
+        bool opensScope,
+        bool closesScope) {
+        const size_t groupCount = m_groups.size();
+        const size_t jobCount = std::min<size_t>(
+            recorder.getWorkerCount(), (groupCount + MIN_GROUPS_PER_JOB - 1) / MIN_GROUPS_PER_JOB);
+        const size_t groupsPerJob = (groupCount + jobCount - 1) / jobCount;
+        m_jobStats.assign(jobCount, RenderStats{});
+        recorder.record(static_cast<uint32_t>(jobCount), [&](uint32_t job, VkCommandBuffer commandBuffer) {
+            if (job == 0 && opensScope) {
+                beginScope(frameInfo, commandBuffer, scope);
+            }
+            const size_t firstGroup = job * groupsPerJob;
+            recordGroups(
+                frameInfo,
+                commandBuffer,
+                firstGroup,
+                std::min(groupCount, firstGroup + groupsPerJob),
+                phase,
+                depthOnly,
+                m_jobStats[job]);
+            if (job == jobCount - 1 && closesScope) {
+                endScope(frameInfo, commandBuffer, scope);
+            }
+        });
+
+        for (const RenderStats& jobStats : m_jobStats) {
+            m_stats.drawCalls += jobStats.drawCalls;
+            m_stats.pipelineBinds += jobStats.pipelineBinds;
+            m_stats.descriptorSetBinds += jobStats.descriptorSetBinds;
+            m_stats.geometryBinds += jobStats.geometryBinds;
+        }
+    }
+
+    void SimpleRenderSystem::recordGroups(
+        FrameInfo& frameInfo,
+        VkCommandBuffer commandBuffer,
+        size_t firstGroup,
+        size_t endGroup,
+        uint32_t phase,
+        bool depthOnly,
+        RenderStats& stats) {
+        if (firstGroup >= endGroup) {
+            return;
+        }
+        FrameResources& frame = m_frames[frameInfo.frameIndex];
+        const uint32_t drawOffset = phase * frame.drawCount;
+
+        vkCmdBindDescriptorSets(
+            commandBuffer,
             VK_PIPELINE_BIND_POINT_GRAPHICS,
             m_pipelineLayout,
             0,
@@ -77,56 +834,122 @@ namespace engine {
             0,
             nullptr
         );
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            m_pipelineLayout,
+            2,
+            1,
+            &frame.instanceSet,
+            0,
+            nullptr
+        );
+        stats.descriptorSetBinds += 2;
+        if (isBindless() && !depthOnly) {
+            vkCmdBindDescriptorSets(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                m_pipelineLayout,
+                1,
+                1,
+                &m_bindlessTextureSet,
+                0,
+                nullptr
+            );
+            stats.descriptorSetBinds++;
+        }
 
-        auto projectionView = frameInfo.camera.getProjection() * frameInfo.camera.getView();
-
-        for (const uint32_t entityID : frameInfo.entityManager.getEntitiesWithComponent(ComponentType::Model)) {
-            if (frameInfo.entityManager.entityExists(entityID)) {
-                ModelComponent modelComponent = 
-                    frameInfo.entityManager.getComponentData<ModelComponent>(entityID);
-                TransformComponent transformComponent = 
-                    frameInfo.entityManager.getComponentData<TransformComponent>(entityID);
-
-                SimplePushConstantData push{};
-                push.modelMatrix = transformComponent.mat4();
-                push.normalMatrix = transformComponent.normalMatrix();
-
-                vkCmdPushConstants(
-                    frameInfo.commandBuffer,
-                    m_pipelineLayout,
-                    VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                    0,
-                    sizeof(SimplePushConstantData),
-                    &push
-                );
-                if (frameInfo.entityManager.hasComponent<ImageComponent>(entityID)){
-                    int i = 0;
-                    ImageComponent imageComponent = 
-                        frameInfo.entityManager.getComponentData<ImageComponent>(entityID);
-                    for (const auto pDescriptor : imageComponent.pDescriptorSet) {
-                        TextureData tex{};
-                        tex.texIndex = imageComponent.textureBufferIndex.at(i);
-                        frameInfo.textureBuffers[imageComponent.textureBufferIndex.at(i)]->writeToBuffer(&tex);
-                        frameInfo.textureBuffers[imageComponent.textureBufferIndex.at(i)]->flush();
-                        vkCmdBindDescriptorSets(
-                            frameInfo.commandBuffer,
-                            VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            m_pipelineLayout,
-                            1,
-                            1,
-                            pDescriptor,
-                            0,
-                            nullptr
-                        );
-                        modelComponent.model->bind(frameInfo.commandBuffer);
-                        modelComponent.model->draw(frameInfo.commandBuffer);
-                        i++;
-                    }
-                } else {
-                    modelComponent.model->bind(frameInfo.commandBuffer);
-                    modelComponent.model->draw(frameInfo.commandBuffer);
+        // Models in a MeshPool share one vertex/index binding, so only switching pools
+        // (or drawing a model that owns its buffers) needs a rebind
+        const uint32_t maxDrawsPerCall = m_device.features.multiDrawIndirect ?
+            m_device.properties.limits.maxDrawIndirectCount : 1;
+        VkDescriptorSet* boundMaterial = nullptr;
+        const void* boundGeometry = nullptr;
+        const Pipeline* boundPipeline = nullptr;
+        // The pre-pass skips groups that discard; they write their own depth in the main pass
+        auto inPass = [&](const DrawGroup& group) {
+            return !depthOnly || !(group.permutation & PERMUTATION_CUT_AWAY);
+        };
+        size_t g = firstGroup;
+        while (g < endGroup) {
+            const DrawGroup& group = m_groups[g];
+            if (!inPass(group)) {
+                g++;
+                continue;
+            }
+            // Groups are sorted by permutation first, so each pipeline is bound once per range.
+            // Sets stay bound across the switch because every permutation shares the layout.
+            Pipeline* pipeline = depthOnly ? m_depthPipeline.get() : m_pipelines[group.permutation].get();
+            if (pipeline != boundPipeline) {
+                pipeline->bind(commandBuffer);
+                boundPipeline = pipeline;
+                stats.pipelineBinds++;
+            }
+            // depth_only.vert never reads set 1, and the bindless set is already bound. A range
+            // recorded into its own secondary buffer starts with nothing bound, so untextured
+            // groups bind the default set rather than count on an earlier group's.
+            if (!depthOnly && !isBindless()) {
+                VkDescriptorSet* material = group.material != nullptr ? group.material : &m_defaultTextureSet;
+                if (material != boundMaterial) {
+                    vkCmdBindDescriptorSets(
+                        commandBuffer,
+                        VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        m_pipelineLayout,
+                        1,
+                        1,
+                        material,
+                        0,
+                        nullptr
+                    );
+                    boundMaterial = material;
+                    stats.descriptorSetBinds++;
                 }
             }
+
+            const MeshPool* meshPool = group.model->getMeshPool();
+            const void* geometry = meshPool != nullptr ?
+                static_cast<const void*>(meshPool) : static_cast<const void*>(group.model);
+            if (geometry != boundGeometry) {
+                group.model->bind(commandBuffer);
+                boundGeometry = geometry;
+                stats.geometryBinds++;
+            }
+
+            // firstInstance offsets gl_InstanceIndex into this group's slice of the visible indices
+            if (m_cullingMode == CullingMode::Cpu) {
+                group.model->draw(commandBuffer, group.instanceCount, group.firstInstance, group.lod);
+                stats.drawCalls++;
+                g++;
+                continue;
+            }
+
+            // Following groups with the same texture and pool go into the same multi-draw; the
+            // pre-pass binds neither, so there only the pool has to match
+            auto sameState = [&](const DrawGroup& next) {
+                if (depthOnly) {
+                    return inPass(next);
+                }
+                return next.material == group.material && next.permutation == group.permutation;
+            };
+            // Groups are merged whole; a meshlet group larger than the limit is split below
+            uint32_t groupCount = 1;
+            uint32_t drawCount = group.drawCount;
+            while (meshPool != nullptr && g + groupCount < endGroup &&
+                drawCount + m_groups[g + groupCount].drawCount <= maxDrawsPerCall &&
+                sameState(m_groups[g + groupCount]) &&
+                m_groups[g + groupCount].model->getMeshPool() == meshPool) {
+                drawCount += m_groups[g + groupCount].drawCount;
+                groupCount++;
+            }
+            for (uint32_t first = 0; first < drawCount; first += maxDrawsPerCall) {
+                group.model->drawIndirect(
+                    commandBuffer,
+                    frame.drawCommands->getBuffer(),
+                    (drawOffset + group.firstDraw + first) * sizeof(VkDrawIndexedIndirectCommand),
+                    std::min(maxDrawsPerCall, drawCount - first));
+                stats.drawCalls++;
+            }
+            g += groupCount;
         }
     }
 } // namespace engine
@@ -1,31 +1,257 @@
 #pragma once
 
 #include "Pipeline.hpp"
+#include "PipelineBuildQueue.hpp"
 #include "FrameInfo.hpp"
+#include "Descriptors.hpp"
+#include "SwapChain.hpp"
+#include "RenderQueue.hpp"
+#include "CommandRecorder.hpp"
+#include "HiZPyramid.hpp"
+#include "GpuCullingData.hpp"
+
+#include <array>
+#include <unordered_map>
 
 namespace engine {
 
+	enum class CullingMode {
+		// Caller passes the entities that survived CullingSystem
+		Cpu,
+		// Caller passes every Model entity; instance_cull.comp culls them and fills indirect
+		// draws. Full detail models with meshlets draw each meshlet separately, culled by
+		// its own sphere and normal cone.
+		Gpu
+	};
+
+	struct RenderStats {
+		uint32_t instances{ 0 };
+		// Triangles of every instance at its level of detail, before GPU culling
+		uint32_t triangles{ 0 };
+		uint32_t drawCalls{ 0 };
+		// Binds actually recorded after redundant ones were skipped
+		uint32_t pipelineBinds{ 0 };
+		uint32_t descriptorSetBinds{ 0 };
+		uint32_t geometryBinds{ 0 };
+		// Gpu mode only, read back MAX_FRAMES_IN_FLIGHT frames late: instances the GPU kept,
+		// counting each kept meshlet of an instance once, and the triangles they draw
+		uint32_t gpuVisibleInstances{ 0 };
+		uint32_t gpuVisibleTriangles{ 0 };
+		// Occlusion culling only: the part of gpuVisibleInstances the second phase drew
+		uint32_t gpuDisoccludedInstances{ 0 };
+		// Gpu mode with verification on: whether the frame read back was checked against the CPU
+		// test, and its draws whose count differed from it, or exceeded it with occlusion culling,
+		// which the CPU test leaves out
+		bool gpuCullingVerified{ false };
+		uint32_t gpuCullingMismatches{ 0 };
+	};
+
 	class SimpleRenderSystem {
 	public:
+		static constexpr uint32_t INITIAL_INSTANCE_CAPACITY = 1024;
+		static constexpr uint32_t INITIAL_DRAW_CAPACITY = 64;
+		static constexpr uint32_t INITIAL_MESHLET_CAPACITY = 256;
+		// Below this many groups per secondary buffer the extra binds cost more than they save
+		static constexpr uint32_t MIN_GROUPS_PER_JOB = 32;
+		// Shader permutations, one pipeline each, picked per draw and stored in the pipeline
+		// field of the render queue sort key. The bits become specialization constants, so the
+		// fragment shader has no per-fragment branches on them.
+		static constexpr uint8_t PERMUTATION_TEXTURED = 1 << 0;
+		// Discards the half of the surface with u > 0.5; used by texture slot 1
+		static constexpr uint8_t PERMUTATION_CUT_AWAY = 1 << 1;
+		static constexpr uint32_t PERMUTATION_COUNT = 4;
 
+		// Gpu culling falls back to Cpu when the device lacks drawIndirectFirstInstance.
+		// Passing bindlessTextureSet switches to bindless textures: textureSetLayout is then the
+		// layout of that set (one sampler array), which is bound once per frame while each
+		// instance carries its texture index. Otherwise each texture has its own set, and
+		// defaultTextureSet, of textureSetLayout, is bound for draws without a texture: the
+		// untextured permutation never samples it, but its layout still declares set 1.
+		// Pipelines compile on pipelineQueue; the first prepareDraws waits for them.
+		// With RenderPath::Deferred draws go to the geometry subpass and only write the G-buffer.
+		// depthPrePass first draws every opaque group through depth_only.vert with no fragment
+		// stage; the shading pipelines then test EQUAL without writing depth, so each pixel is
+		// shaded once however much geometry overlaps it. Cut-away groups discard fragments, so
+		// they stay out of the pre-pass and keep testing LESS and writing depth.
+		// hiZPyramid turns on two-phase occlusion culling, for Gpu mode on the forward path. The
+		// first phase draws what the pyramid of the previous frame's depth does not hide; the
+		// pyramid is then rebuilt from that depth and the second phase draws whatever it hid
+		// that the new pyramid shows. See renderDisoccluded and cullDisoccluded.
 		SimpleRenderSystem(
-			Device& device, 
+			Device& device,
+			PipelineBuildQueue& pipelineQueue,
 			VkRenderPass renderPass,
 			VkDescriptorSetLayout globalSetLayout,
-			VkDescriptorSetLayout textureSetLayout
+			VkDescriptorSetLayout textureSetLayout,
+			VkDescriptorSet defaultTextureSet,
+			CullingMode cullingMode = CullingMode::Cpu,
+			VkDescriptorSet bindlessTextureSet = VK_NULL_HANDLE,
+			RenderPath renderPath = RenderPath::Forward,
+			bool depthPrePass = false,
+			HiZPyramid* hiZPyramid = nullptr
 		);
 		~SimpleRenderSystem();
 
 		SimpleRenderSystem(const SimpleRenderSystem&) = delete;
 		SimpleRenderSystem& operator=(const SimpleRenderSystem&) = delete;
 
+		// Sorts the given entities through the render queue, groups them by (texture, Model) and
+		// uploads their instance data. In Gpu mode this also records the culling dispatch, so it
+		// must run outside the render pass.
+		void prepareDraws(FrameInfo& frameInfo, const std::vector<uint32_t>& entities);
+		// Entities sharing a (Model, texture) pair are drawn with a single instanced call. With
+		// a depth pre-pass it is recorded first, and both passes are timed through
+		// frameInfo.gpuTimer when it is set. Not for occlusion culling, whose second phase only
+		// renderDisoccluded records.
 		void renderGameObjects(FrameInfo& frameInfo);
+		// Same draws, split into contiguous group ranges recorded in parallel into secondary
+		// command buffers. The caller begins the render pass with SECONDARY_COMMAND_BUFFERS
+		// and executes the recorder's buffers. With occlusion culling this is the first phase.
+		void renderGameObjects(FrameInfo& frameInfo, CommandRecorder& recorder);
+		// Occlusion culling only: records the second phase's draws after renderGameObjects. Its
+		// buffers belong in the late render pass, after cullDisoccluded filled their counts.
+		void renderDisoccluded(FrameInfo& frameInfo, CommandRecorder& recorder);
+		// Occlusion culling only, outside any render pass once the first phase's draws ended the
+		// early render pass: rebuilds the pyramid from depthView, then records the second phase
+		// of culling against it
+		void cullDisoccluded(FrameInfo& frameInfo, VkImageView depthView);
+
+		CullingMode getCullingMode() const { return m_cullingMode; }
+		RenderPath getRenderPath() const { return m_renderPath; }
+		bool hasDepthPrePass() const { return m_depthPrePass; }
+		bool hasOcclusionCulling() const { return m_hiZPyramid != nullptr; }
+		bool isBindless() const { return m_bindlessTextureSet != VK_NULL_HANDLE; }
+		const RenderStats& getStats() const { return m_stats; }
+		// Gpu mode: also culls every frame on the CPU with CullingSystem's reference tests and
+		// compares the counts once the GPU's come back, see RenderStats::gpuCullingMismatches
+		void setGpuCullingVerification(bool enabled) { m_verifyGpuCulling = enabled; }
 	private:
+		struct DrawInstance {
+			Model* model;
+			VkDescriptorSet* material;
+			uint16_t textureBufferIndex;
+			uint8_t permutation;
+			uint8_t lod;
+			// Index into m_entityData/m_entitySpheres
+			uint32_t dataIndex;
+		};
+
+		struct DrawGroup {
+			Model* model;
+			VkDescriptorSet* material;
+			uint16_t textureBufferIndex;
+			uint8_t permutation;
+			uint8_t lod;
+			uint32_t firstInstance;
+			uint32_t instanceCount;
+			// Gpu mode: this group's indirect draws, one per meshlet when it has them, and
+			// where its model's meshlets start in the frame's meshlet buffer
+			uint32_t firstDraw;
+			uint32_t drawCount;
+			uint32_t firstMeshlet;
+		};
+
+		struct FrameResources {
+			std::unique_ptr<Buffer> instances;
+			std::unique_ptr<Buffer> visibleIndices;
+			std::unique_ptr<Buffer> cullData;
+			std::unique_ptr<Buffer> drawCommands;
+			std::unique_ptr<Buffer> meshletBounds;
+			std::unique_ptr<Buffer> occludedFlags;
+			VkDescriptorSet instanceSet = VK_NULL_HANDLE;
+			VkDescriptorSet cullSet = VK_NULL_HANDLE;
+			// Generation of the pyramid cullSet points at
+			uint32_t hiZGeneration = 0;
+			// Draws of one culling phase; with occlusion culling the second phase's copies follow
+			uint32_t drawCount = 0;
+			// CPU reference counts of the instances surely inside and of those maybe inside,
+			// within CullingSystem::REFERENCE_TOLERANCE of a boundary
+			std::vector<uint32_t> expectedCounts;
+			std::vector<uint32_t> expectedMaxCounts;
+		};
+
+		void createFrameResources();
+		// CPU reference instance counts of every first phase draw, into frame.expectedCounts
+		// and frame.expectedMaxCounts
+		void computeExpectedCounts(FrameInfo& frameInfo, FrameResources& frame, uint32_t drawCount);
+		// Meshlet draws need visible index slices of their own, so in Gpu mode
+		// visibleCapacity can exceed instanceCapacity
+		void createInstanceBuffers(FrameResources& frame, uint32_t instanceCapacity, uint32_t visibleCapacity);
+		void createDrawBuffer(FrameResources& frame, uint32_t drawCapacity);
+		void createMeshletBuffer(FrameResources& frame, uint32_t meshletCapacity);
+		void writeFrameDescriptors(FrameResources& frame);
+		void ensureCapacity(
+			FrameResources& frame,
+			uint32_t instanceCount,
+			uint32_t visibleCount,
+			uint32_t drawCount,
+			uint32_t meshletCount);
+		bool usesMeshlets(const DrawGroup& group) const;
+		// Two with occlusion culling, each with its own draws and visible index slices
+		uint32_t getPhaseCount() const { return hasOcclusionCulling() ? 2 : 1; }
+		void readBackGpuCounts(FrameResources& frame);
+		void recordCulling(FrameInfo& frameInfo, FrameResources& frame);
+		void dispatchCulling(FrameInfo& frameInfo, FrameResources& frame, uint32_t phase);
+		// Splits the groups across the recorder's workers; the first job opens scope and the
+		// last closes it, which holds since secondary buffers execute in record order
+		void recordJobs(
+			FrameInfo& frameInfo,
+			CommandRecorder& recorder,
+			uint32_t phase,
+			bool depthOnly,
+			GpuScope scope,
+			bool opensScope,
+			bool closesScope);
+		// depthOnly records the pre-pass: one pipeline, no materials and no cut-away groups.
+		// phase picks which culling phase's indirect draws are used.
+		void recordGroups(
+			FrameInfo& frameInfo,
+			VkCommandBuffer commandBuffer,
+			size_t firstGroup,
+			size_t endGroup,
+			uint32_t phase,
+			bool depthOnly,
+			RenderStats& stats);
+
 		void createPipelineLayout(VkDescriptorSetLayout globalSetLayout, VkDescriptorSetLayout textureSetLayout);
-		void createPipeline(VkRenderPass renderPass);
+		void createPipelines(PipelineBuildQueue& pipelineQueue, VkRenderPass renderPass);
+		void createCullPipeline(PipelineBuildQueue& pipelineQueue);
+		// Takes ownership of the pipelines once their builds finish, blocking if they have not
+		void resolvePipelines();
 
 		Device& m_device;
-		std::unique_ptr<Pipeline> m_pipeline;
+		std::array<std::shared_ptr<Pipeline>, PERMUTATION_COUNT> m_pipelines;
 		VkPipelineLayout m_pipelineLayout;
+		std::shared_ptr<ComputePipeline> m_cullPipeline;
+		std::array<std::future<std::shared_ptr<Pipeline>>, PERMUTATION_COUNT> m_pendingPipelines;
+		std::shared_ptr<Pipeline> m_depthPipeline;
+		std::future<std::shared_ptr<Pipeline>> m_pendingDepthPipeline;
+		std::future<std::shared_ptr<ComputePipeline>> m_pendingCullPipeline;
+		VkPipelineLayout m_cullPipelineLayout = VK_NULL_HANDLE;
+		CullingMode m_cullingMode;
+		bool m_verifyGpuCulling = false;
+		// Scratch of computeExpectedCounts, one per instance
+		std::vector<glm::vec4> m_referenceSpheres;
+		std::vector<uint8_t> m_referenceVisible;
+		VkDescriptorSet m_bindlessTextureSet;
+		VkDescriptorSet m_defaultTextureSet;
+		RenderPath m_renderPath;
+		bool m_depthPrePass;
+		HiZPyramid* m_hiZPyramid;
+
+		std::unique_ptr<DescriptorSetLayout> m_instanceSetLayout;
+		std::unique_ptr<DescriptorSetLayout> m_cullSetLayout;
+		std::unique_ptr<DescriptorPool> m_framePool;
+		std::vector<FrameResources> m_frames;
+
+		RenderQueue m_renderQueue;
+		std::vector<InstanceData> m_entityData;
+		std::vector<glm::vec4> m_entitySpheres;
+		std::vector<DrawInstance> m_drawInstances;
+		std::vector<DrawGroup> m_groups;
+		// Start of each model's meshlets in the frame's meshlet buffer
+		std::unordered_map<const Model*, uint32_t> m_meshletOffsets;
+		std::vector<RenderStats> m_jobStats;
+		RenderStats m_stats{};
 	};
 } // namespace engine